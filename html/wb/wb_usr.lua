@@ -370,6 +370,7 @@ wb_usr.tree =
             { link= "doxygen/im__palette_8h.html", name= {en= "im_palette.h" } },
             { link= "doxygen/im__plus_8h.html", name= {en= "im_plus.h" } },
             { link= "doxygen/im__process__ana_8h.html", name= {en= "im_process_ana.h" } },
+            { link= "doxygen/im__process__expr_8h.html", name= {en= "im_process_expr.h" } },
             { link= "doxygen/im__process__glo_8h.html", name= {en= "im_process_glo.h" } },
             { link= "doxygen/im__process__loc_8h.html", name= {en= "im_process_loc.h" } },
             { link= "doxygen/im__process__pnt_8h.html", name= {en= "im_process_pnt.h" } },
@@ -244,7 +244,29 @@ int imFileWriteImageInfo(imFile* ifile, int width, int height, int user_color_mo
  * \verbatim ifile:ReadImageData(data: userdata, convert2bitmap: boolean, color_mode_flags: number) -> error: number [in Lua 5] \endverbatim
  * \ingroup file */
 int imFileReadImageData(imFile* ifile, void* data, int convert2bitmap, int color_mode_flags);
-                           
+
+/** Callback used by \ref imFileReadImageLines and \ref imFileWriteImageLines. \n
+ * Receives a band with line_count lines starting at line_start,
+ * organized as the data of \ref imFileReadImageData or \ref imFileWriteImageData for an image with line_count lines. \n
+ * When reading the band contains the lines read, when writing the callback must fill the band. \n
+ * The band data is valid only during the callback. Must return zero to interrupt the reading or writing.
+ * \ingroup file */
+typedef int (*imFileLinesCallback)(imFile* ifile, void* data, int line_start, int line_count, void* user_data);
+
+/** Reads the image data in bands of band_height lines, with the same conversions of \ref imFileReadImageData. \n
+ * Each band is sent to the callback as soon as all its lines are decoded,
+ * so the full image is never allocated. Bands are usually sent from the first to the last line of the file,
+ * but when the file and the user have different top-bottom orientations, or the file is interlaced,
+ * the order changes, use line_start to place the band. \n
+ * If band_height is 0 or larger than the image height, the image is sent in one band.
+ * Some formats (like ICO) always send the image in one band.
+ * If the color components are stored in separated planes in the file
+ * the bands are completed only when the last plane is read. \n
+ * If the callback interrupts the reading the remaining lines are discarded and IM_ERR_COUNTER is returned. \n
+ * Returns an error code.
+ * \ingroup file */
+int imFileReadImageLines(imFile* ifile, imFileLinesCallback callback, void* user_data, int band_height, int convert2bitmap, int color_mode_flags);
+
 /** Writes the image data. \n
  * Returns an error code.
  *
@@ -252,6 +274,19 @@ int imFileReadImageData(imFile* ifile, void* data, int convert2bitmap, int color
  * \ingroup file */
 int imFileWriteImageData(imFile* ifile, void* data);
 
+/** Writes the image data in bands of band_height lines. \n
+ * The callback is called to fill each band when its first line is needed by the format driver, 
+ * so only one band is allocated. Bands are usually requested from the first to the last line of the file,
+ * but when the format needs the lines out of order or more than once (file and user with different top-bottom orientations, 
+ * interlaced files, or color components stored in separated planes) 
+ * the same band can be requested more than once, so the callback must be able to generate it again. \n
+ * If band_height is 0 or larger than the image height, the image is requested in one band.
+ * Some formats (like ICO) always request the image in one band. \n
+ * If the callback interrupts the writing the remaining lines are written as zeros and IM_ERR_COUNTER is returned. \n
+ * Returns an error code.
+ * \ingroup file */
+int imFileWriteImageLines(imFile* ifile, imFileLinesCallback callback, void* user_data, int band_height);
+
 
 
 
@@ -261,7 +296,9 @@ int imFileWriteImageData(imFile* ifile, void* data);
  * Notice that additional formats when registered will be registered before the internal formats 
  * if imFormatRegisterInternal is not called yet. \n
  * To control the register order is useful when two format drivers handle the same format. 
- * The first registered format will always be used first.
+ * The first registered format will always be used first. \n
+ * The automatic registration is thread safe, so files can be opened in several threads at the same time,
+ * but additional formats should be registered before the threads start.
  * \ingroup format */
 void imFormatRegisterInternal(void);
 
@@ -98,6 +98,31 @@ int imBinFileReadInteger(imBinFile* handle, int *value);
  * \ingroup binfile */
 int imBinFileReadReal(imBinFile* handle, double *value);
 
+/** Reads an array of integer numbers, with the same rules of \ref imBinFileReadInteger. \n
+ * The file is read in large blocks and scanned in memory, 
+ * so it is much faster than reading one number at a time. 
+ * Any other file access returns to the file the characters read ahead. \n
+ * Returns a non zero value if sucessfull.
+ * \ingroup binfile */
+int imBinFileReadIntegerArray(imBinFile* handle, int *values, int count);
+
+/** Reads an array of floating point numbers, with the same rules of \ref imBinFileReadReal. \n
+ * See \ref imBinFileReadIntegerArray.
+ * \ingroup binfile */
+int imBinFileReadRealArray(imBinFile* handle, double *values, int count);
+
+/** Writes an array of integer numbers as text, each one followed by a space. \n
+ * A line break is written when the line is longer than max_line characters (if max_line is not 0),
+ * and after the last number. \n
+ * Returns a non zero value if sucessfull.
+ * \ingroup binfile */
+int imBinFileWriteIntegerArray(imBinFile* handle, const int *values, int count, int max_line);
+
+/** Writes an array of floating point numbers as text using "%.<precision>f", 
+ * see \ref imBinFileWriteIntegerArray.
+ * \ingroup binfile */
+int imBinFileWriteRealArray(imBinFile* handle, const double *values, int count, int precision, int max_line);
+
 /** Moves the file pointer from the begining of the file.\n
  * When writing to a file seeking can go beyond the end of the file.
  * \ingroup binfile */
@@ -121,6 +146,11 @@ unsigned long imBinFileTell(imBinFile* bfile);
  * \ingroup binfile */
 int imBinFileEndOfFile(imBinFile* bfile);
 
+/** Hints the I/O module that a region of the file will be read soon. \n
+ * The module can start loading it in background or ignore the hint. The current position is not changed.
+ * \ingroup binfile */
+void imBinFileReadAhead(imBinFile* bfile, unsigned long pOffset, unsigned long pSize);
+
 /** Predefined I/O Modules.
  * \ingroup binfile */
 enum imBinFileModule 	
@@ -233,6 +263,9 @@ public:
   virtual void SeekFrom(long pOffset) = 0;
   virtual unsigned long Tell() const = 0;
   virtual int EndOfFile() const = 0;
+
+  // Optional, the default ignores the hint.
+  virtual void ReadAhead(unsigned long pOffset, unsigned long pSize) { (void)pOffset; (void)pSize; }
 };
 
 /** File I/O module creation callback.
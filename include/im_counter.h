@@ -26,7 +26,10 @@ extern "C" {
  * Progress in a count reports a value from 0 to 1000. 
  * If -1 indicates the start of a sequence of operations, 1001 ends the sequence. \n
  * If returns 0 the client should abort the operation. \n
- * If the counter is aborted, the callback will be called one last time at 1001.
+ * If the counter is aborted, the callback will be called one last time at 1001. \n
+ * Repeated progress values are not reported. 
+ * The callback can be called from different threads for different counters, 
+ * but the calls for the same counter are never simultaneous.
  * \ingroup counter */
 typedef int (*imCounterCallback)(int counter, void* user_data, const char* text, int progress);
 
@@ -36,7 +39,8 @@ typedef int (*imCounterCallback)(int counter, void* user_data, const char* text,
 imCounterCallback imCounterSetCallback(void* user_data, imCounterCallback counter_func);
 
 /** Returns true if the counter callback is set.
- * When the callback is NULL the counter is inactive and all functions do nothing.
+ * When the callback is NULL the counter is inactive and all functions do nothing, 
+ * unless the \ref profile is collected.
  * \ingroup counter */
 int imCounterHasCallback(void);
 
@@ -77,6 +81,95 @@ void* imCounterGetUserData(int counter);
 void imCounterSetUserData(int counter, void* userdata);
 
 
+/** \defgroup profile Operation Profile
+ * \par
+ * Measures the operations that use a counter, without an external profiler. \n
+ * The processing operations and the \ref imFileReadImageData, \ref imFileWriteImageData, 
+ * \ref imFileReadImageLines and \ref imFileWriteImageLines functions report their name, wall time, CPU time, pixels and bytes processed, threads used and temporary memory allocated.
+ * Each measure is sent to the profile callback when the operation ends, 
+ * and added to an aggregated report by operation name.
+ * \par
+ * The profile is collected only when the profile callback is set or the report is enabled.
+ * Counters are active while the profile is collected even if the counter callback is not set, 
+ * so enable it before opening the files.
+ * \par
+ * CPU time is the time of the thread that measures the operation, 
+ * plus the time of the bands of lines processed by other threads, see \ref imCounterProfileAddCPUTime. 
+ * Other operations running at the same time are not included. 
+ * The time of the lines callback is included in the measures of \ref imFileReadImageLines and \ref imFileWriteImageLines.
+ * \par
+ * See \ref im_counter.h
+ * \ingroup counter */
+
+/** Measures of an operation.
+ * \ingroup profile */
+typedef struct _imCounterProfile
+{
+  const char* name;  /**< operation name, or the aggregated name in the report */
+  int count;         /**< number of operations, 1 for the profile callback */
+  double wall_time;  /**< elapsed time in seconds */
+  double cpu_time;   /**< CPU time of the threads used in seconds */
+  double pixels;     /**< number of pixels processed, all planes included */
+  double bytes;      /**< number of bytes processed */
+  int threads;       /**< maximum number of threads used */
+  double memory;     /**< temporary memory allocated in bytes */
+} imCounterProfile;
+
+/** Profile callback, called by the thread that ends the operation. 
+ * Operations that run in different threads can call it at the same time.
+ * \ingroup profile */
+typedef void (*imCounterProfileCallback)(void* user_data, const imCounterProfile* profile);
+
+/** Changes the profile callback. Returns old callback. \n
+ * User data is changed only if not NULL.
+ * \ingroup profile */
+imCounterProfileCallback imCounterSetProfileCallback(void* user_data, imCounterProfileCallback profile_func);
+
+/** Enables or disables the aggregated report. Returns the previous state. Default: 0.
+ * \ingroup profile */
+int imCounterProfileEnable(int enable);
+
+/** Writes the aggregated report as text, one line per operation name, ordered by wall time. \n
+ * The text is truncated at size-1 characters. Returns the number of operation names.
+ * \ingroup profile */
+int imCounterProfileReport(char* report, int size);
+
+/** Returns the aggregated measures of an operation name in the report, 
+ * index from 0 to the number of names-1, in the same order. Returns 0 if index is invalid. \n
+ * The name is valid until the next call to \ref imCounterProfileGet, \ref imCounterProfileReport or \ref imCounterProfileReset.
+ * \ingroup profile */
+int imCounterProfileGet(int index, imCounterProfile* profile);
+
+/** Clears the aggregated report.
+ * \ingroup profile */
+void imCounterProfileReset(void);
+
+/** Starts measuring an operation in the counter. Ends the previous one if not ended. \n
+ * Used by the operations after \ref imCounterBegin. Does nothing if the profile is not collected.
+ * \ingroup profile */
+void imCounterProfileBegin(int counter, const char* name);
+
+/** Adds to the measures of the operation in the counter. Threads is the maximum. \n
+ * Can be called by any thread while the operation is measured.
+ * \ingroup profile */
+void imCounterProfileAdd(int counter, double pixels, double bytes, int threads, double memory);
+
+/** Returns non zero if an operation is being measured in the counter.
+ * \ingroup profile */
+int imCounterProfileIsActive(int counter);
+
+/** Adds the CPU time used by another thread for the operation in the counter. \n
+ * Called by the threads that process the bands of lines. 
+ * Ignored if called by the thread that started the measure, its time is already measured.
+ * \ingroup profile */
+void imCounterProfileAddCPUTime(int counter, double cpu_time);
+
+/** Ends measuring the operation in the counter and reports it. 
+ * Used by the operations before \ref imCounterEnd.
+ * \ingroup profile */
+void imCounterProfileEnd(int counter);
+
+
 #if defined(__cplusplus)
 }
 #endif
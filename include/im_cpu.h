@@ -0,0 +1,88 @@
+/** \file
+ * \brief Processor Features and Kernel Dispatch (Internal Use Only)
+ *
+ * See Copyright Notice in im_lib.h
+ */
+
+#ifndef __IM_CPU_H
+#define __IM_CPU_H
+
+#if	defined(__cplusplus)
+extern "C" {
+#endif
+
+
+/* Kernels with variants for several instruction sets are selected at run time,
+ * using the features of the processor where the library is running.
+ * Implemented in "im_cpu.cpp". */
+
+/* Instruction sets, each one includes the previous ones. */
+enum imCPUFeature {
+  IM_CPU_SSE2   = 0x01,
+  IM_CPU_SSE41  = 0x02,
+  IM_CPU_AVX2   = 0x04,
+  IM_CPU_AVX512 = 0x08   /* AVX-512 F and BW */
+};
+
+/* Returns the features available to the kernels, detected in the first call.
+ * The environment variable "IM_CPU" limits the features,
+ * it can be "generic", "sse2", "sse41", "avx2" or "avx512".
+ * It is used to test the variants of the kernels. */
+int imCPUFeatures(void);
+
+/* Limits the features available to the kernels, so all the variants can be tested in the same process.
+ * Only detected features are used. A negative value restores the initial features.
+ * Returns the previous features. */
+int imCPUSetFeatures(int features);
+
+/* Returns the name of the best feature: "generic", "sse2", "sse41", "avx2" or "avx512". */
+const char* imCPUFeatureName(int features);
+
+typedef void (*imCPUFunc)(void);
+
+/* One implementation of a kernel, features are the required instruction sets. */
+typedef struct _imCPUVariant
+{
+  int features;
+  imCPUFunc func;
+} imCPUVariant;
+
+/* A kernel with its variants, from the best to the generic one.
+ * The last variant must be the generic one, with no features.
+ * Usually declared as a static variable with IM_CPU_KERNEL. */
+typedef struct _imCPUKernel
+{
+  const char* name;
+  const imCPUVariant* variant;
+  int count;
+  volatile int registered;
+  struct _imCPUKernel* next;
+} imCPUKernel;
+
+#define IM_CPU_KERNEL(_name, _variant) { _name, _variant, sizeof(_variant)/sizeof(imCPUVariant), 0, 0 }
+
+/* Returns the best variant for the current features, the kernel is registered in the first call.
+ * Must be called for each operation and not stored, because the features can be changed. */
+imCPUFunc imCPUKernelSelect(imCPUKernel* kernel);
+
+/* Returns the registered kernels, the first one when kernel is NULL.
+ * Returns NULL after the last one. */
+const imCPUKernel* imCPUKernelNext(const imCPUKernel* kernel);
+
+
+/* Compiler support for kernels using intrinsics of x86 processors.
+ * IM_CPU_TARGET enables an instruction set only for a function. */
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define IM_CPU_X86
+#define IM_CPU_TARGET(_target) __attribute__((target(_target)))
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#define IM_CPU_X86
+#define IM_CPU_TARGET(_target)
+#endif
+
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
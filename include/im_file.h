@@ -61,6 +61,11 @@ struct _imFile
       image_index,
       width,           
       height;
+
+  void* line_band;       /**< used by imFileReadImageLines and imFileWriteImageLines, when not NULL 
+                              imFileLineBufferRead/Write use the lines of bands instead of the user data (that is NULL). */
+
+  void* prefetch;        /**< used by imFileSetPrefetch, when not NULL a worker thread may be using the file. */
 };
 
 
@@ -70,6 +75,15 @@ struct _imFile
  * Used by the special format RAW. */
 void imFileClear(imFile* ifile);
 
+/* Cancels the background prefetch and releases its buffers.
+ * Used by "im_file.cpp" only. */
+void imFilePrefetchFinish(imFile* ifile);
+
+/* Decodes the attributes postponed by the driver, if any.
+ * Called before the attribute table is accessed. 
+ * Used by "im_file.cpp" and "im_image.cpp" only. */
+void imFileReadPendingAttributes(imFile* ifile);
+
 /* Initializes the line buffer.
  * Used by "im_file.cpp" only. */
 void imFileLineBufferInit(imFile* ifile);
@@ -78,6 +92,17 @@ void imFileLineBufferInit(imFile* ifile);
  * Used by "im_file.cpp" only. */
 int imFileCheckConversion(imFile* ifile);
 
+/* Starts to use bands of lines instead of the user data.
+ * When reading the bands are sent to the callback when complete,
+ * when writing the callback fills each band when its first line is needed.
+ * Used by "im_file.cpp" only. */
+int imFileLineBandInit(imFile* ifile, int band_height, imFileLinesCallback callback, void* user_data);
+
+/* Sends the incomplete bands if "send" is not zero, and releases the bands.
+ * Returns zero if the callback interrupted the reading.
+ * Used by "im_file.cpp" only. */
+int imFileLineBandFinish(imFile* ifile, int send);
+
 
 /* File Format SDK */
 
@@ -23,7 +23,7 @@ class imFileFormatBase: public _imFile
 public:
   const imFormat* iformat;
 
-  imFileFormatBase(const imFormat* _iformat): iformat(_iformat) {}
+  imFileFormatBase(const imFormat* _iformat): iformat(_iformat), pending_attributes(0) {}
   virtual ~imFileFormatBase() {}
 
   imAttribTable* AttribTable() {return (imAttribTable*)this->attrib_table;}
@@ -38,6 +38,12 @@ public:
   virtual int ReadImageData(void* data) = 0;
   virtual int WriteImageInfo() = 0;            // Should update compression
   virtual int WriteImageData(void* data) = 0;  // Must update image_count
+
+  /* Optional. Drivers can postpone the decoding of some attributes until they are accessed.
+     In this case ReadImageInfo sets pending_attributes, 
+     and ReadPendingAttributes decodes them and resets it. */
+  int pending_attributes;
+  virtual void ReadPendingAttributes() { pending_attributes = 0; }
 };
 
 /** \brief Image File Format Descriptor Class (SDK Use Only) 
@@ -88,7 +94,8 @@ imFileFormatBase* imFileFormatBaseNew(const char* file_name, const char* format,
 
 /* File Format SDK */
 
-/** Register a format driver.
+/** Register a format driver. The format belongs to the library, 
+ * it is destroyed by \ref imFormatRemoveAll or if the maximum of 50 formats was already registered.
  * \ingroup filesdk */
 void imFormatRegister(imFormat* iformat);
 
@@ -148,16 +148,26 @@ void imFormatRegisterTIFF(void);
     Attributes:
       AutoYCbCr IM_INT (1) (controls YCbCr auto conversion) default 1
       JPEGQuality IM_INT (1) [0-100, default 75] (write only)
+      JPEGScale IM_INT (1) [1, 2, 4 or 8, default 1] (read only) [Image is decoded reduced by 1/JPEGScale using the scaled IDCT. Must be set before reading image info.]
       ResolutionUnit (string) ["DPC", "DPI"]
       XResolution, YResolution IM_FLOAT (1)
       Interlaced (same as Progressive) IM_INT (1 | 0) default 0
       Description (string)
+      JPEGSkipExif IM_INT (1) [1, 0, default 0] (read only) [The EXIF marker is ignored. Must be set before reading image info.]
       (lots of Exif tags)
 
     Changes to libJPEG:
       jdatadst.c - fflush and ferror replaced by macros JFFLUSH and JFERROR.
       jinclude.h - standard JFFLUSH and JFERROR definitions, and new macro HAVE_JFIO.
       new file created: jconfig.h from jconfig.txt
+      new files jsimd.h and jsimd_sse2.c - SSE2 integer DCT, color conversion and upsampling,
+        used only when compiled with JPEG_SIMD (USE_JPEG_SIMD in config.mak) and selected at run time,
+        the environment variable JSIMD_FORCENONE=1 disables them.
+        The IDCT blocks with values outside the 16 bits range are decoded by the scalar routines,
+        so the results are always the same.
+      jddctmgr.c, jcdctmgr.c, jccolor.c, jdcolor.c and jdsample.c - selection of the SSE2 routines,
+        registered as IM kernels (see im_cpu.h) and checked by test/im_cputest.
+      jdcolor.c and jpeglib.h - new function jpeg_set_planar_output for color conversion to separate planes.
 
     Changes to libEXIF:
       new files config.h and _stdint.h
@@ -166,12 +176,44 @@ void imFormatRegisterTIFF(void);
     Comments:
       Other APPx markers are ignored.
       No thumbnail support.
+      The EXIF tags are decoded only when the file attributes are accessed or the image is loaded with imFileLoadImage,
+        so imFileReadImageData alone does not decode them.
+      JPEGScale is the fastest way to obtain a preview of a large image,
+        the returned width and height are already reduced.
       RGB images are automatically converted to YCbCr when saved.
+      Unpacked byte data is decoded directly to the color planes, without an intermediate line buffer.
       Also YcbCr are automatically converted to RGB when loaded. Use AutoYCbCr=0 to disable this behavior.
 \endverbatim
  * \ingroup format */
 void imFormatRegisterJPEG(void);
 
+/** Lossless JPEG transformations. \n
+ * The values are the EXIF Orientation attribute minus 1,
+ * so that transformation will restore the default orientation.
+ * \ingroup jpeg */
+enum imJPEGTransform
+{
+  IM_JPEG_NONE,        /**< no transformation, just crop (if any) */
+  IM_JPEG_FLIP_H,      /**< horizontal mirror */
+  IM_JPEG_ROT180,      /**< rotate 180 degrees */
+  IM_JPEG_FLIP_V,      /**< vertical mirror */
+  IM_JPEG_TRANSPOSE,   /**< transpose across the main diagonal */
+  IM_JPEG_ROT90,       /**< rotate 90 degrees clockwise */
+  IM_JPEG_TRANSVERSE,  /**< transpose across the secondary diagonal */
+  IM_JPEG_ROT270       /**< rotate 270 degrees clockwise (90 counter clockwise) */
+};
+
+/** Transforms and crops a JPEG file without decompression, so there is no loss of quality. \n
+ * The DCT coefficients are directly rearranged and written to the new file.
+ * All the markers (including EXIF) are copied, and the EXIF Orientation is reset to 1 when there is a transformation. \n
+ * The crop region is applied before the transformation and it is in source coordinates. Use width or height <= 0 for no crop.
+ * xmin and ymin are aligned down to the MCU boundary (usually 8 or 16 pixels), and the region is enlarged to compensate. \n
+ * Edge MCUs that are partial along a mirrored direction are trimmed (like "jpegtran -trim"). \n
+ * Returns an error code. See also \ref imErrorCodes and \ref imJPEGTransform.
+ * \ingroup jpeg */
+int imFileJPEGTransform(const char* src_file_name, const char* dst_file_name, int transform, 
+                        int xmin, int ymin, int width, int height);
+
 
 /** \defgroup png PNG - Portable Network Graphic Format
  * \section Description
@@ -196,6 +238,8 @@ void imFormatRegisterJPEG(void);
 
     Attributes:
       ZIPQuality IM_INT (1) [1-9, default 6] (write only)
+      PNGFilter (string) ["NONE", "SUB", "UP", "AVERAGE", "PAETH", "ADAPTIVE"] (write only)
+      PNGParallel IM_INT (1) [0 | 1] default 0 (write only)
       ResolutionUnit (string) ["DPC", "DPI"]
       XResolution, YResolution IM_FLOAT (1)
       Interlaced (same as Progressive) IM_INT (1 | 0) default 0
@@ -222,6 +266,10 @@ void imFormatRegisterJPEG(void);
       When saving PNG image with TransparencyIndex or TransparencyMap, TransparencyMap has precedence, 
         so set it to NULL if you changed TransparencyIndex.
       Attributes set after the image are ignored.
+      PNGFilter default is NONE for MAP and Binary images, and ADAPTIVE for the others.
+      PNGParallel filters and compresses bands of lines independently and joins them in a single IDAT stream.
+        The bands are filtered and compressed in parallel using all the processors.
+        It uses memory for two copies of the image, and it is ignored for interlaced images.
 \endverbatim
  * \ingroup format */
 void imFormatRegisterPNG(void);
@@ -512,6 +560,49 @@ Internally the lines are arranged from bottom to top.
 void imFormatRegisterPFM(void);
 
 
+/** \defgroup imt IMT - IM Tiled Image Format
+* \section Description
+*
+* \par
+* Internal Implementation. \n
+* A native format to store any image of the library, useful as a fast scratch format.
+* The image is divided in tiles that are compressed independently, 
+* and a tile index is stored before the tiles data, so a region can be read without 
+* reading the whole image. Tiles are compressed and uncompressed in parallel using all the available processors.
+*
+* \section Features
+*
+\verbatim
+Data Types: all
+Color Spaces: all
+Compressions:
+  NONE - no compression
+  DEFLATE - ZIP compression 
+  LZF - LZF compression [default]
+  LZO - LZO compression (only if registered using imCompressSetLZO)
+Can have more than one image.
+Can have an alpha channel.
+Internally the components are always unpacked.
+Internally the lines are arranged from top down to bottom.
+File size is limited to 4GB.
+Handle(0) returns an imBinFile* handle.
+
+Attributes:
+  TileWidth, TileHeight IM_INT (1) [default 256]
+  ZIPQuality IM_INT (1) [1-9, default 6] (write only)
+  ViewXmin, ViewXmax, ViewYmin, ViewYmax IM_INT (1) (read only) [region to be read, in top down coordinates]
+  ViewWidth, ViewHeight IM_INT (1) (read only) [size of the returned image, if smaller than the region it is sampled]
+  All other attributes are saved and restored.
+
+Comments:
+  The View attributes are not supported by imFileReadImageLines, it returns IM_ERR_DATA when they define a view.
+  Attributes of complex data types are supported.
+  Written in the CPU byte order, converted when read in a CPU with a different byte order.
+\endverbatim
+* \ingroup format */
+void imFormatRegisterIMT(void);
+
+
 /** \defgroup ico ICO - Windows Icon
  * \section Description
  *
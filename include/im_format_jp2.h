@@ -52,6 +52,8 @@ extern "C" {
       CompressionRatio IM_FLOAT (1) [write only, example: Ratio=7 just like 7:1]
       GeoTIFFBox IM_BYTE (n)
       XMLPacket IM_BYTE (n)
+      ViewWidth, ViewHeight                    IM_INT (1)    [view zoom]
+      ViewXmin, ViewYmin, ViewXmax, ViewYmax   IM_INT (1)    [view limits]
 
     Comments:
       We read code stream syntax and JP2, but we write always as JP2.
@@ -62,6 +64,13 @@ extern "C" {
       New file jas_binfile.c
       Changed base/jas_stream.c to export jas_stream_create and jas_stream_initbuf.
       Changed jp2/jp2_dec.c and jpc/jpc_cs.c to remove "uint" and "ulong" usage.
+      Changed jpc/jpc_dec.c, jpc/jpc_t1dec.c and jpc/jpc_tsfb.c to add the decoder options
+        "reduce", "imgareatlx", "imgareatly", "imgareabrx" and "imgareabry".
+      To read a region of the image you must set the View* attributes before reading the image info.
+      After reading a partial image the width and height returned in ReadImageInfo is the view size.
+      The view limits define the region to be read, tiles and code blocks outside it are not decoded.
+      The view size is the actual size of the image, so the result can be zoomed.
+      The resolution levels above the view size are not decoded, the remaining zoom is done by sampling.
       The counter is restarted many times, because it has many phases.
 \endverbatim
  * \ingroup format */
@@ -40,6 +40,22 @@ extern "C" {
  * If the compression is ASCII the data is stored in textual format, instead of binary. 
  * In this case SwitchType and ByteOrder are ignored, and Padding should be 0.
  * \par
+ * A file with several images of the same size, like a high speed camera dump, can be described as a fixed-stride frame sequence 
+ * using the attributes "FrameHeader", "FramePadding" and "FrameSize". Each frame is composed by a header, the image data and a padding, 
+ * all with the same size. "FrameSize" is the distance between consecutive frames, if not defined it is computed from the other two. 
+ * If any of these attributes are defined, "StartOffset" is the absolute offset of the first frame, 
+ * the frame N is located directly at StartOffset + N*FrameSize, and "ImageCount", if not defined, 
+ * is computed from the file size when the first image information is read.
+ * Only the complete frames are counted. Frame sequences are not supported for ASCII.
+ * When writing, the header and the padding are filled with zeros. \n
+ * Otherwise "StartOffset" is skipped from the current file position when each image information is read or written.
+ * \par
+ * For frame sequences, "FrameReadAhead" asks the system to start loading the given number of next frames in background 
+ * when each image information is read. It is only a hint, currently used only in UNIX.
+ * \par
+ * When the user data has the same color mode and data type of the file, 
+ * and there is no line padding, type switch or RGB16 expansion, the data is read directly into the user buffer.
+ * \par
  * When reading, if data type is BYTE, color space is RGB and data is packed, then the attribute "RGB16" is consulted. 
  * It can has values "555" or "565" indicating a packed 16 bits RGB pixel is stored with the given bit distribution for R, G and B.
  * \par
@@ -53,7 +69,7 @@ extern "C" {
     Compressions: 
       NONE - no compression [default] 
       ASCII (textual data)
-    Can have more than one image, depends on "StartOffset" attribute.
+    Can have more than one image, depends on "StartOffset" or "Frame*" attributes.
     Can have an alpha channel.
     Components can be packed or not.
     Lines arranged from top down to bottom or bottom up to top.
@@ -61,6 +77,7 @@ extern "C" {
     Attributes:
       Width, Height, ColorMode, DataType IM_INT (1)
       ImageCount[1], StartOffset[0], SwitchType[FALSE], ByteOrder[IM_LITTLEENDIAN], Padding[0]  IM_INT (1)
+      FrameHeader[0], FramePadding[0], FrameSize, FrameReadAhead[0] IM_INT (1)
 
     Comments:
       In fact ASCII is an expansion, not a compression, because the file will be larger than binary data.
@@ -410,6 +410,26 @@ imImage* imFileLoadImageRegion(imFile* ifile, int index, int bitmap, int *error,
  * \ingroup imgfile */
 void imFileLoadBitmapFrame(imFile* ifile, int index, imImage* image, int *error);
 
+/** Enables or disables the background prefetch of frames in \ref imFileLoadImageFrame and \ref imFileLoadBitmapFrame. \n
+ * When enabled, after frame "index" is loaded a worker thread starts to decode frame "index+1"
+ * into an internal buffer, while the application processes the current frame.
+ * If the next call loads that frame with the same function it is copied to the image and no decoding is done,
+ * otherwise the prefetched frame is discarded and the requested frame is loaded normally. \n
+ * Ownership: the internal buffer belongs to the file.
+ * The image->data pointers do not change, so the image can also use an application buffer (see \ref imImageInit). \n
+ * While enabled the file belongs to the worker between calls,
+ * so it must be used only through the imFileLoad* functions, imFileSetPrefetch and \ref imFileClose.
+ * Frame attributes must be obtained from the image, not from the file.
+ * The progress counter is not used for this file, because it would be called from the worker thread. \n
+ * Disabling the prefetch cancels it: a frame not yet started is skipped,
+ * a frame already being decoded is waited for, then the internal buffer is released.
+ * \ref imFileClose does the same automatically. \n
+ * Ignored for files opened for writing. If threads are not available frames are loaded normally.
+ *
+ * \verbatim ifile:SetPrefetch(prefetch: boolean) [in Lua 5] \endverbatim
+ * \ingroup imgfile */
+void imFileSetPrefetch(imFile* ifile, int prefetch);
+
 /** Saves the image to an already open file. \n
  * This will call \ref imFileWriteImageInfo and \ref imFileWriteImageData. \n
  * Attributes from the image will be stored at the file.
@@ -43,6 +43,13 @@ extern "C" {
  * But min/max computation must be done in single thread
  * because of limitations in OpenMP support in C (in Fortran it would be easy to implement).
  * \par
+ * The convolution, resize, generic point and morphology operations do not use OpenMP loops.
+ * They split the image in bands of lines that are processed by a pool of threads kept alive by the library,
+ * each thread steals bands from the others when its own bands are done.
+ * So several operations can run at the same time from different application threads without
+ * creating more threads than processors. The number of threads depends on the cost of the operation,
+ * see \ref imProcessOpenMPCalibrate, and the \ref counter can abort them.
+ * \par
  * For more information on OpenMP: \n
  * http://www.openmp.org 
  */
@@ -0,0 +1,355 @@
+/** \file
+ * \brief Image Processing - Point Expressions for C++
+ *
+ * See Copyright Notice in im_lib.h
+ */
+
+#ifndef __IM_PROCESS_EXPR_H
+#define __IM_PROCESS_EXPR_H
+
+#include "im_image.h"
+#include "im_util.h"
+#include "im_math_op.h"
+#include "im_process_glo.h"
+#include "im_thread.h"
+
+
+/** \defgroup expr Point Expressions for C++
+ * \par
+ * Arithmetic expressions over the planes of several images, evaluated in a single loop. \n
+ * The expression is a template type built by the compiler, so there is one specialized loop
+ * for each expression and data type combination, and no intermediate images.
+ * \code
+ *   imExprImage<imbyte> a(image_a), b(image_b), c(image_c), dst(dst_image);
+ *   dst = crop_byte(a*0.5f + b - c);
+ * \endcode
+ * \par
+ * The data type of the \ref imExprImage must be the data type of the image.
+ * All the images must match size and depth, the alpha channel is not included.
+ * If they do not match the expression is not evaluated, see \ref imExprImage::Check.
+ * Complex data types are not supported. \n
+ * Values are promoted as in C, integer types are computed as int,
+ * and float or double when one of the operands is float or double.
+ * They are converted to the target data type without cropping, use \ref crop_byte when necessary.
+ * \par
+ * The lines are distributed among the threads of the band scheduler,
+ * the number of threads depends on the number of operations of the expression, see \ref imProcessThreadCount.
+ * Link with "im_process.lib/.a/.so".
+ * \par
+ * See \ref im_process_expr.h
+ * \ingroup process */
+
+
+/* Data type of the images of each template type. */
+template <class T> struct imExprDataType { enum { value = -1 }; };
+template <> struct imExprDataType<imbyte> { enum { value = IM_BYTE }; };
+template <> struct imExprDataType<short> { enum { value = IM_SHORT }; };
+template <> struct imExprDataType<imushort> { enum { value = IM_USHORT }; };
+template <> struct imExprDataType<int> { enum { value = IM_INT }; };
+template <> struct imExprDataType<float> { enum { value = IM_FLOAT }; };
+template <> struct imExprDataType<double> { enum { value = IM_DOUBLE }; };
+
+/* Rank of the data types to promote values. */
+template <class T> struct imExprRank { enum { value = 0 }; };
+template <> struct imExprRank<float> { enum { value = 1 }; };
+template <> struct imExprRank<double> { enum { value = 2 }; };
+
+template <int R> struct imExprRankType { typedef int type; };
+template <> struct imExprRankType<1> { typedef float type; };
+template <> struct imExprRankType<2> { typedef double type; };
+
+template <class T1, class T2>
+struct imExprPromote
+{
+  enum { r1 = imExprRank<T1>::value, r2 = imExprRank<T2>::value };
+  typedef typename imExprRankType<(r1 > r2)? r1: r2>::type type;
+};
+
+/* Leaf with the line of a plane. */
+template <class T>
+struct imExprPlaneNode
+{
+  typedef T value_type;
+  enum { cost = 0 };
+
+  T** data;
+  const T* line;
+  int width, height, depth;   /* all -1 if the image data type is not T */
+
+  int Check(int w, int h, int d) const { return width == w && height == h && depth == d; }
+  void SetLine(int plane, int offset) { line = data[plane] + offset; }
+  T Eval(int x) const { return line[x]; }
+};
+
+/* Leaf with a constant. */
+template <class T>
+struct imExprConstNode
+{
+  typedef T value_type;
+  enum { cost = 0 };
+
+  T value;
+
+  int Check(int, int, int) const { return 1; }
+  void SetLine(int, int) {}
+  T Eval(int) const { return value; }
+};
+
+template <class N, class Op>
+struct imExprUnaryNode
+{
+  typedef typename imExprPromote<typename N::value_type, typename N::value_type>::type value_type;
+  enum { cost = N::cost + 1 };
+
+  N n;
+
+  int Check(int w, int h, int d) const { return n.Check(w, h, d); }
+  void SetLine(int plane, int offset) { n.SetLine(plane, offset); }
+  value_type Eval(int x) const { return Op::Do((value_type)n.Eval(x)); }
+};
+
+template <class N1, class N2, class Op>
+struct imExprBinaryNode
+{
+  typedef typename imExprPromote<typename N1::value_type, typename N2::value_type>::type value_type;
+  enum { cost = N1::cost + N2::cost + 1 };
+
+  N1 n1;
+  N2 n2;
+
+  int Check(int w, int h, int d) const { return n1.Check(w, h, d) && n2.Check(w, h, d); }
+  void SetLine(int plane, int offset) { n1.SetLine(plane, offset); n2.SetLine(plane, offset); }
+  value_type Eval(int x) const { return Op::Do((value_type)n1.Eval(x), (value_type)n2.Eval(x)); }
+};
+
+/** \brief Point Expression
+ *
+ * \par
+ * Holds a node of the expression tree. It is created by the operators and functions,
+ * and evaluated when assigned to an \ref imExprImage.
+ * \ingroup expr */
+template <class N>
+class imExpr
+{
+public:
+  N node;
+
+  imExpr() {}
+  explicit imExpr(const N& n): node(n) {}
+};
+
+template <class N>
+struct imExprBandData
+{
+  N node;
+  void** dst_data;
+  int width, height;
+};
+
+template <class N, class T>
+static int imExprBand(void* user_data, int start, int end)
+{
+  imExprBandData<N>* data = (imExprBandData<N>*)user_data;
+  N node = data->node;   /* each thread has its own line pointers */
+  int width = data->width, height = data->height;
+
+  for (int line = start; line < end; line++)
+  {
+    /* lines of all the planes */
+    int d = line / height;
+    int offset = (line % height) * width;
+    T* dst_line = (T*)data->dst_data[d] + offset;
+
+    node.SetLine(d, offset);
+
+    for (int x = 0; x < width; x++)
+      dst_line[x] = (T)node.Eval(x);
+  }
+
+  return 1;
+}
+
+/** \brief Image in a Point Expression
+ *
+ * \par
+ * Refers to the planes of an imImage, T must be its data type.
+ * The image is not copied, it must exist while the expression is used.
+ * \par
+ * When an expression is assigned to it, the expression is evaluated for each pixel of each plane.
+ * Can also be used in the expression being assigned.
+ * Nothing is done if the images of the expression do not match this image, see \ref Check.
+ * \ingroup expr */
+template <class T>
+class imExprImage: public imExpr< imExprPlaneNode<T> >
+{
+public:
+  imImage* image;
+
+  explicit imExprImage(imImage* img): image(img)
+  {
+    this->node.data = (T**)img->data;
+    this->node.line = 0;
+
+    if (img->data_type == imExprDataType<T>::value)
+    {
+      this->node.width = img->width;
+      this->node.height = img->height;
+      this->node.depth = img->depth;
+    }
+    else
+    {
+      this->node.width = -1;
+      this->node.height = -1;
+      this->node.depth = -1;
+    }
+  }
+
+  /** Returns non zero if all the images, this one and the ones of the expression, 
+   * have the data type of their imExprImage, and the same size and depth of this image. */
+  template <class N>
+  int Check(const imExpr<N>& e) const
+  {
+    return this->node.width != -1 && e.node.Check(this->node.width, this->node.height, this->node.depth);
+  }
+
+  /** Evaluates the expression for each pixel. */
+  template <class N>
+  imExprImage& operator=(const imExpr<N>& e)
+  {
+    if (!Check(e))
+      return *this;
+
+    imExprBandData<N> data;
+    data.node = e.node;
+    data.dst_data = image->data;
+    data.width = image->width;
+    data.height = image->height;
+
+    int line_count = image->height * image->depth;
+    double cost = (double)image->count * image->depth * (N::cost > 0? N::cost: 1);
+    imThreadParallelBands(line_count, 0, imProcessThreadCount(cost), imExprBand<N, T>, &data);
+    return *this;
+  }
+
+  /** Copies the pixels of another image. */
+  imExprImage& operator=(const imExprImage& e)
+  {
+    return operator=((const imExpr< imExprPlaneNode<T> >&)e);
+  }
+};
+
+/* Operations of the nodes, using the functions of "im_math_op.h". */
+struct imExprOpAdd  { template <class T> static T Do(const T& a, const T& b) { return add_op(a, b); } };
+struct imExprOpSub  { template <class T> static T Do(const T& a, const T& b) { return sub_op(a, b); } };
+struct imExprOpMul  { template <class T> static T Do(const T& a, const T& b) { return mul_op(a, b); } };
+struct imExprOpDiv  { template <class T> static T Do(const T& a, const T& b) { return div_op(a, b); } };
+struct imExprOpDiff { template <class T> static T Do(const T& a, const T& b) { return diff_op(a, b); } };
+struct imExprOpMin  { template <class T> static T Do(const T& a, const T& b) { return min_op(a, b); } };
+struct imExprOpMax  { template <class T> static T Do(const T& a, const T& b) { return max_op(a, b); } };
+struct imExprOpPow  { template <class T> static T Do(const T& a, const T& b) { return pow_op(a, b); } };
+
+struct imExprOpCropByte { template <class T> static T Do(const T& a) { return crop_byte(a); } };
+struct imExprOpAbs  { template <class T> static T Do(const T& a) { return abs_op(a); } };
+struct imExprOpLess { template <class T> static T Do(const T& a) { return less_op(a); } };
+struct imExprOpSqr  { template <class T> static T Do(const T& a) { return sqr_op(a); } };
+struct imExprOpSqrt { template <class T> static T Do(const T& a) { return sqrt_op(a); } };
+struct imExprOpExp  { template <class T> static T Do(const T& a) { return exp_op(a); } };
+struct imExprOpLog  { template <class T> static T Do(const T& a) { return log_op(a); } };
+
+template <class Op, class N1, class N2>
+inline imExpr< imExprBinaryNode<N1, N2, Op> > imExprBinary(const N1& n1, const N2& n2)
+{
+  imExpr< imExprBinaryNode<N1, N2, Op> > e;
+  e.node.n1 = n1;
+  e.node.n2 = n2;
+  return e;
+}
+
+template <class Op, class N>
+inline imExpr< imExprUnaryNode<N, Op> > imExprUnary(const N& n)
+{
+  imExpr< imExprUnaryNode<N, Op> > e;
+  e.node.n = n;
+  return e;
+}
+
+template <class T>
+inline imExprConstNode<T> imExprConst(const T& value)
+{
+  imExprConstNode<T> n;
+  n.value = value;
+  return n;
+}
+
+/* Binary operations with expressions and constants.
+   Functions of "im_math_op.h" are generic templates, they need also
+   the imExprImage version so the generic version is not selected. */
+#define IM_EXPR_BINARY_CONST(_func, _op, _type)                                        \
+template <class N>                                                                    \
+inline imExpr< imExprBinaryNode<N, imExprConstNode<_type>, _op> > _func(const imExpr<N>& e, const _type& v) \
+{ return imExprBinary<_op>(e.node, imExprConst(v)); }                                 \
+template <class N>                                                                    \
+inline imExpr< imExprBinaryNode<imExprConstNode<_type>, N, _op> > _func(const _type& v, const imExpr<N>& e) \
+{ return imExprBinary<_op>(imExprConst(v), e.node); }                                 \
+template <class T>                                                                    \
+inline imExpr< imExprBinaryNode<imExprPlaneNode<T>, imExprConstNode<_type>, _op> > _func(const imExprImage<T>& e, const _type& v) \
+{ return imExprBinary<_op>(e.node, imExprConst(v)); }                                 \
+template <class T>                                                                    \
+inline imExpr< imExprBinaryNode<imExprConstNode<_type>, imExprPlaneNode<T>, _op> > _func(const _type& v, const imExprImage<T>& e) \
+{ return imExprBinary<_op>(imExprConst(v), e.node); }
+
+#define IM_EXPR_BINARY(_func, _op)                                                    \
+template <class N1, class N2>                                                         \
+inline imExpr< imExprBinaryNode<N1, N2, _op> > _func(const imExpr<N1>& e1, const imExpr<N2>& e2) \
+{ return imExprBinary<_op>(e1.node, e2.node); }                                       \
+template <class T, class N>                                                           \
+inline imExpr< imExprBinaryNode<imExprPlaneNode<T>, N, _op> > _func(const imExprImage<T>& e1, const imExpr<N>& e2) \
+{ return imExprBinary<_op>(e1.node, e2.node); }                                       \
+template <class N, class T>                                                           \
+inline imExpr< imExprBinaryNode<N, imExprPlaneNode<T>, _op> > _func(const imExpr<N>& e1, const imExprImage<T>& e2) \
+{ return imExprBinary<_op>(e1.node, e2.node); }                                       \
+template <class T1, class T2>                                                         \
+inline imExpr< imExprBinaryNode<imExprPlaneNode<T1>, imExprPlaneNode<T2>, _op> > _func(const imExprImage<T1>& e1, const imExprImage<T2>& e2) \
+{ return imExprBinary<_op>(e1.node, e2.node); }                                       \
+IM_EXPR_BINARY_CONST(_func, _op, int)                                                 \
+IM_EXPR_BINARY_CONST(_func, _op, float)                                               \
+IM_EXPR_BINARY_CONST(_func, _op, double)
+
+#define IM_EXPR_UNARY(_func, _op)                                                     \
+template <class N>                                                                    \
+inline imExpr< imExprUnaryNode<N, _op> > _func(const imExpr<N>& e)                    \
+{ return imExprUnary<_op>(e.node); }                                                  \
+template <class T>                                                                    \
+inline imExpr< imExprUnaryNode<imExprPlaneNode<T>, _op> > _func(const imExprImage<T>& e) \
+{ return imExprUnary<_op>(e.node); }
+
+/** \addtogroup expr
+ * Operators and functions of the point expressions, the same of \ref im_math_op.h.
+ * Each operand can be an expression, an \ref imExprImage or a constant (int, float or double).
+ * @{
+ */
+
+IM_EXPR_BINARY(operator +, imExprOpAdd)
+IM_EXPR_BINARY(operator -, imExprOpSub)
+IM_EXPR_BINARY(operator *, imExprOpMul)
+IM_EXPR_BINARY(operator /, imExprOpDiv)
+IM_EXPR_BINARY(diff_op, imExprOpDiff)
+IM_EXPR_BINARY(min_op, imExprOpMin)
+IM_EXPR_BINARY(max_op, imExprOpMax)
+IM_EXPR_BINARY(pow_op, imExprOpPow)
+
+IM_EXPR_UNARY(crop_byte, imExprOpCropByte)
+IM_EXPR_UNARY(abs_op, imExprOpAbs)
+IM_EXPR_UNARY(less_op, imExprOpLess)
+IM_EXPR_UNARY(sqr_op, imExprOpSqr)
+IM_EXPR_UNARY(sqrt_op, imExprOpSqrt)
+IM_EXPR_UNARY(exp_op, imExprOpExp)
+IM_EXPR_UNARY(log_op, imExprOpLog)
+
+/** @} */
+
+#undef IM_EXPR_BINARY
+#undef IM_EXPR_BINARY_CONST
+#undef IM_EXPR_UNARY
+
+#endif
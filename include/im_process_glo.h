@@ -182,13 +182,37 @@ void imProcessSwapQuadrants(imImage* image, int center2origin);
  * \ingroup process */
 
 /** Sets the minimum number of interations to split into threads. \n
- * Default value is 250000, or an image with 500x500. \n
+ * Default value is 250000, or an image with 500x500, until calibrated. \n
+ * The value set here is not replaced by the automatic calibration, see \ref imProcessOpenMPCalibrate. \n
  * Returns the previous value.
  *
  * \verbatim im.ProcessOpenMPSetMinCount(min_count: number) -> old_min_count: number [in Lua 5] \endverbatim
  * \ingroup openmp */
 int imProcessOpenMPSetMinCount(int min_count);
 
+/** Measures the minimum number of interations where 2 threads are faster than 1 in the current host,
+ * using a simple arithmetic operation, and sets it as the minimum count. \n
+ * The convolution, resize, generic point and morphology operations multiply the number of pixels 
+ * by the cost of each pixel (kernel size, interpolation order, complex data) 
+ * and compare the result with the minimum count. 
+ * They also use more threads as the cost grows, up to the number of threads. \n
+ * It is called automatically by the first of these operations, 
+ * unless \ref imProcessOpenMPSetMinCount was called before. Takes a few milliseconds. \n
+ * Does nothing if OpenMP is not enabled or if there is only one processor. \n
+ * Returns the new value.
+ *
+ * \verbatim im.ProcessOpenMPCalibrate() -> min_count: number [in Lua 5] \endverbatim
+ * \ingroup openmp */
+int imProcessOpenMPCalibrate(void);
+
+/** Returns the number of threads used by an operation with the given cost, 
+ * the number of pixels times the number of simple arithmetic operations of each pixel. \n
+ * Uses the minimum count, see \ref imProcessOpenMPCalibrate. 
+ * Returns 1 if OpenMP is not enabled or if the cost is smaller than the minimum count. \n
+ * Used by \ref im_process_expr.h.
+ * \ingroup openmp */
+int imProcessThreadCount(double cost);
+
 /** Sets the number of threads. \n
  * Does nothing if OpenMP is not enabled. \n
  * Returns the previous value.
@@ -113,6 +113,43 @@ typedef int(*imMultiPointColorOpFunc)(float* src_value, float* dst_value, float*
  * \ingroup point */
 int imProcessMultiPointColorOp(const imImage** src_image, int src_count, imImage* dst_image, imMultiPointColorOpFunc func, float* params, void* userdata, const char* op_name);
 
+/** Custom unary line funtion. \n
+ * Receives a whole line of all the planes, src_line[d] and dst_line[d] point to the line y of the plane d,
+ * with the data type of the respective image. So the function can process the line without conversions and
+ * without a call for each pixel. \n
+ * Must return zero to abort the operation.
+ * \ingroup point */
+typedef int (*imUnaryPointLineOpFunc)(const void** src_line, void** dst_line, int width, float* params, void* userdata, int y);
+
+/** Apply an unary point operation using a custom function called for each line.
+ * Same as \ref imProcessUnaryPointColorOp but the function receives the lines instead of the pixels. \n
+ * Can be done in-place, images must match size, depth and data type can be different.
+ * Alpha is included in the source only when both images have alpha. \n
+ * Lines can be processed by different threads at the same time. \n
+ * op_name is used only by the counter and can be NULL.
+ * Returns zero if the counter or the function aborted.
+ * \ingroup point */
+int imProcessUnaryPointLineOp(const imImage* src_image, imImage* dst_image, imUnaryPointLineOpFunc func, float* params, void* userdata, const char* op_name);
+
+/** Custom multiple line funtion. \n
+ * Receives a whole line of all the planes of all the sources, 
+ * src_line[i*src_depth + d] points to the line y of the plane d of the source i,
+ * and dst_line[d] points to the line y of the plane d of the target. \n
+ * Must return zero to abort the operation.
+ * \ingroup point */
+typedef int (*imMultiPointLineOpFunc)(const void** src_line, void** dst_line, int width, float* params, void* userdata, int y, int src_count, int src_depth);
+
+/** Apply a multiple point operation using a custom function called for each line.
+ * Same as \ref imProcessMultiPointColorOp but the function receives the lines instead of the pixels. \n
+ * All source images must match in size, depth and data type.
+ * Can be done in-place, source and target must match size, depth and data type can be different.
+ * Alpha is included in the sources only when the target also has alpha. \n
+ * Lines can be processed by different threads at the same time. \n
+ * op_name is used only by the counter and can be NULL.
+ * Returns zero if the counter or the function aborted.
+ * \ingroup point */
+int imProcessMultiPointLineOp(const imImage** src_image, int src_count, imImage* dst_image, imMultiPointLineOpFunc func, float* params, void* userdata, const char* op_name);
+
 
 
 /** \defgroup arithm Arithmetic Operations 
@@ -942,6 +979,74 @@ int imProcessConvertColorSpace(const imImage* src_image, imImage* dst_image);
 int imProcessConvertToBitmap(const imImage* src_image, imImage* dst_image, int cpx2real, float gamma, int abssolute, int cast_mode);
 
 
+/** \defgroup pipeline Point Operations Pipeline
+ * \par
+ * A sequence of point operations recorded and then applied in a single pass over the image. \n
+ * Each line is processed in tiles of a few hundred pixels, all the operations are applied to a tile 
+ * while it is in the cache, so there is no intermediate image and memory is read and written only once.
+ * \par
+ * The values are computed in float and converted to the target data type only at the end, 
+ * cropped to the data type limits for integer types.
+ * So the result can be different from calling each operation with integer images, 
+ * where each intermediate value is cropped and truncated.
+ * \par
+ * See \ref im_process_pnt.h
+ * \ingroup process */
+
+typedef struct _imProcessPipeline imProcessPipeline;
+
+/** Creates an empty pipeline.
+ * \ingroup pipeline */
+imProcessPipeline* imProcessPipelineCreate(void);
+
+/** Destroys the pipeline.
+ * \ingroup pipeline */
+void imProcessPipelineDestroy(imProcessPipeline* pipeline);
+
+/** Adds a \ref imProcessUnArithmeticOp stage. 
+ * IM_UN_CONJ and IM_UN_CPXNORM do nothing since values are real.
+ * \ingroup pipeline */
+void imProcessPipelineUnArithmeticOp(imProcessPipeline* pipeline, int op);
+
+/** Adds a \ref imProcessArithmeticConstOp stage.
+ * \ingroup pipeline */
+void imProcessPipelineArithmeticConstOp(imProcessPipeline* pipeline, float src_const, int op);
+
+/** Adds a \ref imProcessToneGamut stage. params are copied. \n
+ * When IM_GAMUT_MINMAX is not used min and max are computed from the source image, once for all the stages.
+ * So use IM_GAMUT_MINMAX when a previous stage changes the range of the values.
+ * \ingroup pipeline */
+void imProcessPipelineToneGamut(imProcessPipeline* pipeline, int op, float* params);
+
+/** Adds a \ref imProcessBitMask stage. \n
+ * The source image must have an integer data type, the operation uses its number of bits.
+ * \ingroup pipeline */
+void imProcessPipelineBitMask(imProcessPipeline* pipeline, int mask, int op);
+
+/** Adds a \ref imProcessBitwiseNot stage. \n
+ * The source image must have an integer data type, the operation uses its number of bits.
+ * \ingroup pipeline */
+void imProcessPipelineBitwiseNot(imProcessPipeline* pipeline);
+
+/** Adds a \ref imProcessThreshold stage, applied to each plane. \n
+ * threshold = a <= level ? 0: value
+ * \ingroup pipeline */
+void imProcessPipelineThreshold(imProcessPipeline* pipeline, float level, int value);
+
+/** Adds a color space conversion stage. 
+ * Only IM_RGB to IM_GRAY (using the luma) and IM_GRAY to IM_RGB are supported.
+ * \ingroup pipeline */
+void imProcessPipelineConvertColorSpace(imProcessPipeline* pipeline, int color_space);
+
+/** Applies all the stages of the pipeline. \n
+ * Images must match size, target depth must match the depth after the color space stages. 
+ * Data type can be different, but complex is not supported. 
+ * Can be done in-place. Alpha channel is not included. \n
+ * Returns zero if the counter aborted, or if a stage is not supported for the images.
+ * \ingroup pipeline */
+int imProcessPipelineRun(const imProcessPipeline* pipeline, const imImage* src_image, imImage* dst_image);
+
+
 /** \defgroup imageenhance Image Enhance Utilities in Lua
  * \par
  * Operations are done in-place. Limitations are the same of the original functions.
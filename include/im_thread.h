@@ -0,0 +1,95 @@
+/** \file
+ * \brief System Dependent Threads (Internal Use Only)
+ *
+ * See Copyright Notice in im_lib.h
+ */
+
+#ifndef __IM_THREAD_H
+#define __IM_THREAD_H
+
+#if	defined(__cplusplus)
+extern "C" {
+#endif
+
+
+/* Minimal thread support used by the library to run work in background.
+ * Implemented in "im_systhread_win32.cpp" and "im_systhread_unix.cpp". */
+
+typedef struct _imThread imThread;
+
+/* Thread entry point. */
+typedef void (*imThreadFunc)(void* user_data);
+
+/* Starts a new thread that calls func(user_data).
+ * Returns NULL if the thread could not be created,
+ * in this case the caller should do the work in the current thread. */
+imThread* imThreadCreate(imThreadFunc func, void* user_data);
+
+/* Waits for the thread function to return and releases the thread. */
+void imThreadJoin(imThread* thread);
+
+/* Reads and writes a flag shared between threads, with a full memory barrier. */
+int imThreadAtomicGet(volatile int* value);
+void imThreadAtomicSet(volatile int* value, int new_value);
+
+/* Adds to a value shared between threads and returns the new value, with a full memory barrier. */
+int imThreadAtomicAdd(volatile int* value, int add);
+
+/* Replaces the value by new_value only if it is equal to old_value, with a full memory barrier. 
+ * Returns non zero if the value was replaced. */
+int imThreadAtomicCompareExchange(volatile int* value, int old_value, int new_value);
+
+/* Returns an identifier of the calling thread. */
+unsigned long imThreadId(void);
+
+/* Returns the number of processors available, at least 1. */
+int imThreadCount(void);
+
+/* Gives the processor to other threads. */
+void imThreadYield(void);
+
+/* Returns the elapsed time in seconds from an arbitrary start, not affected by clock changes. */
+double imThreadWallTime(void);
+
+/* Returns the CPU time used by the calling thread in seconds. */
+double imThreadCPUTime(void);
+
+typedef struct _imThreadSemaphore imThreadSemaphore;
+
+/* Counting semaphore used to put idle threads to sleep. 
+ * Create returns NULL if failed. Post adds count to the semaphore, 
+ * Wait blocks until the semaphore is not zero and decrements it. */
+imThreadSemaphore* imThreadSemaphoreCreate(void);
+void imThreadSemaphoreDestroy(imThreadSemaphore* sem);
+void imThreadSemaphorePost(imThreadSemaphore* sem, int count);
+void imThreadSemaphoreWait(imThreadSemaphore* sem);
+
+/* Task entry point, index goes from 0 to count-1. */
+typedef void (*imThreadTaskFunc)(void* user_data, int index);
+
+/* Calls func(user_data, index) for each index in [0,count) using up to imThreadCount() threads,
+ * the current thread included. Returns when all the tasks are done.
+ * Tasks are distributed among the threads of imThreadParallelBands, so they must be independent.
+ * Implemented in "im_thread.cpp". */
+void imThreadParallelFor(int count, imThreadTaskFunc func, void* user_data);
+
+/* Band entry point, processes the items from start to end-1. 
+ * Returns zero to cancel the remaining bands. */
+typedef int (*imThreadBandFunc)(void* user_data, int start, int end);
+
+/* Splits [0,count) in bands of band_size items and calls func for each band 
+ * using up to max_threads threads, the current thread included. If band_size is 0 it is computed. 
+ * The other threads are from a pool created in the first use and kept alive.
+ * Each thread starts with a contiguous range of bands and, when its range is done, 
+ * steals half of the bands left in the range of another thread. 
+ * Can be called by several threads at the same time, and also from inside a band (nested).
+ * Returns zero if a band was cancelled, the bands not started yet are skipped.
+ * Implemented in "im_thread.cpp". */
+int imThreadParallelBands(int count, int band_size, int max_threads, imThreadBandFunc func, void* user_data);
+
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
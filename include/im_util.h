@@ -283,6 +283,7 @@ int imCompressDataLZF(const void* src_data, int src_size, void* dst_data, int ds
 int imCompressDataUnLZF(const void* src_data, int src_size, void* dst_data, int dst_size);
 
 /** Compresses the data using the libLZO compression. (Since 3.9) \n
+* The destination buffer must be at least src_size + src_size/16 + 67 bytes. \n
 * Returns the size of the compressed buffer or zero if failed. \n
 * Available in a separate library called "im_lzo" which license is GPL.
 * \ingroup compress */
@@ -294,6 +295,56 @@ int imCompressDataLZO(const void* src_data, int src_size, void* dst_data, int ds
 * \ingroup compress */
 int imCompressDataUnLZO(const void* src_data, int src_size, void* dst_data, int dst_size);
 
+/** Compression or uncompression function with the same parameters as \ref imCompressDataLZF.
+ * \ingroup compress */
+typedef int (*imCompressDataFunc)(const void* src_data, int src_size, void* dst_data, int dst_size);
+
+/** Registers the LZO functions, so they can be used inside the library 
+ * without linking it to the "im_lzo" library. For example by the "IMT" format: \n
+ * imCompressSetLZO(imCompressDataLZO, imCompressDataUnLZO); \n
+ * Use NULL to unregister.
+ * \ingroup compress */
+void imCompressSetLZO(imCompressDataFunc compress_func, imCompressDataFunc uncompress_func);
+
+/** Returns the LZO functions registered with \ref imCompressSetLZO. Returns 0 if not registered.
+ * \ingroup compress */
+int imCompressGetLZO(imCompressDataFunc *compress_func, imCompressDataFunc *uncompress_func);
+
+/** Compression methods used by \ref imCompressDataBlocks.
+ * \ingroup compress */
+enum imCompressMethod
+{
+  IM_COMPRESS_NONE,     /**< blocks are only copied */
+  IM_COMPRESS_DEFLATE,  /**< ZLIB Deflate, quality can be 1 to 9 */
+  IM_COMPRESS_LZF,      /**< libLZF */
+  IM_COMPRESS_LZO       /**< libLZO, must be registered with \ref imCompressSetLZO */
+};
+
+/** Returns the minimum size of the destination buffer for \ref imCompressDataBlocks. \n
+ * Returns zero if the size does not fit in an int.
+ * \ingroup compress */
+int imCompressDataBlocksSize(int src_size, int block_size);
+
+/** Compresses the data in independent blocks using several threads. \n
+ * The data is split in blocks of block_size bytes (if zero uses 512Kb), each block 
+ * is compressed in parallel, and the result is a single buffer with a small block table 
+ * followed by the compressed blocks. Blocks that do not compress are stored as they are. \n
+ * The destination buffer must have at least \ref imCompressDataBlocksSize bytes. 
+ * method is a \ref imCompressMethod, quality is used only by IM_COMPRESS_DEFLATE. \n
+ * Returns the size of the compressed buffer or zero if failed.
+ * \ingroup compress */
+int imCompressDataBlocks(const void* src_data, int src_size, void* dst_data, int dst_size, int method, int quality, int block_size);
+
+/** Uncompresses the data compressed with \ref imCompressDataBlocks, blocks are uncompressed in parallel. \n
+ * Returns the uncompressed size or zero if failed.
+ * \ingroup compress */
+int imCompressDataUnBlocks(const void* src_data, int src_size, void* dst_data, int dst_size);
+
+/** Returns the method and the uncompressed size of data compressed with \ref imCompressDataBlocks. \n
+ * Returns zero if the data is not valid.
+ * \ingroup compress */
+int imCompressDataBlocksInfo(const void* src_data, int src_size, int *method, int *data_size);
+
 
 #if defined(__cplusplus)
 }
@@ -54,10 +54,17 @@ SRCJPEG = \
     jcdctmgr.c  jdcoefct.c  jdmerge.c   jfdctint.c  jquant2.c  \
     jchuff.c    jcprepct.c  jdcolor.c   jidctflt.c  jutils.c    jdarith.c \
     jcinit.c    jcsample.c  jddctmgr.c  jdpostct.c  jidctfst.c  jaricom.c  \
-    jcmainct.c  jctrans.c   jdhuff.c    jdsample.c  jidctint.c  jcarith.c
+    jcmainct.c  jctrans.c   jdhuff.c    jdsample.c  jidctint.c  jcarith.c  \
+    jsimd_sse2.c
 SRCJPEG  := $(addprefix libjpeg/, $(SRCJPEG)) im_format_jpeg.cpp
 INCLUDES += libjpeg 
 
+# SSE2 kernels for the DCT, color conversion and upsampling,
+# selected at run time when the processor supports them.
+ifdef USE_JPEG_SIMD
+  DEFINES += JPEG_SIMD
+endif
+
 SRCEXIF = \
     fuji/exif-mnote-data-fuji.c  fuji/mnote-fuji-entry.c  fuji/mnote-fuji-tag.c                    \
     canon/exif-mnote-data-canon.c  canon/mnote-canon-entry.c  canon/mnote-canon-tag.c              \
@@ -83,11 +90,12 @@ SRC = \
     im_colorutil.cpp      im_format_ico.cpp   im_palette.cpp       im_format_ras.cpp    \
     im_convertbitmap.cpp  im_format_led.cpp   im_counter.cpp       im_str.cpp           \
     im_convertcolor.cpp   im_fileraw.cpp      im_format_krn.cpp    im_compress.cpp      \
-    im_file.cpp           old_im.cpp          im_format_pfm.cpp                         \
+    im_file.cpp           old_im.cpp          im_format_pfm.cpp    im_format_imt.cpp    \
+    im_thread.cpp         im_cpu.cpp                                                  \
     $(SRCJPEG) $(SRCPNG) $(SRCTIFF) $(SRCLZF)
     
 ifneq ($(findstring Win, $(TEC_SYSNAME)), )
-  SRC += im_sysfile_win32.cpp im_dib.cpp im_dibxbitmap.cpp
+  SRC += im_sysfile_win32.cpp im_systhread_win32.cpp im_dib.cpp im_dibxbitmap.cpp
   
   ifneq ($(findstring dll, $(TEC_UNAME)), )
     SRC += im.rc
@@ -106,7 +114,8 @@ ifneq ($(findstring Win, $(TEC_SYSNAME)), )
   endif
 else
   USE_EXIF = Yes
-  SRC += im_sysfile_unix.cpp
+  SRC += im_sysfile_unix.cpp im_systhread_unix.cpp
+  LIBS += pthread
 endif
 
 ifdef USE_EXIF
@@ -7,6 +7,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <memory.h>
 #include <assert.h>
 #include <stdarg.h>
@@ -283,6 +284,7 @@ public:
   void SeekFrom(long pOffset);
   unsigned long Tell() const;
   int EndOfFile() const;
+  void ReadAhead(unsigned long pOffset, unsigned long pSize);
 };
 
 static imBinFileBase* iBinSubFileNewFunc()
@@ -338,6 +340,12 @@ void imBinSubFile::SeekTo(unsigned long pOffset)
   this->FileHandle->SeekTo(StartOffset + pOffset);
 }
 
+void imBinSubFile::ReadAhead(unsigned long pOffset, unsigned long pSize)
+{
+  assert(this->FileHandle);
+  this->FileHandle->ReadAhead(StartOffset + pOffset, pSize);
+}
+
 void imBinSubFile::SeekOffset(long pOffset)
 {
   assert(this->FileHandle);
@@ -519,8 +527,23 @@ extern "C" int imBinFileRegisterModule(imBinFileNewFunc pNewFunc)
 struct _imBinFile
 {
   imBinFileBase* binfile;
+
+  /* read ahead buffer of the text number parser */
+  char* text_buffer;
+  int text_size, text_pos;
 };
 
+/* Returns to the file the characters read ahead by the text number parser, 
+   so the file position is where the last number ended. */
+static void iBinFileTextSync(imBinFile* bfile)
+{
+  if (bfile->text_pos < bfile->text_size)
+    bfile->binfile->SeekOffset(-(long)(bfile->text_size - bfile->text_pos));
+
+  bfile->text_size = 0;
+  bfile->text_pos = 0;
+}
+
 imBinFile* imBinFileOpen(const char* pFileName)
 {
   assert(pFileName);
@@ -540,6 +563,9 @@ imBinFile* imBinFileOpen(const char* pFileName)
 
   imBinFile* bfile = new imBinFile;
   bfile->binfile = binfile;
+  bfile->text_buffer = NULL;
+  bfile->text_size = 0;
+  bfile->text_pos = 0;
 
   return bfile;
 }
@@ -560,6 +586,9 @@ imBinFile* imBinFileNew(const char* pFileName)
 
   imBinFile* bfile = new imBinFile;
   bfile->binfile = binfile;
+  bfile->text_buffer = NULL;
+  bfile->text_size = 0;
+  bfile->text_pos = 0;
 
   return bfile;
 }
@@ -567,6 +596,8 @@ imBinFile* imBinFileNew(const char* pFileName)
 void imBinFileClose(imBinFile* bfile)
 {
   assert(bfile);
+  iBinFileTextSync(bfile);
+  if (bfile->text_buffer) free(bfile->text_buffer);
   bfile->binfile->Close();
   delete bfile->binfile;
   delete bfile;
@@ -593,45 +624,58 @@ unsigned long imBinFileSize(imBinFile* bfile)
 unsigned long imBinFileRead(imBinFile* bfile, void* pValues, unsigned long pCount, int pSizeOf)
 {
   assert(bfile);
+  iBinFileTextSync(bfile);
   return bfile->binfile->Read(pValues, pCount, pSizeOf);
 }
 
 unsigned long imBinFileWrite(imBinFile* bfile, void* pValues, unsigned long pCount, int pSizeOf)
 {
   assert(bfile);
+  iBinFileTextSync(bfile);
   return bfile->binfile->Write(pValues, pCount, pSizeOf);
 }
 
 void imBinFileSeekTo(imBinFile* bfile, unsigned long pOffset)
 {
   assert(bfile);
+  iBinFileTextSync(bfile);
   bfile->binfile->SeekTo(pOffset);
 }
 
 void imBinFileSeekOffset(imBinFile* bfile, long pOffset)
 {
   assert(bfile);
+  iBinFileTextSync(bfile);
   bfile->binfile->SeekOffset(pOffset);
 }
 
 void imBinFileSeekFrom(imBinFile* bfile, long pOffset)
 {
   assert(bfile);
+  iBinFileTextSync(bfile);
   bfile->binfile->SeekFrom(pOffset);
 }
 
 unsigned long imBinFileTell(imBinFile* bfile)
 {
   assert(bfile);
+  iBinFileTextSync(bfile);
   return bfile->binfile->Tell();
 }
 
 int imBinFileEndOfFile(imBinFile* bfile)
 {
   assert(bfile);
+  iBinFileTextSync(bfile);
   return bfile->binfile->EndOfFile();
 }
 
+void imBinFileReadAhead(imBinFile* bfile, unsigned long pOffset, unsigned long pSize)
+{
+  assert(bfile);
+  bfile->binfile->ReadAhead(pOffset, pSize);
+}
+
 unsigned long imBinFilePrintf(imBinFile* bfile, const char *format, ...)
 {
   va_list arglist;
@@ -707,6 +751,347 @@ int imBinFileReadReal(imBinFile* handle, double *value)
   return 1;
 }
 
+/**************************************************
+                Text Number Parser
+***************************************************/
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IM_TEXT_SSE2
+#ifdef _MSC_VER
+#include <intrin.h>
+static int iTextFirstBit(int mask) { unsigned long index; _BitScanForward(&index, (unsigned long)mask); return (int)index; }
+#else
+static int iTextFirstBit(int mask) { return __builtin_ctz((unsigned int)mask); }
+#endif
+#endif
+
+#define IM_TEXT_BUFFER_SIZE 65536
+#define IM_TEXT_MAX_NUMBER 512  /* longest number accepted, a real written with %f can have about 330 characters */
+
+static inline int iTextIsNumber(char c, int real)
+{
+  if ((c >= '0' && c <= '9') || c == '-')
+    return 1;
+  if (real && (c == '+' || c == '.' || c == 'e' || c == 'E'))
+    return 1;
+  return 0;
+}
+
+/* Returns the first character of a number or end. */
+static const char* iTextSkipSeparators(const char* p, const char* end, int real)
+{
+#ifdef IM_TEXT_SSE2
+  /* checks 16 characters at a time */
+  const __m128i zero = _mm_set1_epi8('0');
+  const __m128i nine = _mm_set1_epi8(9);
+  const __m128i minus = _mm_set1_epi8('-');
+  while (end - p >= 16)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i t = _mm_sub_epi8(v, zero);
+    __m128i is_number = _mm_cmpeq_epi8(_mm_min_epu8(t, nine), t);  /* (unsigned)(c - '0') <= 9 */
+    is_number = _mm_or_si128(is_number, _mm_cmpeq_epi8(v, minus));
+    if (real)
+    {
+      is_number = _mm_or_si128(is_number, _mm_cmpeq_epi8(v, _mm_set1_epi8('+')));
+      is_number = _mm_or_si128(is_number, _mm_cmpeq_epi8(v, _mm_set1_epi8('.')));
+      is_number = _mm_or_si128(is_number, _mm_cmpeq_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)), _mm_set1_epi8('e')));
+    }
+
+    int mask = _mm_movemask_epi8(is_number);
+    if (mask)
+      return p + iTextFirstBit(mask);
+
+    p += 16;
+  }
+#endif
+
+  while (p < end && !iTextIsNumber(*p, real))
+    p++;
+
+  return p;
+}
+
+/* same as atoi, the number ends at the first character that is not a digit */
+static int iTextParseInteger(const char* p, const char* end)
+{
+  int negative = 0;
+  if (*p == '-')
+  {
+    negative = 1;
+    p++;
+  }
+
+  unsigned int value = 0;
+  while (p < end && *p >= '0' && *p <= '9')
+  {
+    value = value*10 + (unsigned int)(*p - '0');
+    p++;
+  }
+
+  return negative? -(int)value: (int)value;
+}
+
+/* same as atof */
+static double iTextParseReal(const char* start, const char* end)
+{
+  static const double pow10[23] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 
+                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  const char* p = start;
+  int negative = 0, digits = 0, exponent = 0;
+  unsigned long long mantissa = 0;
+
+  if (*p == '-' || *p == '+')
+  {
+    negative = (*p == '-');
+    p++;
+  }
+
+  while (p < end && *p >= '0' && *p <= '9')
+  {
+    if (digits || *p != '0')
+    {
+      mantissa = mantissa*10 + (*p - '0');
+      digits++;
+    }
+    p++;
+  }
+
+  if (p < end && *p == '.')
+  {
+    p++;
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+      if (digits || *p != '0')
+      {
+        mantissa = mantissa*10 + (*p - '0');
+        digits++;
+      }
+      exponent--;
+      p++;
+    }
+  }
+
+  if (p < end && (*p == 'e' || *p == 'E'))
+  {
+    const char* e = p + 1;
+    int exp_negative = 0, exp_value = 0, exp_digits = 0;
+    if (e < end && (*e == '-' || *e == '+'))
+    {
+      exp_negative = (*e == '-');
+      e++;
+    }
+    while (e < end && *e >= '0' && *e <= '9' && exp_value < 10000)
+    {
+      exp_value = exp_value*10 + (*e - '0');
+      exp_digits++;
+      e++;
+    }
+    if (exp_digits)
+    {
+      exponent += exp_negative? -exp_value: exp_value;
+      p = e;
+    }
+  }
+
+  /* exact when the mantissa and the power of 10 are exact doubles, 
+     otherwise let the C library do the correct rounding */
+  if (p == end && digits <= 15 && exponent >= -22 && exponent <= 22)
+  {
+    double value = (double)mantissa;
+    if (exponent < 0)
+      value /= pow10[-exponent];
+    else
+      value *= pow10[exponent];
+    return negative? -value: value;
+  }
+  else
+  {
+    char number[IM_TEXT_MAX_NUMBER+1];
+    int size = (int)(end - start);
+    memcpy(number, start, size);
+    number[size] = 0;
+    return atof(number);
+  }
+}
+
+/* Finds the next number in the read ahead buffer, refill the buffer when necessary. 
+   Returns the number limits or 0 if there are no more numbers. */
+static int iBinFileTextNextNumber(imBinFile* bfile, int real, const char** start, const char** end)
+{
+  if (!bfile->text_buffer)
+  {
+    bfile->text_buffer = (char*)malloc(IM_TEXT_BUFFER_SIZE);
+    if (!bfile->text_buffer)
+      return 0;
+  }
+
+  for (;;)
+  {
+    char* buffer = bfile->text_buffer;
+    const char* buffer_end = buffer + bfile->text_size;
+    const char* p = iTextSkipSeparators(buffer + bfile->text_pos, buffer_end, real);
+    const char* e = p;
+    while (e < buffer_end && iTextIsNumber(*e, real))
+      e++;
+
+    if (e < buffer_end)  /* number and its separator are in the buffer */
+    {
+      if (e - p > IM_TEXT_MAX_NUMBER)
+        return 0;
+
+      *start = p;
+      *end = e;
+      bfile->text_pos = (int)(e - buffer) + 1;  /* the separator is also consumed */
+      return 1;
+    }
+
+    /* keep the partial number and refill the buffer */
+    int keep = (int)(e - p);
+    if (keep > IM_TEXT_MAX_NUMBER)
+      return 0;
+
+    unsigned long remaining = bfile->binfile->FileSize() - bfile->binfile->Tell();
+    if (remaining == 0)
+    {
+      /* last number ends at the end of the file */
+      if (keep == 0)
+        return 0;
+
+      *start = p;
+      *end = e;
+      bfile->text_pos = bfile->text_size;
+      return 1;
+    }
+
+    memmove(buffer, p, keep);
+
+    unsigned long size = IM_TEXT_BUFFER_SIZE - keep;
+    if (size > remaining)
+      size = remaining;
+
+    size = bfile->binfile->Read(buffer + keep, size, 1);
+    if (bfile->binfile->HasError() || size == 0)
+    {
+      bfile->text_size = 0;
+      bfile->text_pos = 0;
+      return 0;
+    }
+
+    bfile->text_size = keep + (int)size;
+    bfile->text_pos = 0;
+  }
+}
+
+int imBinFileReadIntegerArray(imBinFile* bfile, int *values, int count)
+{
+  assert(bfile);
+  for (int i = 0; i < count; i++)
+  {
+    const char *start, *end;
+    if (!iBinFileTextNextNumber(bfile, 0, &start, &end))
+      return 0;
+
+    values[i] = iTextParseInteger(start, end);
+  }
+
+  return 1;
+}
+
+int imBinFileReadRealArray(imBinFile* bfile, double *values, int count)
+{
+  assert(bfile);
+  for (int i = 0; i < count; i++)
+  {
+    const char *start, *end;
+    if (!iBinFileTextNextNumber(bfile, 1, &start, &end))
+      return 0;
+
+    values[i] = iTextParseReal(start, end);
+  }
+
+  return 1;
+}
+
+static char* iTextFormatInteger(char* p, int value)
+{
+  char digits[12];
+  int n = 0;
+
+  unsigned int v = (unsigned int)value;
+  if (value < 0)
+  {
+    *p++ = '-';
+    v = 0u - v;
+  }
+
+  do
+  {
+    digits[n++] = (char)('0' + v % 10);
+    v /= 10;
+  } while (v);
+
+  while (n)
+    *p++ = digits[--n];
+
+  return p;
+}
+
+/* Writes the numbers separated by spaces, breaks the line when longer than max_line, 
+   and always after the last number. */
+static int iBinFileWriteText(imBinFile* bfile, const void* values, int count, int real, int precision, int max_line)
+{
+  char buffer[8192];
+  char* p = buffer;
+  int line_size = 0;
+
+  for (int i = 0; i < count; i++)
+  {
+    char* number = p;
+
+    if (real)
+      p += sprintf(p, "%.*f ", precision, ((const double*)values)[i]);
+    else
+    {
+      p = iTextFormatInteger(p, ((const int*)values)[i]);
+      *p++ = ' ';
+    }
+
+    line_size += (int)(p - number);
+    if ((max_line && line_size > max_line) || i == count-1)
+    {
+      *p++ = '\n';
+      line_size = 0;
+    }
+
+    /* largest real with %f is about 330 characters */
+    if (p - buffer > (int)sizeof(buffer) - 512)
+    {
+      if (imBinFileWrite(bfile, buffer, (unsigned long)(p - buffer), 1) != (unsigned long)(p - buffer))
+        return 0;
+      p = buffer;
+    }
+  }
+
+  if (p != buffer && imBinFileWrite(bfile, buffer, (unsigned long)(p - buffer), 1) != (unsigned long)(p - buffer))
+    return 0;
+
+  return !imBinFileError(bfile);
+}
+
+int imBinFileWriteIntegerArray(imBinFile* bfile, const int *values, int count, int max_line)
+{
+  assert(bfile);
+  return iBinFileWriteText(bfile, values, count, 0, 0, max_line);
+}
+
+int imBinFileWriteRealArray(imBinFile* bfile, const double *values, int count, int precision, int max_line)
+{
+  assert(bfile);
+  return iBinFileWriteText(bfile, values, count, 1, precision, max_line);
+}
+
 int imBinFileReadLine(imBinFile* handle, char* comment, int *size)
 {
   imbyte byte_value = 0;
@@ -759,5 +1144,6 @@ int imBinFileSkipLine(imBinFile* handle)
 static imBinFileBase* iBinFileBaseHandle(const char* pFileName)
 {
   imBinFile* bfile = (imBinFile*)pFileName;
+  iBinFileTextSync(bfile);
   return (imBinFileBase*)bfile->binfile;
 }
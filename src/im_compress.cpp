@@ -6,8 +6,12 @@
 
 
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 
 #include "im_util.h"
+#include "im_thread.h"
 
 
 #include "zlib.h"
@@ -43,3 +47,296 @@ int imCompressDataUnLZF(const void* src_data, int src_size, void* dst_data, int
 {
   return lzf_decompress(src_data, src_size, dst_data, dst_size);
 }
+
+static imCompressDataFunc iCompressLZO = NULL;
+static imCompressDataFunc iUnCompressLZO = NULL;
+
+void imCompressSetLZO(imCompressDataFunc compress_func, imCompressDataFunc uncompress_func)
+{
+  iCompressLZO = compress_func;
+  iUnCompressLZO = uncompress_func;
+}
+
+int imCompressGetLZO(imCompressDataFunc *compress_func, imCompressDataFunc *uncompress_func)
+{
+  if (!iCompressLZO || !iUnCompressLZO)
+    return 0;
+
+  if (compress_func) *compress_func = iCompressLZO;
+  if (uncompress_func) *uncompress_func = iUnCompressLZO;
+  return 1;
+}
+
+
+/* Block stream layout, all values in little endian:
+     char   signature[4]   "IMCB"
+     byte   version        1
+     byte   method         imCompressMethod
+     byte   reserved[2]
+     uint32 block_size, data_size, block_count
+     uint32 block_comp_size[block_count]
+     blocks data
+   A block with compressed size equal to its uncompressed size is stored as it is. */
+
+#define IM_BLOCK_HEADER 20
+#define IM_BLOCK_DEFAULT (512*1024)
+#define IM_BLOCK_MIN 4096
+
+static void iCompressPut32(unsigned char* data, unsigned int value)
+{
+  data[0] = (unsigned char)(value);
+  data[1] = (unsigned char)(value >> 8);
+  data[2] = (unsigned char)(value >> 16);
+  data[3] = (unsigned char)(value >> 24);
+}
+
+static unsigned int iCompressGet32(const unsigned char* data)
+{
+  return (unsigned int)data[0] | ((unsigned int)data[1] << 8) | 
+         ((unsigned int)data[2] << 16) | ((unsigned int)data[3] << 24);
+}
+
+static int iCompressBlockSize(int block_size)
+{
+  if (block_size <= 0) return IM_BLOCK_DEFAULT;
+  if (block_size < IM_BLOCK_MIN) return IM_BLOCK_MIN;
+  return block_size;
+}
+
+/* enough for all the methods, see imCompressDataZ and imCompressDataLZO */
+static int iCompressBlockBound(int size)
+{
+  return size + size/16 + 128;
+}
+
+int imCompressDataBlocksSize(int src_size, int block_size)
+{
+  block_size = iCompressBlockSize(block_size);
+  double block_count = (src_size + (double)block_size - 1) / block_size;
+  double size = IM_BLOCK_HEADER + block_count*(4 + (double)iCompressBlockBound(block_size));
+  if (size > INT_MAX)
+    return 0;
+  return (int)size;
+}
+
+struct iCompressBlocks
+{
+  const unsigned char* src_data;
+  unsigned char* dst_data;
+  int src_size, block_size, block_slot, method, quality;
+  const int* offset;      /* when uncompressing */
+  int* comp_size;         /* size of each block */
+  imCompressDataFunc lzo_func;
+};
+
+static int iCompressBlockRawSize(iCompressBlocks* blocks, int index)
+{
+  int start = index*blocks->block_size;
+  int size = blocks->src_size - start;
+  if (size > blocks->block_size) size = blocks->block_size;
+  return size;
+}
+
+static void iCompressBlock(void* user_data, int index)
+{
+  iCompressBlocks* blocks = (iCompressBlocks*)user_data;
+  const unsigned char* src = blocks->src_data + index*blocks->block_size;
+  unsigned char* dst = blocks->dst_data + index*blocks->block_slot;
+  int raw_size = iCompressBlockRawSize(blocks, index);
+  int size = 0;
+
+  switch (blocks->method)
+  {
+  case IM_COMPRESS_DEFLATE:
+    size = imCompressDataZ(src, raw_size, dst, blocks->block_slot, blocks->quality);
+    break;
+  case IM_COMPRESS_LZF:
+    size = imCompressDataLZF(src, raw_size, dst, blocks->block_slot);
+    break;
+  case IM_COMPRESS_LZO:
+    size = blocks->lzo_func(src, raw_size, dst, blocks->block_slot);
+    break;
+  }
+
+  /* store as it is when it does not compress */
+  if (size <= 0 || size >= raw_size)
+  {
+    memcpy(dst, src, raw_size);
+    size = raw_size;
+  }
+
+  blocks->comp_size[index] = size;
+}
+
+int imCompressDataBlocks(const void* src_data, int src_size, void* dst_data, int dst_size, int method, int quality, int block_size)
+{
+  iCompressBlocks blocks;
+  int i;
+
+  if (src_size <= 0 || method < IM_COMPRESS_NONE || method > IM_COMPRESS_LZO)
+    return 0;
+
+  block_size = iCompressBlockSize(block_size);
+  int min_size = imCompressDataBlocksSize(src_size, block_size);
+  if (min_size == 0 || dst_size < min_size)
+    return 0;
+
+  blocks.lzo_func = NULL;
+  if (method == IM_COMPRESS_LZO && !imCompressGetLZO(&blocks.lzo_func, NULL))
+    return 0;
+
+  if (quality < 1) quality = 1;
+  if (quality > 9) quality = 9;
+
+  int block_count = (int)(((double)src_size + block_size - 1) / block_size);
+  int table_size = IM_BLOCK_HEADER + 4*block_count;
+
+  blocks.src_data = (const unsigned char*)src_data;
+  blocks.dst_data = (unsigned char*)dst_data + table_size;
+  blocks.src_size = src_size;
+  blocks.block_size = block_size;
+  blocks.block_slot = iCompressBlockBound(block_size);
+  blocks.method = method;
+  blocks.quality = quality;
+  blocks.offset = NULL;
+  blocks.comp_size = (int*)malloc(block_count*sizeof(int));
+  if (!blocks.comp_size)
+    return 0;
+
+  /* each block is compressed in its own slot of the destination */
+  imThreadParallelFor(block_count, iCompressBlock, &blocks);
+
+  /* then the blocks are moved to be contiguous */
+  unsigned char* dst = (unsigned char*)dst_data;
+  int offset = table_size;
+  for (i = 0; i < block_count; i++)
+  {
+    unsigned char* slot = blocks.dst_data + i*blocks.block_slot;
+    if (dst + offset != slot)
+      memmove(dst + offset, slot, blocks.comp_size[i]);
+
+    iCompressPut32(dst + IM_BLOCK_HEADER + 4*i, (unsigned int)blocks.comp_size[i]);
+    offset += blocks.comp_size[i];
+  }
+
+  free(blocks.comp_size);
+
+  memcpy(dst, "IMCB", 4);
+  dst[4] = 1;
+  dst[5] = (unsigned char)method;
+  dst[6] = 0;
+  dst[7] = 0;
+  iCompressPut32(dst + 8, (unsigned int)block_size);
+  iCompressPut32(dst + 12, (unsigned int)src_size);
+  iCompressPut32(dst + 16, (unsigned int)block_count);
+
+  return offset;
+}
+
+int imCompressDataBlocksInfo(const void* src_data, int src_size, int *method, int *data_size)
+{
+  const unsigned char* src = (const unsigned char*)src_data;
+
+  if (src_size < IM_BLOCK_HEADER || memcmp(src, "IMCB", 4) != 0 || src[4] != 1 || src[5] > IM_COMPRESS_LZO)
+    return 0;
+
+  unsigned int block_size = iCompressGet32(src + 8);
+  unsigned int size = iCompressGet32(src + 12);
+  unsigned int block_count = iCompressGet32(src + 16);
+  if (block_size < IM_BLOCK_MIN || block_size > INT_MAX || size == 0 || size > INT_MAX ||
+      block_count != (unsigned int)(((double)size + block_size - 1) / block_size) ||
+      block_count > (unsigned int)(src_size - IM_BLOCK_HEADER)/4)
+    return 0;
+
+  if (method) *method = src[5];
+  if (data_size) *data_size = (int)size;
+  return 1;
+}
+
+static void iUnCompressBlock(void* user_data, int index)
+{
+  iCompressBlocks* blocks = (iCompressBlocks*)user_data;
+  const unsigned char* src = blocks->src_data + blocks->offset[index];
+  unsigned char* dst = blocks->dst_data + index*blocks->block_size;
+  int raw_size = iCompressBlockRawSize(blocks, index);
+  int comp_size = blocks->comp_size[index];
+  int size = 0;
+
+  if (comp_size == raw_size)
+  {
+    memcpy(dst, src, raw_size);
+    return;
+  }
+
+  switch (blocks->method)
+  {
+  case IM_COMPRESS_DEFLATE:
+    size = imCompressDataUnZ(src, comp_size, dst, raw_size);
+    break;
+  case IM_COMPRESS_LZF:
+    size = imCompressDataUnLZF(src, comp_size, dst, raw_size);
+    break;
+  case IM_COMPRESS_LZO:
+    size = blocks->lzo_func(src, comp_size, dst, raw_size);
+    break;
+  }
+
+  if (size != raw_size)
+    blocks->comp_size[index] = -1;  /* failed */
+}
+
+int imCompressDataUnBlocks(const void* src_data, int src_size, void* dst_data, int dst_size)
+{
+  const unsigned char* src = (const unsigned char*)src_data;
+  iCompressBlocks blocks;
+  int i, method, data_size;
+
+  if (!imCompressDataBlocksInfo(src_data, src_size, &method, &data_size) || dst_size < data_size)
+    return 0;
+
+  blocks.lzo_func = NULL;
+  if (method == IM_COMPRESS_LZO && !imCompressGetLZO(NULL, &blocks.lzo_func))
+    return 0;
+
+  int block_count = (int)iCompressGet32(src + 16);
+
+  blocks.src_data = src;
+  blocks.dst_data = (unsigned char*)dst_data;
+  blocks.src_size = data_size;
+  blocks.block_size = (int)iCompressGet32(src + 8);
+  blocks.method = method;
+  blocks.comp_size = (int*)malloc(2*block_count*sizeof(int));
+  if (!blocks.comp_size)
+    return 0;
+
+  int* offset = blocks.comp_size + block_count;
+  blocks.offset = offset;
+
+  /* validates the block table */
+  unsigned int pos = IM_BLOCK_HEADER + 4*block_count;
+  for (i = 0; i < block_count; i++)
+  {
+    unsigned int comp_size = iCompressGet32(src + IM_BLOCK_HEADER + 4*i);
+    if (comp_size == 0 || comp_size > (unsigned int)iCompressBlockRawSize(&blocks, i) || 
+        comp_size > (unsigned int)src_size - pos)
+    {
+      free(blocks.comp_size);
+      return 0;
+    }
+
+    blocks.comp_size[i] = (int)comp_size;
+    offset[i] = (int)pos;
+    pos += comp_size;
+  }
+
+  imThreadParallelFor(block_count, iUnCompressBlock, &blocks);
+
+  for (i = 0; i < block_count; i++)
+  {
+    if (blocks.comp_size[i] < 0)
+      data_size = 0;
+  }
+
+  free(blocks.comp_size);
+  return data_size;
+}
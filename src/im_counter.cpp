@@ -5,8 +5,11 @@
  */
 
 #include "im_counter.h"
+#include "im_thread.h"
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 #include <memory.h>
 
 
@@ -27,49 +30,113 @@ int imCounterHasCallback(void)
   return iCounterFunc!=NULL;
 }
 
+static imCounterProfileCallback iProfileFunc = NULL;
+static void* iProfileUserData = NULL;
+static volatile int iProfileEnabled = 0;
+
+static int iCounterProfileOn(void)
+{
+  return iProfileFunc != NULL || imThreadAtomicGet(&iProfileEnabled);
+}
+
+#define MAX_PROFILE_NAME 64
+
+/* Measure of one operation, while it is running */
+struct iCounterProfile
+{
+  int active;
+  char name[MAX_PROFILE_NAME];
+  double wall_time, cpu_time;   /* at begin, the difference at end */
+  double pixels, bytes, memory;
+  double other_cpu_time;        /* used by the other threads */
+  unsigned long thread_id;      /* thread that began the measure */
+  int threads;
+};
+
+/* nested operations in the same counter */
+#define MAX_PROFILE_LEVELS 4
+
+/* The counters can be used by several threads at the same time.
+   Begin, Total and End are called only by the thread that owns the counter, 
+   Inc and IncTo can be called by any thread while the counter is active. */
+
 struct iCounter
 {
-  int total;
-  int current;
-  int sequence;
+  volatile int total;
+  volatile int current;
+  volatile int sequence;
+  volatile int last_progress;  /* last progress sent to the callback, to skip repeated values */
+  volatile int aborted;
+  volatile int in_callback;    /* callback calls for the same counter are serialized */
+  unsigned long owner;         /* thread that began the counter */
   const char* message;
   void* userdata;
+  iCounterProfile profile[MAX_PROFILE_LEVELS];  /* one for each sequence level */
 };
 
-#define MAX_COUNTERS 10
+#define MAX_COUNTERS 64
 static iCounter iCounterList[MAX_COUNTERS];
+static volatile int iCounterListLock = 0;
 
-int imCounterBegin(const char* title)
+static void iCounterListLockEnter(void)
 {
-  static int first = 1;
-  if (first)
-  {
-    memset(iCounterList, 0, MAX_COUNTERS*sizeof(iCounter));
-    first = 0;
-  }
+  /* held only to search and update the list */
+  while (!imThreadAtomicCompareExchange(&iCounterListLock, 0, 1))
+    imThreadYield();
+}
+
+static void iCounterListLockLeave(void)
+{
+  imThreadAtomicSet(&iCounterListLock, 0);
+}
 
-  if (!iCounterFunc) 
+int imCounterBegin(const char* title)
+{
+  if (!iCounterFunc && !iCounterProfileOn()) 
     return -1;             // counter management is useless
 
-  int counter = -1;
+  unsigned long owner = imThreadId();
+  int counter = -1, sequence = 0;
+
+  iCounterListLockEnter();
+
+  // we are in a sequence of this thread
   for (int i = 0; i < MAX_COUNTERS; i++)
   {
-    if (iCounterList[i].sequence == 0 ||  // the counter is free
-        iCounterList[i].current == 0)     // or we are in a sequence
+    iCounter *ct = &iCounterList[i];
+    if (ct->sequence != 0 && ct->owner == owner && imThreadAtomicGet(&ct->current) == 0)
     {
       counter = i;
       break;
     }
   }
 
-  if (counter == -1) 
-    return -1;             // too many counters
+  // or the counter is free
+  if (counter == -1)
+  {
+    for (int i = 0; i < MAX_COUNTERS; i++)
+    {
+      if (iCounterList[i].sequence == 0)
+      {
+        iCounterList[i].owner = owner;
+        counter = i;
+        break;
+      }
+    }
+  }
 
-  iCounter *ct = &iCounterList[counter];
+  if (counter != -1)
+  {
+    iCounterList[counter].sequence++;
+    sequence = iCounterList[counter].sequence;
+  }
 
-  ct->sequence++;
+  iCounterListLockLeave();
 
-  if (ct->sequence == 1)   // top level counter
+  if (counter == -1) 
+    return -1;             // too many counters
+
+  if (sequence == 1 && iCounterFunc)       // top level counter
     iCounterFunc(counter, iCounterUserData, title, -1);
 
   return counter;
@@ -77,26 +144,34 @@ int imCounterBegin(const char* title)
 
 void imCounterEnd(int counter)
 {
-  if (counter == -1 || !iCounterFunc) 
+  if (counter == -1) 
     return;                // invalid counter
 
   iCounter *ct = &iCounterList[counter];
   if (ct->sequence == 0 || // counter with no begin or no total
-      ct->total == 0)
+      (ct->total == 0 && iCounterFunc))
     return;
 
   if (ct->sequence == 1)   // top level counter
   {
-    iCounterFunc(counter, iCounterUserData, NULL, 1001);
+    if (iCounterFunc)
+      iCounterFunc(counter, iCounterUserData, NULL, 1001);
+
+    iCounterListLockEnter();
     memset(ct, 0, sizeof(iCounter));
+    iCounterListLockLeave();
   }
   else
+  {
+    iCounterListLockEnter();
     ct->sequence--;
+    iCounterListLockLeave();
+  }
 }
 
 void* imCounterGetUserData(int counter)
 {
-  if (counter == -1 || !iCounterFunc) 
+  if (counter == -1) 
     return NULL;            // invalid counter
 
   iCounter *ct = &iCounterList[counter];
@@ -105,13 +180,53 @@ void* imCounterGetUserData(int counter)
 
 void imCounterSetUserData(int counter, void* userdata)
 {
-  if (counter == -1 || !iCounterFunc) 
+  if (counter == -1) 
     return;                // invalid counter
 
   iCounter *ct = &iCounterList[counter];
   ct->userdata = userdata;
 }
 
+static int iCounterNotify(int counter, iCounter *ct, int current, const char* msg)
+{
+  int total = ct->total;
+  int progress = (int)((current * 1000.0f)/total);
+  int last = (current == total);
+
+  if (last)
+    imThreadAtomicCompareExchange(&ct->current, total, 0);
+
+  // the first and the last counts are always sent,
+  // the others only if the progress changed and the callback is not busy
+  if (!msg && !last)
+  {
+    if (progress <= imThreadAtomicGet(&ct->last_progress) ||
+        !imThreadAtomicCompareExchange(&ct->in_callback, 0, 1))
+      return !imThreadAtomicGet(&ct->aborted);
+
+    if (progress <= ct->last_progress)  // another thread sent a newer progress
+    {
+      imThreadAtomicSet(&ct->in_callback, 0);
+      return !imThreadAtomicGet(&ct->aborted);
+    }
+  }
+  else
+  {
+    /* waits for the callback of another thread, that can be slow */
+    while (!imThreadAtomicCompareExchange(&ct->in_callback, 0, 1))
+      imThreadYield();
+  }
+
+  imThreadAtomicSet(&ct->last_progress, last? -1: progress);
+
+  int ret = iCounterFunc(counter, iCounterUserData, msg, progress);
+  if (!ret)
+    imThreadAtomicSet(&ct->aborted, 1);
+
+  imThreadAtomicSet(&ct->in_callback, 0);
+  return ret;
+}
+
 int imCounterInc(int counter)
 {
   if (counter == -1 || !iCounterFunc)                       
@@ -122,18 +237,16 @@ int imCounterInc(int counter)
       ct->total == 0)
     return 1;
 
-  const char* msg = NULL;
-  if (ct->current == 0)
-    msg = ct->message;
-
-  ct->current++;
+  if (imThreadAtomicGet(&ct->aborted))
+    return 0;
 
-  int progress = (int)((ct->current * 1000.0f)/ct->total);
+  int current = imThreadAtomicAdd(&ct->current, 1);
 
-  if (ct->current == ct->total)
-    ct->current = 0;
+  const char* msg = NULL;
+  if (current == 1)
+    msg = ct->message;
 
-  return iCounterFunc(counter, iCounterUserData, msg, progress);
+  return iCounterNotify(counter, ct, current, msg);
 }
 
 int imCounterIncTo(int counter, int count)
@@ -146,26 +259,24 @@ int imCounterIncTo(int counter, int count)
       ct->total == 0)
     return 1;
 
+  if (imThreadAtomicGet(&ct->aborted))
+    return 0;
+
   if (count <= 0) count = 0;
   if (count >= ct->total) count = ct->total;
 
-  ct->current = count;
+  imThreadAtomicSet(&ct->current, count);
 
   const char* msg = NULL;
-  if (ct->current == 0)
+  if (count == 0)
     msg = ct->message;
 
-  int progress = (int)((ct->current * 1000.0f)/ct->total);
-
-  if (ct->current == ct->total)
-    ct->current = 0;
-
-  return iCounterFunc(counter, iCounterUserData, msg, progress);
+  return iCounterNotify(counter, ct, count, msg);
 }
 
 void imCounterTotal(int counter, int total, const char* message)
 {
-  if (counter == -1 || !iCounterFunc) 
+  if (counter == -1) 
     return;                // invalid counter
 
   iCounter *ct = &iCounterList[counter];
@@ -174,5 +285,291 @@ void imCounterTotal(int counter, int total, const char* message)
 
   ct->message = message;
   ct->total = total;
-  ct->current = 0;
+  ct->last_progress = -1;
+  ct->aborted = 0;
+  imThreadAtomicSet(&ct->current, 0);
+}
+
+/* Aggregated report, by operation name */
+
+#define MAX_PROFILE_NAMES 128
+
+struct iCounterProfileTotal
+{
+  char name[MAX_PROFILE_NAME];
+  imCounterProfile total;
+};
+
+static iCounterProfileTotal iProfileReport[MAX_PROFILE_NAMES];
+static int iProfileReportCount = 0;
+static volatile int iProfileReportLock = 0;
+
+static void iCounterProfileReportLockEnter(void)
+{
+  while (!imThreadAtomicCompareExchange(&iProfileReportLock, 0, 1))
+    imThreadYield();
+}
+
+static void iCounterProfileReportLockLeave(void)
+{
+  imThreadAtomicSet(&iProfileReportLock, 0);
+}
+
+static void iCounterProfileReportAdd(const imCounterProfile* profile)
+{
+  iCounterProfileReportLockEnter();
+
+  int i;
+  for (i = 0; i < iProfileReportCount; i++)
+  {
+    if (strcmp(iProfileReport[i].name, profile->name) == 0)
+      break;
+  }
+
+  if (i == iProfileReportCount)
+  {
+    if (i == MAX_PROFILE_NAMES)
+    {
+      iCounterProfileReportLockLeave();
+      return;              // too many names
+    }
+
+    memset(&iProfileReport[i], 0, sizeof(iCounterProfileTotal));
+    strcpy(iProfileReport[i].name, profile->name);
+    iProfileReportCount++;
+  }
+
+  imCounterProfile* total = &iProfileReport[i].total;
+  total->count++;
+  total->wall_time += profile->wall_time;
+  total->cpu_time += profile->cpu_time;
+  total->pixels += profile->pixels;
+  total->bytes += profile->bytes;
+  total->memory += profile->memory;
+  if (profile->threads > total->threads)
+    total->threads = profile->threads;
+
+  iCounterProfileReportLockLeave();
+}
+
+imCounterProfileCallback imCounterSetProfileCallback(void* user_data, imCounterProfileCallback profile_func)
+{
+  imCounterProfileCallback old_profile_func = iProfileFunc;
+  iProfileFunc = profile_func;
+  if (user_data)
+    iProfileUserData = user_data;
+  return old_profile_func;
+}
+
+int imCounterProfileEnable(int enable)
+{
+  int old_enable = imThreadAtomicGet(&iProfileEnabled);
+  imThreadAtomicSet(&iProfileEnabled, enable? 1: 0);
+  return old_enable;
+}
+
+void imCounterProfileReset(void)
+{
+  iCounterProfileReportLockEnter();
+  iProfileReportCount = 0;
+  iCounterProfileReportLockLeave();
+}
+
+static int iCounterProfileCompare(const void* p1, const void* p2)
+{
+  const iCounterProfileTotal* profile1 = (const iCounterProfileTotal*)p1;
+  const iCounterProfileTotal* profile2 = (const iCounterProfileTotal*)p2;
+  if (profile1->total.wall_time > profile2->total.wall_time) return -1;
+  if (profile1->total.wall_time < profile2->total.wall_time) return 1;
+  return 0;
+}
+
+static void iCounterProfileSort(void)
+{
+  /* must be called with the report lock */
+  qsort(iProfileReport, iProfileReportCount, sizeof(iCounterProfileTotal), iCounterProfileCompare);
+  for (int i = 0; i < iProfileReportCount; i++)
+    iProfileReport[i].total.name = iProfileReport[i].name;
+}
+
+int imCounterProfileGet(int index, imCounterProfile* profile)
+{
+  iCounterProfileReportLockEnter();
+
+  if (index < 0 || index >= iProfileReportCount)
+  {
+    iCounterProfileReportLockLeave();
+    return 0;
+  }
+
+  iCounterProfileSort();
+  *profile = iProfileReport[index].total;
+
+  iCounterProfileReportLockLeave();
+  return 1;
+}
+
+static void iCounterProfileAppend(char* report, int size, int *len, const char* line)
+{
+  int line_len = (int)strlen(line);
+  if (*len + line_len > size - 1)
+    line_len = size - 1 - *len;
+  if (line_len <= 0)
+    return;
+
+  memcpy(report + *len, line, line_len);
+  *len += line_len;
+  report[*len] = 0;
+}
+
+int imCounterProfileReport(char* report, int size)
+{
+  char line[256];
+  int len = 0;
+
+  if (report && size > 0)
+    report[0] = 0;
+
+  iCounterProfileReportLockEnter();
+
+  iCounterProfileSort();
+
+  if (report && size > 0)
+  {
+    sprintf(line, "%-32s %8s %10s %10s %10s %10s %10s %7s %10s\n", 
+            "Operation", "Count", "Wall(s)", "CPU(s)", "MPixels", "MPixels/s", "MBytes", "Threads", "Memory(MB)");
+    iCounterProfileAppend(report, size, &len, line);
+
+    for (int i = 0; i < iProfileReportCount; i++)
+    {
+      imCounterProfile* total = &iProfileReport[i].total;
+      double rate = total->wall_time > 0? total->pixels / (total->wall_time * 1.0e6): 0;
+      sprintf(line, "%-32.32s %8d %10.4f %10.4f %10.3f %10.2f %10.3f %7d %10.3f\n", 
+              total->name, total->count, total->wall_time, total->cpu_time, 
+              total->pixels * 1.0e-6, rate, total->bytes / (1024.0*1024.0), 
+              total->threads, total->memory / (1024.0*1024.0));
+      iCounterProfileAppend(report, size, &len, line);
+    }
+  }
+
+  int count = iProfileReportCount;
+  iCounterProfileReportLockLeave();
+  return count;
+}
+
+/* The measures are updated with the list lock, 
+   Begin and End are called only by the thread that uses the counter, Add by any thread. */
+
+static iCounterProfile* iCounterProfileLevel(int counter)
+{
+  iCounter *ct = &iCounterList[counter];
+  if (ct->sequence == 0 || ct->sequence > MAX_PROFILE_LEVELS)
+    return NULL;
+  return &ct->profile[ct->sequence - 1];
+}
+
+void imCounterProfileBegin(int counter, const char* name)
+{
+  if (counter == -1 || !iCounterProfileOn())
+    return;
+
+  double cpu_time = imThreadCPUTime();
+  double wall_time = imThreadWallTime();
+
+  iCounterListLockEnter();
+  iCounterProfile* profile = iCounterProfileLevel(counter);
+  if (profile)
+  {
+    memset(profile, 0, sizeof(iCounterProfile));
+    strncpy(profile->name, name? name: "", MAX_PROFILE_NAME - 1);
+    profile->wall_time = wall_time;
+    profile->cpu_time = cpu_time;
+    profile->thread_id = imThreadId();
+    profile->threads = 1;
+    profile->active = 1;
+  }
+  iCounterListLockLeave();
+}
+
+void imCounterProfileAdd(int counter, double pixels, double bytes, int threads, double memory)
+{
+  if (counter == -1 || !iCounterProfileOn())
+    return;
+
+  iCounterListLockEnter();
+  iCounterProfile* profile = iCounterProfileLevel(counter);
+  if (profile && profile->active)
+  {
+    profile->pixels += pixels;
+    profile->bytes += bytes;
+    profile->memory += memory;
+    if (threads > profile->threads)
+      profile->threads = threads;
+  }
+  iCounterListLockLeave();
+}
+
+int imCounterProfileIsActive(int counter)
+{
+  if (counter == -1 || !iCounterProfileOn())
+    return 0;
+
+  iCounterListLockEnter();
+  iCounterProfile* profile = iCounterProfileLevel(counter);
+  int active = profile && profile->active;
+  iCounterListLockLeave();
+  return active;
+}
+
+void imCounterProfileAddCPUTime(int counter, double cpu_time)
+{
+  if (counter == -1 || !iCounterProfileOn())
+    return;
+
+  unsigned long thread_id = imThreadId();
+
+  iCounterListLockEnter();
+  iCounterProfile* profile = iCounterProfileLevel(counter);
+  if (profile && profile->active && profile->thread_id != thread_id)
+    profile->other_cpu_time += cpu_time;
+  iCounterListLockLeave();
+}
+
+void imCounterProfileEnd(int counter)
+{
+  if (counter == -1)
+    return;
+
+  double wall_time = imThreadWallTime();
+  double cpu_time = imThreadCPUTime();
+
+  imCounterProfile measure;
+  char name[MAX_PROFILE_NAME];
+
+  iCounterListLockEnter();
+  iCounterProfile* profile = iCounterProfileLevel(counter);
+  if (!profile || !profile->active)
+  {
+    iCounterListLockLeave();
+    return;
+  }
+
+  profile->active = 0;
+  strcpy(name, profile->name);
+  measure.name = name;
+  measure.count = 1;
+  measure.wall_time = wall_time - profile->wall_time;
+  measure.cpu_time = cpu_time - profile->cpu_time + profile->other_cpu_time;
+  measure.pixels = profile->pixels;
+  measure.bytes = profile->bytes;
+  measure.threads = profile->threads;
+  measure.memory = profile->memory;
+  iCounterListLockLeave();
+
+  if (imThreadAtomicGet(&iProfileEnabled))
+    iCounterProfileReportAdd(&measure);
+
+  imCounterProfileCallback profile_func = iProfileFunc;
+  if (profile_func)
+    profile_func(iProfileUserData, &measure);
 }
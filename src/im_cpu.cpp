@@ -0,0 +1,196 @@
+/** \file
+ * \brief Processor Features and Kernel Dispatch
+ *
+ * See Copyright Notice in im_lib.h
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "im_cpu.h"
+#include "im_thread.h"
+
+#if defined(IM_CPU_X86)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+
+static volatile int iCPUDetected = -1;   /* features of the processor, limited by IM_CPU */
+static volatile int iCPUFeatures = -1;   /* features used by the kernels */
+
+#if defined(IM_CPU_X86)
+static void iCPUId(int leaf, unsigned int reg[4])
+{
+#ifdef _MSC_VER
+  int info[4];
+  __cpuidex(info, leaf, 0);
+  for (int i = 0; i < 4; i++)
+    reg[i] = (unsigned int)info[i];
+#else
+  if (!__get_cpuid_count((unsigned int)leaf, 0, &reg[0], &reg[1], &reg[2], &reg[3]))
+    reg[0] = reg[1] = reg[2] = reg[3] = 0;
+#endif
+}
+
+static unsigned int iCPUXCR0(void)
+{
+  /* registers saved by the operating system */
+#ifdef _MSC_VER
+  return (unsigned int)_xgetbv(0);
+#else
+  unsigned int eax, edx;
+  __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return eax;
+#endif
+}
+#endif
+
+static int iCPUDetect(void)
+{
+  int features = 0;
+
+#if defined(IM_CPU_X86)
+  unsigned int reg[4];
+  iCPUId(0, reg);
+  unsigned int max_leaf = reg[0];
+
+  iCPUId(1, reg);
+  unsigned int ecx1 = reg[2], edx1 = reg[3];
+
+  if (!(edx1 & (1u << 26)))   /* SSE2 */
+    return 0;
+  features |= IM_CPU_SSE2;
+
+  if (!(ecx1 & (1u << 19)))   /* SSE4.1 */
+    return features;
+  features |= IM_CPU_SSE41;
+
+  /* OSXSAVE and AVX, and the YMM registers are saved */
+  if (max_leaf < 7 || !(ecx1 & (1u << 27)) || !(ecx1 & (1u << 28)))
+    return features;
+  unsigned int xcr0 = iCPUXCR0();
+  if ((xcr0 & 0x06) != 0x06)
+    return features;
+
+  iCPUId(7, reg);
+  unsigned int ebx7 = reg[1];
+  if (!(ebx7 & (1u << 5)))    /* AVX2 */
+    return features;
+  features |= IM_CPU_AVX2;
+
+  /* AVX-512 F and BW, and the ZMM and mask registers are saved */
+  if ((ebx7 & (1u << 16)) && (ebx7 & (1u << 30)) && (xcr0 & 0xE6) == 0xE6)
+    features |= IM_CPU_AVX512;
+#endif
+
+  return features;
+}
+
+static int iCPUEnvLimit(void)
+{
+  const char* env = getenv("IM_CPU");
+  if (!env)
+    return -1;
+
+  if (strcmp(env, "generic") == 0) return 0;
+  if (strcmp(env, "sse2") == 0) return IM_CPU_SSE2;
+  if (strcmp(env, "sse41") == 0) return IM_CPU_SSE2 | IM_CPU_SSE41;
+  if (strcmp(env, "avx2") == 0) return IM_CPU_SSE2 | IM_CPU_SSE41 | IM_CPU_AVX2;
+  return -1;   /* "avx512" or unknown, no limit */
+}
+
+static int iCPUInit(void)
+{
+  int detected = imThreadAtomicGet(&iCPUDetected);
+  if (detected < 0)
+  {
+    /* several threads may detect at the same time, the result is the same */
+    detected = iCPUDetect() & iCPUEnvLimit();
+    imThreadAtomicCompareExchange(&iCPUFeatures, -1, detected);
+    imThreadAtomicSet(&iCPUDetected, detected);
+  }
+  return detected;
+}
+
+int imCPUFeatures(void)
+{
+  iCPUInit();
+  return imThreadAtomicGet(&iCPUFeatures);
+}
+
+int imCPUSetFeatures(int features)
+{
+  int detected = iCPUInit();
+  int old_features = imThreadAtomicGet(&iCPUFeatures);
+
+  if (features < 0)
+    features = detected;
+
+  imThreadAtomicSet(&iCPUFeatures, features & detected);
+  return old_features;
+}
+
+const char* imCPUFeatureName(int features)
+{
+  if (features & IM_CPU_AVX512) return "avx512";
+  if (features & IM_CPU_AVX2) return "avx2";
+  if (features & IM_CPU_SSE41) return "sse41";
+  if (features & IM_CPU_SSE2) return "sse2";
+  return "generic";
+}
+
+static volatile int iKernelLock = 0;
+static imCPUKernel* iKernelList = NULL;
+
+static void iCPUKernelRegister(imCPUKernel* kernel)
+{
+  while (!imThreadAtomicCompareExchange(&iKernelLock, 0, 1))
+    imThreadYield();
+
+  if (!kernel->registered)
+  {
+    imCPUKernel** link = &iKernelList;
+    while (*link) link = &((*link)->next);
+    kernel->next = NULL;
+    *link = kernel;
+
+    imThreadAtomicSet(&kernel->registered, 1);
+  }
+
+  imThreadAtomicSet(&iKernelLock, 0);
+}
+
+imCPUFunc imCPUKernelSelect(imCPUKernel* kernel)
+{
+  if (!imThreadAtomicGet(&kernel->registered))
+    iCPUKernelRegister(kernel);
+
+  int features = imCPUFeatures();
+
+  for (int i = 0; i < kernel->count; i++)
+  {
+    int required = kernel->variant[i].features;
+    if ((features & required) == required)
+      return kernel->variant[i].func;
+  }
+
+  /* the generic variant is the last one */
+  return kernel->variant[kernel->count - 1].func;
+}
+
+const imCPUKernel* imCPUKernelNext(const imCPUKernel* kernel)
+{
+  const imCPUKernel* next;
+
+  while (!imThreadAtomicCompareExchange(&iKernelLock, 0, 1))
+    imThreadYield();
+
+  next = kernel? kernel->next: iKernelList;
+
+  imThreadAtomicSet(&iKernelLock, 0);
+  return next;
+}
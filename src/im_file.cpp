@@ -5,6 +5,7 @@
  */
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 #include <assert.h>
 
@@ -27,6 +28,8 @@ void imFileClear(imFile* ifile)
   ifile->line_buffer_size = 0;
   ifile->line_buffer_extra = 0;
   ifile->line_buffer_alloc = 0;
+  ifile->line_band = 0;
+  ifile->prefetch = 0;
 
   ifile->convert_bpp = 0;
   ifile->switch_type = 0;
@@ -54,6 +57,13 @@ void imFileSetBaseAttributes(imFile* ifile)
   attrib_table->Set("FileImageCount", IM_INT, 1, &ifileformat->image_count);
 }
 
+void imFileReadPendingAttributes(imFile* ifile)
+{
+  imFileFormatBase* ifileformat = (imFileFormatBase*)ifile;
+  if (ifileformat->pending_attributes)
+    ifileformat->ReadPendingAttributes();
+}
+
 imFile* imFileOpen(const char* file_name, int *error)
 {
   assert(file_name);
@@ -117,6 +127,8 @@ void imFileClose(imFile* ifile)
   imFileFormatBase* ifileformat = (imFileFormatBase*)ifile;
   imAttribTable* attrib_table = (imAttribTable*)ifile->attrib_table;
 
+  if (ifile->prefetch) imFilePrefetchFinish(ifile);
+
   imCounterEnd(ifile->counter);
 
   ifileformat->Close();
@@ -141,6 +153,7 @@ void imFileSetAttribute(imFile* ifile, const char* attrib, int data_type, int co
   assert(ifile);
   assert(attrib);
   imFileFormatBase* ifileformat = (imFileFormatBase*)ifile;
+  imFileReadPendingAttributes(ifile);
   imAttribTable* attrib_table = (imAttribTable*)ifileformat->attrib_table;
   if (data)
     attrib_table->Set(attrib, data_type, count, data);
@@ -153,6 +166,7 @@ void imFileSetAttribInteger(const imFile* ifile, const char* attrib, int data_ty
   assert(ifile);
   assert(attrib);
   imFileFormatBase* ifileformat = (imFileFormatBase*)ifile;
+  imFileReadPendingAttributes((imFile*)ifile);
   imAttribTable* attrib_table = (imAttribTable*)ifileformat->attrib_table;
   attrib_table->SetInteger(attrib, data_type, value);
 }
@@ -162,6 +176,7 @@ void imFileSetAttribReal(const imFile* ifile, const char* attrib, int data_type,
   assert(ifile);
   assert(attrib);
   imFileFormatBase* ifileformat = (imFileFormatBase*)ifile;
+  imFileReadPendingAttributes((imFile*)ifile);
   imAttribTable* attrib_table = (imAttribTable*)ifileformat->attrib_table;
   attrib_table->SetReal(attrib, data_type, value);
 }
@@ -171,6 +186,7 @@ void imFileSetAttribString(const imFile* ifile, const char* attrib, const char*
   assert(ifile);
   assert(attrib);
   imFileFormatBase* ifileformat = (imFileFormatBase*)ifile;
+  imFileReadPendingAttributes((imFile*)ifile);
   imAttribTable* attrib_table = (imAttribTable*)ifileformat->attrib_table;
   attrib_table->SetString(attrib, value);
 }
@@ -180,6 +196,7 @@ const void* imFileGetAttribute(imFile* ifile, const char* attrib, int *data_type
   assert(ifile);
   assert(attrib);
   imFileFormatBase* ifileformat = (imFileFormatBase*)ifile;
+  imFileReadPendingAttributes(ifile);
   imAttribTable* attrib_table = (imAttribTable*)ifileformat->attrib_table;
   return attrib_table->Get(attrib, data_type, count);
 }
@@ -189,6 +206,7 @@ int imFileGetAttribInteger(const imFile* ifile, const char* attrib, int index)
   assert(ifile);
   assert(attrib);
   imFileFormatBase* ifileformat = (imFileFormatBase*)ifile;
+  imFileReadPendingAttributes((imFile*)ifile);
   imAttribTable* attrib_table = (imAttribTable*)ifileformat->attrib_table;
   return attrib_table->GetInteger(attrib, index);
 }
@@ -198,6 +216,7 @@ double imFileGetAttribReal(const imFile* ifile, const char* attrib, int index)
   assert(ifile);
   assert(attrib);
   imFileFormatBase* ifileformat = (imFileFormatBase*)ifile;
+  imFileReadPendingAttributes((imFile*)ifile);
   imAttribTable* attrib_table = (imAttribTable*)ifileformat->attrib_table;
   return attrib_table->GetReal(attrib, index);
 }
@@ -207,6 +226,7 @@ const char* imFileGetAttribString(const imFile* ifile, const char* attrib)
   assert(ifile);
   assert(attrib);
   imFileFormatBase* ifileformat = (imFileFormatBase*)ifile;
+  imFileReadPendingAttributes((imFile*)ifile);
   imAttribTable* attrib_table = (imAttribTable*)ifileformat->attrib_table;
   return attrib_table->GetString(attrib);
 }
@@ -226,6 +246,8 @@ void imFileGetAttributeList(imFile* ifile, char** attrib, int *attrib_count)
   assert(ifile);
   assert(attrib_count);
 
+  imFileReadPendingAttributes(ifile);
+
   imAttribTable* attrib_table = (imAttribTable*)ifile->attrib_table;
   *attrib_count = attrib_table->Count();
 
@@ -359,10 +381,10 @@ void imFileGetPalette(imFile* ifile, long* palette, int *palette_count)
  if (palette_count) *palette_count = ifile->palette_count;
 }
 
-static void iFileCheckConvertGray(imFile* ifile, imbyte* data)
+static int iFileCheckGrayPalette(imFile* ifile, imbyte* remap)
 {
   int i, do_remap = 0;
-  imbyte remap[256], r, g, b;
+  imbyte r, g, b;
 
   // enforce the palette to only have grays in the correct order.
 
@@ -380,14 +402,7 @@ static void iFileCheckConvertGray(imFile* ifile, imbyte* data)
   }
 
   if (!do_remap)
-    return;
-
-  int count = ifile->width*ifile->height;
-  for(i = 0; i < count; i++)
-  {
-    *data = remap[*data];
-    data++;
-  }
+    return 0;
 
   int transp_count;
   imbyte* transp_map = (imbyte*)imFileGetAttribute(ifile, "TransparencyMap", NULL, &transp_count);
@@ -398,11 +413,28 @@ static void iFileCheckConvertGray(imFile* ifile, imbyte* data)
       new_transp_map[i] = transp_map[remap[i]];
     imFileSetAttribute(ifile, "TransparencyMap", IM_BYTE, transp_count, new_transp_map);
   }
+
+  return 1;
+}
+
+static void iFileConvertGray(imbyte* data, int count, const imbyte* remap)
+{
+  for(int i = 0; i < count; i++)
+  {
+    *data = remap[*data];
+    data++;
+  }
+}
+
+static void iFileCheckConvertGray(imFile* ifile, imbyte* data)
+{
+  imbyte remap[256];
+  if (iFileCheckGrayPalette(ifile, remap))
+    iFileConvertGray(data, ifile->width*ifile->height, remap);
 }
 
-static void iFileCheckConvertBinary(imFile* ifile, imbyte* data)
+static void iFileCheckConvertBinary(imbyte* data, int count)
 {
-  int count = ifile->width*ifile->height;
   for(int i = 0; i < count; i++)
   {
     if (*data)
@@ -411,12 +443,8 @@ static void iFileCheckConvertBinary(imFile* ifile, imbyte* data)
   }
 }
 
-int imFileReadImageData(imFile* ifile, void* data, int convert2bitmap, int color_mode_flags)
+static int iFileSetUserMode(imFile* ifile, int convert2bitmap, int color_mode_flags)
 {
-  assert(ifile);
-  assert(!ifile->is_new);
-  imFileFormatBase* ifileformat = (imFileFormatBase*)ifile;
-
   if (ifile->image_index == -1)
     return IM_ERR_DATA;
 
@@ -443,7 +471,45 @@ int imFileReadImageData(imFile* ifile, void* data, int convert2bitmap, int color
 
   imFileLineBufferInit(ifile);
 
-  int ret = ifileformat->ReadImageData(data);
+  return IM_ERR_NONE;
+}
+
+static void iFileProfileBegin(imFile* ifile, const char* op)
+{
+  if (ifile->counter == -1)
+    return;
+
+  imFileFormatBase* ifileformat = (imFileFormatBase*)ifile;
+  char name[64];
+  sprintf(name, "%s %.50s", op, ifileformat->iformat->format);
+  imCounterProfileBegin(ifile->counter, name);
+}
+
+static void iFileProfileEnd(imFile* ifile, int band_height)
+{
+  if (ifile->counter == -1)
+    return;
+
+  double pixels = (double)ifile->width*ifile->height*imColorModeDepth(ifile->user_color_mode);
+  double bytes = (double)imImageDataSize(ifile->width, ifile->height, ifile->user_color_mode, ifile->user_data_type);
+  double memory = band_height? (double)imImageDataSize(ifile->width, band_height, ifile->user_color_mode, ifile->user_data_type): 0;
+  imCounterProfileAdd(ifile->counter, pixels, bytes, 1, memory);
+  imCounterProfileEnd(ifile->counter);
+}
+
+int imFileReadImageData(imFile* ifile, void* data, int convert2bitmap, int color_mode_flags)
+{
+  assert(ifile);
+  assert(!ifile->is_new);
+  imFileFormatBase* ifileformat = (imFileFormatBase*)ifile;
+
+  int ret = iFileSetUserMode(ifile, convert2bitmap, color_mode_flags);
+  if (ret != IM_ERR_NONE)
+    return ret;
+
+  iFileProfileBegin(ifile, "Read");
+
+  ret = ifileformat->ReadImageData(data);
 
   // here we can NOT change the file_color_mode we already returned to the user
   // so just check for gray and binary consistency
@@ -452,7 +518,98 @@ int imFileReadImageData(imFile* ifile, void* data, int convert2bitmap, int color
     iFileCheckConvertGray(ifile, (imbyte*)data);
 
   if (imColorModeSpace(ifile->file_color_mode) == IM_BINARY)
-    iFileCheckConvertBinary(ifile, (imbyte*)data);
+    iFileCheckConvertBinary((imbyte*)data, ifile->width*ifile->height);
+
+  iFileProfileEnd(ifile, 0);
+
+  return ret;
+}
+
+struct iFileLines
+{
+  imFileLinesCallback callback;
+  void* user_data;
+  int check_gray, do_remap;
+  imbyte remap[256];
+};
+
+static int iFileLinesCallback(imFile* ifile, void* data, int line_start, int line_count, void* user_data)
+{
+  iFileLines* lines = (iFileLines*)user_data;
+
+  // same checks of imFileReadImageData, but for each band
+
+  if (imColorModeSpace(ifile->file_color_mode) == IM_GRAY && ifile->file_data_type == IM_BYTE)
+  {
+    if (lines->check_gray)
+    {
+      lines->do_remap = iFileCheckGrayPalette(ifile, lines->remap);
+      lines->check_gray = 0;
+    }
+
+    if (lines->do_remap)
+      iFileConvertGray((imbyte*)data, ifile->width*line_count, lines->remap);
+  }
+
+  if (imColorModeSpace(ifile->file_color_mode) == IM_BINARY)
+    iFileCheckConvertBinary((imbyte*)data, ifile->width*line_count);
+
+  return lines->callback(ifile, data, line_start, line_count, lines->user_data);
+}
+
+int imFileReadImageLines(imFile* ifile, imFileLinesCallback callback, void* user_data, int band_height, int convert2bitmap, int color_mode_flags)
+{
+  assert(ifile);
+  assert(!ifile->is_new);
+  assert(callback);
+  imFileFormatBase* ifileformat = (imFileFormatBase*)ifile;
+
+  int ret = iFileSetUserMode(ifile, convert2bitmap, color_mode_flags);
+  if (ret != IM_ERR_NONE)
+    return ret;
+
+  iFileLines lines;
+  lines.callback = callback;
+  lines.user_data = user_data;
+  lines.check_gray = 1;
+  lines.do_remap = 0;
+
+  // ICO changes the user data after all the lines are read
+  if (band_height <= 0 || band_height > ifile->height || 
+      imStrEqual(ifileformat->iformat->format, "ICO"))
+    band_height = ifile->height;
+
+  if (band_height == ifile->height)
+  {
+    void* data = malloc(imImageDataSize(ifile->width, ifile->height, ifile->user_color_mode, ifile->user_data_type));
+    if (!data)
+      return IM_ERR_MEM;
+
+    iFileProfileBegin(ifile, "Read Lines");
+
+    ret = ifileformat->ReadImageData(data);
+
+    if (ret == IM_ERR_NONE && 
+        !iFileLinesCallback(ifile, data, 0, ifile->height, &lines))
+      ret = IM_ERR_COUNTER;
+
+    iFileProfileEnd(ifile, band_height);
+
+    free(data);
+    return ret;
+  }
+
+  if (!imFileLineBandInit(ifile, band_height, iFileLinesCallback, &lines))
+    return IM_ERR_MEM;
+
+  iFileProfileBegin(ifile, "Read Lines");
+
+  ret = ifileformat->ReadImageData(NULL);
+
+  if (!imFileLineBandFinish(ifile, ret == IM_ERR_NONE) && ret == IM_ERR_NONE)
+    ret = IM_ERR_COUNTER;
+
+  iFileProfileEnd(ifile, band_height);
 
   return ret;
 }
@@ -517,5 +674,63 @@ int imFileWriteImageData(imFile* ifile, void* data)
 
   imFileLineBufferInit(ifile);
 
-  return ifileformat->WriteImageData(data);
+  iFileProfileBegin(ifile, "Write");
+
+  int ret = ifileformat->WriteImageData(data);
+
+  iFileProfileEnd(ifile, 0);
+
+  return ret;
+}
+
+int imFileWriteImageLines(imFile* ifile, imFileLinesCallback callback, void* user_data, int band_height)
+{
+  assert(ifile);
+  assert(ifile->is_new);
+  assert(callback);
+  imFileFormatBase* ifileformat = (imFileFormatBase*)ifile;
+
+  if (!imFileCheckConversion(ifile))
+    return IM_ERR_DATA;
+
+  imFileLineBufferInit(ifile);
+
+  // ICO uses the user data after all the lines are written
+  if (band_height <= 0 || band_height > ifile->height || 
+      imStrEqual(ifileformat->iformat->format, "ICO"))
+    band_height = ifile->height;
+
+  int ret;
+  if (band_height == ifile->height)
+  {
+    void* data = malloc(imImageDataSize(ifile->width, ifile->height, ifile->user_color_mode, ifile->user_data_type));
+    if (!data)
+      return IM_ERR_MEM;
+
+    iFileProfileBegin(ifile, "Write Lines");
+
+    if (!callback(ifile, data, 0, ifile->height, user_data))
+      ret = IM_ERR_COUNTER;
+    else
+      ret = ifileformat->WriteImageData(data);
+
+    iFileProfileEnd(ifile, band_height);
+
+    free(data);
+    return ret;
+  }
+
+  if (!imFileLineBandInit(ifile, band_height, callback, user_data))
+    return IM_ERR_MEM;
+
+  iFileProfileBegin(ifile, "Write Lines");
+
+  ret = ifileformat->WriteImageData(NULL);
+
+  if (!imFileLineBandFinish(ifile, 0) && ret == IM_ERR_NONE)
+    ret = IM_ERR_COUNTER;
+
+  iFileProfileEnd(ifile, band_height);
+
+  return ret;
 }
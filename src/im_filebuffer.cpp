@@ -465,6 +465,184 @@ static void iFileSwitchToType(imFile* ifile)
   }
 }
 
+struct imFileLineBand
+{
+  imFileLinesCallback callback;
+  void* user_data;
+  int band_height,
+      band_count,
+      band_size,      /* size in bytes of a full band in user data */
+      plane_count,    /* number of lines stored for each image line */
+      interrupted;
+  void** band_data;   /* buffer of each band, NULL while not used */
+  int* band_stored;   /* number of lines already stored in each band */
+  void* free_data;    /* buffer of the last band sent, reused by the next band.
+                         When writing it is the buffer of the current band. */
+  int current_band;   /* band in free_data when writing */
+};
+
+int imFileLineBandInit(imFile* ifile, int band_height, imFileLinesCallback callback, void* user_data)
+{
+  imFileLineBand* line_band = (imFileLineBand*)malloc(sizeof(imFileLineBand));
+  if (!line_band)
+    return 0;
+
+  line_band->callback = callback;
+  line_band->user_data = user_data;
+  line_band->band_height = band_height;
+  line_band->band_count = (ifile->height + band_height-1) / band_height;
+  line_band->band_size = imImageDataSize(ifile->width, band_height, ifile->user_color_mode, ifile->user_data_type);
+  line_band->plane_count = imFileLineBufferCount(ifile) / ifile->height;
+  line_band->interrupted = 0;
+  line_band->free_data = NULL;
+  line_band->current_band = -1;
+  line_band->band_data = (void**)calloc(line_band->band_count, sizeof(void*));
+  line_band->band_stored = (int*)calloc(line_band->band_count, sizeof(int));
+  if (!line_band->band_data || !line_band->band_stored)
+  {
+    free(line_band->band_data);
+    free(line_band->band_stored);
+    free(line_band);
+    return 0;
+  }
+
+  if (ifile->is_new)
+  {
+    // when writing only one band is used at a time
+    line_band->free_data = malloc(line_band->band_size);
+    if (!line_band->free_data)
+    {
+      free(line_band->band_data);
+      free(line_band->band_stored);
+      free(line_band);
+      return 0;
+    }
+  }
+
+  ifile->line_band = line_band;
+  return 1;
+}
+
+static int iFileLineBandHeight(imFile* ifile, imFileLineBand* line_band, int band)
+{
+  int line_start = band * line_band->band_height;
+  return IM_MIN(line_band->band_height, ifile->height - line_start);
+}
+
+static void iFileLineBandSend(imFile* ifile, imFileLineBand* line_band, int band)
+{
+  void* data = line_band->band_data[band];
+
+  if (!line_band->interrupted &&
+      !line_band->callback(ifile, data, band * line_band->band_height, 
+                           iFileLineBandHeight(ifile, line_band, band), line_band->user_data))
+    line_band->interrupted = 1;
+
+  if (line_band->free_data)
+    free(data);
+  else
+    line_band->free_data = data;
+
+  line_band->band_data[band] = NULL;
+}
+
+static void* iFileLineBandGet(imFile* ifile, int band, int plane, int *line, int *height)
+{
+  // returns the buffer of the band and the position of the line inside it
+
+  imFileLineBand* line_band = (imFileLineBand*)ifile->line_band;
+  if (line_band->interrupted || band >= line_band->band_count || plane >= line_band->plane_count)
+    return NULL;
+
+  // all lines of the band were already stored and sent
+  if (line_band->band_stored[band] == iFileLineBandHeight(ifile, line_band, band) * line_band->plane_count)
+    return NULL;
+
+  void* data = line_band->band_data[band];
+  if (!data)
+  {
+    if (line_band->free_data)
+    {
+      data = line_band->free_data;
+      line_band->free_data = NULL;
+    }
+    else
+    {
+      data = malloc(line_band->band_size);
+      if (!data)
+        return NULL;
+    }
+
+    line_band->band_data[band] = data;
+  }
+
+  *line -= band * line_band->band_height;
+  *height = iFileLineBandHeight(ifile, line_band, band);
+  return data;
+}
+
+static const void* iFileLineBandFill(imFile* ifile, int band, int *line, int *height)
+{
+  // (writing) returns the buffer of the band filled by the callback
+
+  imFileLineBand* line_band = (imFileLineBand*)ifile->line_band;
+  if (line_band->interrupted || band >= line_band->band_count)
+    return NULL;
+
+  int line_start = band * line_band->band_height;
+  *line -= line_start;
+  *height = iFileLineBandHeight(ifile, line_band, band);
+
+  if (band != line_band->current_band)
+  {
+    line_band->current_band = band;
+
+    if (!line_band->callback(ifile, line_band->free_data, line_start, *height, line_band->user_data))
+    {
+      line_band->interrupted = 1;
+      return NULL;
+    }
+  }
+
+  return line_band->free_data;
+}
+
+static void iFileLineBandStored(imFile* ifile, int band)
+{
+  imFileLineBand* line_band = (imFileLineBand*)ifile->line_band;
+
+  line_band->band_stored[band]++;
+  if (line_band->band_stored[band] == iFileLineBandHeight(ifile, line_band, band) * line_band->plane_count)
+    iFileLineBandSend(ifile, line_band, band);
+}
+
+int imFileLineBandFinish(imFile* ifile, int send)
+{
+  imFileLineBand* line_band = (imFileLineBand*)ifile->line_band;
+
+  // some drivers do not read all the lines, or all the planes
+  for (int band = 0; band < line_band->band_count; band++)
+  {
+    if (line_band->band_data[band])
+    {
+      if (send)
+        iFileLineBandSend(ifile, line_band, band);
+      else
+        free(line_band->band_data[band]);
+    }
+  }
+
+  int interrupted = line_band->interrupted;
+
+  free(line_band->free_data);
+  free(line_band->band_data);
+  free(line_band->band_stored);
+  free(line_band);
+  ifile->line_band = NULL;
+
+  return !interrupted;
+}
+
 void imFileLineBufferWrite(imFile* ifile, const void* data, int line, int plane)
 {
   // (writing) from data to file
@@ -472,12 +650,25 @@ void imFileLineBufferWrite(imFile* ifile, const void* data, int line, int plane)
   if (imColorModeIsTopDown(ifile->file_color_mode) != imColorModeIsTopDown(ifile->user_color_mode))
     line = ifile->height-1 - line;
 
+  // data has the image height, or the band height when writing in bands
+  int height = ifile->height;
+  if (ifile->line_band)
+  {
+    data = iFileLineBandFill(ifile, line / ((imFileLineBand*)ifile->line_band)->band_height, &line, &height);
+    if (!data)
+    {
+      // interrupted, the remaining lines are empty
+      memset(ifile->line_buffer, 0, ifile->line_buffer_size);
+      return;
+    }
+  }
+
   if ((ifile->file_color_mode & 0x3FF) == 
       (ifile->user_color_mode & 0x3FF)) // compare only packing, alpha and color space, ignore bottom up.
   {
     int data_offset = line*ifile->line_buffer_size;
     if (plane != 0)
-      data_offset += plane*ifile->height*ifile->line_buffer_size;
+      data_offset += plane*height*ifile->line_buffer_size;
 
     memcpy(ifile->line_buffer, (unsigned char*)data + data_offset, ifile->line_buffer_size);
   }
@@ -486,42 +677,42 @@ void imFileLineBufferWrite(imFile* ifile, const void* data, int line, int plane)
     switch(ifile->file_data_type)
     {
     case IM_BYTE:
-      iDoFillLineBuffer(ifile->width, ifile->height, line, plane, 
+      iDoFillLineBuffer(ifile->width, height, line, plane, 
                         ifile->file_color_mode, (imbyte*)ifile->line_buffer, 
                         ifile->user_color_mode, (const imbyte*)data);
       break;
     case IM_SHORT:
-      iDoFillLineBuffer(ifile->width, ifile->height, line, plane,  
+      iDoFillLineBuffer(ifile->width, height, line, plane,  
                         ifile->file_color_mode, (short*)ifile->line_buffer, 
                         ifile->user_color_mode, (const short*)data);
       break;
     case IM_USHORT:
-      iDoFillLineBuffer(ifile->width, ifile->height, line, plane,  
+      iDoFillLineBuffer(ifile->width, height, line, plane,  
                         ifile->file_color_mode, (imushort*)ifile->line_buffer, 
                         ifile->user_color_mode, (const imushort*)data);
       break;
     case IM_INT:
-      iDoFillLineBuffer(ifile->width, ifile->height, line, plane,  
+      iDoFillLineBuffer(ifile->width, height, line, plane,  
                         ifile->file_color_mode, (int*)ifile->line_buffer, 
                         ifile->user_color_mode, (const int*)data);
       break;
     case IM_FLOAT:
-      iDoFillLineBuffer(ifile->width, ifile->height, line, plane,  
+      iDoFillLineBuffer(ifile->width, height, line, plane,  
                         ifile->file_color_mode, (float*)ifile->line_buffer, 
                         ifile->user_color_mode, (const float*)data);
       break;
     case IM_CFLOAT:
-      iDoFillLineBuffer(ifile->width, ifile->height, line, plane,  
+      iDoFillLineBuffer(ifile->width, height, line, plane,  
                         ifile->file_color_mode, (imcfloat*)ifile->line_buffer, 
                         ifile->user_color_mode, (const imcfloat*)data);
       break;
     case IM_DOUBLE:
-      iDoFillLineBuffer(ifile->width, ifile->height, line, plane,  
+      iDoFillLineBuffer(ifile->width, height, line, plane,  
                         ifile->file_color_mode, (double*)ifile->line_buffer, 
                         ifile->user_color_mode, (const double*)data);
       break;
     case IM_CDOUBLE:
-      iDoFillLineBuffer(ifile->width, ifile->height, line, plane,  
+      iDoFillLineBuffer(ifile->width, height, line, plane,  
                         ifile->file_color_mode, (imcdouble*)ifile->line_buffer, 
                         ifile->user_color_mode, (const imcdouble*)data);
       break;
@@ -542,6 +733,16 @@ void imFileLineBufferRead(imFile* ifile, void* data, int line, int plane)
   if (imColorModeIsTopDown(ifile->file_color_mode) != imColorModeIsTopDown(ifile->user_color_mode))
     line = ifile->height-1 - line;
 
+  // data has the image height, or the band height when reading in bands
+  int height = ifile->height, band = -1;
+  if (ifile->line_band)
+  {
+    band = line / ((imFileLineBand*)ifile->line_band)->band_height;
+    data = iFileLineBandGet(ifile, band, plane, &line, &height);
+    if (!data)
+      return;
+  }
+
   if (ifile->convert_bpp)
     iFileExpandBits(ifile);
 
@@ -554,7 +755,7 @@ void imFileLineBufferRead(imFile* ifile, void* data, int line, int plane)
   {
     int data_offset = line*ifile->line_buffer_size;
     if (plane != 0)
-      data_offset += plane*ifile->height*ifile->line_buffer_size;
+      data_offset += plane*height*ifile->line_buffer_size;
 
     memcpy((unsigned char*)data + data_offset, ifile->line_buffer, ifile->line_buffer_size);
   }
@@ -572,86 +773,89 @@ void imFileLineBufferRead(imFile* ifile, void* data, int line, int plane)
     {
     case IM_BYTE:
       if (convert2bitmap)
-        iDoFillDataBitmap(ifile->width, ifile->height, line, plane, ifile->file_data_type,
+        iDoFillDataBitmap(ifile->width, height, line, plane, ifile->file_data_type,
                           ifile->file_color_mode, (const imbyte*)ifile->line_buffer, 
                           ifile->user_color_mode, (imbyte*)data);
       else
-        iDoFillData(ifile->width, ifile->height, line, plane, 
+        iDoFillData(ifile->width, height, line, plane, 
                     ifile->file_color_mode, (const imbyte*)ifile->line_buffer, 
                     ifile->user_color_mode, (imbyte*)data);
       break;
     case IM_SHORT:
       if (convert2bitmap)
-        iDoFillDataBitmap(ifile->width, ifile->height, line, plane, ifile->file_data_type,
+        iDoFillDataBitmap(ifile->width, height, line, plane, ifile->file_data_type,
                           ifile->file_color_mode, (const short*)ifile->line_buffer, 
                           ifile->user_color_mode, (imbyte*)data);
       else
-        iDoFillData(ifile->width, ifile->height, line, plane,  
+        iDoFillData(ifile->width, height, line, plane,  
                     ifile->file_color_mode, (const short*)ifile->line_buffer, 
                     ifile->user_color_mode, (short*)data);
       break;
     case IM_USHORT:
       if (convert2bitmap)
-        iDoFillDataBitmap(ifile->width, ifile->height, line, plane, ifile->file_data_type,
+        iDoFillDataBitmap(ifile->width, height, line, plane, ifile->file_data_type,
                           ifile->file_color_mode, (const imushort*)ifile->line_buffer, 
                           ifile->user_color_mode, (imbyte*)data);
       else
-        iDoFillData(ifile->width, ifile->height, line, plane,  
+        iDoFillData(ifile->width, height, line, plane,  
                     ifile->file_color_mode, (const imushort*)ifile->line_buffer, 
                     ifile->user_color_mode, (imushort*)data);
       break;
     case IM_INT:
       if (convert2bitmap)
-        iDoFillDataBitmap(ifile->width, ifile->height, line, plane, ifile->file_data_type,
+        iDoFillDataBitmap(ifile->width, height, line, plane, ifile->file_data_type,
                           ifile->file_color_mode, (const int*)ifile->line_buffer, 
                           ifile->user_color_mode, (imbyte*)data);
       else
-        iDoFillData(ifile->width, ifile->height, line, plane,  
+        iDoFillData(ifile->width, height, line, plane,  
                     ifile->file_color_mode, (const int*)ifile->line_buffer, 
                     ifile->user_color_mode, (int*)data);
       break;
     case IM_FLOAT:
       if (convert2bitmap)
-        iDoFillDataBitmap(ifile->width, ifile->height, line, plane, ifile->file_data_type,
+        iDoFillDataBitmap(ifile->width, height, line, plane, ifile->file_data_type,
                           ifile->file_color_mode, (const float*)ifile->line_buffer, 
                           ifile->user_color_mode, (imbyte*)data);
       else
-        iDoFillData(ifile->width, ifile->height, line, plane,  
+        iDoFillData(ifile->width, height, line, plane,  
                     ifile->file_color_mode, (const float*)ifile->line_buffer, 
                     ifile->user_color_mode, (float*)data);
       break;
     case IM_CFLOAT:
       if (convert2bitmap)
-        iDoFillDataBitmap(ifile->width, ifile->height, line, plane, ifile->file_data_type,
+        iDoFillDataBitmap(ifile->width, height, line, plane, ifile->file_data_type,
                           ifile->file_color_mode, (const double*)ifile->line_buffer, 
                           ifile->user_color_mode, (imbyte*)data);
       else
-        iDoFillData(ifile->width, ifile->height, line, plane,  
+        iDoFillData(ifile->width, height, line, plane,  
                     ifile->file_color_mode, (const imcfloat*)ifile->line_buffer, 
                     ifile->user_color_mode, (imcfloat*)data);
       break;
     case IM_DOUBLE:
       if (convert2bitmap)
-        iDoFillDataBitmap(ifile->width, ifile->height, line, plane, ifile->file_data_type,
+        iDoFillDataBitmap(ifile->width, height, line, plane, ifile->file_data_type,
                           ifile->file_color_mode, (const double*)ifile->line_buffer, 
                           ifile->user_color_mode, (imbyte*)data);
       else
-        iDoFillData(ifile->width, ifile->height, line, plane,  
+        iDoFillData(ifile->width, height, line, plane,  
                     ifile->file_color_mode, (const double*)ifile->line_buffer, 
                     ifile->user_color_mode, (double*)data);
       break;
     case IM_CDOUBLE:
       if (convert2bitmap)
-        iDoFillDataBitmap(ifile->width, ifile->height, line, plane, ifile->file_data_type,
+        iDoFillDataBitmap(ifile->width, height, line, plane, ifile->file_data_type,
                           ifile->file_color_mode, (const double*)ifile->line_buffer, 
                           ifile->user_color_mode, (imbyte*)data);
       else
-        iDoFillData(ifile->width, ifile->height, line, plane,  
+        iDoFillData(ifile->width, height, line, plane,  
                     ifile->file_color_mode, (const imcdouble*)ifile->line_buffer, 
                     ifile->user_color_mode, (imcdouble*)data);
       break;
     }
   }
+
+  if (band != -1)
+    iFileLineBandStored(ifile, band);
 }
            
 void imFileLineBufferInit(imFile* ifile)
@@ -14,11 +14,17 @@
 #include "im.h"
 #include "im_format.h"
 #include "im_util.h"
+#include "im_thread.h"
 
 
-static imFormat* iFormatList[50];
-static int iFormatCount = 0;
-static int iFormatRegistredAll = 0;
+#define IM_MAXFORMATS 50
+
+static imFormat* iFormatList[IM_MAXFORMATS];
+static volatile int iFormatCount = 0;
+static volatile int iFormatLock = 0;
+
+/* 0 - not registered, 1 - being registered, 2 - registered */
+static volatile int iFormatRegistredAll = 0;
 
 void imFormatRemoveAll(void)
 {
@@ -34,19 +40,44 @@ void imFormatRemoveAll(void)
 
 void imFormatRegister(imFormat* iformat)
 {
-  iFormatList[iFormatCount] = iformat;
-  iFormatCount++;
+  while (!imThreadAtomicCompareExchange(&iFormatLock, 0, 1))
+    imThreadYield();
+
+  if (iFormatCount < IM_MAXFORMATS)
+  {
+    iFormatList[iFormatCount] = iformat;
+    imThreadAtomicSet(&iFormatCount, iFormatCount + 1);
+  }
+  else
+    delete iformat;
+
+  imThreadAtomicSet(&iFormatLock, 0);
 }
 
-static imFormat* iFormatFind(const char* format)
+/* The internal formats are registered when a format is used for the first time,
+   that can be at the same time in several threads, so only one registers and the others wait. */
+static void iFormatRegisterAll(void)
 {
-  assert(format);
+  if (imThreadAtomicGet(&iFormatRegistredAll) == 2)
+    return;
 
-  if (!iFormatRegistredAll) 
+  if (imThreadAtomicCompareExchange(&iFormatRegistredAll, 0, 1))
   {
     imFormatRegisterInternal();
-    iFormatRegistredAll = 1;
+    imThreadAtomicSet(&iFormatRegistredAll, 2);
   }
+  else
+  {
+    while (imThreadAtomicGet(&iFormatRegistredAll) != 2)
+      imThreadYield();
+  }
+}
+
+static imFormat* iFormatFind(const char* format)
+{
+  assert(format);
+
+  iFormatRegisterAll();
 
   for (int i = 0; i < iFormatCount; i++)
   {
@@ -62,13 +93,9 @@ void imFormatList(char** format_list, int *format_count)
   assert(format_list);
   assert(format_count);
 
-  if (!iFormatRegistredAll) 
-  {
-    imFormatRegisterInternal();
-    iFormatRegistredAll = 1;
-  }
+  iFormatRegisterAll();
 
-  static char format_list_buffer[50][50];
+  static char format_list_buffer[IM_MAXFORMATS][50];
 
   *format_count = iFormatCount;
   for (int i = 0; i < iFormatCount; i++)
@@ -179,11 +206,7 @@ imFileFormatBase* imFileFormatBaseOpen(const char* file_name, int *error)
   assert(file_name);
   assert(error);
 
-  if (!iFormatRegistredAll) 
-  {
-    imFormatRegisterInternal();
-    iFormatRegistredAll = 1;
-  }
+  iFormatRegisterAll();
 
   int* ext_mark = new int [iFormatCount];
   memset(ext_mark, 0, sizeof(int)*iFormatCount);
@@ -266,11 +289,7 @@ imFileFormatBase* imFileFormatBaseOpenAs(const char* file_name, const char* form
   assert(format);
   assert(error);
 
-  if (!iFormatRegistredAll) 
-  {
-    imFormatRegisterInternal();
-    iFormatRegistredAll = 1;
-  }
+  iFormatRegisterAll();
 
   imFormat* iformat = iFormatFind(format);
   if (!format)
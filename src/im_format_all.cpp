@@ -28,6 +28,7 @@ void imFormatRegisterInternal(void)
   imFormatRegisterICO();
   imFormatRegisterPNM();
   imFormatRegisterPFM();
+  imFormatRegisterIMT();
   imFormatRegisterKRN();
   imFormatRegisterLED();
   imFormatRegisterSGI();
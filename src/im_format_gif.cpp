@@ -28,10 +28,10 @@ static const int InterlacedOffset[4] = { 0, 4, 2, 1 },  /* The way Interlaced im
 #define GIF_FIRST_CODE		  4097    /* Impossible code, to signal first. */
 #define GIF_NO_SUCH_CODE		4098    /* Impossible code, to signal empty. */
 
-#define GIF_HT_KEY_MASK		0x1FFF		/* 13bits keys */
-#define GIF_HT_KEY_NUM_BITS		13		/* 13bits keys */
-#define GIF_HT_MAX_KEY		  8191	  /* 13bits - 1, maximal code possible */
-#define GIF_HT_SIZE			    8192	  /* 12bits = 4096 or twice as big! */
+#define GIF_HT_KEY_MASK		0x3FFF		/* 14bits keys */
+#define GIF_HT_KEY_NUM_BITS		14		/* 14bits keys */
+#define GIF_HT_MAX_KEY		  16383	  /* 14bits - 1, maximal code possible */
+#define GIF_HT_SIZE			    16384	  /* 12bits = 4096 four times as big, at most 25% full */
 
 /*  GIF89 extension function codes                                             */
 #define COMMENT_EXT_FUNC_CODE	    0xFE	/* comment */
@@ -69,8 +69,10 @@ struct iGIFData
 	    CrntShiftState;		 /* Number of bits in CrntShiftDWord. */
   unsigned char Buf[256];	                  /* Compressed input is buffered here. */
   unsigned int CrntShiftDWord;             /* For bytes decomposition into codes. */
-  unsigned char Stack[GIF_LZ_MAX_CODE];	    /* Decoded pixels are stacked here. */
+  unsigned char Stack[GIF_LZ_MAX_CODE+1];	  /* Decoded pixels are stacked here. */
   unsigned char Suffix[GIF_LZ_MAX_CODE+1];	/* So we can trace the codes. */
+  unsigned char First[GIF_LZ_MAX_CODE+1];	  /* First pixel of the string of each code. */
+  unsigned short Length[GIF_LZ_MAX_CODE+1];	/* Length of the string of each code, 0 if not defined. */
   unsigned int Prefix[GIF_LZ_MAX_CODE+1];
   unsigned int HTable[GIF_HT_SIZE];            /* hash table for the compression only, when using LZW */
 };
@@ -79,47 +81,33 @@ struct iGIFData
 * Routine to generate an HKey for the hashtable out of the given unique key.  *
 * The given Key is assumed to be 20 bits as follows: lower 8 bits are the     *
 * new postfix character, while the upper 12 bits are the prefix code.	      *
-* Because the average hit ratio is only 2 (2 hash references per entry),      *
-* evaluating more complex keys (such as twin prime keys) does not worth it!   *
+* A multiplicative (Fibonacci) hash spreads the keys over the whole table,    *
+* since consecutive prefix codes and pixels would otherwise cluster.          *
 ******************************************************************************/
-static int iGIFHashKeyItem(unsigned int Item)
+static inline int iGIFHashKeyItem(unsigned int Item)
 {
-  return ((Item >> 12) ^ Item) & GIF_HT_KEY_MASK;
-}
-
-/******************************************************************************
-* Routine to insert a new Item into the HashTable. The data is assumed to be  *
-* new one.								      *
-******************************************************************************/
-static void iGIFInsertHashTable(unsigned int *HTable, unsigned int Key, int Code)
-{
-  int HKey = iGIFHashKeyItem(Key);
-
-  while (GIF_HT_GET_KEY(HTable[HKey]) != 0xFFFFFL) 
-  {
-    HKey = (HKey + 1) & GIF_HT_KEY_MASK;
-  }
-
-  HTable[HKey] = GIF_HT_PUT_KEY(Key) | GIF_HT_PUT_CODE(Code);
+  return (int)((Item * 2654435761U) >> (32 - GIF_HT_KEY_NUM_BITS));
 }
 
 /******************************************************************************
 * Routine to test if given Key exists in HashTable and if so returns its code *
-* Returns the Code if key was found, -1 if not.				      *
+* Returns the Code if key was found, -1 if not. In this case HKey returns     *
+* the empty slot where the key must be inserted.                              *
 ******************************************************************************/
-static int iGIFExistsHashTable(unsigned int *HTable, unsigned int Key)
+static inline int iGIFLookupHashTable(unsigned int *HTable, unsigned int Key, int *HKey)
 {
-  int HKey = iGIFHashKeyItem(Key);
+  int Slot = iGIFHashKeyItem(Key);
   unsigned int HTKey;
 
-  while ((HTKey = GIF_HT_GET_KEY(HTable[HKey])) != 0xFFFFFL) 
+  while ((HTKey = GIF_HT_GET_KEY(HTable[Slot])) != 0xFFFFFL) 
   {
     if (Key == HTKey) 
-      return GIF_HT_GET_CODE(HTable[HKey]);
+      return GIF_HT_GET_CODE(HTable[Slot]);
 
-    HKey = (HKey + 1) & GIF_HT_KEY_MASK;
+    Slot = (Slot + 1) & GIF_HT_KEY_MASK;
   }
 
+  *HKey = Slot;
   return -1;
 }
 
@@ -147,9 +135,13 @@ static int iGIFBufferedOutput(imBinFile* handle, unsigned char *Buf, int c)
       /* Dump out this buffer - it is full: */
       imBinFileWrite(handle, Buf, Buf[0] + 1, 1);
       Buf[0] = 0;
+
+      if (imBinFileError(handle))
+        return IM_ERR_ACCESS;
     }
 
     Buf[++Buf[0]] = (unsigned char)c;
+    return IM_ERR_NONE;
   }
 
   if (imBinFileError(handle))
@@ -242,7 +234,7 @@ static int iGIFCompressOutput(iGIFData* igif, imBinFile* handle, int Code)
 ******************************************************************************/
 static int iGIFCompressLine(iGIFData* igif, imBinFile* handle, unsigned char *Line, int LineLen)
 {
-  int i = 0, CrntCode, NewCode;
+  int i = 0, CrntCode, NewCode, HKey;
   unsigned int NewKey;
   unsigned char Pixel;
 
@@ -258,7 +250,7 @@ static int iGIFCompressLine(iGIFData* igif, imBinFile* handle, unsigned char *Li
     /* CrntCode as Prefix string with Pixel as postfix char.	     */
     NewKey = (((unsigned int) CrntCode) << 8) + Pixel;
 
-    if ((NewCode = iGIFExistsHashTable(igif->HTable, NewKey)) >= 0) 
+    if ((NewCode = iGIFLookupHashTable(igif->HTable, NewKey, &HKey)) >= 0) 
     {
       /* This Key is already there, or the string is old one, so	     */
       /* simple take new code as our CrntCode:			     */
@@ -288,8 +280,9 @@ static int iGIFCompressLine(iGIFData* igif, imBinFile* handle, unsigned char *Li
       }
       else 
       {
-        /* Put this unique key with its relative Code in hash table: */
-        iGIFInsertHashTable(igif->HTable, NewKey, igif->RunningCode++);
+        /* Put this unique key with its relative Code in hash table,   */
+        /* at the empty slot found by the lookup:                       */
+        igif->HTable[HKey] = GIF_HT_PUT_KEY(NewKey) | GIF_HT_PUT_CODE(igif->RunningCode++);
       }
     }
   }
@@ -373,30 +366,41 @@ static int iGIFDecompressInput(iGIFData* igif, imBinFile* handle, int *Code)
 }
 
 /******************************************************************************
-* Routine to trace the Prefixes linked list until we get a prefix which is    *
-* not code, but a pixel value (less than ClearCode). Returns that pixel value.*
-* If image is defective, we might loop here forever, so we limit the loops to *
-* the maximum possible if image O.k. - LZ_MAX_CODE times.		      *
+* Routine to reset the string table after a Clear code.                       *
+* Codes below ClearCode are single pixels, all other codes are undefined.     *
 ******************************************************************************/
-static int iGIFGetPrefixChar(unsigned int *Prefix, int Code, int ClearCode)
+static void iGIFResetStringTable(iGIFData* igif)
 {
-  int i = 0;
-
-  while (Code > ClearCode && i++ <= GIF_LZ_MAX_CODE) 
-    Code = Prefix[Code];
+  for (int j = 0; j < igif->ClearCode; j++) 
+  {
+    igif->Prefix[j] = GIF_NO_SUCH_CODE;
+    igif->Suffix[j] = igif->First[j] = (unsigned char)j;
+    igif->Length[j] = 1;
+  }
 
-  return Code;
+  memset(igif->Length + igif->ClearCode, 0, (GIF_LZ_MAX_CODE+1 - igif->ClearCode) * sizeof(unsigned short));
 }
 
+/******************************************************************************
+*   The LZ decompression routine:                                             *
+*   Each code has its string length and first pixel in the string table, so   *
+* the string is written directly at its final place, from the last pixel to   *
+* the first, following the Prefix links exactly Length times. Only when the   *
+* string does not fit in the rest of the line it goes to the Stack, to be     *
+* popped at the next call.                                                    *
+******************************************************************************/
 static int iGIFDecompressLine(iGIFData* igif, imBinFile* handle, unsigned char *Line,	int LineLen)
 {
-  int i = 0, j, CrntCode, EOFCode, ClearCode, CrntPrefix, LastCode, StackPtr;
-  unsigned char *Stack, *Suffix;
+  int i = 0, CrntCode, EOFCode, ClearCode, LastCode, StackPtr, NewCode, Length;
+  unsigned char *Stack, *Suffix, *First;
+  unsigned short *Lengths;
   unsigned int *Prefix;
 
   StackPtr = igif->StackPtr;
   Prefix = igif->Prefix;
   Suffix = igif->Suffix;
+  First = igif->First;
+  Lengths = igif->Length;
   Stack = igif->Stack;
   EOFCode = igif->EOFCode;
   ClearCode = igif->ClearCode;
@@ -428,89 +432,88 @@ static int iGIFDecompressLine(iGIFData* igif, imBinFile* handle, unsigned char *
     else if (CrntCode == ClearCode) 
     {
       /* We need to start over again: */
-      for (j = 0; j <= GIF_LZ_MAX_CODE; j++) 
-        Prefix[j] = GIF_NO_SUCH_CODE;
+      iGIFResetStringTable(igif);
 
       igif->RunningCode = igif->EOFCode + 1;
       igif->RunningBits = igif->BitsPerPixel + 1;
       igif->MaxCode1 = 1 << igif->RunningBits;
       LastCode = igif->LastCode = GIF_NO_SUCH_CODE;
     }
-    else 
+    else if (CrntCode < ClearCode) 
     {
-      /* Its regular code - if in pixel range simply add it to output  */
-      /* stream, otherwise trace to codes linked list until the prefix */
-      /* is in pixel range:					     */
-      if (CrntCode < ClearCode) 
-      {
-        /* This is simple - its pixel scalar, so add it to output:   */
-        Line[i++] = (unsigned char)CrntCode;
-      }
-      else 
+      /* This is simple - its pixel scalar, so add it to output:   */
+      Line[i++] = (unsigned char)CrntCode;
+
+      if (LastCode != GIF_NO_SUCH_CODE) 
       {
-        /* Its a code to needed to be traced: trace the linked list  */
-        /* until the prefix is a pixel, while pushing the suffix     */
-        /* pixels on our stack. If we done, pop the stack in reverse */
-        /* (thats what stack is good for!) order to output.	     */
-        if (Prefix[CrntCode] == GIF_NO_SUCH_CODE) 
+        NewCode = igif->RunningCode - 2;
+        if (NewCode <= GIF_LZ_MAX_CODE)
         {
-          /* Only allowed if CrntCode is exactly the running code: */
-          /* In that case CrntCode = XXXCode, CrntCode or the	     */
-          /* prefix code is last code and the suffix char is	     */
-          /* exactly the prefix of last code!			     */
-          if (CrntCode == igif->RunningCode - 2) 
-          {
-            CrntPrefix = LastCode;
-            Suffix[igif->RunningCode - 2] =
-            Stack[StackPtr++] = (unsigned char)iGIFGetPrefixChar(Prefix, LastCode, ClearCode);
-          }
-          else 
-            return IM_ERR_ACCESS;
-        }
-        else
-          CrntPrefix = CrntCode;
-
-        /* Now (if image is O.K.) we should not get an NO_SUCH_CODE  */
-        /* During the trace. As we might loop forever, in case of    */
-        /* defective image, we count the number of loops we trace    */
-        /* and stop if we got LZ_MAX_CODE. obviously we can not      */
-        /* loop more than that.					     */
-        j = 0;
-        while (j++ <= GIF_LZ_MAX_CODE && CrntPrefix > ClearCode && CrntPrefix <= GIF_LZ_MAX_CODE) 
-        {
-          Stack[StackPtr++] = Suffix[CrntPrefix];
-          CrntPrefix = Prefix[CrntPrefix];
+          Prefix[NewCode] = LastCode;
+          Suffix[NewCode] = (unsigned char)CrntCode;
+          First[NewCode] = First[LastCode];
+          Lengths[NewCode] = (unsigned short)(Lengths[LastCode] + 1);
         }
+      }
 
-        if (j >= GIF_LZ_MAX_CODE || CrntPrefix > GIF_LZ_MAX_CODE) 
+      LastCode = CrntCode;
+    }
+    else 
+    {
+      /* First add the new code to the table, because the current code */
+      /* can be exactly the new code. In that case its string is the   */
+      /* last string plus its own first pixel.                         */
+      if (LastCode != GIF_NO_SUCH_CODE) 
+      {
+        NewCode = igif->RunningCode - 2;
+        if (NewCode <= GIF_LZ_MAX_CODE)
+        {
+          if (CrntCode == NewCode)
+            Suffix[NewCode] = First[LastCode];
+          else if (Lengths[CrntCode] != 0)
+            Suffix[NewCode] = First[CrntCode];
+          else
             return IM_ERR_ACCESS;
 
-        /* Push the last character on stack: */
-        Stack[StackPtr++] = (unsigned char)CrntPrefix;
-
-        /* Now lets pop all the stack into output: */
-        while (StackPtr != 0 && i < LineLen)
-          Line[i++] = Stack[--StackPtr];
+          Prefix[NewCode] = LastCode;
+          First[NewCode] = First[LastCode];
+          Lengths[NewCode] = (unsigned short)(Lengths[LastCode] + 1);
+        }
       }
 
-      if (LastCode != GIF_NO_SUCH_CODE) 
-      {
-        Prefix[igif->RunningCode - 2] = LastCode;
+      Length = Lengths[CrntCode];
+      if (Length == 0)  /* defective image */
+        return IM_ERR_ACCESS;
 
-        if (CrntCode == igif->RunningCode - 2) 
+      if (Length <= LineLen - i)
+      {
+        /* The whole string fits in the line, write it backwards: */
+        int Code = CrntCode;
+        unsigned char* Out = Line + i + Length - 1;
+        while (Out > Line + i)
         {
-          /* Only allowed if CrntCode is exactly the running code: */
-          /* In that case CrntCode = XXXCode, CrntCode or the	     */
-          /* prefix code is last code and the suffix char is	     */
-          /* exactly the prefix of last code!			     */
-          Suffix[igif->RunningCode - 2] = (unsigned char)iGIFGetPrefixChar(Prefix, LastCode, ClearCode);
+          *Out-- = Suffix[Code];
+          Code = Prefix[Code];
         }
-        else 
+        *Out = (unsigned char)Code;
+        i += Length;
+      }
+      else
+      {
+        /* Push the string on the stack, last pixel first,  */
+        /* and pop what fits in the line:                   */
+        int Code = CrntCode;
+        while (Code > ClearCode)
         {
-          Suffix[igif->RunningCode - 2] = (unsigned char)iGIFGetPrefixChar(Prefix, CrntCode, ClearCode);
+          Stack[StackPtr++] = Suffix[Code];
+          Code = Prefix[Code];
         }
+        Stack[StackPtr++] = (unsigned char)Code;
+
+        while (StackPtr != 0 && i < LineLen)
+          Line[i++] = Stack[--StackPtr];
       }
-    
+
       LastCode = CrntCode;
     }
   }
@@ -530,7 +533,8 @@ static int iGIFSkipSubBlocks(imBinFile* handle)
   do
   {
     /* reads the number of bytes of the block or the terminator */
-    imBinFileRead(handle, &byte_value, 1, 1);
+    if (imBinFileRead(handle, &byte_value, 1, 1) != 1)  /* also stops at EOF */
+      return IM_ERR_ACCESS;
 
     if (imBinFileError(handle))
       return IM_ERR_ACCESS;
@@ -744,13 +748,16 @@ static int iGIFReadComment(imBinFile* handle, imAttribTable* attrib_table)
   do
   {
     /* reads the number of bytes of the block or the terminator */
-    imBinFileRead(handle, &byte_value, 1, 1);
+    if (imBinFileRead(handle, &byte_value, 1, 1) != 1)  /* also stops at EOF */
+      return IM_ERR_ACCESS;
 
     if (imBinFileError(handle))
       return IM_ERR_ACCESS;
 
-    /* reads data */
-    if (byte_value)
+    /* reads data, ignores what does not fit in the buffer */
+    if (byte_value && size + byte_value > (int)sizeof(buffer) - 1)
+      imBinFileSeekOffset(handle, byte_value);
+    else if (byte_value)
     {
       imBinFileRead(handle, buffer_ptr, byte_value, 1);
 
@@ -1305,6 +1312,8 @@ int imFileFormatGIF::ReadImageInfo(int index)
 
   /* reads the LZW Min code byte */
   imBinFileRead(handle, &byte_value, 1, 1);
+  if (byte_value < 1 || byte_value > 8)
+    return IM_ERR_FORMAT;
 
   /* now initialize the compression control data */
 
@@ -1320,8 +1329,7 @@ int imFileFormatGIF::ReadImageInfo(int index)
   gif_data.CrntShiftDWord = 0;
   gif_data.Buf[0] = 0;			      /* Input Buffer empty. */
 
-  for (int i = 0; i <= GIF_LZ_MAX_CODE; i++) 
-    gif_data.Prefix[i] = GIF_NO_SUCH_CODE;
+  iGIFResetStringTable(&gif_data);
 
   gif_data.step = 0;
 
@@ -1428,7 +1436,8 @@ int imFileFormatGIF::ReadImageData(void* data)
 	  {
       lin += InterlacedJumps[gif_data.step];
 
-      if (lin > this->height-1)
+      /* small images may skip whole passes */
+      while (lin > this->height-1 && gif_data.step < 3)
       {
         gif_data.step++;
         lin = InterlacedOffset[gif_data.step];
@@ -1466,7 +1475,8 @@ int imFileFormatGIF::WriteImageData(void* data)
 	  {
       lin += InterlacedJumps[gif_data.step];
 
-      if (lin > this->height-1)
+      /* small images may skip whole passes */
+      while (lin > this->height-1 && gif_data.step < 3)
       {
         gif_data.step++;
         lin = InterlacedOffset[gif_data.step];
@@ -0,0 +1,1052 @@
+/** \file
+ * \brief IMT - IM Tiled Image Format
+ *
+ * See Copyright Notice in im_lib.h
+ */
+
+#include "im_format.h"
+#include "im_format_all.h"
+#include "im_util.h"
+#include "im_counter.h"
+#include "im_attrib.h"
+#include "im_thread.h"
+
+#include "im_binfile.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <memory.h>
+#include <limits.h>
+
+
+/* File Layout (all offsets are absolute, all values in the byte order of the signature)
+
+   Header (16 bytes):
+     char   byte_order[2]     "II" or "MM"
+     char   signature[3]      "IMT"
+     byte   version           1
+     byte   reserved[2]
+     uint32 image_count
+     uint32 first_image_offset
+
+   Each image:
+     uint32 next_image_offset (0 for the last)
+     int32  width, height, color_mode (color space and IM_ALPHA), data_type
+     int32  compression, tile_width, tile_height
+     int32  palette_count, uint32 palette[palette_count]
+     int32  attrib_count, and for each attribute:
+       int32 name_size (including the terminator), char name[name_size],
+       int32 data_type, int32 count, data[count]
+     uint32 tile_offset, tile_size   for each plane, tile row and tile column
+     tiles data
+
+   Tiles store planes separately, lines from top to bottom.
+   Tiles at the right and bottom borders store only the pixels inside the image.
+   A tile with tile_size equal to its uncompressed size is not compressed.
+*/
+
+#define IMT_VERSION 1
+#define IMT_TILE_SIZE 256
+
+enum {IMT_NONE, IMT_DEFLATE, IMT_LZF, IMT_LZO};
+
+static const char* iIMTCompTable[4] =
+{
+  "NONE",
+  "DEFLATE",
+  "LZF",
+  "LZO"
+};
+
+static int iIMTCompFind(const char* compression)
+{
+  for (int i = 0; i < 4; i++)
+  {
+    if (imStrEqual(compression, iIMTCompTable[i]))
+      return i;
+  }
+  return -1;
+}
+
+static int iIMTAttribSkip(const char* name)
+{
+  /* attributes that are stored elsewhere or that are valid only for the current read */
+  static const char* skip_names[] = {"FileFormat", "FileCompression", "FileImageCount",
+                                     "TileWidth", "TileHeight", "ZIPQuality",
+                                     "ViewXmin", "ViewXmax", "ViewYmin", "ViewYmax",
+                                     "ViewWidth", "ViewHeight"};
+  for (int i = 0; i < (int)(sizeof(skip_names)/sizeof(skip_names[0])); i++)
+  {
+    if (imStrEqual(name, skip_names[i]))
+      return 1;
+  }
+  return 0;
+}
+
+/* One tile being encoded or decoded */
+struct iIMTTile
+{
+  imbyte* raw;        /* uncompressed tile, tile_width*tile_height*type_size */
+  imbyte* comp;       /* compressed tile */
+  int comp_size;
+  int x, y, plane;    /* position in the image */
+  int width, height;  /* actual tile size, smaller at the borders */
+  int error;
+};
+
+/* Shared by all the tiles of a strip */
+struct iIMTStrip
+{
+  iIMTTile* tile;
+  imbyte* data;           /* strip of lines, one for each plane */
+  int x, y;               /* strip position in the image */
+  int line_size;          /* strip width times type size */
+  int plane_size;         /* strip line_size times tile_height */
+  int type_size, swap_size, swap_bytes;
+  int comp, zip_quality;
+  imCompressDataFunc lzo_func;
+};
+
+static void iIMTEncodeTile(void* user_data, int index)
+{
+  iIMTStrip* strip = (iIMTStrip*)user_data;
+  iIMTTile* tile = strip->tile + index;
+  int tile_line_size = tile->width*strip->type_size;
+  int raw_size = tile_line_size*tile->height;
+
+  imbyte* src_data = strip->data + tile->plane*strip->plane_size + (tile->x - strip->x)*strip->type_size;
+  for (int lin = 0; lin < tile->height; lin++)
+    memcpy(tile->raw + lin*tile_line_size, src_data + lin*strip->line_size, tile_line_size);
+
+  int comp_alloc = raw_size + raw_size/16 + 128;
+  switch (strip->comp)
+  {
+  case IMT_DEFLATE:
+    tile->comp_size = imCompressDataZ(tile->raw, raw_size, tile->comp, comp_alloc, strip->zip_quality);
+    break;
+  case IMT_LZF:
+    tile->comp_size = imCompressDataLZF(tile->raw, raw_size, tile->comp, comp_alloc);
+    break;
+  case IMT_LZO:
+    tile->comp_size = strip->lzo_func(tile->raw, raw_size, tile->comp, comp_alloc);
+    break;
+  default:
+    tile->comp_size = 0;
+    break;
+  }
+
+  /* store uncompressed when it does not compress */
+  if (tile->comp_size <= 0 || tile->comp_size >= raw_size)
+  {
+    memcpy(tile->comp, tile->raw, raw_size);
+    tile->comp_size = raw_size;
+  }
+}
+
+static void iIMTDecodeTile(void* user_data, int index)
+{
+  iIMTStrip* strip = (iIMTStrip*)user_data;
+  iIMTTile* tile = strip->tile + index;
+  int tile_line_size = tile->width*strip->type_size;
+  int raw_size = tile_line_size*tile->height;
+  int size;
+
+  if (tile->comp_size == raw_size)
+    memcpy(tile->raw, tile->comp, raw_size);
+  else
+  {
+    switch (strip->comp)
+    {
+    case IMT_DEFLATE:
+      size = imCompressDataUnZ(tile->comp, tile->comp_size, tile->raw, raw_size);
+      break;
+    case IMT_LZF:
+      size = imCompressDataUnLZF(tile->comp, tile->comp_size, tile->raw, raw_size);
+      break;
+    case IMT_LZO:
+      size = strip->lzo_func(tile->comp, tile->comp_size, tile->raw, raw_size);
+      break;
+    default:
+      size = 0;
+      break;
+    }
+
+    if (size != raw_size)
+    {
+      tile->error = 1;
+      return;
+    }
+  }
+
+  if (strip->swap_bytes)
+    imBinSwapBytes(tile->raw, raw_size/strip->swap_size, strip->swap_size);
+
+  imbyte* dst_data = strip->data + tile->plane*strip->plane_size + (tile->x - strip->x)*strip->type_size;
+  for (int lin = 0; lin < tile->height; lin++)
+    memcpy(dst_data + lin*strip->line_size, tile->raw + lin*tile_line_size, tile_line_size);
+}
+
+class imFileFormatIMT: public imFileFormatBase
+{
+  imBinFile* handle;          /* the binary file handle */
+  int swap_bytes;             /* file byte order is not the CPU byte order */
+  unsigned int* image_offset; /* offset of each image header */
+  unsigned int last_next_offset, end_offset;
+
+  int comp, tile_width, tile_height, tile_count_x, tile_count_y, zip_quality;
+  unsigned int index_offset, *tile_index;  /* offset and size of each tile */
+
+  int PlaneCount();
+  int ReadAttributes();
+  void WriteAttributes();
+
+public:
+  imFileFormatIMT(const imFormat* _iformat): imFileFormatBase(_iformat), handle(NULL), image_offset(NULL), tile_index(NULL) {}
+  ~imFileFormatIMT() { if (image_offset) free(image_offset); if (tile_index) free(tile_index); }
+
+  int Open(const char* file_name);
+  int New(const char* file_name);
+  void Close();
+  void* Handle(int index);
+  int ReadImageInfo(int index);
+  int ReadImageData(void* data);
+  int WriteImageInfo();
+  int WriteImageData(void* data);
+};
+
+class imFormatIMT: public imFormat
+{
+public:
+  imFormatIMT()
+    :imFormat("IMT",
+              "IM Tiled Image Format",
+              "*.imt;",
+              iIMTCompTable,
+              4,
+              1)
+    {}
+  ~imFormatIMT() {}
+
+  imFileFormatBase* Create(void) const { return new imFileFormatIMT(this); }
+  int CanWrite(const char* compression, int color_mode, int data_type) const;
+};
+
+
+void imFormatRegisterIMT(void)
+{
+  imFormatRegister(new imFormatIMT());
+}
+
+int imFileFormatIMT::Open(const char* file_name)
+{
+  unsigned char sig[8];
+  unsigned int first_offset;
+
+  /* opens the binary file for reading */
+  handle = imBinFileOpen(file_name);
+  if (!handle)
+    return IM_ERR_OPEN;
+
+  /* reads the IMT format identifier */
+  imBinFileRead(handle, sig, 8, 1);
+  if (imBinFileError(handle))
+  {
+    imBinFileClose(handle);
+    return IM_ERR_ACCESS;
+  }
+
+  if (!((sig[0] == 'I' && sig[1] == 'I') || (sig[0] == 'M' && sig[1] == 'M')) ||
+      sig[2] != 'I' || sig[3] != 'M' || sig[4] != 'T')
+  {
+    imBinFileClose(handle);
+    return IM_ERR_FORMAT;
+  }
+
+  if (sig[5] != IMT_VERSION)
+  {
+    imBinFileClose(handle);
+    return IM_ERR_DATA;
+  }
+
+  int byte_order = (sig[0] == 'I')? IM_LITTLEENDIAN: IM_BIGENDIAN;
+  imBinFileByteOrder(handle, byte_order);
+  this->swap_bytes = (byte_order != imBinCPUByteOrder());
+
+  imBinFileRead(handle, &this->image_count, 1, 4);
+  imBinFileRead(handle, &first_offset, 1, 4);
+  if (imBinFileError(handle) || this->image_count <= 0)
+  {
+    imBinFileClose(handle);
+    return IM_ERR_ACCESS;
+  }
+
+  /* follow the chain of image headers */
+  unsigned long file_size = imBinFileSize(handle);
+  if ((unsigned long)this->image_count > file_size/4)
+  {
+    imBinFileClose(handle);
+    return IM_ERR_DATA;
+  }
+
+  this->image_offset = (unsigned int*)malloc(this->image_count*sizeof(unsigned int));
+  if (!this->image_offset)
+  {
+    imBinFileClose(handle);
+    return IM_ERR_MEM;
+  }
+
+  this->image_offset[0] = first_offset;
+  for (int i = 0; i < this->image_count; i++)
+  {
+    if (this->image_offset[i] < 16 || this->image_offset[i] >= file_size)
+    {
+      imBinFileClose(handle);
+      return IM_ERR_DATA;
+    }
+
+    if (i+1 < this->image_count)
+    {
+      imBinFileSeekTo(handle, this->image_offset[i]);
+      imBinFileRead(handle, this->image_offset + i+1, 1, 4);
+    }
+  }
+
+  /* compression of the first image */
+  int comp_value = -1;
+  imBinFileSeekTo(handle, this->image_offset[0] + 5*4);
+  imBinFileRead(handle, &comp_value, 1, 4);
+  if (imBinFileError(handle) || comp_value < 0 || comp_value > IMT_LZO)
+  {
+    imBinFileClose(handle);
+    return IM_ERR_ACCESS;
+  }
+
+  strcpy(this->compression, iIMTCompTable[comp_value]);
+
+  return IM_ERR_NONE;
+}
+
+int imFileFormatIMT::New(const char* file_name)
+{
+  /* opens the binary file for writing */
+  handle = imBinFileNew(file_name);
+  if (!handle)
+    return IM_ERR_OPEN;
+
+  /* always writes in the CPU byte order */
+  int byte_order = imBinCPUByteOrder();
+  imBinFileByteOrder(handle, byte_order);
+  this->swap_bytes = 0;
+
+  unsigned char sig[8] = {'I', 'I', 'I', 'M', 'T', IMT_VERSION, 0, 0};
+  if (byte_order == IM_BIGENDIAN)
+    sig[0] = sig[1] = 'M';
+  imBinFileWrite(handle, sig, 8, 1);
+
+  unsigned int dword_value = 0;
+  imBinFileWrite(handle, &dword_value, 1, 4);  /* image_count, updated after each image */
+  imBinFileWrite(handle, &dword_value, 1, 4);  /* first_image_offset, updated in WriteImageInfo */
+
+  if (imBinFileError(handle))
+  {
+    imBinFileClose(handle);
+    return IM_ERR_ACCESS;
+  }
+
+  this->last_next_offset = 12;
+  this->end_offset = 16;
+  this->image_count = 0;
+
+  return IM_ERR_NONE;
+}
+
+void imFileFormatIMT::Close()
+{
+  imBinFileClose(handle);
+}
+
+void* imFileFormatIMT::Handle(int index)
+{
+  if (index == 0)
+    return (void*)this->handle;
+  else
+    return NULL;
+}
+
+int imFileFormatIMT::PlaneCount()
+{
+  /* same rule as imFileLineBufferCount, alpha is skipped if the user does not want it */
+  if (imColorModeHasAlpha(this->file_color_mode) && imColorModeHasAlpha(this->user_color_mode))
+    return imColorModeDepth(this->file_color_mode);
+  else
+    return imColorModeDepth(imColorModeSpace(this->file_color_mode));
+}
+
+int imFileFormatIMT::ReadAttributes()
+{
+  imAttribTable* attrib_table = AttribTable();
+  unsigned long file_size = imBinFileSize(handle);
+  int attrib_count;
+
+  imBinFileRead(handle, &attrib_count, 1, 4);
+  if (imBinFileError(handle) || attrib_count < 0)
+    return IM_ERR_ACCESS;
+
+  for (int i = 0; i < attrib_count; i++)
+  {
+    char name[256];
+    int name_size, data_type, count;
+
+    imBinFileRead(handle, &name_size, 1, 4);
+    if (imBinFileError(handle) || name_size <= 0 || name_size > 256)
+      return IM_ERR_ACCESS;
+
+    imBinFileRead(handle, name, name_size, 1);
+    name[name_size-1] = 0;
+
+    imBinFileRead(handle, &data_type, 1, 4);
+    imBinFileRead(handle, &count, 1, 4);
+    if (imBinFileError(handle) || data_type < IM_BYTE || data_type > IM_CDOUBLE ||
+        count <= 0 || (unsigned long)count > file_size/imDataTypeSize(data_type))
+      return IM_ERR_ACCESS;
+
+    /* complex values are swapped by component */
+    int value_size = imDataTypeSize(data_type), value_count = count;
+    if (data_type == IM_CFLOAT || data_type == IM_CDOUBLE)
+    {
+      value_size /= 2;
+      value_count *= 2;
+    }
+
+    void* data = malloc(value_size*value_count);
+    if (!data)
+      return IM_ERR_MEM;
+
+    imBinFileRead(handle, data, value_count, value_size);
+    if (imBinFileError(handle))
+    {
+      free(data);
+      return IM_ERR_ACCESS;
+    }
+
+    attrib_table->Set(name, data_type, count, data);
+    free(data);
+  }
+
+  return IM_ERR_NONE;
+}
+
+int imFileFormatIMT::ReadImageInfo(int index)
+{
+  imAttribTable* attrib_table = AttribTable();
+  unsigned long file_size = imBinFileSize(handle);
+  unsigned int next_offset;
+  int value[7];
+
+  /* jump to start offset of the image */
+  imBinFileSeekTo(handle, this->image_offset[index]);
+
+  imBinFileRead(handle, &next_offset, 1, 4);
+  imBinFileRead(handle, value, 7, 4);
+  if (imBinFileError(handle))
+    return IM_ERR_ACCESS;
+
+  this->width = value[0];
+  this->height = value[1];
+  int color_mode = value[2];
+  this->file_data_type = value[3];
+  this->comp = value[4];
+  this->tile_width = value[5];
+  this->tile_height = value[6];
+
+  if (this->width <= 0 || this->height <= 0 ||
+      this->tile_width <= 0 || this->tile_width > this->width ||
+      this->tile_height <= 0 || this->tile_height > this->height ||
+      this->tile_width > (1 << 26) / this->tile_height ||   /* so tile sizes in bytes fit in an int */
+      (color_mode & ~(0xFF | IM_ALPHA)) != 0 || imColorModeSpace(color_mode) > IM_XYZ ||
+      this->file_data_type < IM_BYTE || this->file_data_type > IM_CDOUBLE ||
+      this->comp < IMT_NONE || this->comp > IMT_LZO)
+    return IM_ERR_DATA;
+
+  this->file_color_mode = imColorModeSpace(color_mode) | IM_TOPDOWN;
+  if (imColorModeHasAlpha(color_mode))
+    this->file_color_mode |= IM_ALPHA;
+
+  if (!imImageCheckFormat(this->file_color_mode, this->file_data_type))
+    return IM_ERR_DATA;
+
+  /* the image size in bytes must fit in an int, like the size of an imImage */
+  if ((long long)this->width*this->height*imColorModeDepth(this->file_color_mode)*imDataTypeSize(this->file_data_type) > INT_MAX)
+    return IM_ERR_DATA;
+
+  if (this->comp == IMT_LZO && !imCompressGetLZO(NULL, NULL))
+    return IM_ERR_COMPRESS;
+
+  strcpy(this->compression, iIMTCompTable[this->comp]);
+
+  /* must clear the attribute list, because it can have multiple images and
+     each image has its own attributes. */
+  attrib_table->RemoveAll();
+  imFileSetBaseAttributes(this);
+
+  imBinFileRead(handle, &this->palette_count, 1, 4);
+  if (imBinFileError(handle) || this->palette_count < 0 || this->palette_count > 256)
+    return IM_ERR_ACCESS;
+
+  if (this->palette_count)
+  {
+    unsigned int palette[256];
+    imBinFileRead(handle, palette, this->palette_count, 4);
+    for (int c = 0; c < this->palette_count; c++)
+      this->palette[c] = (long)palette[c];
+  }
+
+  int error = ReadAttributes();
+  if (error)
+    return error;
+
+  attrib_table->Set("TileWidth", IM_INT, 1, &this->tile_width);
+  attrib_table->Set("TileHeight", IM_INT, 1, &this->tile_height);
+
+  /* reads the tile index */
+  int depth = imColorModeDepth(this->file_color_mode);
+  this->tile_count_x = (this->width + this->tile_width - 1) / this->tile_width;
+  this->tile_count_y = (this->height + this->tile_height - 1) / this->tile_height;
+  long long tile_count64 = (long long)this->tile_count_x * this->tile_count_y * depth;
+  if (tile_count64 > (long long)(file_size/8))
+    return IM_ERR_DATA;
+  int tile_count = (int)tile_count64;
+
+  unsigned int* new_index = (unsigned int*)realloc(this->tile_index, 2*tile_count*sizeof(unsigned int));
+  if (!new_index)
+    return IM_ERR_MEM;
+  this->tile_index = new_index;
+
+  imBinFileRead(handle, this->tile_index, 2*tile_count, 4);
+  if (imBinFileError(handle))
+    return IM_ERR_ACCESS;
+
+  /* each tile must be inside the file */
+  for (int t = 0; t < tile_count; t++)
+  {
+    unsigned long tile_offset = this->tile_index[2*t], tile_size = this->tile_index[2*t+1];
+    if (tile_offset > file_size || tile_size > file_size - tile_offset)
+      return IM_ERR_DATA;
+  }
+
+  return IM_ERR_NONE;
+}
+
+int imFileFormatIMT::ReadImageData(void* data)
+{
+  imAttribTable* attrib_table = AttribTable();
+  int *attrib_data, view_width, view_height, xmin, xmax, ymin, ymax;
+  int image_width = this->width, image_height = this->height;
+
+  /* full image if the view is not defined, the view must be inside the image */
+  attrib_data = (int*)attrib_table->Get("ViewXmin");
+  xmin = attrib_data? *attrib_data: 0;
+  if (xmin < 0) xmin = 0;
+
+  attrib_data = (int*)attrib_table->Get("ViewYmin");
+  ymin = attrib_data? *attrib_data: 0;
+  if (ymin < 0) ymin = 0;
+
+  attrib_data = (int*)attrib_table->Get("ViewXmax");
+  xmax = attrib_data? *attrib_data: image_width-1;
+  if (xmax > image_width-1) xmax = image_width-1;
+
+  attrib_data = (int*)attrib_table->Get("ViewYmax");
+  ymax = attrib_data? *attrib_data: image_height-1;
+  if (ymax > image_height-1) ymax = image_height-1;
+
+  if (xmin > xmax || ymin > ymax)
+    return IM_ERR_DATA;
+
+  int region_width = xmax-xmin+1, region_height = ymax-ymin+1;
+
+  /* the view size can be smaller than the region, then the region is sampled */
+  attrib_data = (int*)attrib_table->Get("ViewWidth");
+  view_width = attrib_data? *attrib_data: region_width;
+  if (view_width > region_width || view_width <= 0) view_width = region_width;
+
+  attrib_data = (int*)attrib_table->Get("ViewHeight");
+  view_height = attrib_data? *attrib_data: region_height;
+  if (view_height > region_height || view_height <= 0) view_height = region_height;
+
+  int is_view = (view_width != image_width || view_height != image_height);
+
+  /* the bands of imFileReadImageLines were already sized with the full image */
+  if (is_view && this->line_band)
+    return IM_ERR_DATA;
+
+  if (is_view)
+  {
+    /* from now on the image has the size of the view */
+    this->width = view_width;
+    this->height = view_height;
+    this->line_buffer_size = imImageLineSize(view_width, this->file_color_mode, this->file_data_type);
+  }
+
+  iIMTStrip strip;
+  strip.type_size = imDataTypeSize(this->file_data_type);
+  strip.swap_size = strip.type_size;
+  if (this->file_data_type == IM_CFLOAT || this->file_data_type == IM_CDOUBLE)
+    strip.swap_size /= 2;
+  strip.swap_bytes = this->swap_bytes && strip.swap_size > 1;
+  strip.comp = this->comp;
+  strip.zip_quality = 0;
+  strip.lzo_func = NULL;
+  if (this->comp == IMT_LZO)
+    imCompressGetLZO(NULL, &strip.lzo_func);
+
+  /* only the tile columns inside the region are decoded */
+  int tile_x0 = xmin / this->tile_width, tile_x1 = xmax / this->tile_width;
+  int strip_tile_count = tile_x1 - tile_x0 + 1;
+  int plane_count = PlaneCount();
+  int tile_alloc = this->tile_width*this->tile_height*strip.type_size;
+
+  strip.x = tile_x0*this->tile_width;
+  int strip_width = (tile_x1+1)*this->tile_width;
+  if (strip_width > image_width) strip_width = image_width;
+  strip_width -= strip.x;
+  strip.line_size = strip_width*strip.type_size;
+  strip.plane_size = strip.line_size*this->tile_height;
+
+  int task_count = strip_tile_count*plane_count;
+  strip.data = (imbyte*)malloc(strip.plane_size*plane_count);
+  strip.tile = (iIMTTile*)malloc(task_count*sizeof(iIMTTile));
+  imbyte* tile_buffer = (imbyte*)malloc(2*task_count*tile_alloc);
+  if (!strip.data || !strip.tile || !tile_buffer)
+  {
+    if (strip.data) free(strip.data);
+    if (strip.tile) free(strip.tile);
+    if (tile_buffer) free(tile_buffer);
+    return IM_ERR_MEM;
+  }
+
+  for (int t = 0; t < task_count; t++)
+  {
+    strip.tile[t].raw = tile_buffer + 2*t*tile_alloc;
+    strip.tile[t].comp = strip.tile[t].raw + tile_alloc;
+  }
+
+  /* sampling positions of the view columns */
+  int* xpos = NULL;
+  if (view_width != region_width)
+  {
+    xpos = (int*)malloc(view_width*sizeof(int));
+    if (!xpos)
+    {
+      free(strip.data);
+      free(strip.tile);
+      free(tile_buffer);
+      return IM_ERR_MEM;
+    }
+
+    for (int x = 0; x < view_width; x++)
+      xpos[x] = (xmin + (x*region_width)/view_width - strip.x)*strip.type_size;
+  }
+
+  imCounterTotal(this->counter, view_height, "Reading IMT...");
+
+  int error = IM_ERR_NONE, strip_tile_y = -1;
+  for (int row = 0; row < view_height; row++)
+  {
+    int y = ymin + (row*region_height)/view_height;
+    int tile_y = y / this->tile_height;
+
+    if (tile_y != strip_tile_y)
+    {
+      /* reads the compressed tiles of the strip */
+      strip.y = tile_y*this->tile_height;
+      int tile_height = image_height - strip.y;
+      if (tile_height > this->tile_height) tile_height = this->tile_height;
+
+      for (int plane = 0; plane < plane_count && !error; plane++)
+      {
+        for (int tx = 0; tx < strip_tile_count; tx++)
+        {
+          iIMTTile* tile = strip.tile + plane*strip_tile_count + tx;
+          int tile_x = tile_x0 + tx;
+          int t = (plane*this->tile_count_y + tile_y)*this->tile_count_x + tile_x;
+
+          tile->x = tile_x*this->tile_width;
+          tile->y = strip.y;
+          tile->plane = plane;
+          tile->width = image_width - tile->x;
+          if (tile->width > this->tile_width) tile->width = this->tile_width;
+          tile->height = tile_height;
+          tile->error = 0;
+          tile->comp_size = (int)this->tile_index[2*t+1];
+
+          if (tile->comp_size > tile->width*tile->height*strip.type_size)
+          {
+            error = IM_ERR_ACCESS;
+            break;
+          }
+
+          imBinFileSeekTo(handle, this->tile_index[2*t]);
+          imBinFileRead(handle, tile->comp, tile->comp_size, 1);
+          if (imBinFileError(handle))
+          {
+            error = IM_ERR_ACCESS;
+            break;
+          }
+        }
+      }
+
+      if (error)
+        break;
+
+      imThreadParallelFor(task_count, iIMTDecodeTile, &strip);
+
+      for (int t = 0; t < task_count; t++)
+      {
+        if (strip.tile[t].error)
+          error = IM_ERR_ACCESS;
+      }
+
+      if (error)
+        break;
+
+      strip_tile_y = tile_y;
+    }
+
+    imbyte* strip_line = strip.data + (y - strip.y)*strip.line_size;
+    for (int plane = 0; plane < plane_count; plane++)
+    {
+      imbyte* src_line = strip_line + plane*strip.plane_size;
+      imbyte* dst_line = (imbyte*)this->line_buffer;
+
+      if (xpos)
+      {
+        for (int x = 0; x < view_width; x++)
+        {
+          memcpy(dst_line, src_line + xpos[x], strip.type_size);
+          dst_line += strip.type_size;
+        }
+      }
+      else
+        memcpy(dst_line, src_line + (xmin - strip.x)*strip.type_size, this->line_buffer_size);
+
+      imFileLineBufferRead(this, data, row, plane);
+    }
+
+    if (!imCounterInc(this->counter))
+    {
+      error = IM_ERR_COUNTER;
+      break;
+    }
+  }
+
+  if (xpos) free(xpos);
+  free(strip.data);
+  free(strip.tile);
+  free(tile_buffer);
+
+  /* width and height now have the view size,
+     so the next imFileReadImageInfo must read the header again */
+  if (is_view)
+    this->image_index = -1;
+
+  return error;
+}
+
+struct iIMTAttribWrite
+{
+  imBinFile* handle;
+  int count;
+};
+
+static int iIMTAttribCount(void* user_data, int index, const char* name, int data_type, int count, const void* data)
+{
+  iIMTAttribWrite* attrib_write = (iIMTAttribWrite*)user_data;
+  (void)index; (void)data_type; (void)count; (void)data;
+
+  if (!iIMTAttribSkip(name))
+    attrib_write->count++;
+
+  return 1;
+}
+
+static int iIMTAttribWriteFunc(void* user_data, int index, const char* name, int data_type, int count, const void* data)
+{
+  iIMTAttribWrite* attrib_write = (iIMTAttribWrite*)user_data;
+  (void)index;
+
+  if (iIMTAttribSkip(name))
+    return 1;
+
+  int name_size = (int)strlen(name)+1;
+  if (name_size > 256)
+    name_size = 256;
+
+  imBinFileWrite(attrib_write->handle, &name_size, 1, 4);
+  imBinFileWrite(attrib_write->handle, (void*)name, name_size-1, 1);
+  imbyte terminator = 0;
+  imBinFileWrite(attrib_write->handle, &terminator, 1, 1);
+  imBinFileWrite(attrib_write->handle, &data_type, 1, 4);
+  imBinFileWrite(attrib_write->handle, &count, 1, 4);
+  imBinFileWrite(attrib_write->handle, (void*)data, count, imDataTypeSize(data_type));
+
+  return 1;
+}
+
+void imFileFormatIMT::WriteAttributes()
+{
+  imAttribTable* attrib_table = AttribTable();
+  iIMTAttribWrite attrib_write;
+  attrib_write.handle = handle;
+  attrib_write.count = 0;
+
+  attrib_table->ForEach(&attrib_write, iIMTAttribCount);
+  imBinFileWrite(handle, &attrib_write.count, 1, 4);
+  attrib_table->ForEach(&attrib_write, iIMTAttribWriteFunc);
+}
+
+int imFileFormatIMT::WriteImageInfo()
+{
+  imAttribTable* attrib_table = AttribTable();
+
+  if (this->compression[0] == 0)
+    strcpy(this->compression, "LZF");
+
+  this->comp = iIMTCompFind(this->compression);
+  if (this->comp < 0)
+    return IM_ERR_COMPRESS;
+
+  if (this->comp == IMT_LZO && !imCompressGetLZO(NULL, NULL))
+    return IM_ERR_COMPRESS;
+
+  this->file_data_type = this->user_data_type;
+  this->file_color_mode = imColorModeSpace(this->user_color_mode) | IM_TOPDOWN;
+  if (imColorModeHasAlpha(this->user_color_mode))
+    this->file_color_mode |= IM_ALPHA;
+
+  int* attrib_data = (int*)attrib_table->Get("TileWidth");
+  this->tile_width = attrib_data? *attrib_data: IMT_TILE_SIZE;
+  if (this->tile_width < 8) this->tile_width = 8;
+  if (this->tile_width > this->width) this->tile_width = this->width;
+
+  attrib_data = (int*)attrib_table->Get("TileHeight");
+  this->tile_height = attrib_data? *attrib_data: IMT_TILE_SIZE;
+  if (this->tile_height < 8) this->tile_height = 8;
+  if (this->tile_height > this->height) this->tile_height = this->height;
+
+  attrib_data = (int*)attrib_table->Get("ZIPQuality");
+  this->zip_quality = attrib_data? *attrib_data: 6;
+  if (this->zip_quality < 1) this->zip_quality = 1;
+  if (this->zip_quality > 9) this->zip_quality = 9;
+
+  /* the new image goes at the end of the file,
+     and it is linked to the previous one */
+  unsigned int header_offset = this->end_offset;
+  imBinFileSeekTo(handle, this->last_next_offset);
+  imBinFileWrite(handle, &header_offset, 1, 4);
+  imBinFileSeekTo(handle, header_offset);
+  this->last_next_offset = header_offset;
+
+  unsigned int next_offset = 0;
+  int value[7];
+  value[0] = this->width;
+  value[1] = this->height;
+  value[2] = imColorModeSpace(this->file_color_mode) | (this->file_color_mode & IM_ALPHA);
+  value[3] = this->file_data_type;
+  value[4] = this->comp;
+  value[5] = this->tile_width;
+  value[6] = this->tile_height;
+
+  imBinFileWrite(handle, &next_offset, 1, 4);
+  imBinFileWrite(handle, value, 7, 4);
+
+  int palette_count = 0;
+  if (imColorModeSpace(this->file_color_mode) == IM_MAP)
+    palette_count = this->palette_count;
+
+  imBinFileWrite(handle, &palette_count, 1, 4);
+  for (int c = 0; c < palette_count; c++)
+  {
+    unsigned int color = (unsigned int)this->palette[c];
+    imBinFileWrite(handle, &color, 1, 4);
+  }
+
+  WriteAttributes();
+
+  /* the tile index is written after the tiles */
+  int depth = imColorModeDepth(this->file_color_mode);
+  this->tile_count_x = (this->width + this->tile_width - 1) / this->tile_width;
+  this->tile_count_y = (this->height + this->tile_height - 1) / this->tile_height;
+  int tile_count = this->tile_count_x * this->tile_count_y * depth;
+
+  this->index_offset = imBinFileTell(handle);
+  unsigned int* new_index = (unsigned int*)realloc(this->tile_index, 2*tile_count*sizeof(unsigned int));
+  if (!new_index)
+    return IM_ERR_MEM;
+  this->tile_index = new_index;
+
+  memset(this->tile_index, 0, 2*tile_count*sizeof(unsigned int));
+  imBinFileWrite(handle, this->tile_index, 2*tile_count, 4);
+
+  this->end_offset = imBinFileTell(handle);
+
+  if (imBinFileError(handle))
+    return IM_ERR_ACCESS;
+
+  return IM_ERR_NONE;
+}
+
+int imFileFormatIMT::WriteImageData(void* data)
+{
+  iIMTStrip strip;
+  strip.type_size = imDataTypeSize(this->file_data_type);
+  strip.swap_size = strip.type_size;
+  strip.swap_bytes = 0;
+  strip.comp = this->comp;
+  strip.zip_quality = this->zip_quality;
+  strip.lzo_func = NULL;
+  if (this->comp == IMT_LZO)
+    imCompressGetLZO(&strip.lzo_func, NULL);
+
+  int plane_count = PlaneCount();
+  int tile_alloc = this->tile_width*this->tile_height*strip.type_size;
+  int comp_alloc = tile_alloc + tile_alloc/16 + 128;
+
+  strip.x = 0;
+  strip.line_size = this->line_buffer_size;
+  strip.plane_size = strip.line_size*this->tile_height;
+
+  int task_count = this->tile_count_x*plane_count;
+  strip.data = (imbyte*)malloc(strip.plane_size*plane_count);
+  strip.tile = (iIMTTile*)malloc(task_count*sizeof(iIMTTile));
+  imbyte* tile_buffer = (imbyte*)malloc(task_count*(tile_alloc + comp_alloc));
+  if (!strip.data || !strip.tile || !tile_buffer)
+  {
+    if (strip.data) free(strip.data);
+    if (strip.tile) free(strip.tile);
+    if (tile_buffer) free(tile_buffer);
+    return IM_ERR_MEM;
+  }
+
+  for (int t = 0; t < task_count; t++)
+  {
+    strip.tile[t].raw = tile_buffer + t*(tile_alloc + comp_alloc);
+    strip.tile[t].comp = strip.tile[t].raw + tile_alloc;
+  }
+
+  imCounterTotal(this->counter, this->height, "Writing IMT...");
+
+  unsigned int offset = this->end_offset;
+  imBinFileSeekTo(handle, offset);
+
+  int error = IM_ERR_NONE;
+  for (int tile_y = 0; tile_y < this->tile_count_y && !error; tile_y++)
+  {
+    strip.y = tile_y*this->tile_height;
+    int tile_height = this->height - strip.y;
+    if (tile_height > this->tile_height) tile_height = this->tile_height;
+
+    for (int lin = 0; lin < tile_height; lin++)
+    {
+      for (int plane = 0; plane < plane_count; plane++)
+      {
+        imFileLineBufferWrite(this, data, strip.y + lin, plane);
+        memcpy(strip.data + plane*strip.plane_size + lin*strip.line_size, this->line_buffer, strip.line_size);
+      }
+
+      if (!imCounterInc(this->counter))
+      {
+        error = IM_ERR_COUNTER;
+        break;
+      }
+    }
+
+    if (error)
+      break;
+
+    for (int plane = 0; plane < plane_count; plane++)
+    {
+      for (int tile_x = 0; tile_x < this->tile_count_x; tile_x++)
+      {
+        iIMTTile* tile = strip.tile + plane*this->tile_count_x + tile_x;
+        tile->x = tile_x*this->tile_width;
+        tile->y = strip.y;
+        tile->plane = plane;
+        tile->width = this->width - tile->x;
+        if (tile->width > this->tile_width) tile->width = this->tile_width;
+        tile->height = tile_height;
+        tile->error = 0;
+      }
+    }
+
+    imThreadParallelFor(task_count, iIMTEncodeTile, &strip);
+
+    /* tiles are written in the order of the index */
+    for (int plane = 0; plane < plane_count; plane++)
+    {
+      for (int tile_x = 0; tile_x < this->tile_count_x; tile_x++)
+      {
+        iIMTTile* tile = strip.tile + plane*this->tile_count_x + tile_x;
+        int t = (plane*this->tile_count_y + tile_y)*this->tile_count_x + tile_x;
+
+        if (offset + (unsigned int)tile->comp_size < offset)
+        {
+          error = IM_ERR_ACCESS;  /* offsets are limited to 4GB */
+          break;
+        }
+
+        this->tile_index[2*t] = offset;
+        this->tile_index[2*t+1] = tile->comp_size;
+
+        imBinFileWrite(handle, tile->comp, tile->comp_size, 1);
+        offset += tile->comp_size;
+      }
+    }
+
+    if (imBinFileError(handle))
+      error = IM_ERR_ACCESS;
+  }
+
+  free(strip.data);
+  free(strip.tile);
+  free(tile_buffer);
+
+  if (error)
+    return error;
+
+  this->end_offset = offset;
+  this->image_count++;
+
+  /* updates the tile index and the image count */
+  int tile_count = this->tile_count_x * this->tile_count_y * imColorModeDepth(this->file_color_mode);
+  imBinFileSeekTo(handle, this->index_offset);
+  imBinFileWrite(handle, this->tile_index, 2*tile_count, 4);
+
+  imBinFileSeekTo(handle, 8);
+  imBinFileWrite(handle, &this->image_count, 1, 4);
+
+  imBinFileSeekTo(handle, this->end_offset);
+
+  if (imBinFileError(handle))
+    return IM_ERR_ACCESS;
+
+  return IM_ERR_NONE;
+}
+
+int imFormatIMT::CanWrite(const char* compression, int color_mode, int data_type) const
+{
+  (void)color_mode;
+  (void)data_type;
+
+  if (!compression || compression[0] == 0)
+    return IM_ERR_NONE;
+
+  int comp = iIMTCompFind(compression);
+  if (comp < 0)
+    return IM_ERR_COMPRESS;
+
+  if (comp == IMT_LZO && !imCompressGetLZO(NULL, NULL))
+    return IM_ERR_COMPRESS;
+
+  return IM_ERR_NONE;
+}
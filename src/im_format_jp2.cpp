@@ -12,13 +12,17 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <stdio.h>
+#include <math.h>
 
 #include "jasper/jasper.h"
-#include "jpc/jpc_enc.h"
-#include "jp2/jp2_cod.h"
 
 extern "C" 
 {
+#include "jpc/jpc_enc.h"
+#include "jpc/jpc_cs.h"
+#include "jp2/jp2_cod.h"
+
   /* implemented in jas_binfile.c */
   jas_stream_t *jas_binfile_open(const char *file_name, int is_new);
 }
@@ -29,13 +33,21 @@ jas_seqent_t iJP2Bits2Int(jas_seqent_t v, int prec, int sgnd)
   return  (sgnd && (v & (1 << (prec - 1)))) ? (v - (1 << prec)) : v;
 }
 
-/* this is based on jas_image_readcmpt */
+/* this is based on jas_image_readcmpt, 
+   but reads all the samples of the line at once.
+   Reads "count" samples starting at column "xmin", 
+   xmap when not NULL selects the samples of a zoomed view. */
 template <class T> 
-int iJP2ReadLine(jas_image_t *image, int lin, int cmpno, T *data)
+int iJP2ReadLine(jas_image_t *image, int lin, int cmpno, T *data, int xmin, int count, 
+                 const int* xmap, int width, unsigned char* buffer)
 {
   jas_image_cmpt_t *cmpt = image->cmpts_[cmpno];
+  int cps = cmpt->cps_;
 
-  if (jas_stream_seek(cmpt->stream_, (cmpt->width_ * lin) * cmpt->cps_, SEEK_SET) < 0) 
+  if (jas_stream_seek(cmpt->stream_, (cmpt->width_ * lin + xmin) * cps, SEEK_SET) < 0) 
+    return 0;
+
+  if (jas_stream_read(cmpt->stream_, buffer, count * cps) != count * cps)
     return 0;
 
   // this offset will convert from signed to unsigned
@@ -43,17 +55,20 @@ int iJP2ReadLine(jas_image_t *image, int lin, int cmpno, T *data)
   if (cmpt->sgnd_ && cmpt->prec_ > 1)
     offset = 1 << (cmpt->prec_-1);
 
-  for (int j = 0; j < cmpt->width_; j++) 
+  for (int j = 0; j < width; j++) 
   {
-    jas_seqent_t v = 0;
+    unsigned char* b = buffer + (xmap? xmap[j]: j) * cps;
+    jas_seqent_t v;
 
-    for (int k = 0; k < cmpt->cps_; k++) 
+    if (cps == 1)
+      v = b[0];
+    else if (cps == 2)
+      v = (b[0] << 8) | b[1];
+    else
     {
-      int c = jas_stream_getc(cmpt->stream_);
-      if (c == EOF) 
-        return 0;
-
-      v = (v << 8) | (c & 0xff);
+      v = 0;
+      for (int k = 0; k < cps; k++) 
+        v = (v << 8) | b[k];
     }
 
     v = iJP2Bits2Int(v, cmpt->prec_, cmpt->sgnd_);
@@ -64,6 +79,64 @@ int iJP2ReadLine(jas_image_t *image, int lin, int cmpno, T *data)
   return 1;
 }
 
+/* Reads the image size and the number of decomposition levels 
+   from the main header of the code stream, without decoding it. */
+static int iJP2ReadHeader(jas_stream_t *stream, int fmtid, int *width, int *height, 
+                          int *xoff, int *yoff, int *numdlvls)
+{
+  if (fmtid == jas_image_strtofmt((char*)"jp2"))
+  {
+    jp2_box_t *box;
+    int found = 0;
+    while (!found && (box = jp2_box_get(stream)) != NULL)
+    {
+      found = (box->type == JP2_BOX_JP2C);
+      jp2_box_destroy(box);
+    }
+
+    if (!found)
+      return 0;
+  }
+
+  jpc_cstate_t *cstate = jpc_cstate_create();
+  if (!cstate)
+    return 0;
+
+  int found_siz = 0, done = 0;
+  *numdlvls = 0;
+
+  while (!done)
+  {
+    jpc_ms_t *ms = jpc_getms(stream, cstate);
+    if (!ms)
+      break;
+
+    switch (jpc_ms_gettype(ms))
+    {
+    case JPC_MS_SIZ:
+      *xoff = ms->parms.siz.xoff;
+      *yoff = ms->parms.siz.yoff;
+      *width = ms->parms.siz.width - ms->parms.siz.xoff;
+      *height = ms->parms.siz.height - ms->parms.siz.yoff;
+      found_siz = 1;
+      break;
+    case JPC_MS_COD:
+      *numdlvls = ms->parms.cod.compparms.numdlvls;
+      done = 1;
+      break;
+    case JPC_MS_SOT:
+    case JPC_MS_EOC:
+      done = 1;
+      break;
+    }
+
+    jpc_ms_destroy(ms);
+  }
+
+  jpc_cstate_destroy(cstate);
+  return found_siz;
+}
+
 uint_fast32_t iJP2Int2Bits(jas_seqent_t v, int prec, int sgnd)
 {
   uint_fast32_t ret;
@@ -108,8 +181,16 @@ class imFileFormatJP2: public imFileFormatBase
   jas_stream_t *stream;
   jas_image_t *image;
 
+  /* region of the decoded image that is read, see the View* attributes */
+  int view_xmin, view_ymin, view_width, view_height;
+  int* view_xmap;
+  unsigned char* cmpt_buffer;
+
+  void ReadViewAttributes(int image_width, int image_height, int *xmin, int *ymin, int *xmax, int *ymax, 
+                          int *zoom_width, int *zoom_height);
+
 public:
-  imFileFormatJP2(const imFormat* _iformat): imFileFormatBase(_iformat), image(0) {}
+  imFileFormatJP2(const imFormat* _iformat): imFileFormatBase(_iformat), image(0), view_xmap(0), cmpt_buffer(0) {}
   ~imFileFormatJP2() {}
 
   int Open(const char* file_name);
@@ -212,6 +293,9 @@ void imFileFormatJP2::Close()
   if (this->image)
     jas_image_destroy(this->image);
 
+  if (this->view_xmap) free(this->view_xmap);
+  if (this->cmpt_buffer) free(this->cmpt_buffer);
+
   jas_stream_close(this->stream);
 }
 
@@ -227,15 +311,86 @@ void* imFileFormatJP2::Handle(int index)
     return NULL;
 }
 
+void imFileFormatJP2::ReadViewAttributes(int image_width, int image_height, int *xmin, int *ymin, int *xmax, int *ymax, 
+                                         int *zoom_width, int *zoom_height)
+{
+  imAttribTable* attrib_table = AttribTable();
+  int* attrib_data;
+
+  // full image if not defined.
+  // this size must be inside the image
+  attrib_data = (int*)attrib_table->Get("ViewXmin");
+  *xmin = attrib_data? *attrib_data: 0; 
+  if (*xmin < 0) *xmin = 0;
+  if (*xmin > image_width-1) *xmin = image_width-1;
+
+  attrib_data = (int*)attrib_table->Get("ViewYmin");
+  *ymin = attrib_data? *attrib_data: 0; 
+  if (*ymin < 0) *ymin = 0;
+  if (*ymin > image_height-1) *ymin = image_height-1;
+
+  attrib_data = (int*)attrib_table->Get("ViewXmax");
+  *xmax = attrib_data? *attrib_data: image_width-1; 
+  if (*xmax > image_width-1) *xmax = image_width-1;
+  if (*xmax < *xmin) *xmax = *xmin;
+
+  attrib_data = (int*)attrib_table->Get("ViewYmax");
+  *ymax = attrib_data? *attrib_data: image_height-1; 
+  if (*ymax > image_height-1) *ymax = image_height-1;
+  if (*ymax < *ymin) *ymax = *ymin;
+
+  // this size is free, can be anything, but we restricted to less than the image size
+  attrib_data = (int*)attrib_table->Get("ViewWidth");
+  *zoom_width = attrib_data? *attrib_data: *xmax - *xmin + 1; 
+  if (*zoom_width > image_width) *zoom_width = image_width;
+  if (*zoom_width < 1) *zoom_width = 1;
+
+  attrib_data = (int*)attrib_table->Get("ViewHeight");
+  *zoom_height = attrib_data? *attrib_data: *ymax - *ymin + 1; 
+  if (*zoom_height > image_height) *zoom_height = image_height;
+  if (*zoom_height < 1) *zoom_height = 1;
+}
+
 int imFileFormatJP2::ReadImageInfo(int index)
 {
   (void)index;
 
+  imAttribTable* attrib_table = AttribTable();
+  int has_view = attrib_table->Get("ViewWidth") || attrib_table->Get("ViewHeight") ||
+                 attrib_table->Get("ViewXmin") || attrib_table->Get("ViewYmin") ||
+                 attrib_table->Get("ViewXmax") || attrib_table->Get("ViewYmax");
+
+  char options[256] = "";
+  int image_width = 0, image_height = 0, xmin = 0, ymin = 0, xmax = 0, ymax = 0, 
+      zoom_width = 0, zoom_height = 0;
+
+  if (has_view)
+  {
+    int xoff = 0, yoff = 0, numdlvls = 0;
+    if (!iJP2ReadHeader(this->stream, this->fmtid, &image_width, &image_height, &xoff, &yoff, &numdlvls))
+      return IM_ERR_FORMAT;
+
+    if (jas_stream_seek(this->stream, 0, SEEK_SET) < 0)
+      return IM_ERR_ACCESS;
+
+    ReadViewAttributes(image_width, image_height, &xmin, &ymin, &xmax, &ymax, &zoom_width, &zoom_height);
+
+    // discard the resolution levels that are not necessary for the view size
+    int reduce = 0;
+    while (reduce < numdlvls && 
+           (((xmax - xmin + 1) + (1 << (reduce+1)) - 1) >> (reduce+1)) >= zoom_width &&
+           (((ymax - ymin + 1) + (1 << (reduce+1)) - 1) >> (reduce+1)) >= zoom_height)
+      reduce++;
+
+    sprintf(options, "reduce=%d imgareatlx=%d imgareatly=%d imgareabrx=%d imgareabry=%d", 
+            reduce, xoff + xmin, yoff + ymin, xoff + xmax + 1, yoff + ymax + 1);
+  }
+
   // The counter is started because in Jasper all image reading is done here. BAD!
   ijp2_counter = this->counter;
   ijp2_abort = 0;
   ijp2_message = "Reading JP2...";
-  this->image = jas_image_decode(this->stream, this->fmtid, 0);
+  this->image = jas_image_decode(this->stream, this->fmtid, options);
   ijp2_counter = -1;
   if (!this->image)
     return IM_ERR_ACCESS;
@@ -243,6 +398,28 @@ int imFileFormatJP2::ReadImageInfo(int index)
   this->width = jas_image_width(this->image);
   this->height = jas_image_height(this->image);
 
+  this->view_xmin = 0;
+  this->view_ymin = 0;
+  this->view_width = this->width;
+  this->view_height = this->height;
+
+  if (has_view)
+  {
+    // map the view limits to the decoded resolution
+    this->view_xmin = (int)(((double)xmin * this->width) / image_width);
+    this->view_ymin = (int)(((double)ymin * this->height) / image_height);
+    int view_xmax = (int)ceil(((double)(xmax + 1) * this->width) / image_width);
+    int view_ymax = (int)ceil(((double)(ymax + 1) * this->height) / image_height);
+    if (view_xmax > this->width) view_xmax = this->width;
+    if (view_ymax > this->height) view_ymax = this->height;
+    this->view_width = view_xmax - this->view_xmin;
+    this->view_height = view_ymax - this->view_ymin;
+
+    // After reading the width and height returned is the view size
+    this->width = zoom_width;
+    this->height = zoom_height;
+  }
+
   int clrspc_fam = jas_clrspc_fam(jas_image_clrspc(image));
   switch(clrspc_fam)
   {
@@ -394,6 +571,27 @@ int imFileFormatJP2::ReadImageData(void* data)
 
   imCounterTotal(this->counter, count, NULL);
 
+  int max_cps = 1;
+  for (int c = 0; c < jas_image_numcmpts(image); c++)
+  {
+    if (image->cmpts_[c]->cps_ > max_cps)
+      max_cps = image->cmpts_[c]->cps_;
+  }
+
+  this->cmpt_buffer = (unsigned char*)realloc(this->cmpt_buffer, this->view_width * max_cps);
+  if (!this->cmpt_buffer)
+    return IM_ERR_MEM;
+
+  if (this->view_width != this->width)
+  {
+    this->view_xmap = (int*)realloc(this->view_xmap, this->width * sizeof(int));
+    if (!this->view_xmap)
+      return IM_ERR_MEM;
+
+    for (int x = 0; x < this->width; x++)
+      this->view_xmap[x] = (int)(((double)x * this->view_width) / this->width);
+  }
+
   int alpha_plane = -1;
   if (imColorModeHasAlpha(this->user_color_mode) && imColorModeHasAlpha(this->file_color_mode))
     alpha_plane = imColorModeDepth(this->file_color_mode) - 1;
@@ -410,11 +608,21 @@ int imFileFormatJP2::ReadImageData(void* data)
     if (cmpno == -1)
       return IM_ERR_DATA;
 
+    int view_lin = this->view_ymin;
+    if (this->view_height == this->height)
+      view_lin += lin;
+    else
+      view_lin += (int)(((double)lin * this->view_height) / this->height);
+
+    int* xmap = (this->view_width != this->width)? this->view_xmap: NULL;
+
     int ret = 1;
     if (this->file_data_type == IM_BYTE)
-      ret = iJP2ReadLine(image, lin, cmpno, (imbyte*)this->line_buffer);
+      ret = iJP2ReadLine(image, view_lin, cmpno, (imbyte*)this->line_buffer, this->view_xmin, this->view_width, 
+                         xmap, this->width, this->cmpt_buffer);
     else
-      ret = iJP2ReadLine(image, lin, cmpno, (imushort*)this->line_buffer);
+      ret = iJP2ReadLine(image, view_lin, cmpno, (imushort*)this->line_buffer, this->view_xmin, this->view_width, 
+                         xmap, this->width, this->cmpt_buffer);
 
     if (!ret)
       return IM_ERR_ACCESS;
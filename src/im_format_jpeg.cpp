@@ -299,13 +299,21 @@ class imFileFormatJPEG: public imFileFormatBase
   int fix_adobe_cmyk;
 
 #ifdef USE_EXIF
+  unsigned char* exif_data;  /* copy of the APP1 marker, decoded only when attributes are accessed */
+  int exif_data_length;
+
   void iReadExifAttrib(unsigned char* data, int data_length, imAttribTable* attrib_table);
   void iWriteExifAttrib(imAttribTable* attrib_table);
 #endif
 
 public:
+#ifdef USE_EXIF
+  imFileFormatJPEG(const imFormat* _iformat): imFileFormatBase(_iformat), exif_data(NULL), exif_data_length(0) {}
+  ~imFileFormatJPEG() { if (exif_data) free(exif_data); }
+#else
   imFileFormatJPEG(const imFormat* _iformat): imFileFormatBase(_iformat) {}
   ~imFileFormatJPEG() {}
+#endif
 
   int Open(const char* file_name);
   int New(const char* file_name);
@@ -315,6 +323,9 @@ public:
   int ReadImageData(void* data);
   int WriteImageInfo();
   int WriteImageData(void* data);
+#ifdef USE_EXIF
+  void ReadPendingAttributes();
+#endif
 };
 
 class imFormatJPEG: public imFormat
@@ -445,6 +456,19 @@ void* imFileFormatJPEG::Handle(int index)
 }
 
 #ifdef USE_EXIF
+void imFileFormatJPEG::ReadPendingAttributes()
+{
+  this->pending_attributes = 0;
+
+  if (this->exif_data)
+  {
+    iReadExifAttrib(this->exif_data, this->exif_data_length, AttribTable());
+    free(this->exif_data);
+    this->exif_data = NULL;
+    this->exif_data_length = 0;
+  }
+}
+
 void imFileFormatJPEG::iReadExifAttrib(unsigned char* data, int data_length, imAttribTable* attrib_table)
 {
   ExifData* exif = exif_data_new_from_data(data, data_length);
@@ -831,16 +855,40 @@ int imFileFormatJPEG::ReadImageInfo(int index)
   if (setjmp(this->jerr.setjmp_buffer)) 
     return IM_ERR_ACCESS;
 
-  // notify libjpeg to save the COM marker
+  imAttribTable* attrib_table = AttribTable();
+
+#ifdef USE_EXIF
+  if (this->exif_data)
+  {
+    free(this->exif_data);
+    this->exif_data = NULL;
+    this->pending_attributes = 0;
+  }
+#endif
+
+  // notify libjpeg to save the COM marker, 
+  // and the EXIF marker unless the user does not want it
+  int* skip_exif = (int*)attrib_table->Get("JPEGSkipExif");
   jpeg_save_markers(&this->dinfo, JPEG_COM, 0xFFFF);
-  jpeg_save_markers(&this->dinfo, JPEG_APP0+1, 0xFFFF);
+  if (!skip_exif || *skip_exif == 0)
+    jpeg_save_markers(&this->dinfo, JPEG_APP0+1, 0xFFFF);
 
   /* Step 3: read file parameters with jpeg_read_header() */
   if (jpeg_read_header(&this->dinfo, TRUE) != JPEG_HEADER_OK)
     return IM_ERR_ACCESS;
 
-  this->width = this->dinfo.image_width;
-  this->height = this->dinfo.image_height;
+  // reduced size decoding using the scaled IDCT
+  int* scale = (int*)attrib_table->Get("JPEGScale");
+  if (scale && (*scale == 2 || *scale == 4 || *scale == 8))
+  {
+    this->dinfo.scale_num = 1;
+    this->dinfo.scale_denom = *scale;
+  }
+
+  jpeg_calc_output_dimensions(&this->dinfo);
+
+  this->width = this->dinfo.output_width;
+  this->height = this->dinfo.output_height;
   this->file_data_type = IM_BYTE;
 
   switch(this->dinfo.jpeg_color_space)
@@ -869,8 +917,6 @@ int imFileFormatJPEG::ReadImageInfo(int index)
     return IM_ERR_DATA;
   }
 
-  imAttribTable* attrib_table = AttribTable();
-
   int* auto_ycbcr = (int*)attrib_table->Get("AutoYCbCr");
   if (auto_ycbcr && *auto_ycbcr == 0 &&
       this->dinfo.jpeg_color_space == JCS_YCbCr)
@@ -921,8 +967,19 @@ int imFileFormatJPEG::ReadImageInfo(int index)
       }
       
 #ifdef USE_EXIF
-      if (cur_marker->marker == JPEG_APP0+1)
-        iReadExifAttrib(cur_marker->data, cur_marker->data_length, attrib_table);
+      // EXIF is decoded only if the attributes are accessed, 
+      // the marker data is released by libjpeg so keep a copy
+      if (cur_marker->marker == JPEG_APP0+1 && !this->exif_data &&
+          cur_marker->data_length > 6 && memcmp(cur_marker->data, "Exif\0\0", 6) == 0)
+      {
+        this->exif_data = (unsigned char*)malloc(cur_marker->data_length);
+        if (this->exif_data)
+        {
+          memcpy(this->exif_data, cur_marker->data, cur_marker->data_length);
+          this->exif_data_length = cur_marker->data_length;
+          this->pending_attributes = 1;
+        }
+      }
 #endif
 
       cur_marker = cur_marker->next;
@@ -1038,6 +1095,28 @@ static void iFixAdobeCMYK(unsigned char* line_buffer, int width)
   }
 }
 
+static int iJPEGDirectLayout(imFile* ifile)
+{
+  /* the decoded lines can be stored directly in the user buffer
+     if there is no data type, alpha or color space conversion.
+     Returns 1 if the layout is the same, 2 if the user wants unpacked data. */
+
+  if (ifile->convert_bpp || ifile->switch_type || ifile->user_data_type != IM_BYTE)
+    return 0;
+
+  if (ifile->line_band)  /* there is no user buffer, see imFileReadImageLines */
+    return 0;
+
+  if ((ifile->file_color_mode & 0x3FF) == (ifile->user_color_mode & 0x3FF))  // ignore bottom up
+    return 1;
+
+  if (imColorModeSpace(ifile->file_color_mode) == imColorModeSpace(ifile->user_color_mode) &&
+      !imColorModeIsPacked(ifile->user_color_mode) && !imColorModeHasAlpha(ifile->user_color_mode))
+    return 2;
+
+  return 0;
+}
+
 int imFileFormatJPEG::ReadImageData(void* data)
 {
   if (setjmp(this->jerr.setjmp_buffer)) 
@@ -1045,6 +1124,49 @@ int imFileFormatJPEG::ReadImageData(void* data)
 
   imCounterTotal(this->counter, this->dinfo.output_height, "Reading JPEG...");
 
+  int direct = this->fix_adobe_cmyk? 0: iJPEGDirectLayout(this);
+  if (direct == 2 && !jpeg_set_planar_output(&this->dinfo, (size_t)this->width*this->height))
+    direct = 0;
+
+  if (direct)
+  {
+    /* decode straight to the user buffer, 
+       unpacked data is written by libJPEG directly in each plane */
+    int line_size = this->width;
+    if (direct == 1 && imColorModeIsPacked(this->user_color_mode))
+      line_size *= imColorModeDepth(this->user_color_mode);
+    int invert = imColorModeIsTopDown(this->file_color_mode) != imColorModeIsTopDown(this->user_color_mode);
+
+    JSAMPROW rows[16];
+    while (this->dinfo.output_scanline < this->dinfo.output_height) 
+    {
+      int count = IM_MIN((int)(this->dinfo.output_height - this->dinfo.output_scanline), 16);
+      for (int i = 0; i < count; i++)
+      {
+        int lin = this->dinfo.output_scanline + i;
+        if (invert)
+          lin = this->height-1 - lin;
+        rows[i] = (JSAMPROW)data + lin*line_size;
+      }
+
+      count = jpeg_read_scanlines(&this->dinfo, rows, count);
+      if (count == 0)
+        return IM_ERR_ACCESS;
+
+      for (int i = 0; i < count; i++)
+      {
+        if (!imCounterInc(this->counter))
+        {
+          jpeg_finish_decompress(&this->dinfo);
+          return IM_ERR_COUNTER;
+        }
+      }
+    }
+
+    jpeg_finish_decompress(&this->dinfo);
+    return IM_ERR_NONE;
+  }
+
   int lin = 0, plane = 0;
   while (this->dinfo.output_scanline < this->dinfo.output_height) 
   {
@@ -1119,3 +1241,401 @@ int imFormatJPEG::CanWrite(const char* compression, int color_mode, int data_typ
   return IM_ERR_NONE;
 }
 
+
+/* Lossless transformations in the DCT coefficient domain */
+
+static int iJPEGTransformMirrorX(int transform)
+{
+  return transform == IM_JPEG_FLIP_H || transform == IM_JPEG_ROT180 ||
+         transform == IM_JPEG_ROT270 || transform == IM_JPEG_TRANSVERSE;
+}
+
+static int iJPEGTransformMirrorY(int transform)
+{
+  return transform == IM_JPEG_FLIP_V || transform == IM_JPEG_ROT180 ||
+         transform == IM_JPEG_ROT90 || transform == IM_JPEG_TRANSVERSE;
+}
+
+static int iJPEGTransformSwapXY(int transform)
+{
+  return transform == IM_JPEG_TRANSPOSE || transform == IM_JPEG_ROT90 ||
+         transform == IM_JPEG_ROT270 || transform == IM_JPEG_TRANSVERSE;
+}
+
+static void iJPEGTransformBlock(JCOEFPTR src, JCOEFPTR dst, int transform)
+{
+  /* Mirroring a block negates the odd frequencies along the mirrored axis. 
+     Transposing a block transposes the coefficients. */
+  int i, j;
+  for (i = 0; i < DCTSIZE; i++)
+  {
+    for (j = 0; j < DCTSIZE; j++)
+    {
+      switch (transform)
+      {
+      case IM_JPEG_FLIP_H:
+        dst[i*DCTSIZE + j] = (j & 1)? -src[i*DCTSIZE + j]: src[i*DCTSIZE + j];
+        break;
+      case IM_JPEG_FLIP_V:
+        dst[i*DCTSIZE + j] = (i & 1)? -src[i*DCTSIZE + j]: src[i*DCTSIZE + j];
+        break;
+      case IM_JPEG_ROT180:
+        dst[i*DCTSIZE + j] = ((i + j) & 1)? -src[i*DCTSIZE + j]: src[i*DCTSIZE + j];
+        break;
+      case IM_JPEG_TRANSPOSE:
+        dst[i*DCTSIZE + j] = src[j*DCTSIZE + i];
+        break;
+      case IM_JPEG_ROT90:
+        dst[i*DCTSIZE + j] = (j & 1)? -src[j*DCTSIZE + i]: src[j*DCTSIZE + i];
+        break;
+      case IM_JPEG_ROT270:
+        dst[i*DCTSIZE + j] = (i & 1)? -src[j*DCTSIZE + i]: src[j*DCTSIZE + i];
+        break;
+      case IM_JPEG_TRANSVERSE:
+        dst[i*DCTSIZE + j] = ((i + j) & 1)? -src[j*DCTSIZE + i]: src[j*DCTSIZE + i];
+        break;
+      default:
+        dst[i*DCTSIZE + j] = src[i*DCTSIZE + j];
+        break;
+      }
+    }
+  }
+}
+
+static int iJPEGDivRoundUp(int a, int b)
+{
+  return (a + b - 1) / b;
+}
+
+static int iJPEGRoundUp(int a, int b)
+{
+  return iJPEGDivRoundUp(a, b) * b;
+}
+
+static void iJPEGTransformSrcBlock(int transform, int dx, int dy, int src_w, int src_h, int *sx, int *sy)
+{
+  switch (transform)
+  {
+  case IM_JPEG_FLIP_H:     *sx = src_w-1 - dx; *sy = dy;           break;
+  case IM_JPEG_FLIP_V:     *sx = dx;           *sy = src_h-1 - dy; break;
+  case IM_JPEG_ROT180:     *sx = src_w-1 - dx; *sy = src_h-1 - dy; break;
+  case IM_JPEG_TRANSPOSE:  *sx = dy;           *sy = dx;           break;
+  case IM_JPEG_ROT90:      *sx = dy;           *sy = src_h-1 - dx; break;
+  case IM_JPEG_ROT270:     *sx = src_w-1 - dy; *sy = dx;           break;
+  case IM_JPEG_TRANSVERSE: *sx = src_w-1 - dy; *sy = src_h-1 - dx; break;
+  default:                 *sx = dx;           *sy = dy;           break;
+  }
+}
+
+static void iJPEGResetExifOrientation(unsigned char* data, int data_length)
+{
+  /* "Exif\0\0" + TIFF header + IFD0 */
+  if (data_length < 14 || memcmp(data, "Exif\0\0", 6) != 0)
+    return;
+
+  unsigned char* tiff = data + 6;
+  int tiff_length = data_length - 6;
+  int motorola = (tiff[0] == 'M');
+
+#define iEXIF_GET16(_p) (motorola? ((_p)[0] << 8) | (_p)[1]: ((_p)[1] << 8) | (_p)[0])
+#define iEXIF_GET32(_p) (motorola? ((_p)[0] << 24) | ((_p)[1] << 16) | ((_p)[2] << 8) | (_p)[3]: \
+                                   ((_p)[3] << 24) | ((_p)[2] << 16) | ((_p)[1] << 8) | (_p)[0])
+
+  int offset = iEXIF_GET32(tiff + 4);
+  if (offset < 8 || offset + 2 > tiff_length)
+    return;
+
+  int count = iEXIF_GET16(tiff + offset);
+  unsigned char* entry = tiff + offset + 2;
+  for (int i = 0; i < count && (entry + 12) - tiff <= tiff_length; i++, entry += 12)
+  {
+    if (iEXIF_GET16(entry) == 0x0112 && iEXIF_GET16(entry + 2) == 3)  /* Orientation, SHORT */
+    {
+      entry[8] = motorola? 0: 1;
+      entry[9] = motorola? 1: 0;
+      break;
+    }
+  }
+
+#undef iEXIF_GET16
+#undef iEXIF_GET32
+}
+
+static void iJPEGCopyMarkers(j_decompress_ptr dinfo, j_compress_ptr cinfo, int transform)
+{
+  jpeg_saved_marker_ptr marker = dinfo->marker_list;
+  while (marker)
+  {
+    /* JFIF and Adobe markers are written by libjpeg */
+    if (!(cinfo->write_JFIF_header && marker->marker == JPEG_APP0 &&
+          marker->data_length >= 5 && memcmp(marker->data, "JFIF", 5) == 0) &&
+        !(cinfo->write_Adobe_marker && marker->marker == JPEG_APP0+14 &&
+          marker->data_length >= 5 && memcmp(marker->data, "Adobe", 5) == 0))
+    {
+      if (transform != IM_JPEG_NONE && marker->marker == JPEG_APP0+1)
+        iJPEGResetExifOrientation(marker->data, marker->data_length);
+
+      jpeg_write_marker(cinfo, marker->marker, marker->data, marker->data_length);
+    }
+
+    marker = marker->next;
+  }
+}
+
+static void iJPEGTransposeCriticalParameters(j_compress_ptr cinfo)
+{
+  for (int ci = 0; ci < cinfo->num_components; ci++) 
+  {
+    jpeg_component_info* compptr = cinfo->comp_info + ci;
+    int samp = compptr->h_samp_factor;
+    compptr->h_samp_factor = compptr->v_samp_factor;
+    compptr->v_samp_factor = samp;
+  }
+
+  for (int tblno = 0; tblno < NUM_QUANT_TBLS; tblno++) 
+  {
+    JQUANT_TBL* qtblptr = cinfo->quant_tbl_ptrs[tblno];
+    if (qtblptr) 
+    {
+      for (int i = 0; i < DCTSIZE; i++) 
+      {
+        for (int j = 0; j < i; j++) 
+        {
+          UINT16 qtemp = qtblptr->quantval[i*DCTSIZE + j];
+          qtblptr->quantval[i*DCTSIZE + j] = qtblptr->quantval[j*DCTSIZE + i];
+          qtblptr->quantval[j*DCTSIZE + i] = qtemp;
+        }
+      }
+    }
+  }
+}
+
+struct iJPEGTransformData
+{
+  jpeg_decompress_struct dinfo;
+  jpeg_compress_struct cinfo;
+  JPEGerror_mgr jerr;
+  imBinFile* src_handle;
+  imBinFile* dst_handle;
+  int has_dinfo, has_cinfo;
+};
+
+static void iJPEGTransformRelease(iJPEGTransformData* tdata)
+{
+  if (tdata->has_cinfo) jpeg_destroy_compress(&tdata->cinfo);
+  if (tdata->has_dinfo) jpeg_destroy_decompress(&tdata->dinfo);
+  if (tdata->dst_handle) imBinFileClose(tdata->dst_handle);
+  if (tdata->src_handle) imBinFileClose(tdata->src_handle);
+  delete tdata;
+}
+
+int imFileJPEGTransform(const char* src_file_name, const char* dst_file_name, int transform, 
+                        int xmin, int ymin, int width, int height)
+{
+  iJPEGTransformData* tdata = new iJPEGTransformData;
+  memset(tdata, 0, sizeof(iJPEGTransformData));
+  j_decompress_ptr dinfo = &tdata->dinfo;
+  j_compress_ptr cinfo = &tdata->cinfo;
+
+  tdata->src_handle = imBinFileOpen(src_file_name);
+  if (!tdata->src_handle)
+  {
+    iJPEGTransformRelease(tdata);
+    return IM_ERR_OPEN;
+  }
+
+  unsigned char sig[2];
+  if (!imBinFileRead(tdata->src_handle, sig, 2, 1) || sig[0] != 0xFF || sig[1] != 0xD8)
+  {
+    iJPEGTransformRelease(tdata);
+    return IM_ERR_FORMAT;
+  }
+
+  imBinFileSeekTo(tdata->src_handle, 0);
+
+  dinfo->err = jpeg_std_error(&tdata->jerr.pub);
+  cinfo->err = dinfo->err;
+  tdata->jerr.pub.error_exit = JPEGerror_exit;
+  tdata->jerr.pub.output_message = JPEGoutput_message;
+  tdata->jerr.pub.emit_message = JPEGemit_message;
+
+  if (setjmp(tdata->jerr.setjmp_buffer)) 
+  {
+    iJPEGTransformRelease(tdata);
+    return IM_ERR_ACCESS;
+  }
+
+  jpeg_create_decompress(dinfo);
+  tdata->has_dinfo = 1;
+  jpeg_stdio_src(dinfo, (FILE*)tdata->src_handle);
+
+  jpeg_save_markers(dinfo, JPEG_COM, 0xFFFF);
+  for (int m = 0; m < 16; m++)
+    jpeg_save_markers(dinfo, JPEG_APP0+m, 0xFFFF);
+
+  if (jpeg_read_header(dinfo, TRUE) != JPEG_HEADER_OK)
+  {
+    iJPEGTransformRelease(tdata);
+    return IM_ERR_FORMAT;
+  }
+
+  jpeg_core_output_dimensions(dinfo);
+
+  if (dinfo->min_DCT_h_scaled_size != DCTSIZE || dinfo->min_DCT_v_scaled_size != DCTSIZE)
+  {
+    iJPEGTransformRelease(tdata);
+    return IM_ERR_DATA;
+  }
+
+  /* iMCU size in pixels */
+  int max_h_samp = dinfo->max_h_samp_factor, 
+      max_v_samp = dinfo->max_v_samp_factor;
+  int mcu_w = DCTSIZE, mcu_h = DCTSIZE;
+  if (dinfo->num_components > 1)
+  {
+    mcu_w *= max_h_samp;
+    mcu_h *= max_v_samp;
+  }
+
+  /* crop region, offsets aligned to the iMCU boundaries */
+  int img_w = (int)dinfo->output_width, 
+      img_h = (int)dinfo->output_height;
+  int x_crop = 0, y_crop = 0, crop_w = img_w, crop_h = img_h;
+  if (width > 0 && height > 0)
+  {
+    if (xmin < 0) xmin = 0;
+    if (ymin < 0) ymin = 0;
+    if (xmin >= img_w || ymin >= img_h)
+    {
+      iJPEGTransformRelease(tdata);
+      return IM_ERR_DATA;
+    }
+
+    x_crop = xmin / mcu_w;
+    y_crop = ymin / mcu_h;
+    crop_w = width + xmin % mcu_w;
+    crop_h = height + ymin % mcu_h;
+    if (crop_w > img_w - x_crop*mcu_w) crop_w = img_w - x_crop*mcu_w;
+    if (crop_h > img_h - y_crop*mcu_h) crop_h = img_h - y_crop*mcu_h;
+  }
+
+  /* partial iMCUs at the edges can not be mirrored, so they are trimmed */
+  if (iJPEGTransformMirrorX(transform))
+    crop_w = (crop_w / mcu_w) * mcu_w;
+  if (iJPEGTransformMirrorY(transform))
+    crop_h = (crop_h / mcu_h) * mcu_h;
+
+  if (crop_w == 0 || crop_h == 0)
+  {
+    iJPEGTransformRelease(tdata);
+    return IM_ERR_DATA;
+  }
+
+  int swap_xy = iJPEGTransformSwapXY(transform);
+  int ci, num_components = dinfo->num_components;
+
+  /* destination coefficient arrays must be requested before reading the source */
+  jvirt_barray_ptr* dst_coefs = (jvirt_barray_ptr*)(*dinfo->mem->alloc_small)((j_common_ptr)dinfo, JPOOL_IMAGE, 
+                                                                              sizeof(jvirt_barray_ptr) * num_components);
+  for (ci = 0; ci < num_components; ci++)
+  {
+    jpeg_component_info* compptr = dinfo->comp_info + ci;
+    int h_samp = compptr->h_samp_factor, 
+        v_samp = compptr->v_samp_factor;
+    int w_blocks = iJPEGRoundUp(iJPEGDivRoundUp(crop_w * h_samp, max_h_samp * DCTSIZE), h_samp);
+    int h_blocks = iJPEGRoundUp(iJPEGDivRoundUp(crop_h * v_samp, max_v_samp * DCTSIZE), v_samp);
+
+    if (swap_xy)
+      dst_coefs[ci] = (*dinfo->mem->request_virt_barray)((j_common_ptr)dinfo, JPOOL_IMAGE, FALSE,
+                                                         h_blocks, w_blocks, h_samp);
+    else
+      dst_coefs[ci] = (*dinfo->mem->request_virt_barray)((j_common_ptr)dinfo, JPOOL_IMAGE, FALSE,
+                                                         w_blocks, h_blocks, v_samp);
+  }
+
+  jvirt_barray_ptr* src_coefs = jpeg_read_coefficients(dinfo);
+
+  tdata->dst_handle = imBinFileNew(dst_file_name);
+  if (!tdata->dst_handle)
+  {
+    iJPEGTransformRelease(tdata);
+    return IM_ERR_OPEN;
+  }
+
+  jpeg_create_compress(cinfo);
+  tdata->has_cinfo = 1;
+  jpeg_stdio_dest(cinfo, (FILE*)tdata->dst_handle);
+
+  jpeg_copy_critical_parameters(dinfo, cinfo);
+
+  if (dinfo->progressive_mode)
+    jpeg_simple_progression(cinfo);
+
+  if (swap_xy)
+  {
+    cinfo->image_width = cinfo->jpeg_width = crop_h;
+    cinfo->image_height = cinfo->jpeg_height = crop_w;
+    iJPEGTransposeCriticalParameters(cinfo);
+  }
+  else
+  {
+    cinfo->image_width = cinfo->jpeg_width = crop_w;
+    cinfo->image_height = cinfo->jpeg_height = crop_h;
+  }
+
+  jpeg_write_coefficients(cinfo, dst_coefs);
+
+  iJPEGCopyMarkers(dinfo, cinfo, transform);
+
+  for (ci = 0; ci < num_components; ci++)
+  {
+    jpeg_component_info* src_compptr = dinfo->comp_info + ci;
+    jpeg_component_info* dst_compptr = cinfo->comp_info + ci;
+    int h_samp = src_compptr->h_samp_factor, 
+        v_samp = src_compptr->v_samp_factor;
+    int x_crop_blocks = (x_crop * mcu_w * h_samp) / (max_h_samp * DCTSIZE);
+    int y_crop_blocks = (y_crop * mcu_h * v_samp) / (max_v_samp * DCTSIZE);
+
+    /* size of the source region in blocks, exact along the mirrored axes */
+    int src_w = iJPEGDivRoundUp(crop_w * h_samp, max_h_samp * DCTSIZE);
+    int src_h = iJPEGDivRoundUp(crop_h * v_samp, max_v_samp * DCTSIZE);
+
+    /* the last iMCU row is read entirely by the encoder, so the padding rows must be defined */
+    int dst_h = iJPEGRoundUp(dst_compptr->height_in_blocks, dst_compptr->v_samp_factor);
+
+    for (int dy = 0; dy < dst_h; dy++)
+    {
+      JBLOCKROW dst_row = (*dinfo->mem->access_virt_barray)((j_common_ptr)dinfo, dst_coefs[ci], dy, 1, TRUE)[0];
+      JBLOCKROW src_row = NULL;
+
+      if (dy >= (int)dst_compptr->height_in_blocks)
+      {
+        memset(dst_row, 0, dst_compptr->width_in_blocks * sizeof(JBLOCK));
+        continue;
+      }
+      int src_row_y = -1;
+
+      for (int dx = 0; dx < (int)dst_compptr->width_in_blocks; dx++)
+      {
+        int sx, sy;
+        iJPEGTransformSrcBlock(transform, dx, dy, src_w, src_h, &sx, &sy);
+        sx += x_crop_blocks;
+        sy += y_crop_blocks;
+
+        if (sy != src_row_y)
+        {
+          src_row = (*dinfo->mem->access_virt_barray)((j_common_ptr)dinfo, src_coefs[ci], sy, 1, FALSE)[0];
+          src_row_y = sy;
+        }
+
+        iJPEGTransformBlock(src_row[sx], dst_row[dx], transform);
+      }
+    }
+  }
+
+  jpeg_finish_compress(cinfo);
+  jpeg_finish_decompress(dinfo);
+
+  iJPEGTransformRelease(tdata);
+  return IM_ERR_NONE;
+}
@@ -11,11 +11,13 @@
 #include "im_counter.h"
 
 #include "im_binfile.h"
+#include "im_thread.h"
 
 #include <stdlib.h>
 #include <string.h>
 
 #include "png.h"
+#include "zlib.h"
 
 
 static void png_user_read_fn(png_structp png_ptr, png_bytep buffer, png_size_t size)
@@ -50,10 +52,12 @@ class imFileFormatPNG: public imFileFormatBase
   png_infop info_ptr;
 
   imBinFile* handle;
-  int interlace_steps, fixbits;
+  int interlace_steps, fixbits, 
+      parallel, filters, zlib_level;
 
   void iReadAttrib(imAttribTable* attrib_table);
   void iWriteAttrib(imAttribTable* attrib_table);
+  int WriteParallelData(void* data);
 
 public:
   imFileFormatPNG(const imFormat* _iformat): imFileFormatBase(_iformat) {}
@@ -370,11 +374,15 @@ void imFileFormatPNG::iReadAttrib(imAttribTable* attrib_table)
   }
 }
 
-static int iAttribStringCount = 0;
+struct iPNGTextList
+{
+  png_text text[512];
+  int count;
+};
 
 static int iFindAttribString(void* user_data, int index, const char* name, int data_type, int count, const void* data)
 {
-  png_textp text_ptr = (png_textp)user_data;
+  iPNGTextList* text_list = (iPNGTextList*)user_data;
   (void)index;
 
   if (data_type == IM_BYTE && count > 3 && ((imbyte*)data)[count-1] == 0)
@@ -387,8 +395,11 @@ static int iFindAttribString(void* user_data, int index, const char* name, int d
         imStrEqual(name, "ICCProfile") ||
         imStrEqual(name, "ScaleUnit"))
       return 1;
+
+    if (text_list->count == 512)
+      return 0;
     
-    png_textp png_text = &text_ptr[iAttribStringCount];
+    png_textp png_text = &text_list->text[text_list->count];
 
     png_text->key = (char*)name;
     png_text->text = (char*)data;
@@ -399,7 +410,7 @@ static int iFindAttribString(void* user_data, int index, const char* name, int d
     else
       png_text->compression = PNG_TEXT_COMPRESSION_zTXt;
 
-    iAttribStringCount++;
+    text_list->count++;
   }
 
   return 1;
@@ -564,11 +575,12 @@ void imFileFormatPNG::iWriteAttrib(imAttribTable* attrib_table)
     }
   }
   
-  iAttribStringCount = 0;
-  png_text text_ptr[512];
-  attrib_table->ForEach(text_ptr, iFindAttribString);
-  if (iAttribStringCount)
-    png_set_text(png_ptr, info_ptr, text_ptr, iAttribStringCount);
+  // local list, so several files can be written at the same time
+  iPNGTextList text_list;
+  text_list.count = 0;
+  attrib_table->ForEach(&text_list, iFindAttribString);
+  if (text_list.count)
+    png_set_text(png_ptr, info_ptr, text_list.text, text_list.count);
 
   attrib_data = attrib_table->Get("DateTimeModified");
   if (attrib_data)
@@ -801,9 +813,43 @@ int imFileFormatPNG::WriteImageInfo()
     png_set_PLTE(png_ptr, info_ptr, pal, this->palette_count);
   }
 
+  this->zlib_level = Z_DEFAULT_COMPRESSION;
   int* quality = (int*)attrib_table->Get("ZIPQuality");
   if (quality)
+  {
     png_set_compression_level(png_ptr, *quality);
+    this->zlib_level = *quality;
+  }
+
+  /* same default as libPNG */
+  if (color_type == PNG_COLOR_TYPE_PALETTE || bit_depth < 8)
+    this->filters = PNG_FILTER_NONE;
+  else
+    this->filters = PNG_ALL_FILTERS;
+
+  const char* filter = (const char*)attrib_table->Get("PNGFilter");
+  if (filter)
+  {
+    if (imStrEqual(filter, "NONE"))
+      this->filters = PNG_FILTER_NONE;
+    else if (imStrEqual(filter, "SUB"))
+      this->filters = PNG_FILTER_SUB;
+    else if (imStrEqual(filter, "UP"))
+      this->filters = PNG_FILTER_UP;
+    else if (imStrEqual(filter, "AVERAGE"))
+      this->filters = PNG_FILTER_AVG;
+    else if (imStrEqual(filter, "PAETH"))
+      this->filters = PNG_FILTER_PAETH;
+    else if (imStrEqual(filter, "ADAPTIVE"))
+      this->filters = PNG_ALL_FILTERS;
+
+    png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, this->filters);
+  }
+
+  this->parallel = 0;
+  int* parallel = (int*)attrib_table->Get("PNGParallel");
+  if (parallel && *parallel && !interlace)
+    this->parallel = 1;
 
   iWriteAttrib(attrib_table);
 
@@ -907,8 +953,374 @@ int imFileFormatPNG::ReadImageData(void* data)
   return IM_ERR_NONE;
 }
 
+/* Parallel Encoding
+
+   The rows are filtered and split in bands of about IPNG_BAND_SIZE bytes.
+   Each band is compressed as an independent raw deflate stream, 
+   using the last 32Kb of the previous band as preset dictionary. 
+   All bands but the last end with a sync flush, so they can be simply concatenated. 
+   Then the zlib header and the combined Adler-32 checksum are added, 
+   and the result is a single valid IDAT stream. */
+
+#define IPNG_BAND_SIZE 131072
+#define IPNG_DICT_SIZE 32768
+
+static int iPNGFilterSum(const imbyte* buf, int size)
+{
+  /* libPNG heuristic: sum of the absolute values of the differences as signed bytes */
+  int sum = 0;
+  for (int i = 0; i < size; i++)
+    sum += buf[i] < 128? buf[i]: 256 - buf[i];
+  return sum;
+}
+
+static inline imbyte iPNGPaeth(int a, int b, int c)
+{
+  int p = b - c;
+  int pc = a - c;
+  int pa = p < 0? -p: p;
+  int pb = pc < 0? -pc: pc;
+  pc = (p + pc) < 0? -(p + pc): p + pc;
+
+  if (pa <= pb && pa <= pc)
+    return (imbyte)a;
+  else if (pb <= pc)
+    return (imbyte)b;
+  else
+    return (imbyte)c;
+}
+
+static void iPNGFilterRow(int filter, imbyte* dst, const imbyte* row, const imbyte* prev, int size, int bpp)
+{
+  int i;
+  switch (filter)
+  {
+  case PNG_FILTER_VALUE_NONE:
+    memcpy(dst, row, size);
+    break;
+  case PNG_FILTER_VALUE_SUB:
+    for (i = 0; i < bpp; i++)
+      dst[i] = row[i];
+    for (; i < size; i++)
+      dst[i] = (imbyte)(row[i] - row[i-bpp]);
+    break;
+  case PNG_FILTER_VALUE_UP:
+    for (i = 0; i < size; i++)
+      dst[i] = (imbyte)(row[i] - prev[i]);
+    break;
+  case PNG_FILTER_VALUE_AVG:
+    for (i = 0; i < bpp; i++)
+      dst[i] = (imbyte)(row[i] - (prev[i] >> 1));
+    for (; i < size; i++)
+      dst[i] = (imbyte)(row[i] - ((row[i-bpp] + prev[i]) >> 1));
+    break;
+  case PNG_FILTER_VALUE_PAETH:
+    for (i = 0; i < bpp; i++)
+      dst[i] = (imbyte)(row[i] - prev[i]);
+    for (; i < size; i++)
+      dst[i] = (imbyte)(row[i] - iPNGPaeth(row[i-bpp], prev[i], prev[i-bpp]));
+    break;
+  }
+}
+
+static void iPNGFilterBand(imbyte* dst, const imbyte* raw, const imbyte* zero, int row_size, int bpp, 
+                           int lin0, int lin1, int filters, imbyte* try_buf, imbyte* best_buf)
+{
+  for (int lin = lin0; lin < lin1; lin++)
+  {
+    const imbyte* row = raw + (size_t)lin*row_size;
+    const imbyte* prev = lin == 0? zero: row - row_size;
+    imbyte* out = dst + (size_t)lin*(row_size+1);
+    int best_filter = 0, best_sum = -1;
+
+    for (int f = PNG_FILTER_VALUE_NONE; f <= PNG_FILTER_VALUE_PAETH; f++)
+    {
+      if (!(filters & (PNG_FILTER_NONE << f)))
+        continue;
+
+      iPNGFilterRow(f, try_buf, row, prev, row_size, bpp);
+
+      if (filters == (PNG_FILTER_NONE << f)) /* only one filter, no need to compare */
+      {
+        best_filter = f;
+        imbyte* tmp = best_buf; best_buf = try_buf; try_buf = tmp;
+        break;
+      }
+
+      int sum = iPNGFilterSum(try_buf, row_size);
+      if (best_sum < 0 || sum < best_sum)
+      {
+        best_sum = sum;
+        best_filter = f;
+        imbyte* tmp = best_buf; best_buf = try_buf; try_buf = tmp;
+      }
+    }
+
+    out[0] = (imbyte)best_filter;
+    memcpy(out + 1, best_buf, row_size);
+  }
+}
+
+static int iPNGDeflateBand(const imbyte* src, int size, const imbyte* dict, int dict_size, int level, int strategy, int last,
+                           imbyte** out_buf, int* out_size, int offset)
+{
+  z_stream strm;
+  memset(&strm, 0, sizeof(z_stream));
+  if (deflateInit2(&strm, level, Z_DEFLATED, -MAX_WBITS, 8, strategy) != Z_OK)
+    return 0;
+
+  if (dict_size)
+    deflateSetDictionary(&strm, dict, dict_size);
+
+  /* offset reserves space for the zlib header, 4 bytes are reserved for the checksum */
+  int alloc = (int)deflateBound(&strm, size) + 16 + offset + 4;
+  imbyte* buf = (imbyte*)malloc(alloc);
+  if (!buf)
+  {
+    deflateEnd(&strm);
+    return 0;
+  }
+
+  strm.next_in = (Bytef*)src;
+  strm.avail_in = size;
+  strm.next_out = buf + offset;
+  strm.avail_out = alloc - offset - 4;
+
+  int flush = last? Z_FINISH: Z_SYNC_FLUSH;
+  for (;;)
+  {
+    int ret = deflate(&strm, flush);
+    if (ret == Z_STREAM_ERROR)
+      break;
+
+    if (last? ret == Z_STREAM_END: strm.avail_out != 0)
+    {
+      *out_buf = buf;
+      *out_size = offset + (int)strm.total_out;
+      deflateEnd(&strm);
+      return 1;
+    }
+
+    /* output buffer is full, must grow it */
+    int new_alloc = alloc * 2;
+    imbyte* new_buf = (imbyte*)realloc(buf, new_alloc);
+    if (!new_buf)
+      break;
+
+    buf = new_buf;
+    strm.next_out = buf + offset + strm.total_out;
+    strm.avail_out = new_alloc - offset - 4 - (int)strm.total_out;
+    alloc = new_alloc;
+  }
+
+  free(buf);
+  deflateEnd(&strm);
+  return 0;
+}
+
+/* Shared by all the bands of the image */
+struct iPNGBands
+{
+  imbyte *raw, *zero, *filtered;
+  imbyte** band_buf;
+  int* band_size;
+  uLong* band_adler;
+  int row_size, bpp, height, band_height, band_count;
+  int filters, level, strategy;
+  volatile int failed;
+};
+
+static void iPNGFilterTask(void* user_data, int b)
+{
+  iPNGBands* bands = (iPNGBands*)user_data;
+  int row_size = bands->row_size;
+  int lin0 = b*bands->band_height;
+  int lin1 = lin0 + bands->band_height;
+  if (lin1 > bands->height) lin1 = bands->height;
+
+  imbyte* tmp_buf = (imbyte*)malloc(2*row_size);
+  if (!tmp_buf)
+  {
+    imThreadAtomicSet(&bands->failed, 1);
+    return;
+  }
+
+  iPNGFilterBand(bands->filtered, bands->raw, bands->zero, row_size, bands->bpp, lin0, lin1, bands->filters, tmp_buf, tmp_buf + row_size);
+  free(tmp_buf);
+}
+
+static void iPNGDeflateTask(void* user_data, int b)
+{
+  iPNGBands* bands = (iPNGBands*)user_data;
+  int filtered_row_size = bands->row_size + 1;
+  size_t start = (size_t)b*bands->band_height*filtered_row_size;
+  int lin0 = b*bands->band_height;
+  int lin1 = lin0 + bands->band_height;
+  if (lin1 > bands->height) lin1 = bands->height;
+  int size = (lin1 - lin0)*filtered_row_size;
+
+  int dict_size = start < IPNG_DICT_SIZE? (int)start: IPNG_DICT_SIZE;
+  imbyte* filtered = bands->filtered;
+
+  bands->band_adler[b] = adler32(adler32(0L, Z_NULL, 0), filtered + start, size);
+
+  if (!iPNGDeflateBand(filtered + start, size, filtered + start - dict_size, dict_size, bands->level, bands->strategy, 
+                       b == bands->band_count-1, &bands->band_buf[b], &bands->band_size[b], b == 0? 2: 0))
+    imThreadAtomicSet(&bands->failed, 1);
+}
+
+int imFileFormatPNG::WriteParallelData(void* data)
+{
+  int bit_depth = png_get_bit_depth(png_ptr, info_ptr);
+  int channels = png_get_channels(png_ptr, info_ptr);
+  int row_size = (this->width*channels*bit_depth + 7) / 8;
+  int bpp = (channels*bit_depth + 7) / 8;
+  int band_height = IPNG_BAND_SIZE / (row_size+1);
+  if (band_height < 1) band_height = 1;
+  int band_count = (this->height + band_height-1) / band_height;
+  int filtered_row_size = row_size + 1;
+
+  imbyte* raw = (imbyte*)malloc((size_t)this->height*row_size + row_size);
+  imbyte* filtered = (imbyte*)malloc((size_t)this->height*filtered_row_size);
+  imbyte** band_buf = (imbyte**)calloc(band_count, sizeof(imbyte*));
+  int* band_size = (int*)malloc(band_count*sizeof(int));
+  uLong* band_adler = (uLong*)malloc(band_count*sizeof(uLong));
+  if (!raw || !filtered || !band_buf || !band_size || !band_adler)
+  {
+    free(raw); free(filtered); free(band_buf); free(band_size); free(band_adler);
+    return IM_ERR_MEM;
+  }
+
+  imCounterTotal(this->counter, this->height + band_count, "Writing PNG...");
+
+  /* modified between setjmp and a possible longjmp */
+  volatile int error = IM_ERR_NONE;
+  volatile int b;
+  int lin;
+
+  /* the line buffer is not thread safe, so the rows are collected first */
+  for (lin = 0; lin < this->height; lin++)
+  {
+    imFileLineBufferWrite(this, data, lin, 0);
+
+    imbyte* row = raw + (size_t)lin*row_size;
+    if (bit_depth == 16)
+    {
+      imushort* line_buffer = (imushort*)this->line_buffer;
+      for (int i = 0; i < row_size/2; i++)
+      {
+        row[2*i]   = (imbyte)(line_buffer[i] >> 8);  /* PNG is always big endian */
+        row[2*i+1] = (imbyte)(line_buffer[i] & 0xFF);
+      }
+    }
+    else
+      memcpy(row, this->line_buffer, row_size);
+
+    if (!imCounterInc(this->counter))
+    {
+      error = IM_ERR_COUNTER;
+      break;
+    }
+  }
+
+  if (error == IM_ERR_NONE)
+  {
+    imbyte* zero = raw + (size_t)this->height*row_size;  /* the line before the first */
+    memset(zero, 0, row_size);
+
+    iPNGBands bands;
+    bands.raw = raw;
+    bands.zero = zero;
+    bands.filtered = filtered;
+    bands.band_buf = band_buf;
+    bands.band_size = band_size;
+    bands.band_adler = band_adler;
+    bands.row_size = row_size;
+    bands.bpp = bpp;
+    bands.height = this->height;
+    bands.band_height = band_height;
+    bands.band_count = band_count;
+    bands.filters = this->filters;
+    bands.level = this->zlib_level;
+    bands.strategy = this->filters == PNG_FILTER_NONE? Z_DEFAULT_STRATEGY: Z_FILTERED;
+    bands.failed = 0;
+
+    /* the deflate of a band uses the filtered rows of the previous band as dictionary,
+       so all the bands are filtered before */
+    imThreadParallelFor(band_count, iPNGFilterTask, &bands);
+    if (!bands.failed)
+      imThreadParallelFor(band_count, iPNGDeflateTask, &bands);
+
+    if (bands.failed)
+      error = IM_ERR_MEM;
+  }
+
+  if (error == IM_ERR_NONE)
+  {
+    /* zlib header, 32Kb window */
+    int level = this->zlib_level;
+    if (level < 0) level = 6;
+    int flevel = level < 2? 0: (level < 6? 1: (level == 6? 2: 3));
+    int header = (0x78 << 8) | (flevel << 6);
+    if (header % 31)
+      header += 31 - (header % 31);
+    band_buf[0][0] = (imbyte)(header >> 8);
+    band_buf[0][1] = (imbyte)(header & 0xFF);
+
+    uLong adler = band_adler[0];
+    for (b = 1; b < band_count; b++)
+    {
+      int lin0 = b*band_height;
+      int lin1 = lin0 + band_height;
+      if (lin1 > this->height) lin1 = this->height;
+      adler = adler32_combine(adler, band_adler[b], (lin1 - lin0)*filtered_row_size);
+    }
+
+    imbyte* tail = band_buf[band_count-1] + band_size[band_count-1];
+    tail[0] = (imbyte)(adler >> 24);
+    tail[1] = (imbyte)(adler >> 16);
+    tail[2] = (imbyte)(adler >> 8);
+    tail[3] = (imbyte)(adler);
+    band_size[band_count-1] += 4;
+  }
+
+  if (setjmp(png_jmpbuf(this->png_ptr)))
+    error = IM_ERR_ACCESS;
+  else
+  {
+    if (error == IM_ERR_NONE)
+    {
+      for (b = 0; b < band_count; b++)
+      {
+        png_write_chunk(this->png_ptr, (png_const_bytep)"IDAT", band_buf[b], band_size[b]);
+
+        if (!imCounterInc(this->counter))
+        {
+          error = IM_ERR_COUNTER;
+          break;
+        }
+      }
+    }
+
+    /* png_write_end would not know about the IDAT chunks, 
+       and all the other chunks were already written by png_write_info. 
+       The file is always finished, even when aborted, like in the sequential write,
+       the returned error reports that the image data is incomplete. */
+    png_write_chunk(this->png_ptr, (png_const_bytep)"IEND", NULL, 0);
+  }
+
+  for (b = 0; b < band_count; b++)
+    free(band_buf[b]);
+  free(raw); free(filtered); free(band_buf); free(band_size); free(band_adler);
+
+  return error;
+}
+
 int imFileFormatPNG::WriteImageData(void* data)
 {
+  if (this->parallel)
+    return WriteParallelData(data);
+
   if (setjmp(png_jmpbuf(this->png_ptr)))
     return IM_ERR_ACCESS;
 
@@ -297,19 +297,27 @@ int imFileFormatPNM::ReadImageData(void* data)
   else
     line_raw_size = imImageLineSize(this->width, this->file_color_mode, this->file_data_type);
 
-  int ascii = 0;
+  int* ascii_values = NULL;
   if (this->image_type == '1' || this->image_type == '2' || this->image_type == '3')
-    ascii = 1;
+  {
+    ascii_values = (int*)malloc(line_count * sizeof(int));
+    if (!ascii_values)
+      return IM_ERR_MEM;
+  }
 
   for (int lin = 0; lin < this->height; lin++)
   {
-    if (ascii)
+    if (ascii_values)
     {
-      int value;
+      if (!imBinFileReadIntegerArray(handle, ascii_values, line_count))
+      {
+        free(ascii_values);
+        return IM_ERR_ACCESS;
+      }
+
       for (int col = 0; col < line_count; col++)
       {
-        if (!imBinFileReadInteger(handle, &value))
-          return IM_ERR_ACCESS;
+        int value = ascii_values[col];
 
         if (this->image_type == '1' && value < 2)
           value = 1 - value;
@@ -334,9 +342,14 @@ int imFileFormatPNM::ReadImageData(void* data)
     imFileLineBufferRead(this, data, lin, 0);
 
     if (!imCounterInc(this->counter))
+    {
+      if (ascii_values) free(ascii_values);
       return IM_ERR_COUNTER;
+    }
   }
 
+  if (ascii_values) free(ascii_values);
+
   // try to find another image, ignore errors from here
 
   /* reads the PNM format identifier */
@@ -373,17 +386,20 @@ int imFileFormatPNM::WriteImageData(void* data)
   else
     line_raw_size = imImageLineSize(this->width, this->file_color_mode, this->file_data_type);
 
-  int ascii = 0;
+  int* ascii_values = NULL;
   if (this->image_type == '1' || this->image_type == '2' || this->image_type == '3')
-    ascii = 1;
+  {
+    ascii_values = (int*)malloc(line_count * sizeof(int));
+    if (!ascii_values)
+      return IM_ERR_MEM;
+  }
 
   for (int lin = 0; lin < this->height; lin++)
   {
     imFileLineBufferWrite(this, data, lin, 0);
 
-    if (ascii)
+    if (ascii_values)
     {
-      int line_size = 0;
       for (int col = 0; col < line_count; col++)
       {
         int value;
@@ -395,18 +411,14 @@ int imFileFormatPNM::WriteImageData(void* data)
         if (this->image_type == '1' && value < 2)
           value = 1 - value;
 
-        int write_size = imBinFilePrintf(handle, "%d ", value);
-        if (!write_size)
-          return IM_ERR_ACCESS;
-
-        line_size += write_size;
+        ascii_values[col] = value;
+      }
 
-        // No line should be longer than 70 characters. 
-        if (line_size > 60 || col == line_count-1)
-        {
-          line_size = 0;
-          imBinFileWrite(handle, (void*)"\n", 1, 1);
-        }
+      // No line should be longer than 70 characters. 
+      if (!imBinFileWriteIntegerArray(handle, ascii_values, line_count, 60))
+      {
+        free(ascii_values);
+        return IM_ERR_ACCESS;
       }
     }
     else
@@ -417,13 +429,21 @@ int imFileFormatPNM::WriteImageData(void* data)
       imBinFileWrite(handle, this->line_buffer, line_raw_size, 1);
     }
 
+    int error = IM_ERR_NONE;
     if (imBinFileError(handle))
-      return IM_ERR_ACCESS;     
+      error = IM_ERR_ACCESS;
+    else if (!imCounterInc(this->counter))
+      error = IM_ERR_COUNTER;
 
-    if (!imCounterInc(this->counter))
-      return IM_ERR_COUNTER;
+    if (error)
+    {
+      if (ascii_values) free(ascii_values);
+      return error;
+    }
   }
 
+  if (ascii_values) free(ascii_values);
+
   return IM_ERR_NONE;
 }
 
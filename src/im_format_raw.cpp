@@ -29,6 +29,16 @@ class imFileFormatRAW: public imFileFormatBase
   int rgb16;
   void iRawFixRGB16();
 
+  /* fixed-stride frame sequence, frame_stride is 0 if not a sequence */
+  unsigned long frame_start;  
+  int frame_header, frame_stride, frame_read_ahead;
+  unsigned long iRawFrameOffset(int index) 
+    { return this->frame_start + (unsigned long)index * (unsigned long)this->frame_stride; }
+  int iRawFrameDataSize();
+  int iRawWriteZeros(int size);
+  int iRawCanReadDirect();
+  int iRawReadDirect(void* data);
+
   int iRawUpdateParam(int index);
 
 public:
@@ -91,6 +101,8 @@ int imFileFormatRAW::Open(const char* file_name)
 
   this->image_count = 1;  /* at least one image */
   this->padding = 0;
+  this->rgb16 = 0;
+  this->frame_stride = 0;
 
   return IM_ERR_NONE;
 }
@@ -102,6 +114,8 @@ int imFileFormatRAW::New(const char* file_name)
     return IM_ERR_OPEN;
 
   this->padding = 0;
+  this->rgb16 = 0;
+  this->frame_stride = 0;
 
   return IM_ERR_NONE;
 }
@@ -131,33 +145,50 @@ static int iCalcPad(int padding, int line_size)
   return padding - rest;
 }
 
-int imFileFormatRAW::iRawUpdateParam(int index)
+int imFileFormatRAW::iRawFrameDataSize()
 {
-  (void)index;
+  int line_size;
+  if (this->rgb16)
+    line_size = this->width * 2;  /* RGB packed in 2 bytes */
+  else
+  {
+    line_size = imImageLineSize(this->width, this->file_color_mode, this->file_data_type);
+    if (this->switch_type && (this->file_data_type == IM_FLOAT || this->file_data_type == IM_CFLOAT))
+      line_size *= 2;  /* from double to float */
+  }
 
+  int plane_count = 1;
+  if (!imColorModeIsPacked(this->file_color_mode))
+    plane_count = imColorModeDepth(this->file_color_mode);
+
+  return (line_size + this->padding) * this->height * plane_count;
+}
+
+int imFileFormatRAW::iRawUpdateParam(int index)
+{
   imAttribTable* attrib_table = AttribTable();
 
-  // update image count
+  // update image count, when writing it is the number of images written so far
   int* icount = (int*)attrib_table->Get("ImageCount");
-  if (icount)
-    this->image_count = *icount;
-  else
-    this->image_count = 1;
+  if (!this->is_new)
+  {
+    if (icount)
+      this->image_count = *icount;
+    else
+      this->image_count = 1;
+  }
 
   // update file byte order
   int* byte_order = (int*)attrib_table->Get("ByteOrder");
   if (byte_order)
     imBinFileByteOrder(this->handle, *byte_order);
 
-  // position at start offset, the default is at 0
+  // start offset, the default is 0
   int* start_offset = (int*)attrib_table->Get("StartOffset");
   if (!start_offset)
-    imBinFileSeekOffset(this->handle, 0);
+    this->frame_start = 0;
   else
-    imBinFileSeekOffset(this->handle, *start_offset);
-
-  if (imBinFileError(this->handle))
-    return IM_ERR_ACCESS;
+    this->frame_start = (unsigned long)*start_offset;
 
   int* stype = (int*)attrib_table->Get("SwitchType");
   if (stype)
@@ -192,6 +223,68 @@ int imFileFormatRAW::iRawUpdateParam(int index)
     }
   }
 
+  int* frame_header = (int*)attrib_table->Get("FrameHeader");
+  int* frame_padding = (int*)attrib_table->Get("FramePadding");
+  int* frame_size = (int*)attrib_table->Get("FrameSize");
+  if (!frame_header && !frame_padding && !frame_size)
+  {
+    // not a sequence, skip "StartOffset" from the current position
+    this->frame_stride = 0;
+    imBinFileSeekOffset(this->handle, (long)this->frame_start);
+    if (imBinFileError(this->handle))
+      return IM_ERR_ACCESS;
+    return IM_ERR_NONE;
+  }
+
+  // fixed-stride frame sequence
+  if (imStrEqual(this->compression, "ASCII"))
+    return IM_ERR_COMPRESS;
+
+  this->frame_header = frame_header? *frame_header: 0;
+  int data_size = iRawFrameDataSize();
+  if (frame_size)
+    this->frame_stride = *frame_size;
+  else
+    this->frame_stride = this->frame_header + data_size + (frame_padding? *frame_padding: 0);
+
+  if (this->frame_header < 0 || data_size <= 0 || this->frame_stride < this->frame_header + data_size)
+    return IM_ERR_DATA;
+
+  if (!this->is_new)
+  {
+    if (!icount)
+    {
+      // count only complete frames
+      unsigned long file_size = imBinFileSize(this->handle);
+      if (file_size > this->frame_start)
+        this->image_count = (int)((file_size - this->frame_start) / (unsigned long)this->frame_stride);
+      else
+        this->image_count = 0;
+
+      if (this->image_count == 0)
+        return IM_ERR_ACCESS;
+    }
+
+    if (index >= this->image_count)
+      return IM_ERR_DATA;
+  }
+
+  imBinFileSeekTo(this->handle, iRawFrameOffset(index) + this->frame_header);
+  if (imBinFileError(this->handle))
+    return IM_ERR_ACCESS;
+
+  int* read_ahead = (int*)attrib_table->Get("FrameReadAhead");
+  this->frame_read_ahead = read_ahead? *read_ahead: 0;
+
+  if (!this->is_new && this->frame_read_ahead > 0)
+  {
+    // the current frame and the next frames
+    int last = index + this->frame_read_ahead;
+    if (last > this->image_count - 1) 
+      last = this->image_count - 1;
+    imBinFileReadAhead(this->handle, iRawFrameOffset(index), (unsigned long)(last - index + 1) * (unsigned long)this->frame_stride);
+  }
+
   return IM_ERR_NONE;
 }
 
@@ -205,7 +298,36 @@ int imFileFormatRAW::WriteImageInfo()
   this->file_color_mode = this->user_color_mode;
   this->file_data_type = this->user_data_type;
 
-  return iRawUpdateParam(this->image_count);
+  int error = iRawUpdateParam(this->image_count);
+  if (error)
+    return error;
+
+  if (this->frame_stride && this->frame_header)
+  {
+    // rewind to write the frame header
+    imBinFileSeekTo(this->handle, iRawFrameOffset(this->image_count));
+    if (!iRawWriteZeros(this->frame_header))
+      return IM_ERR_ACCESS;
+  }
+
+  return IM_ERR_NONE;
+}
+
+int imFileFormatRAW::iRawWriteZeros(int size)
+{
+  imbyte zeros[1024];
+  memset(zeros, 0, sizeof(zeros));
+
+  while (size > 0)
+  {
+    int n = size < (int)sizeof(zeros)? size: (int)sizeof(zeros);
+    imBinFileWrite(this->handle, zeros, n, 1);
+    if (imBinFileError(this->handle))
+      return 0;
+    size -= n;
+  }
+
+  return 1;
 }
 
 static int iFileDataTypeSize(int file_data_type, int switch_type)
@@ -259,8 +381,56 @@ void imFileFormatRAW::iRawFixRGB16()
   }
 }
 
+int imFileFormatRAW::iRawCanReadDirect()
+{
+  // the file lines have the same layout of the user data
+  return !imStrEqual(this->compression, "ASCII") &&
+         !this->rgb16 && !this->padding && !this->switch_type && !this->convert_bpp && !this->line_band &&
+         this->file_color_mode == this->user_color_mode &&
+         this->file_data_type == this->user_data_type;
+}
+
+int imFileFormatRAW::iRawReadDirect(void* data)
+{
+  int count = imFileLineBufferCount(this);
+  int line_size = imImageLineSize(this->width, this->file_color_mode, this->file_data_type);
+  int type_size = imDataTypeSize(this->file_data_type);
+
+  // treat complex as 2 real
+  if (this->file_data_type == IM_CFLOAT || this->file_data_type == IM_CDOUBLE)
+    type_size /= 2;
+
+  // read in blocks of lines of about 1Mb, so the counter is still updated
+  int block_count = (1024*1024) / line_size;
+  if (block_count < 1) block_count = 1;
+
+  imCounterTotal(this->counter, count, "Reading RAW...");
+
+  imbyte* bdata = (imbyte*)data;
+  for (int i = 0; i < count; i += block_count)
+  {
+    int lines = count - i < block_count? count - i: block_count;
+    unsigned long size = (unsigned long)lines * (unsigned long)line_size;
+
+    imBinFileRead(this->handle, bdata, size / type_size, type_size);
+
+    if (imBinFileError(this->handle))
+      return IM_ERR_ACCESS;
+
+    bdata += size;
+
+    if (!imCounterIncTo(this->counter, i + lines))
+      return IM_ERR_COUNTER;
+  }
+
+  return IM_ERR_NONE;
+}
+
 int imFileFormatRAW::ReadImageData(void* data)
 {
+  if (iRawCanReadDirect())
+    return iRawReadDirect(data);
+
   int count = imFileLineBufferCount(this);
   int line_count = imImageLineCount(this->width, this->file_color_mode);
   int type_size = iFileDataTypeSize(this->file_data_type, this->switch_type);
@@ -281,6 +451,18 @@ int imFileFormatRAW::ReadImageData(void* data)
   else
     ascii = 0;
 
+  int real = (this->file_data_type == IM_FLOAT || this->file_data_type == IM_CFLOAT || 
+              this->file_data_type == IM_DOUBLE || this->file_data_type == IM_CDOUBLE);
+
+  // the numbers are read directly in the line buffer when possible
+  void* ascii_values = NULL;
+  if (ascii && this->file_data_type != IM_INT && this->file_data_type != IM_DOUBLE && this->file_data_type != IM_CDOUBLE)
+  {
+    ascii_values = malloc(line_count * (real? sizeof(double): sizeof(int)));
+    if (!ascii_values)
+      return IM_ERR_MEM;
+  }
+
   imCounterTotal(this->counter, count, "Reading RAW...");
 
   int lin = 0, plane = 0;
@@ -288,38 +470,31 @@ int imFileFormatRAW::ReadImageData(void* data)
   {
     if (ascii)
     {
-      for (int col = 0; col < line_count; col++)
+      void* values = ascii_values? ascii_values: this->line_buffer;
+      int ok;
+      if (real)
+        ok = imBinFileReadRealArray(handle, (double*)values, line_count);
+      else
+        ok = imBinFileReadIntegerArray(handle, (int*)values, line_count);
+
+      if (!ok)
       {
-        if (this->file_data_type == IM_FLOAT || this->file_data_type == IM_CFLOAT)
-        {
-          double value;
-          if (!imBinFileReadReal(handle, &value))
-            return IM_ERR_ACCESS;
-
-          ((float*)this->line_buffer)[col] = (float)value;
-        }
-        else if (this->file_data_type == IM_DOUBLE || this->file_data_type == IM_CDOUBLE)
-        {
-          double value;
-          if (!imBinFileReadReal(handle, &value))
-            return IM_ERR_ACCESS;
+        if (ascii_values) free(ascii_values);
+        return IM_ERR_ACCESS;
+      }
 
-          ((double*)this->line_buffer)[col] = value;
-        }
-        else
+      if (ascii_values)
+      {
+        for (int col = 0; col < line_count; col++)
         {
-          int value;
-          if (!imBinFileReadInteger(handle, &value))
-            return IM_ERR_ACCESS;
-
-          if (this->file_data_type == IM_INT)
-            ((int*)this->line_buffer)[col] = value;
+          if (this->file_data_type == IM_FLOAT || this->file_data_type == IM_CFLOAT)
+            ((float*)this->line_buffer)[col] = (float)((double*)ascii_values)[col];
           else if (this->file_data_type == IM_SHORT)
-            ((short*)this->line_buffer)[col] = (short)value;
+            ((short*)this->line_buffer)[col] = (short)((int*)ascii_values)[col];
           else if (this->file_data_type == IM_USHORT)
-            ((imushort*)this->line_buffer)[col] = (imushort)value;
+            ((imushort*)this->line_buffer)[col] = (imushort)((int*)ascii_values)[col];
           else
-            ((imbyte*)this->line_buffer)[col] = (unsigned char)value;
+            ((imbyte*)this->line_buffer)[col] = (unsigned char)((int*)ascii_values)[col];
         }
       }
     }
@@ -337,7 +512,10 @@ int imFileFormatRAW::ReadImageData(void* data)
     imFileLineBufferRead(this, data, lin, plane);
 
     if (!imCounterInc(this->counter))
+    {
+      if (ascii_values) free(ascii_values);
       return IM_ERR_COUNTER;
+    }
 
     imFileLineBufferInc(this, &lin, &plane);
 
@@ -345,6 +523,8 @@ int imFileFormatRAW::ReadImageData(void* data)
       imBinFileSeekOffset(this->handle, this->padding);
   }
 
+  if (ascii_values) free(ascii_values);
+
   return IM_ERR_NONE;
 }
 
@@ -367,6 +547,18 @@ int imFileFormatRAW::WriteImageData(void* data)
   else
     ascii = 0;
 
+  int real = (this->file_data_type == IM_FLOAT || this->file_data_type == IM_CFLOAT || 
+              this->file_data_type == IM_DOUBLE || this->file_data_type == IM_CDOUBLE);
+
+  // the numbers are written directly from the line buffer when possible
+  void* ascii_values = NULL;
+  if (ascii && this->file_data_type != IM_INT && this->file_data_type != IM_DOUBLE && this->file_data_type != IM_CDOUBLE)
+  {
+    ascii_values = malloc(line_count * (real? sizeof(double): sizeof(int)));
+    if (!ascii_values)
+      return IM_ERR_MEM;
+  }
+
   imCounterTotal(this->counter, count, "Writing RAW...");
 
   int lin = 0, plane = 0;
@@ -376,40 +568,35 @@ int imFileFormatRAW::WriteImageData(void* data)
 
     if (ascii)
     {
-      for (int col = 0; col < line_count; col++)
+      if (ascii_values)
       {
-        if (this->file_data_type == IM_FLOAT || this->file_data_type == IM_CFLOAT)
+        for (int col = 0; col < line_count; col++)
         {
-          float value = ((float*)this->line_buffer)[col];
-
-          if (!imBinFilePrintf(handle, "%.9f ", value))
-            return IM_ERR_ACCESS;
-        }
-        else if (this->file_data_type == IM_DOUBLE || this->file_data_type == IM_CDOUBLE)
-        {
-          double value = ((double*)this->line_buffer)[col];
-
-          if (!imBinFilePrintf(handle, "%.18f ", value))
-            return IM_ERR_ACCESS;
-        }
-        else
-        {
-          int value;
-          if (this->file_data_type == IM_INT)
-            value = ((int*)this->line_buffer)[col];
+          if (this->file_data_type == IM_FLOAT || this->file_data_type == IM_CFLOAT)
+            ((double*)ascii_values)[col] = ((float*)this->line_buffer)[col];
           else if (this->file_data_type == IM_SHORT)
-            value = ((short*)this->line_buffer)[col];
+            ((int*)ascii_values)[col] = ((short*)this->line_buffer)[col];
           else if (this->file_data_type == IM_USHORT)
-            value = ((imushort*)this->line_buffer)[col];
+            ((int*)ascii_values)[col] = ((imushort*)this->line_buffer)[col];
           else
-            value = ((imbyte*)this->line_buffer)[col];
-
-          if (!imBinFilePrintf(handle, "%d ", value))
-            return IM_ERR_ACCESS;
+            ((int*)ascii_values)[col] = ((imbyte*)this->line_buffer)[col];
         }
       }
 
-      imBinFileWrite(handle, (void*)"\n", 1, 1);
+      void* values = ascii_values? ascii_values: this->line_buffer;
+      int ok;
+      if (this->file_data_type == IM_FLOAT || this->file_data_type == IM_CFLOAT)
+        ok = imBinFileWriteRealArray(handle, (double*)values, line_count, 9, 0);
+      else if (real)
+        ok = imBinFileWriteRealArray(handle, (double*)values, line_count, 18, 0);
+      else
+        ok = imBinFileWriteIntegerArray(handle, (int*)values, line_count, 0);
+
+      if (!ok)
+      {
+        if (ascii_values) free(ascii_values);
+        return IM_ERR_ACCESS;
+      }
     }
     else
     {
@@ -428,6 +615,13 @@ int imFileFormatRAW::WriteImageData(void* data)
       imBinFileSeekOffset(this->handle, this->padding);
   }
 
+  if (this->frame_stride)
+  {
+    // complete the frame, the next image can be appended at its end
+    if (!iRawWriteZeros(this->frame_stride - this->frame_header - iRawFrameDataSize()))
+      return IM_ERR_ACCESS;
+  }
+
   this->image_count++;
   return IM_ERR_NONE;
 }
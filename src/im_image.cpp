@@ -16,6 +16,7 @@
 #include "im_file.h"
 #include "im_color.h"
 #include "im_palette.h"
+#include "im_thread.h"
 
 
 int imImageCheckFormat(int color_mode, int data_type)
@@ -671,15 +672,219 @@ void imImageMakeGray(imImage *image)
 
 static void iLoadImageData(imFile* ifile, imImage* image, int *error, int bitmap)
 {
+  imFileReadPendingAttributes(ifile);
   iAttributeTableCopy(ifile->attrib_table, image->attrib_table);
   *error = imFileReadImageData(ifile, image->data[0], bitmap, image->has_alpha);
   if (image->color_space == IM_MAP)
     imFileGetPalette(ifile, image->palette, &image->palette_count);
 }
 
+static void iLoadImageFrame(imFile* ifile, int index, imImage* image, int *error, int bitmap)
+{
+  int width, height, color_mode, data_type;
+  *error = imFileReadImageInfo(ifile, index, &width, &height, &color_mode, &data_type);
+  if (*error) return; 
+
+  int color_space = bitmap? imColorModeToBitmap(color_mode): imColorModeSpace(color_mode);
+  if (bitmap) data_type = IM_BYTE;
+  
+  // check if we can reuse the data
+  if (image->width != width || 
+      image->height != height ||
+      image->depth != imColorModeDepth(color_space) ||
+      image->has_alpha != imColorModeHasAlpha(color_mode) ||
+      image->data_type != data_type) 
+  {
+    *error = IM_ERR_DATA;
+    return;
+  }
+
+  image->color_space = color_space;
+  iLoadImageData(ifile, image, error, bitmap);
+}
+
+/* Background prefetch of the next frame.
+   While "thread" is not NULL the worker owns the imFile and the "image" buffer,
+   the application thread only touches them after iFilePrefetchWait. */
+struct imFilePrefetch
+{
+  imFile* ifile;
+  imThread* thread;
+  imImage* image;       // internal buffer, receives the frame "index"
+  int index, bitmap, error;
+  volatile int cancel;
+  int counter;          // the file counter is disabled while prefetch is enabled
+};
+
+static void iFilePrefetchThread(void* user_data)
+{
+  imFilePrefetch* prefetch = (imFilePrefetch*)user_data;
+
+  if (imThreadAtomicGet(&prefetch->cancel))  // canceled before the worker started
+    prefetch->error = IM_ERR_COUNTER;
+  else
+    iLoadImageFrame(prefetch->ifile, prefetch->index, prefetch->image, &prefetch->error, prefetch->bitmap);
+}
+
+static void iFilePrefetchWait(imFilePrefetch* prefetch)
+{
+  if (prefetch->thread)
+  {
+    imThreadJoin(prefetch->thread);
+    prefetch->thread = NULL;
+
+    // the file is positioned after the prefetched frame, 
+    // so if it is requested again it must be read from the start
+    prefetch->ifile->image_index = -1;
+  }
+}
+
+static int iFilePrefetchMatch(const imImage* image1, const imImage* image2)
+{
+  return (image1->width == image2->width &&
+          image1->height == image2->height &&
+          image1->depth == image2->depth &&
+          image1->has_alpha == image2->has_alpha &&
+          image1->data_type == image2->data_type);
+}
+
+static int iFilePrefetchGet(imFilePrefetch* prefetch, int index, imImage* image, int bitmap)
+{
+  iFilePrefetchWait(prefetch);
+
+  imImage* buffer = prefetch->image;
+  if (!buffer || prefetch->index != index || prefetch->bitmap != bitmap || 
+      prefetch->error != IM_ERR_NONE || !iFilePrefetchMatch(buffer, image))
+    return 0;
+
+  prefetch->index = -1;
+
+  // copy the planes, the image data can be an application buffer (see imImageInit),
+  // the internal buffer is reused for the next prefetch
+  int depth = image->has_alpha? image->depth+1: image->depth;
+  for (int d = 0; d < depth; d++)
+    memcpy(image->data[d], buffer->data[d], image->plane_size);
+
+  image->color_space = buffer->color_space;
+  iAttributeTableCopy(buffer->attrib_table, image->attrib_table);
+  if (image->color_space == IM_MAP && image->palette && buffer->palette)
+  {
+    memcpy(image->palette, buffer->palette, 256*sizeof(long));
+    image->palette_count = buffer->palette_count;
+  }
+
+  return 1;
+}
+
+static void iFilePrefetchStart(imFilePrefetch* prefetch, int index, const imImage* image, int bitmap)
+{
+  prefetch->index = -1;
+
+  if (index >= prefetch->ifile->image_count)
+    return;
+
+  // the buffer is allocated only once for a sequence of frames of the same size
+  if (prefetch->image && !iFilePrefetchMatch(prefetch->image, image))
+  {
+    imImageDestroy(prefetch->image);
+    prefetch->image = NULL;
+  }
+
+  if (!prefetch->image)
+  {
+    imImage* buffer = imImageCreate(image->width, image->height, image->color_space, image->data_type);
+    if (!buffer)
+      return;
+
+    if (image->has_alpha)
+      imImageAddAlpha(buffer);
+
+    prefetch->image = buffer;
+    if (!iFilePrefetchMatch(buffer, image))
+      return;
+  }
+
+  prefetch->index = index;
+  prefetch->bitmap = bitmap;
+  prefetch->error = IM_ERR_NONE;
+  prefetch->cancel = 0;
+
+  prefetch->thread = imThreadCreate(iFilePrefetchThread, prefetch);
+  if (!prefetch->thread)
+    prefetch->index = -1;   // no threads, frames are simply loaded in the application thread
+}
+
+static void iFileLoadFrame(imFile* ifile, int index, imImage* image, int *error, int bitmap)
+{
+  imFilePrefetch* prefetch = (imFilePrefetch*)ifile->prefetch;
+  if (!prefetch)
+  {
+    iLoadImageFrame(ifile, index, image, error, bitmap);
+    return;
+  }
+
+  if (iFilePrefetchGet(prefetch, index, image, bitmap))
+    *error = IM_ERR_NONE;
+  else
+    iLoadImageFrame(ifile, index, image, error, bitmap);
+
+  if (*error == IM_ERR_NONE)
+    iFilePrefetchStart(prefetch, index+1, image, bitmap);
+}
+
+static void iFilePrefetchSync(imFile* ifile)
+{
+  // other loads can be mixed with frame loads, but not with the worker
+  if (ifile->prefetch)
+    iFilePrefetchWait((imFilePrefetch*)ifile->prefetch);
+}
+
+void imFilePrefetchFinish(imFile* ifile)
+{
+  imFilePrefetch* prefetch = (imFilePrefetch*)ifile->prefetch;
+
+  imThreadAtomicSet(&prefetch->cancel, 1);
+  iFilePrefetchWait(prefetch);
+
+  if (prefetch->image)
+    imImageDestroy(prefetch->image);
+
+  ifile->counter = prefetch->counter;
+  ifile->prefetch = NULL;
+  free(prefetch);
+}
+
+void imFileSetPrefetch(imFile* ifile, int prefetch)
+{
+  assert(ifile);
+
+  if (prefetch)
+  {
+    if (ifile->prefetch || ifile->is_new)
+      return;
+
+    imFilePrefetch* new_prefetch = (imFilePrefetch*)malloc(sizeof(imFilePrefetch));
+    if (!new_prefetch)
+      return;
+
+    memset(new_prefetch, 0, sizeof(imFilePrefetch));
+    new_prefetch->ifile = ifile;
+    new_prefetch->index = -1;
+
+    // the counter callback must not be called from the worker thread
+    new_prefetch->counter = ifile->counter;
+    ifile->counter = -1;
+
+    ifile->prefetch = new_prefetch;
+  }
+  else if (ifile->prefetch)
+    imFilePrefetchFinish(ifile);
+}
+
 imImage* imFileLoadImage(imFile* ifile, int index, int *error)
 {
   assert(ifile);
+  iFilePrefetchSync(ifile);
 
   int width, height, color_mode, data_type;
   *error = imFileReadImageInfo(ifile, index, &width, &height, &color_mode, &data_type);
@@ -703,29 +908,13 @@ imImage* imFileLoadImage(imFile* ifile, int index, int *error)
 void imFileLoadImageFrame(imFile* ifile, int index, imImage* image, int *error)
 {
   assert(ifile);
-
-  int width, height, color_mode, data_type;
-  *error = imFileReadImageInfo(ifile, index, &width, &height, &color_mode, &data_type);
-  if (*error) return; 
-  
-  // check if we can reuse the data
-  if (image->width != width || 
-      image->height != height ||
-      image->depth != imColorModeDepth(imColorModeSpace(color_mode)) ||
-      image->has_alpha != imColorModeHasAlpha(color_mode) ||
-      image->data_type != data_type) 
-  {
-    *error = IM_ERR_DATA;
-    return;
-  }
-
-  image->color_space = imColorModeSpace(color_mode);
-  iLoadImageData(ifile, image, error, 0);
+  iFileLoadFrame(ifile, index, image, error, 0);
 }
 
 imImage* imFileLoadBitmap(imFile* ifile, int index, int *error)
 {
   assert(ifile);
+  iFilePrefetchSync(ifile);
 
   int width, height, color_mode, data_type;
   *error = imFileReadImageInfo(ifile, index, &width, &height, &color_mode, &data_type);
@@ -749,30 +938,14 @@ imImage* imFileLoadBitmap(imFile* ifile, int index, int *error)
 void imFileLoadBitmapFrame(imFile* ifile, int index, imImage* image, int *error)
 {
   assert(ifile);
-
-  int width, height, color_mode, data_type;
-  *error = imFileReadImageInfo(ifile, index, &width, &height, &color_mode, &data_type);
-  if (*error) return; 
-  
-  // check if we can reuse the data
-  if (image->width != width || 
-      image->height != height ||
-      image->depth != imColorModeDepth(imColorModeToBitmap(color_mode)) ||
-      image->has_alpha != imColorModeHasAlpha(color_mode) ||
-      image->data_type != IM_BYTE) 
-  {
-    *error = IM_ERR_DATA;
-    return;
-  }
-
-  image->color_space = imColorModeToBitmap(color_mode);
-  iLoadImageData(ifile, image, error, 1);
+  iFileLoadFrame(ifile, index, image, error, 1);
 }
 
 imImage* imFileLoadImageRegion(imFile* ifile, int index, int bitmap, int *error, 
                           int xmin, int xmax, int ymin, int ymax, int width, int height)
 {
   assert(ifile);
+  iFilePrefetchSync(ifile);
 
   int color_mode, data_type;
   *error = imFileReadImageInfo(ifile, index, NULL, NULL, &color_mode, &data_type);
@@ -6,30 +6,32 @@
 
 
 #include <math.h>
+#include <stdlib.h>
 
 #include "im_util.h"
 
 
 #include "minilzo.h"
 
-/* Work-memory needed for compression. Allocate memory in units
+/* Work-memory needed for compression. It is allocated in units
 * of 'lzo_align_t' (instead of 'char') to make sure it is properly aligned.
+* It is allocated for each call so the functions can be used by several threads.
 */
-
-#define HEAP_ALLOC(var,size) \
-    lzo_align_t __LZO_MMODEL var [ ((size) + (sizeof(lzo_align_t) - 1)) / sizeof(lzo_align_t) ]
-
-static HEAP_ALLOC(wrkmem, LZO1X_1_MEM_COMPRESS);
-
 int imCompressDataLZO(const void* src_data, int src_size, void* dst_data, int dst_size)
 {
   lzo_uint dst_len = dst_size;
+  lzo_align_t* wrkmem;
 
   int ret = lzo_init();
   if (ret != LZO_E_OK)
     return 0;
 
+  wrkmem = (lzo_align_t*)malloc(LZO1X_1_MEM_COMPRESS + sizeof(lzo_align_t));
+  if (!wrkmem)
+    return 0;
+
   ret = lzo1x_1_compress((const lzo_bytep)src_data, src_size, (lzo_bytep)dst_data, &dst_len, wrkmem);
+  free(wrkmem);
   if (ret != LZO_E_OK)
     return 0;
 
@@ -44,7 +46,8 @@ int imCompressDataUnLZO(const void* src_data, int src_size, void* dst_data, int
   if (ret != LZO_E_OK)
     return 0;
 
-  ret = lzo1x_decompress((const lzo_bytep)src_data, src_size, (lzo_bytep)dst_data, &dst_len, wrkmem);
+  /* the safe version checks the destination size, decompression does not need work-memory */
+  ret = lzo1x_decompress_safe((const lzo_bytep)src_data, src_size, (lzo_bytep)dst_data, &dst_len, NULL);
   if (ret != LZO_E_OK)
     return 0;
 
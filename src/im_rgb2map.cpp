@@ -20,6 +20,7 @@
 #include "im_util.h"
 #include "im_convert.h"
 #include "im_counter.h"
+#include "im_thread.h"
 
 
 /* RANGE forces a to be in the range b..c (inclusive) */
@@ -179,28 +180,36 @@ typedef struct {
 } box;
 typedef box * boxptr;
 
-/* Local state for the IJG quantizer */
+/* Local state for the IJG quantizer, one for each conversion,
+   so several threads can convert at the same time. */
+typedef struct {
+  hist2d * histogram;	/* pointer to the 3D histogram array */
+  FSERRPTR fserrors;	/* accumulated-errors array */
+  int * error_limiter;	/* table for clamping the applied error */
+  int on_odd_lin;	/* flag to remember which line we are on */
+  imbyte* colormap[3];	/* selected colormap */
+  int num_colors;	/* number of selected colors */
+} quant_state;
 
-static hist2d * sl_histogram;	/* pointer to the 3D histogram array */
-static FSERRPTR sl_fserrors;	/* accumulated-errors array */
-static int * sl_error_limiter;	/* table for clamping the applied error */
-static int sl_on_odd_lin;	/* flag to remember which line we are on */
-static imbyte* sl_colormap[3];	/* selected colormap */
-static int sl_num_colors;	/* number of selected colors */
+/* Pixels counted by each partial histogram, and pixels in the image
+   to fill the whole inverse color map in parallel before mapping. */
+#define HIST_MIN_PIXELS  (256*1024)
+#define FILL_MIN_PIXELS  (HIST_C0_ELEMS*HIST_C1_ELEMS*HIST_C2_ELEMS)
 
 
-static void   slow_fill_histogram (imbyte*, imbyte*, imbyte*, int);
+static int    slow_fill_histogram (quant_state*, imbyte*, imbyte*, imbyte*, int);
 static boxptr find_biggest_color_pop (boxptr, int);
 static boxptr find_biggest_volume (boxptr, int);
-static void   update_box (boxptr);
-static int    median_cut (boxptr, int, int);
-static void   compute_color (boxptr, int);
-static void   slow_select_colors (int);
-static int    find_nearby_colors (int, int, int, imbyte []);
-static void   find_best_colors (int,int,int,int, imbyte [], imbyte []);
-static void   fill_inverse_cmap (int, int, int);
-static void   slow_map_pixels (imbyte*, imbyte*, imbyte*, int, int, imbyte*);
-static void   init_error_limit (void);
+static void   update_box (quant_state*, boxptr);
+static int    median_cut (quant_state*, boxptr, int, int);
+static void   compute_color (quant_state*, boxptr, int);
+static void   slow_select_colors (quant_state*, int);
+static int    find_nearby_colors (quant_state*, int, int, int, imbyte []);
+static void   find_best_colors (quant_state*, int,int,int,int, imbyte [], imbyte []);
+static void   fill_inverse_cmap (quant_state*, int, int, int);
+static void   fill_all_inverse_cmap (quant_state*);
+static void   slow_map_pixels (quant_state*, imbyte*, imbyte*, imbyte*, int, int, imbyte*);
+static int *  init_error_limit (void);
 
 
 /* Master control for slow quantizer. */
@@ -208,54 +217,64 @@ static int slow_quant(imbyte *red, imbyte *green, imbyte *blue, int w, int h, im
                       imbyte *rm, imbyte *gm, imbyte *bm, int descols)
 {
   size_t fs_arraysize = (w + 2) * (3 * sizeof(FSERROR));
+  quant_state qs;
   
   /* Allocate all the temporary storage needed */
-  init_error_limit();
-
-  sl_histogram = (hist2d *) malloc(sizeof(hist3d));
-  sl_fserrors = (FSERRPTR) malloc(fs_arraysize);
+  qs.error_limiter = init_error_limit();
+  qs.histogram = (hist2d *) malloc(sizeof(hist3d));
+  qs.fserrors = (FSERRPTR) malloc(fs_arraysize);
   
-  if (! sl_error_limiter || ! sl_histogram || ! sl_fserrors) 
+  if (! qs.error_limiter || ! qs.histogram || ! qs.fserrors) 
   {
-    if (sl_error_limiter) free(sl_error_limiter-255);
-    if (sl_fserrors) free(sl_fserrors);
-    if (sl_histogram) free(sl_histogram);
+    if (qs.error_limiter) free(qs.error_limiter-255);
+    if (qs.fserrors) free(qs.fserrors);
+    if (qs.histogram) free(qs.histogram);
     return 1;
   }
   
-  sl_colormap[0] = (imbyte*) rm;
-  sl_colormap[1] = (imbyte*) gm;
-  sl_colormap[2] = (imbyte*) bm;
+  qs.colormap[0] = (imbyte*) rm;
+  qs.colormap[1] = (imbyte*) gm;
+  qs.colormap[2] = (imbyte*) bm;
   
   /* Compute the color histogram */
-  slow_fill_histogram(red, green, blue, w*h);
+  if (slow_fill_histogram(&qs, red, green, blue, w*h))
+  {
+    free(qs.histogram);
+    free(qs.error_limiter-255);
+    free(qs.fserrors);
+    return 1;
+  }
   
   /* Select the colormap */
-  slow_select_colors(descols);
+  slow_select_colors(&qs, descols);
   
   /* Zero the histogram: now to be used as inverse color map */
-  memset(sl_histogram, 0, sizeof(hist3d));
+  memset(qs.histogram, 0, sizeof(hist3d));
+
+  /* For large images most of the cells will be used, 
+     so fill them all in parallel instead of on demand. */
+  if (w*h >= FILL_MIN_PIXELS && imThreadCount() > 1)
+    fill_all_inverse_cmap(&qs);
   
   /* Initialize the propagated errors to zero. */
-  memset(sl_fserrors, 0, fs_arraysize);
-  sl_on_odd_lin = 0;
+  memset(qs.fserrors, 0, fs_arraysize);
+  qs.on_odd_lin = 0;
   
   /* Map the image. */
-  slow_map_pixels(red, green, blue, w, h, map);
+  slow_map_pixels(&qs, red, green, blue, w, h, map);
   
   /* Release working memory. */
-  free(sl_histogram);
-  free(sl_error_limiter-255);
-  free(sl_fserrors);
+  free(qs.histogram);
+  free(qs.error_limiter-255);
+  free(qs.fserrors);
 
   return 0;
 }
 
 
-static void slow_fill_histogram (register imbyte *red, register imbyte *green, register imbyte *blue, int numpixels)
+static void count_histogram (hist2d * histogram, register imbyte *red, register imbyte *green, register imbyte *blue, int numpixels)
 {
   register histptr histp;
-  register hist2d * histogram = sl_histogram;
   
   memset(histogram, 0, sizeof(hist3d));
   
@@ -274,6 +293,88 @@ static void slow_fill_histogram (register imbyte *red, register imbyte *green, r
   }
 }
 
+/* Partial histograms, one for each part of the image */
+typedef struct {
+  hist2d ** partial;
+  int numpartial;
+  imbyte *red, *green, *blue;
+  int numpixels;
+} hist_parts;
+
+static void count_histogram_part (void* user_data, int index)
+{
+  hist_parts* parts = (hist_parts*)user_data;
+  int start = (int)(((double)parts->numpixels * index) / parts->numpartial);
+  int end = (int)(((double)parts->numpixels * (index+1)) / parts->numpartial);
+
+  count_histogram(parts->partial[index], parts->red + start, parts->green + start, parts->blue + start, end - start);
+}
+
+static void merge_histogram_part (void* user_data, int c0)
+{
+  hist_parts* parts = (hist_parts*)user_data;
+  histptr histp = & parts->partial[0][c0][0][0];
+  int i, p, count;
+
+  /* the counts saturate as if counted in a single histogram */
+  for (i = 0; i < HIST_C1_ELEMS*HIST_C2_ELEMS; i++)
+  {
+    count = histp[i];
+    for (p = 1; p < parts->numpartial; p++)
+      count += parts->partial[p][c0][0][i];
+    if (count > 0xFFFF)
+      count = 0xFFFF;
+    histp[i] = (histcell) count;
+  }
+}
+
+static int slow_fill_histogram (quant_state* qs, imbyte *red, imbyte *green, imbyte *blue, int numpixels)
+{
+  hist_parts parts;
+  int p, numpartial = numpixels / HIST_MIN_PIXELS;
+  int thread_count = imThreadCount();
+
+  if (numpartial > thread_count)
+    numpartial = thread_count;
+
+  if (numpartial <= 1)
+  {
+    count_histogram(qs->histogram, red, green, blue, numpixels);
+    return 0;
+  }
+
+  /* Each part of the image is counted in its own histogram, then they are added. */
+  parts.partial = (hist2d **) malloc(numpartial * sizeof(hist2d*));
+  if (!parts.partial)
+    return 1;
+
+  parts.partial[0] = qs->histogram;
+  for (p = 1; p < numpartial; p++)
+  {
+    parts.partial[p] = (hist2d *) malloc(sizeof(hist3d));
+    if (!parts.partial[p])
+    {
+      while (--p > 0) free(parts.partial[p]);
+      free(parts.partial);
+      return 1;
+    }
+  }
+
+  parts.numpartial = numpartial;
+  parts.red = red;
+  parts.green = green;
+  parts.blue = blue;
+  parts.numpixels = numpixels;
+
+  imThreadParallelFor(numpartial, count_histogram_part, &parts);
+  imThreadParallelFor(HIST_C0_ELEMS, merge_histogram_part, &parts);
+
+  for (p = 1; p < numpartial; p++)
+    free(parts.partial[p]);
+  free(parts.partial);
+  return 0;
+}
+
 
 static boxptr find_biggest_color_pop (boxptr boxlist, int numboxes)
 {
@@ -308,9 +409,9 @@ static boxptr find_biggest_volume (boxptr boxlist, int numboxes)
 }
 
 
-static void update_box (boxptr boxp)
+static void update_box (quant_state* qs, boxptr boxp)
 {
-  hist2d * histogram = sl_histogram;
+  hist2d * histogram = qs->histogram;
   histptr histp;
   int c0,c1,c2;
   int c0min,c0max,c1min,c1max,c2min,c2max;
@@ -406,7 +507,7 @@ have_c2max:
 }
 
 
-static int median_cut (boxptr boxlist, int numboxes, int desired_colors)
+static int median_cut (quant_state* qs, boxptr boxlist, int numboxes, int desired_colors)
 {
   int n,lb;
   int c0,c1,c2,cmax;
@@ -453,18 +554,18 @@ static int median_cut (boxptr boxlist, int numboxes, int desired_colors)
       break;
     }
     /* Update stats for boxes */
-    update_box(b1);
-    update_box(b2);
+    update_box(qs, b1);
+    update_box(qs, b2);
     numboxes++;
   }
   return numboxes;
 }
 
-static void compute_color (boxptr boxp, int icolor)
+static void compute_color (quant_state* qs, boxptr boxp, int icolor)
 {
   /* Current algorithm: mean weighted by pixels (not colors) */
   /* Note it is important to get the rounding correct! */
-  hist2d * histogram = sl_histogram;
+  hist2d * histogram = qs->histogram;
   histptr histp;
   int c0,c1,c2;
   int c0min,c0max,c1min,c1max,c2min,c2max;
@@ -491,13 +592,13 @@ static void compute_color (boxptr boxp, int icolor)
       }
     }
     
-    sl_colormap[0][icolor] = (imbyte) ((c0total + (total>>1)) / total);
-    sl_colormap[1][icolor] = (imbyte) ((c1total + (total>>1)) / total);
-    sl_colormap[2][icolor] = (imbyte) ((c2total + (total>>1)) / total);
+    qs->colormap[0][icolor] = (imbyte) ((c0total + (total>>1)) / total);
+    qs->colormap[1][icolor] = (imbyte) ((c1total + (total>>1)) / total);
+    qs->colormap[2][icolor] = (imbyte) ((c2total + (total>>1)) / total);
 }
 
 
-static void slow_select_colors (int descolors)
+static void slow_select_colors (quant_state* qs, int descolors)
 /* Master routine for color selection */
 {
   box boxlist[MAXNUMCOLORS];
@@ -513,13 +614,13 @@ static void slow_select_colors (int descolors)
   boxlist[0].c2min = 0;
   boxlist[0].c2max = 255 >> C2_SHIFT;
   /* Shrink it to actually-used volume and set its statistics */
-  update_box(& boxlist[0]);
+  update_box(qs, & boxlist[0]);
   /* Perform median-cut to produce final box list */
-  numboxes = median_cut(boxlist, numboxes, descolors);
+  numboxes = median_cut(qs, boxlist, numboxes, descolors);
   /* Compute the representative color for each box, fill colormap */
   for (i = 0; i < numboxes; i++)
-    compute_color(& boxlist[i], i);
-  sl_num_colors = numboxes;
+    compute_color(qs, & boxlist[i], i);
+  qs->num_colors = numboxes;
 }
 
 
@@ -537,9 +638,9 @@ static void slow_select_colors (int descolors)
 #define BOX_C2_SHIFT  (C2_SHIFT + BOX_C2_LOG)
 
 
-static int find_nearby_colors (int minc0, int minc1, int minc2, imbyte* colorlist)
+static int find_nearby_colors (quant_state* qs, int minc0, int minc1, int minc2, imbyte* colorlist)
 {
-  int numcolors = sl_num_colors;
+  int numcolors = qs->num_colors;
   int maxc0, maxc1, maxc2;
   int centerc0, centerc1, centerc2;
   int i, x, ncolors;
@@ -557,7 +658,7 @@ static int find_nearby_colors (int minc0, int minc1, int minc2, imbyte* colorlis
   
   for (i = 0; i < numcolors; i++) {
     /* We compute the squared-c0-distance term, then add in the other two. */
-    x = sl_colormap[0][i];
+    x = qs->colormap[0][i];
     if (x < minc0) {
       tdist = (x - minc0) * C0_SCALE;
       min_dist = tdist*tdist;
@@ -580,7 +681,7 @@ static int find_nearby_colors (int minc0, int minc1, int minc2, imbyte* colorlis
       }
     }
     
-    x = sl_colormap[1][i];
+    x = qs->colormap[1][i];
     if (x < minc1) {
       tdist = (x - minc1) * C1_SCALE;
       min_dist += tdist*tdist;
@@ -602,7 +703,7 @@ static int find_nearby_colors (int minc0, int minc1, int minc2, imbyte* colorlis
       }
     }
     
-    x = sl_colormap[2][i];
+    x = qs->colormap[2][i];
     if (x < minc2) {
       tdist = (x - minc2) * C2_SCALE;
       min_dist += tdist*tdist;
@@ -638,7 +739,7 @@ static int find_nearby_colors (int minc0, int minc1, int minc2, imbyte* colorlis
 }
 
 
-static void find_best_colors (int minc0, int minc1, int minc2, int numcolors,
+static void find_best_colors (quant_state* qs, int minc0, int minc1, int minc2, int numcolors,
                               imbyte* colorlist, imbyte* bestcolor)
 {
   int ic0, ic1, ic2;
@@ -666,11 +767,11 @@ static void find_best_colors (int minc0, int minc1, int minc2, int numcolors,
   for (i = 0; i < numcolors; i++) {
     icolor = colorlist[i];
     /* Compute (square of) distance from minc0/c1/c2 to this color */
-    inc0 = (minc0 - (int) sl_colormap[0][icolor]) * C0_SCALE;
+    inc0 = (minc0 - (int) qs->colormap[0][icolor]) * C0_SCALE;
     dist0 = inc0*inc0;
-    inc1 = (minc1 - (int) sl_colormap[1][icolor]) * C1_SCALE;
+    inc1 = (minc1 - (int) qs->colormap[1][icolor]) * C1_SCALE;
     dist0 += inc1*inc1;
-    inc2 = (minc2 - (int) sl_colormap[2][icolor]) * C2_SCALE;
+    inc2 = (minc2 - (int) qs->colormap[2][icolor]) * C2_SCALE;
     dist0 += inc2*inc2;
     /* Form the initial difference increments */
     inc0 = inc0 * (2 * STEP_C0) + STEP_C0 * STEP_C0;
@@ -706,9 +807,9 @@ static void find_best_colors (int minc0, int minc1, int minc2, int numcolors,
 }
 
 
-static void fill_inverse_cmap (int c0, int c1, int c2)
+static void fill_inverse_cmap (quant_state* qs, int c0, int c1, int c2)
 {
-  hist2d * histogram = sl_histogram;
+  hist2d * histogram = qs->histogram;
   int minc0, minc1, minc2;	/* lower left corner of update box */
   int ic0, ic1, ic2;
   register imbyte * cptr;	/* pointer into bestcolor[] array */
@@ -728,10 +829,10 @@ static void fill_inverse_cmap (int c0, int c1, int c2)
   minc1 = (c1 << BOX_C1_SHIFT) + ((1 << C1_SHIFT) >> 1);
   minc2 = (c2 << BOX_C2_SHIFT) + ((1 << C2_SHIFT) >> 1);
   
-  numcolors = find_nearby_colors(minc0, minc1, minc2, colorlist);
+  numcolors = find_nearby_colors(qs, minc0, minc1, minc2, colorlist);
   
   /* Determine the actually nearest colors. */
-  find_best_colors(minc0, minc1, minc2, numcolors, colorlist, bestcolor);
+  find_best_colors(qs, minc0, minc1, minc2, numcolors, colorlist, bestcolor);
   
   /* Save the best color numbers (plus 1) in the main cache array */
   c0 <<= BOX_C0_LOG;		/* convert ID back to base cell indexes */
@@ -749,7 +850,27 @@ static void fill_inverse_cmap (int c0, int c1, int c2)
 }
 
 
-static void slow_map_pixels (imbyte *red, imbyte *green, imbyte *blue, int width, int height, imbyte *map)
+/* Each update box writes only its own cells, so they can be filled in parallel */
+#define NUM_BOX_C1  (HIST_C1_ELEMS >> BOX_C1_LOG)
+#define NUM_BOX_C2  (HIST_C2_ELEMS >> BOX_C2_LOG)
+
+static void fill_inverse_cmap_box (void* user_data, int index)
+{
+  int c0 = index / (NUM_BOX_C1*NUM_BOX_C2);
+  int c1 = (index / NUM_BOX_C2) % NUM_BOX_C1;
+  int c2 = index % NUM_BOX_C2;
+
+  fill_inverse_cmap((quant_state*)user_data, c0 << BOX_C0_LOG, c1 << BOX_C1_LOG, c2 << BOX_C2_LOG);
+}
+
+static void fill_all_inverse_cmap (quant_state* qs)
+{
+  int numboxes = (HIST_C0_ELEMS >> BOX_C0_LOG) * NUM_BOX_C1 * NUM_BOX_C2;
+  imThreadParallelFor(numboxes, fill_inverse_cmap_box, qs);
+}
+
+
+static void slow_map_pixels (quant_state* qs, imbyte *red, imbyte *green, imbyte *blue, int width, int height, imbyte *map)
 {
   register LOCFSERROR cur0, cur1, cur2;	/* current error or pixel value */
   LOCFSERROR belowerr0, belowerr1, belowerr2; /* error for pixel below cur */
@@ -761,11 +882,11 @@ static void slow_map_pixels (imbyte *red, imbyte *green, imbyte *blue, int width
   int dir;			/* +1 or -1 depending on direction */
   int dir3;			/* 3*dir, for advancing errorptr */
   int lin, col, offset;
-  int *error_limit = sl_error_limiter;
-  imbyte* colormap0 = sl_colormap[0];
-  imbyte* colormap1 = sl_colormap[1];
-  imbyte* colormap2 = sl_colormap[2];
-  hist2d * histogram = sl_histogram;
+  int *error_limit = qs->error_limiter;
+  imbyte* colormap0 = qs->colormap[0];
+  imbyte* colormap1 = qs->colormap[1];
+  imbyte* colormap2 = qs->colormap[2];
+  hist2d * histogram = qs->histogram;
   
   for (lin = 0; lin < height; lin++) 
   {
@@ -776,7 +897,7 @@ static void slow_map_pixels (imbyte *red, imbyte *green, imbyte *blue, int width
     inBptr = & blue[offset];
     outptr = & map[offset];
 
-    if (sl_on_odd_lin) 
+    if (qs->on_odd_lin) 
     {
       /* work right to left in this line */
       offset = width-1;
@@ -789,16 +910,16 @@ static void slow_map_pixels (imbyte *red, imbyte *green, imbyte *blue, int width
 
       dir = -1;
       dir3 = -3;
-      errorptr = sl_fserrors + (width+1)*3; /* => entry after last column */
-      sl_on_odd_lin = 0;	/* flip for next time */
+      errorptr = qs->fserrors + (width+1)*3; /* => entry after last column */
+      qs->on_odd_lin = 0;	/* flip for next time */
     } 
     else 
     {
       /* work left to right in this line */
       dir = 1;
       dir3 = 3;
-      errorptr = sl_fserrors;	/* => entry before first real column */
-      sl_on_odd_lin = 1;	/* flip for next time */
+      errorptr = qs->fserrors;	/* => entry before first real column */
+      qs->on_odd_lin = 1;	/* flip for next time */
     }
 
     /* Preset error values: no error propagated to first pixel from left */
@@ -831,7 +952,7 @@ static void slow_map_pixels (imbyte *red, imbyte *green, imbyte *blue, int width
       /* If we have not seen this color before, find nearest colormap */
       /* entry and update the cache */
       if (*cachep == 0)
-        fill_inverse_cmap(cur0>>C0_SHIFT, cur1>>C1_SHIFT, cur2>>C2_SHIFT);
+        fill_inverse_cmap(qs, cur0>>C0_SHIFT, cur1>>C1_SHIFT, cur2>>C2_SHIFT);
 
       /* Now emit the colormap index for this cell */
       {
@@ -897,16 +1018,15 @@ static void slow_map_pixels (imbyte *red, imbyte *green, imbyte *blue, int width
 
 
 /* Allocate and fill in the error_limiter table */
-static void init_error_limit (void)
+static int * init_error_limit (void)
 {
   int * table;
   int in, out, STEPSIZE;
   
   table = (int *) malloc((size_t) ((255*2+1) * sizeof(int)));
-  if (! table) return;
+  if (! table) return NULL;
   
   table += 255;		/* so can index -255 .. +255 */
-  sl_error_limiter = table;
   
   STEPSIZE = ((255+1)/16);
 
@@ -931,6 +1051,8 @@ static void init_error_limit (void)
     table[in]  =  out; 
     table[-in] = -out;
   }
+
+  return table;
 }
 
 int imConvertRGB2Map(int width, int height, unsigned char *red, unsigned char *green, unsigned char *blue, unsigned char *map, long *palette, int *palette_count)
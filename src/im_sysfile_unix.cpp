@@ -38,6 +38,7 @@ public:
   void SeekFrom(long pOffset);
   unsigned long Tell() const;
   int EndOfFile() const;
+  void ReadAhead(unsigned long pOffset, unsigned long pSize);
 };
 
 imBinFileBase* iBinSystemFileNewFunc()
@@ -116,7 +117,7 @@ unsigned long imBinSystemFile::WriteBuf(void* pValues, unsigned long pSize)
 void imBinSystemFile::SeekTo(unsigned long pOffset)
 {
   assert(this->FileHandle > -1);
-  int ret = lseek(this->FileHandle, pOffset, SEEK_SET);
+  off_t ret = lseek(this->FileHandle, pOffset, SEEK_SET);
   if (ret < 0)
     this->Error = errno;
   else
@@ -126,7 +127,7 @@ void imBinSystemFile::SeekTo(unsigned long pOffset)
 void imBinSystemFile::SeekOffset(long pOffset)
 {
   assert(this->FileHandle > -1);
-  int ret = lseek(this->FileHandle, pOffset, SEEK_CUR);
+  off_t ret = lseek(this->FileHandle, pOffset, SEEK_CUR);
   if (ret < 0)
     this->Error = errno;
   else
@@ -136,7 +137,7 @@ void imBinSystemFile::SeekOffset(long pOffset)
 void imBinSystemFile::SeekFrom(long pOffset)
 {
   assert(this->FileHandle > -1);
-  int ret = lseek(this->FileHandle, pOffset, SEEK_END);
+  off_t ret = lseek(this->FileHandle, pOffset, SEEK_END);
   if (ret < 0)
     this->Error = errno;
   else
@@ -146,15 +147,15 @@ void imBinSystemFile::SeekFrom(long pOffset)
 unsigned long imBinSystemFile::Tell() const
 {
   assert(this->FileHandle > -1);
-  long offset = lseek(this->FileHandle, 0L, SEEK_CUR);
+  off_t offset = lseek(this->FileHandle, 0L, SEEK_CUR);
   return offset < 0? 0: offset;
 }
 
 unsigned long imBinSystemFile::FileSize()
 {
   assert(this->FileHandle > -1);
-  long lCurrentPosition = lseek(this->FileHandle, 0L, SEEK_CUR);
-  long lSize = lseek(this->FileHandle, 0L, SEEK_END);
+  off_t lCurrentPosition = lseek(this->FileHandle, 0L, SEEK_CUR);
+  off_t lSize = lseek(this->FileHandle, 0L, SEEK_END);
   lseek(this->FileHandle, lCurrentPosition, SEEK_SET);
   return lSize < 0? 0: lSize;
 }
@@ -162,12 +163,24 @@ unsigned long imBinSystemFile::FileSize()
 int imBinSystemFile::EndOfFile() const
 {
   assert(this->FileHandle > -1);
-  long lCurrentPosition = lseek(this->FileHandle, 0L, SEEK_CUR);
-  long lSize = lseek(this->FileHandle, 0L, SEEK_END);
+  off_t lCurrentPosition = lseek(this->FileHandle, 0L, SEEK_CUR);
+  off_t lSize = lseek(this->FileHandle, 0L, SEEK_END);
   lseek(this->FileHandle, lCurrentPosition, SEEK_SET);
   return lCurrentPosition == lSize? 1: 0;
 }
 
+void imBinSystemFile::ReadAhead(unsigned long pOffset, unsigned long pSize)
+{
+  assert(this->FileHandle > -1);
+#ifdef POSIX_FADV_WILLNEED
+  /* only a hint, errors are ignored */
+  posix_fadvise(this->FileHandle, (off_t)pOffset, (off_t)pSize, POSIX_FADV_WILLNEED);
+#else
+  (void)pOffset; 
+  (void)pSize;
+#endif
+}
+
 
 
 class imBinSystemFileHandle: public imBinSystemFile
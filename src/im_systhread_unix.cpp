@@ -0,0 +1,151 @@
+/** \file
+ * \brief System Dependent Threads (UNIX)
+ *
+ * See Copyright Notice in im_lib.h
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "im_thread.h"
+
+
+struct _imThread
+{
+  pthread_t handle;
+  imThreadFunc func;
+  void* user_data;
+};
+
+static void* iThreadStart(void* arg)
+{
+  imThread* thread = (imThread*)arg;
+  thread->func(thread->user_data);
+  return NULL;
+}
+
+imThread* imThreadCreate(imThreadFunc func, void* user_data)
+{
+  imThread* thread = (imThread*)malloc(sizeof(imThread));
+  if (!thread)
+    return NULL;
+
+  thread->func = func;
+  thread->user_data = user_data;
+
+  if (pthread_create(&thread->handle, NULL, iThreadStart, thread) != 0)
+  {
+    free(thread);
+    return NULL;
+  }
+
+  return thread;
+}
+
+void imThreadJoin(imThread* thread)
+{
+  pthread_join(thread->handle, NULL);
+  free(thread);
+}
+
+int imThreadAtomicGet(volatile int* value)
+{
+  return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+}
+
+void imThreadAtomicSet(volatile int* value, int new_value)
+{
+  __atomic_store_n(value, new_value, __ATOMIC_SEQ_CST);
+}
+
+int imThreadAtomicAdd(volatile int* value, int add)
+{
+  return __atomic_add_fetch(value, add, __ATOMIC_SEQ_CST);
+}
+
+int imThreadAtomicCompareExchange(volatile int* value, int old_value, int new_value)
+{
+  return __atomic_compare_exchange_n(value, &old_value, new_value, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+unsigned long imThreadId(void)
+{
+  return (unsigned long)pthread_self();
+}
+
+int imThreadCount(void)
+{
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  if (count < 1)
+    return 1;
+  return (int)count;
+}
+
+void imThreadYield(void)
+{
+  sched_yield();
+}
+
+double imThreadWallTime(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + ts.tv_nsec*1.0e-9;
+}
+
+double imThreadCPUTime(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (double)ts.tv_sec + ts.tv_nsec*1.0e-9;
+}
+
+/* POSIX unnamed semaphores are not available in all systems */
+struct _imThreadSemaphore
+{
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int count;
+};
+
+imThreadSemaphore* imThreadSemaphoreCreate(void)
+{
+  imThreadSemaphore* sem = (imThreadSemaphore*)malloc(sizeof(imThreadSemaphore));
+  if (!sem)
+    return NULL;
+
+  pthread_mutex_init(&sem->mutex, NULL);
+  pthread_cond_init(&sem->cond, NULL);
+  sem->count = 0;
+  return sem;
+}
+
+void imThreadSemaphoreDestroy(imThreadSemaphore* sem)
+{
+  pthread_cond_destroy(&sem->cond);
+  pthread_mutex_destroy(&sem->mutex);
+  free(sem);
+}
+
+void imThreadSemaphorePost(imThreadSemaphore* sem, int count)
+{
+  pthread_mutex_lock(&sem->mutex);
+  sem->count += count;
+  if (count == 1)
+    pthread_cond_signal(&sem->cond);
+  else
+    pthread_cond_broadcast(&sem->cond);
+  pthread_mutex_unlock(&sem->mutex);
+}
+
+void imThreadSemaphoreWait(imThreadSemaphore* sem)
+{
+  pthread_mutex_lock(&sem->mutex);
+  while (sem->count == 0)
+    pthread_cond_wait(&sem->cond, &sem->mutex);
+  sem->count--;
+  pthread_mutex_unlock(&sem->mutex);
+}
@@ -0,0 +1,150 @@
+/** \file
+ * \brief System Dependent Threads (WIN32)
+ *
+ * See Copyright Notice in im_lib.h
+ */
+
+#include <stdlib.h>
+#include <windows.h>
+#include <process.h>
+
+#include "im_thread.h"
+
+
+struct _imThread
+{
+  HANDLE handle;
+  imThreadFunc func;
+  void* user_data;
+};
+
+static unsigned __stdcall iThreadStart(void* arg)
+{
+  imThread* thread = (imThread*)arg;
+  thread->func(thread->user_data);
+  return 0;
+}
+
+imThread* imThreadCreate(imThreadFunc func, void* user_data)
+{
+  imThread* thread = (imThread*)malloc(sizeof(imThread));
+  if (!thread)
+    return NULL;
+
+  thread->func = func;
+  thread->user_data = user_data;
+
+  /* _beginthreadex initializes the C run time for the new thread */
+  thread->handle = (HANDLE)_beginthreadex(NULL, 0, iThreadStart, thread, 0, NULL);
+  if (!thread->handle)
+  {
+    free(thread);
+    return NULL;
+  }
+
+  return thread;
+}
+
+void imThreadJoin(imThread* thread)
+{
+  WaitForSingleObject(thread->handle, INFINITE);
+  CloseHandle(thread->handle);
+  free(thread);
+}
+
+int imThreadAtomicGet(volatile int* value)
+{
+  return (int)InterlockedCompareExchange((volatile LONG*)value, 0, 0);
+}
+
+void imThreadAtomicSet(volatile int* value, int new_value)
+{
+  InterlockedExchange((volatile LONG*)value, (LONG)new_value);
+}
+
+int imThreadAtomicAdd(volatile int* value, int add)
+{
+  return (int)InterlockedExchangeAdd((volatile LONG*)value, (LONG)add) + add;
+}
+
+int imThreadAtomicCompareExchange(volatile int* value, int old_value, int new_value)
+{
+  return InterlockedCompareExchange((volatile LONG*)value, (LONG)new_value, (LONG)old_value) == (LONG)old_value;
+}
+
+unsigned long imThreadId(void)
+{
+  return (unsigned long)GetCurrentThreadId();
+}
+
+int imThreadCount(void)
+{
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  if (info.dwNumberOfProcessors < 1)
+    return 1;
+  return (int)info.dwNumberOfProcessors;
+}
+
+void imThreadYield(void)
+{
+  SwitchToThread();
+}
+
+double imThreadWallTime(void)
+{
+  LARGE_INTEGER count, frequency;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&frequency);
+  return (double)count.QuadPart / (double)frequency.QuadPart;
+}
+
+double imThreadCPUTime(void)
+{
+  FILETIME creation, exit, kernel, user;
+  if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+    return 0;
+
+  /* in 100 nanoseconds units */
+  ULARGE_INTEGER k, u;
+  k.LowPart = kernel.dwLowDateTime; k.HighPart = kernel.dwHighDateTime;
+  u.LowPart = user.dwLowDateTime;   u.HighPart = user.dwHighDateTime;
+  return (double)(k.QuadPart + u.QuadPart) * 1.0e-7;
+}
+
+struct _imThreadSemaphore
+{
+  HANDLE handle;
+};
+
+imThreadSemaphore* imThreadSemaphoreCreate(void)
+{
+  imThreadSemaphore* sem = (imThreadSemaphore*)malloc(sizeof(imThreadSemaphore));
+  if (!sem)
+    return NULL;
+
+  sem->handle = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+  if (!sem->handle)
+  {
+    free(sem);
+    return NULL;
+  }
+
+  return sem;
+}
+
+void imThreadSemaphoreDestroy(imThreadSemaphore* sem)
+{
+  CloseHandle(sem->handle);
+  free(sem);
+}
+
+void imThreadSemaphorePost(imThreadSemaphore* sem, int count)
+{
+  ReleaseSemaphore(sem->handle, (LONG)count, NULL);
+}
+
+void imThreadSemaphoreWait(imThreadSemaphore* sem)
+{
+  WaitForSingleObject(sem->handle, INFINITE);
+}
@@ -0,0 +1,292 @@
+/** \file
+ * \brief Parallel Loops using System Dependent Threads
+ *
+ * See Copyright Notice in im_lib.h
+ */
+
+#include <stdlib.h>
+
+#include "im_thread.h"
+
+
+#define IM_MAX_THREADS 64
+
+/* Range of bands of one thread.
+   The owner takes bands from the begining, the other threads steal from the end. */
+struct iThreadDeque
+{
+  volatile int lock;
+  int first, last;
+  int pad[13];   /* one deque per cache line */
+};
+
+struct iThreadJob
+{
+  imThreadBandFunc func;
+  void* user_data;
+  int count, band_size, slot_count;
+  int slot_next;            /* next slot to be taken by a pool thread, protected by the pool lock */
+  volatile int active;      /* pool threads working in the job */
+  volatile int cancel;
+  iThreadJob* next;         /* list of jobs with free slots */
+  iThreadDeque deque[IM_MAX_THREADS];
+};
+
+static volatile int iPoolLock = 0;
+static iThreadJob* iPoolJobs = NULL;
+static int iPoolThreadCount = 0;
+static imThreadSemaphore* iPoolWake = NULL;
+
+static void iSpinLock(volatile int* lock)
+{
+  while (!imThreadAtomicCompareExchange(lock, 0, 1))
+    imThreadYield();
+}
+
+static void iSpinUnlock(volatile int* lock)
+{
+  imThreadAtomicSet(lock, 0);
+}
+
+static int iThreadDequePop(iThreadDeque* deque, int *band)
+{
+  int ret = 0;
+  iSpinLock(&deque->lock);
+  if (deque->first < deque->last)
+  {
+    *band = deque->first;
+    deque->first++;
+    ret = 1;
+  }
+  iSpinUnlock(&deque->lock);
+  return ret;
+}
+
+static int iThreadDequeSteal(iThreadJob* job, int slot, int *band)
+{
+  for (int i = 1; i < job->slot_count; i++)
+  {
+    iThreadDeque* victim = job->deque + (slot + i) % job->slot_count;
+
+    iSpinLock(&victim->lock);
+    int left = victim->last - victim->first;
+    if (left > 0)
+    {
+      /* take half of the bands left, from the end */
+      int steal = (left + 1) / 2;
+      int last = victim->last;
+      victim->last -= steal;
+      iSpinUnlock(&victim->lock);
+
+      /* the first one is returned, the others go to the thief */
+      iThreadDeque* deque = job->deque + slot;
+      iSpinLock(&deque->lock);
+      deque->first = last - steal + 1;
+      deque->last = last;
+      iSpinUnlock(&deque->lock);
+
+      *band = last - steal;
+      return 1;
+    }
+    iSpinUnlock(&victim->lock);
+  }
+
+  return 0;
+}
+
+static void iThreadJobRun(iThreadJob* job, int slot)
+{
+  int band;
+  while (!imThreadAtomicGet(&job->cancel))
+  {
+    if (!iThreadDequePop(job->deque + slot, &band) &&
+        !iThreadDequeSteal(job, slot, &band))
+      break;
+
+    int start = band * job->band_size;
+    int end = start + job->band_size;
+    if (end > job->count) end = job->count;
+
+    if (!job->func(job->user_data, start, end))
+      imThreadAtomicSet(&job->cancel, 1);
+  }
+}
+
+static void iThreadJobRemove(iThreadJob* job)
+{
+  /* must be called with the pool lock */
+  iThreadJob** link = &iPoolJobs;
+  while (*link)
+  {
+    if (*link == job)
+    {
+      *link = job->next;
+      return;
+    }
+    link = &((*link)->next);
+  }
+}
+
+static void iThreadPoolFunc(void* user_data)
+{
+  (void)user_data;
+
+  for (;;)
+  {
+    imThreadSemaphoreWait(iPoolWake);
+
+    iSpinLock(&iPoolLock);
+
+    /* help the job with less threads, so concurrent jobs share the pool */
+    iThreadJob* job = iPoolJobs;
+    for (iThreadJob* j = iPoolJobs; j; j = j->next)
+    {
+      if (imThreadAtomicGet(&j->active) < imThreadAtomicGet(&job->active))
+        job = j;
+    }
+
+    int slot = 0;
+    if (job)
+    {
+      slot = job->slot_next;
+      job->slot_next++;
+      imThreadAtomicAdd(&job->active, 1);
+
+      if (job->slot_next == job->slot_count)
+        iThreadJobRemove(job);
+    }
+
+    iSpinUnlock(&iPoolLock);
+
+    if (job)
+    {
+      iThreadJobRun(job, slot);
+      imThreadAtomicAdd(&job->active, -1);
+    }
+  }
+}
+
+static int iThreadPoolStart(int thread_count)
+{
+  iSpinLock(&iPoolLock);
+
+  if (!iPoolWake)
+    iPoolWake = imThreadSemaphoreCreate();
+
+  /* the pool threads are never released */
+  while (iPoolWake && iPoolThreadCount < thread_count)
+  {
+    if (!imThreadCreate(iThreadPoolFunc, NULL))
+      break;
+    iPoolThreadCount++;
+  }
+
+  int count = iPoolWake? iPoolThreadCount: 0;
+  iSpinUnlock(&iPoolLock);
+  return count;
+}
+
+int imThreadParallelBands(int count, int band_size, int max_threads, imThreadBandFunc func, void* user_data)
+{
+  if (count <= 0)
+    return 1;
+
+  static volatile int cpu_count = 0;
+  if (!imThreadAtomicGet(&cpu_count))
+    imThreadAtomicSet(&cpu_count, imThreadCount());
+
+  int thread_count = imThreadAtomicGet(&cpu_count);
+  if (thread_count > max_threads) thread_count = max_threads;
+  if (thread_count > IM_MAX_THREADS) thread_count = IM_MAX_THREADS;
+  if (thread_count < 1) thread_count = 1;
+
+  if (band_size <= 0)
+  {
+    /* several bands per thread, so the work can be balanced */
+    band_size = count / (thread_count * 8);
+    if (band_size < 1) band_size = 1;
+  }
+
+  int band_count = (count + band_size - 1) / band_size;
+  if (thread_count > band_count) thread_count = band_count;
+
+  if (thread_count > 1)
+  {
+    int pool_count = iThreadPoolStart(thread_count - 1);
+    if (thread_count > pool_count + 1) thread_count = pool_count + 1;
+  }
+
+  if (thread_count <= 1)
+  {
+    for (int start = 0; start < count; start += band_size)
+    {
+      int end = start + band_size;
+      if (end > count) end = count;
+
+      if (!func(user_data, start, end))
+        return 0;
+    }
+    return 1;
+  }
+
+  iThreadJob job;
+  job.func = func;
+  job.user_data = user_data;
+  job.count = count;
+  job.band_size = band_size;
+  job.slot_count = thread_count;
+  job.slot_next = 1;  /* the current thread uses the first slot */
+  job.active = 0;
+  job.cancel = 0;
+  job.next = NULL;
+
+  for (int i = 0; i < thread_count; i++)
+  {
+    job.deque[i].lock = 0;
+    job.deque[i].first = (int)(((long long)band_count * i) / thread_count);
+    job.deque[i].last = (int)(((long long)band_count * (i + 1)) / thread_count);
+  }
+
+  iSpinLock(&iPoolLock);
+  iThreadJob** link = &iPoolJobs;
+  while (*link) link = &((*link)->next);
+  *link = &job;
+  iSpinUnlock(&iPoolLock);
+
+  imThreadSemaphorePost(iPoolWake, thread_count - 1);
+
+  iThreadJobRun(&job, 0);
+
+  /* no more bands to start, but the pool threads may be still running the last ones */
+  iSpinLock(&iPoolLock);
+  iThreadJobRemove(&job);
+  iSpinUnlock(&iPoolLock);
+
+  while (imThreadAtomicGet(&job.active))
+    imThreadYield();
+
+  return !job.cancel;
+}
+
+struct iThreadTask
+{
+  imThreadTaskFunc func;
+  void* user_data;
+};
+
+static int iThreadTaskBand(void* user_data, int start, int end)
+{
+  iThreadTask* task = (iThreadTask*)user_data;
+  for (int index = start; index < end; index++)
+    task->func(task->user_data, index);
+  return 1;
+}
+
+void imThreadParallelFor(int count, imThreadTaskFunc func, void* user_data)
+{
+  iThreadTask task;
+  task.func = func;
+  task.user_data = user_data;
+
+  imThreadParallelBands(count, 1, imThreadCount(), iThreadTaskBand, &task);
+}
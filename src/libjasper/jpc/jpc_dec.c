@@ -306,13 +306,23 @@ error:
 typedef enum {
 	OPT_MAXLYRS,
 	OPT_MAXPKTS,
-	OPT_DEBUG
+	OPT_DEBUG,
+	OPT_REDUCE,       /* IMLIB - reduced resolution and area of interest */
+	OPT_IMGAREATLX,
+	OPT_IMGAREATLY,
+	OPT_IMGAREABRX,
+	OPT_IMGAREABRY
 } optid_t;
 
 jas_taginfo_t decopts[] = {
 	{OPT_MAXLYRS, "maxlyrs"},
 	{OPT_MAXPKTS, "maxpkts"},
 	{OPT_DEBUG, "debug"},
+	{OPT_REDUCE, "reduce"},
+	{OPT_IMGAREATLX, "imgareatlx"},
+	{OPT_IMGAREATLY, "imgareatly"},
+	{OPT_IMGAREABRX, "imgareabrx"},
+	{OPT_IMGAREABRY, "imgareabry"},
 	{-1, 0}
 };
 
@@ -323,6 +333,11 @@ static int jpc_dec_parseopts(char *optstr, jpc_dec_importopts_t *opts)
 	opts->debug = 0;
 	opts->maxlyrs = JPC_MAXLYRS;
 	opts->maxpkts = -1;
+	opts->reduce = 0;
+	opts->areaxstart = 0;
+	opts->areaystart = 0;
+	opts->areaxend = UINT_FAST32_MAX;
+	opts->areayend = UINT_FAST32_MAX;
 
 	if (!(tvp = jas_tvparser_create(optstr ? optstr : ""))) {
 		return -1;
@@ -340,6 +355,23 @@ static int jpc_dec_parseopts(char *optstr, jpc_dec_importopts_t *opts)
 		case OPT_MAXPKTS:
 			opts->maxpkts = atoi(jas_tvparser_getval(tvp));
 			break;
+		case OPT_REDUCE:
+			opts->reduce = atoi(jas_tvparser_getval(tvp));
+			if (opts->reduce < 0)
+				opts->reduce = 0;
+			break;
+		case OPT_IMGAREATLX:
+			opts->areaxstart = atol(jas_tvparser_getval(tvp));
+			break;
+		case OPT_IMGAREATLY:
+			opts->areaystart = atol(jas_tvparser_getval(tvp));
+			break;
+		case OPT_IMGAREABRX:
+			opts->areaxend = atol(jas_tvparser_getval(tvp));
+			break;
+		case OPT_IMGAREABRY:
+			opts->areayend = atol(jas_tvparser_getval(tvp));
+			break;
 		default:
 			jas_eprintf("warning: ignoring invalid option %s\n",
 			  jas_tvparser_gettag(tvp));
@@ -473,6 +505,18 @@ static int jpc_dec_process_sot(jpc_dec_t *dec, jpc_ms_t *ms)
 
 	if (dec->state == JPC_MH) {
 
+		/* IMLIB - at most all the decomposition levels can be discarded,
+		  and the area of interest is limited to the image area */
+		for (cmptno = 0; cmptno < dec->numcomps; ++cmptno) {
+			if (dec->reduce > dec->cp->ccps[cmptno].numrlvls - 1) {
+				dec->reduce = dec->cp->ccps[cmptno].numrlvls - 1;
+			}
+		}
+		dec->areaxstart = JAS_MIN(JAS_MAX(dec->areaxstart, dec->xstart), dec->xend);
+		dec->areaystart = JAS_MIN(JAS_MAX(dec->areaystart, dec->ystart), dec->yend);
+		dec->areaxend = JAS_MAX(JAS_MIN(dec->areaxend, dec->xend), dec->areaxstart);
+		dec->areayend = JAS_MAX(JAS_MIN(dec->areayend, dec->yend), dec->areaystart);
+
 		compinfos = jas_malloc(dec->numcomps * sizeof(jas_image_cmptparm_t));
 		assert(compinfos);
 		for (cmptno = 0, cmpt = dec->cmpts, compinfo = compinfos;
@@ -481,8 +525,12 @@ static int jpc_dec_process_sot(jpc_dec_t *dec, jpc_ms_t *ms)
 			compinfo->tly = 0;
 			compinfo->prec = cmpt->prec;
 			compinfo->sgnd = cmpt->sgnd;
-			compinfo->width = cmpt->width;
-			compinfo->height = cmpt->height;
+			compinfo->width = JPC_CEILDIVPOW2(JPC_CEILDIV(dec->xend,
+			  cmpt->hstep), dec->reduce) - JPC_CEILDIVPOW2(JPC_CEILDIV(
+			  dec->xstart, cmpt->hstep), dec->reduce);
+			compinfo->height = JPC_CEILDIVPOW2(JPC_CEILDIV(dec->yend,
+			  cmpt->vstep), dec->reduce) - JPC_CEILDIVPOW2(JPC_CEILDIV(
+			  dec->ystart, cmpt->vstep), dec->reduce);
 			compinfo->hstep = cmpt->hstep;
 			compinfo->vstep = cmpt->vstep;
 		}
@@ -580,6 +628,24 @@ static int jpc_dec_process_sod(jpc_dec_t *dec, jpc_ms_t *ms)
 		return -1;
 	}
 
+	/* IMLIB - skip the data of tiles outside the area of interest */
+	if (dec->curtileendoff > 0 && (tile->state == JPC_TILE_DONE ||
+	  tile->xend <= dec->areaxstart || tile->xstart >= dec->areaxend ||
+	  tile->yend <= dec->areaystart || tile->ystart >= dec->areayend)) {
+		long curoff = jas_stream_getrwcount(dec->in);
+		if (curoff < dec->curtileendoff &&
+		  jas_stream_gobble(dec->in, dec->curtileendoff - curoff) !=
+		  dec->curtileendoff - curoff) {
+			jas_eprintf("read error\n");
+			return -1;
+		}
+		jpc_dec_tilefini(dec, tile);
+		dec->curtile = 0;
+		++tile->partno;
+		dec->state = JPC_TPHSOT;
+		return 0;
+	}
+
 	if (!tile->partno) {
 		if (!jpc_dec_cp_isvalid(tile->cp)) {
 			return -1;
@@ -735,6 +801,11 @@ static int jpc_dec_tileinit(jpc_dec_t *dec, jpc_dec_tile_t *tile)
 			tile->realmode = 1;
 		}
 		tcomp->numrlvls = ccp->numrlvls;
+		if (dec->reduce > tcomp->numrlvls - 1) {
+			jas_eprintf("cannot discard %d resolution levels of a tile\n",
+			  dec->reduce);
+			return -1;
+		}
 		if (!(tcomp->rlvls = jas_malloc(tcomp->numrlvls *
 		  sizeof(jpc_dec_rlvl_t)))) {
 			return -1;
@@ -1070,6 +1141,8 @@ static int jpc_dec_tiledecode(jpc_dec_t *dec, jpc_dec_tile_t *tile)
 	int v;
 	jpc_dec_ccp_t *ccp;
 	jpc_dec_cmpt_t *cmpt;
+	jas_matrix_t **fulldata;
+	int ret;
 
 	if (jpc_dec_decodecblks(dec, tile)) {
 		jas_eprintf("jpc_dec_decodecblks failed\n");
@@ -1080,8 +1153,9 @@ static int jpc_dec_tiledecode(jpc_dec_t *dec, jpc_dec_tile_t *tile)
 	for (compno = 0, tcomp = tile->tcomps; compno < dec->numcomps;
 	  ++compno, ++tcomp) {
 		ccp = &tile->cp->ccps[compno];
-		for (rlvlno = 0, rlvl = tcomp->rlvls; rlvlno < tcomp->numrlvls;
-		  ++rlvlno, ++rlvl) {
+		/* IMLIB - discarded resolution levels are not dequantized */
+		for (rlvlno = 0, rlvl = tcomp->rlvls; rlvlno < tcomp->numrlvls -
+		  dec->reduce; ++rlvlno, ++rlvl) {
 			if (!rlvl->bands) {
 				continue;
 			}
@@ -1105,7 +1179,43 @@ static int jpc_dec_tiledecode(jpc_dec_t *dec, jpc_dec_tile_t *tile)
 	for (compno = 0, tcomp = tile->tcomps; compno < dec->numcomps;
 	  ++compno, ++tcomp) {
 		ccp = &tile->cp->ccps[compno];
-		jpc_tsfb_synthesize(tcomp->tsfb, tcomp->data);
+		if (dec->reduce) {
+			jpc_tsfb_synthesizereduced(tcomp->tsfb, tcomp->data, dec->reduce);
+		} else {
+			jpc_tsfb_synthesize(tcomp->tsfb, tcomp->data);
+		}
+	}
+
+	/* IMLIB - The reduced resolution tile-component is at the top left
+	  corner of the data, the remaining steps use only that part. */
+	fulldata = 0;
+	if (dec->reduce) {
+		if (!(fulldata = jas_malloc(dec->numcomps * sizeof(jas_matrix_t *)))) {
+			return -1;
+		}
+		for (compno = 0, tcomp = tile->tcomps; compno < dec->numcomps;
+		  ++compno, ++tcomp) {
+			fulldata[compno] = tcomp->data;
+			tcomp->data = 0;
+		}
+		for (compno = 0, tcomp = tile->tcomps; compno < dec->numcomps;
+		  ++compno, ++tcomp) {
+			jas_matrix_t *full = fulldata[compno];
+			int xstart = JPC_CEILDIVPOW2(jas_seq2d_xstart(full), dec->reduce);
+			int ystart = JPC_CEILDIVPOW2(jas_seq2d_ystart(full), dec->reduce);
+			int xend = JPC_CEILDIVPOW2(jas_seq2d_xend(full), dec->reduce);
+			int yend = JPC_CEILDIVPOW2(jas_seq2d_yend(full), dec->reduce);
+			if (!(tcomp->data = jas_seq2d_create(0, 0, 0, 0))) {
+				ret = -1;
+				goto done;
+			}
+			if (xend > xstart && yend > ystart) {
+				jas_seq2d_bindsub(tcomp->data, full, jas_seq2d_xstart(full),
+				  jas_seq2d_ystart(full), jas_seq2d_xstart(full) + xend - xstart,
+				  jas_seq2d_ystart(full) + yend - ystart);
+			}
+			jas_seq2d_setshift(tcomp->data, xstart, ystart);
+		}
 	}
 
 
@@ -1162,18 +1272,37 @@ static int jpc_dec_tiledecode(jpc_dec_t *dec, jpc_dec_tile_t *tile)
 	/* XXX need to free tsfb struct */
 
 	/* Write the data for each component of the image. */
+	ret = 0;
 	for (compno = 0, tcomp = tile->tcomps, cmpt = dec->cmpts; compno <
 	  dec->numcomps; ++compno, ++tcomp, ++cmpt) {
-		if (jas_image_writecmpt(dec->image, compno, tcomp->xstart -
-		  JPC_CEILDIV(dec->xstart, cmpt->hstep), tcomp->ystart -
-		  JPC_CEILDIV(dec->ystart, cmpt->vstep), jas_matrix_numcols(
-		  tcomp->data), jas_matrix_numrows(tcomp->data), tcomp->data)) {
+		if (!jas_matrix_numcols(tcomp->data) || !jas_matrix_numrows(tcomp->data)) {
+			continue;
+		}
+		if (jas_image_writecmpt(dec->image, compno, jas_seq2d_xstart(tcomp->data) -
+		  JPC_CEILDIVPOW2(JPC_CEILDIV(dec->xstart, cmpt->hstep), dec->reduce),
+		  jas_seq2d_ystart(tcomp->data) -
+		  JPC_CEILDIVPOW2(JPC_CEILDIV(dec->ystart, cmpt->vstep), dec->reduce),
+		  jas_matrix_numcols(tcomp->data), jas_matrix_numrows(tcomp->data),
+		  tcomp->data)) {
 			jas_eprintf("write component failed\n");
-			return -4;
+			ret = -4;
+			break;
 		}
 	}
 
-	return 0;
+done:
+	if (fulldata) {
+		for (compno = 0, tcomp = tile->tcomps; compno < dec->numcomps;
+		  ++compno, ++tcomp) {
+			if (tcomp->data) {
+				jas_matrix_destroy(tcomp->data);
+			}
+			tcomp->data = fulldata[compno];
+		}
+		jas_free(fulldata);
+	}
+
+	return ret;
 }
 
 static int jpc_dec_process_eoc(jpc_dec_t *dec, jpc_ms_t *ms)
@@ -1271,6 +1400,7 @@ static int jpc_dec_process_siz(jpc_dec_t *dec, jpc_ms_t *ms)
 		tile->pkthdrstreampos = 0;
 		tile->pptstab = 0;
 		tile->cp = 0;
+		tile->pi = 0;
 		if (!(tile->tcomps = jas_malloc(dec->numcomps *
 		  sizeof(jpc_dec_tcomp_t)))) {
 			return -1;
@@ -1278,6 +1408,7 @@ static int jpc_dec_process_siz(jpc_dec_t *dec, jpc_ms_t *ms)
 		for (compno = 0, cmpt = dec->cmpts, tcomp = tile->tcomps;
 		  compno < dec->numcomps; ++compno, ++cmpt, ++tcomp) {
 			tcomp->rlvls = 0;
+			tcomp->numrlvls = 0;
 			tcomp->data = 0;
 			tcomp->xstart = JPC_CEILDIV(tile->xstart, cmpt->hstep);
 			tcomp->ystart = JPC_CEILDIV(tile->ystart, cmpt->vstep);
@@ -1911,6 +2042,11 @@ static jpc_dec_t *jpc_dec_create(jpc_dec_importopts_t *impopts, jas_stream_t *in
 	dec->maxlyrs = impopts->maxlyrs;
 	dec->maxpkts = impopts->maxpkts;
 dec->numpkts = 0;
+	dec->reduce = impopts->reduce;
+	dec->areaxstart = impopts->areaxstart;
+	dec->areaystart = impopts->areaystart;
+	dec->areaxend = impopts->areaxend;
+	dec->areayend = impopts->areayend;
 	dec->ppmseqno = 0;
 	dec->state = 0;
 	dec->cmpts = 0;
@@ -659,8 +659,23 @@ typedef struct {
 	/* This is required by the tier-2 decoder. */
 	jpc_cstate_t *cstate;
 
+	/* IMLIB - The number of highest resolution levels to discard. */
+	int reduce;
+
+	/* IMLIB - The area of interest on the reference grid.  Tiles and code
+	  blocks that do not contribute to it are not decoded. */
+	uint_fast32_t areaxstart;
+	uint_fast32_t areaystart;
+	uint_fast32_t areaxend;
+	uint_fast32_t areayend;
+
 } jpc_dec_t;
 
+/* IMLIB - Margin, in coefficients, kept around the area of interest when
+  selecting the code blocks to decode.  It covers the support of the
+  synthesis filters accumulated over the decomposition levels. */
+#define JPC_DEC_AREAMARGIN	8
+
 /* Decoder options. */
 
 typedef struct {
@@ -674,6 +689,15 @@ typedef struct {
 	/* The maximum number of packets to decode. */
 	int maxpkts;
 
+	/* IMLIB - The number of highest resolution levels to discard. */
+	int reduce;
+
+	/* IMLIB - The area of interest on the reference grid. */
+	uint_fast32_t areaxstart;
+	uint_fast32_t areaystart;
+	uint_fast32_t areaxend;
+	uint_fast32_t areayend;
+
 } jpc_dec_importopts_t;
 
 /******************************************************************************\
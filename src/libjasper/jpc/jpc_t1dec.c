@@ -84,6 +84,7 @@
 #include "jpc_t1dec.h"
 #include "jpc_t1cod.h"
 #include "jpc_dec.h"
+#include "jpc_math.h"
 
 /******************************************************************************\
 *
@@ -152,9 +153,15 @@ int jpc_dec_decodecblks(jpc_dec_t *dec, jpc_dec_tile_t *tile)
 	int prccnt;
 	jpc_dec_cblk_t *cblk;
 	int cblkcnt;
-
-	for (compcnt = dec->numcomps, tcomp = tile->tcomps; compcnt > 0;
-	  --compcnt, ++tcomp) {
+	jpc_dec_cmpt_t *cmpt;
+	int lvlno;
+	long areaxstart;
+	long areaystart;
+	long areaxend;
+	long areayend;
+
+	for (compcnt = dec->numcomps, tcomp = tile->tcomps, cmpt = dec->cmpts;
+	  compcnt > 0; --compcnt, ++tcomp, ++cmpt) {
 		for (rlvlcnt = tcomp->numrlvls, rlvl = tcomp->rlvls;
 		  rlvlcnt > 0; --rlvlcnt, ++rlvl) {
 
@@ -165,6 +172,24 @@ int jpc_dec_decodecblks(jpc_dec_t *dec, jpc_dec_tile_t *tile)
 			if (!rlvl->bands) {
 				continue;
 			}
+
+			/* IMLIB - the discarded resolution levels are not decoded */
+			if (rlvlcnt <= dec->reduce) {
+				continue;
+			}
+
+			/* IMLIB - area of interest in the band coordinates of this
+			  level, with a margin for the support of the synthesis filters */
+			lvlno = (rlvlcnt == tcomp->numrlvls) ? (rlvlcnt - 1) : rlvlcnt;
+			areaxstart = (long)JPC_FLOORDIVPOW2(JPC_CEILDIV(dec->areaxstart,
+			  cmpt->hstep), lvlno) - JPC_DEC_AREAMARGIN;
+			areaystart = (long)JPC_FLOORDIVPOW2(JPC_CEILDIV(dec->areaystart,
+			  cmpt->vstep), lvlno) - JPC_DEC_AREAMARGIN;
+			areaxend = (long)JPC_CEILDIVPOW2(JPC_CEILDIV(dec->areaxend,
+			  cmpt->hstep), lvlno) + JPC_DEC_AREAMARGIN;
+			areayend = (long)JPC_CEILDIVPOW2(JPC_CEILDIV(dec->areayend,
+			  cmpt->vstep), lvlno) + JPC_DEC_AREAMARGIN;
+
 			for (bandcnt = rlvl->numbands, band = rlvl->bands;
 			  bandcnt > 0; --bandcnt, ++band) {
 				if (!band->data) {
@@ -178,6 +203,12 @@ int jpc_dec_decodecblks(jpc_dec_t *dec, jpc_dec_tile_t *tile)
 					for (cblkcnt = prc->numcblks,
 					  cblk = prc->cblks; cblkcnt > 0;
 					  --cblkcnt, ++cblk) {
+						if (jas_seq2d_xend(cblk->data) <= areaxstart ||
+						  jas_seq2d_xstart(cblk->data) >= areaxend ||
+						  jas_seq2d_yend(cblk->data) <= areaystart ||
+						  jas_seq2d_ystart(cblk->data) >= areayend) {
+							continue;
+						}
 						if (jpc_dec_decodecblk(dec, tile, tcomp,
 						  band, cblk, 1, JPC_MAXLYRS)) {
 							return -1;
@@ -85,6 +85,8 @@
 void jpc_tsfb_getbands2(jpc_tsfb_t *tsfb, int locxstart, int locystart,
   int xstart, int ystart, int xend, int yend, jpc_tsfb_band_t **bands,
   int numlvls);
+int jpc_tsfb_synthesize2(jpc_tsfb_t *tsfb, int *a, int xstart, int ystart,
+  int width, int height, int stride, int numlvls);
 
 /******************************************************************************\
 *
@@ -154,6 +156,20 @@ int jpc_tsfb_synthesize(jpc_tsfb_t *tsfb, jas_seq2d_t *a)
 	  jas_seq2d_height(a), jas_seq2d_rowstep(a), tsfb->numlvls - 1) : 0;
 }
 
+/* IMLIB - The lowest resolution levels are synthesized in place, the result
+  is left at the top left corner of the array. */
+int jpc_tsfb_synthesizereduced(jpc_tsfb_t *tsfb, jas_seq2d_t *a, int reduce)
+{
+	int xstart = JPC_CEILDIVPOW2(jas_seq2d_xstart(a), reduce);
+	int ystart = JPC_CEILDIVPOW2(jas_seq2d_ystart(a), reduce);
+	int xend = JPC_CEILDIVPOW2(jas_seq2d_xend(a), reduce);
+	int yend = JPC_CEILDIVPOW2(jas_seq2d_yend(a), reduce);
+	return (tsfb->numlvls > reduce) ? jpc_tsfb_synthesize2(tsfb,
+	  jas_seq2d_getref(a, jas_seq2d_xstart(a), jas_seq2d_ystart(a)),
+	  xstart, ystart, xend - xstart, yend - ystart, jas_seq2d_rowstep(a),
+	  tsfb->numlvls - reduce - 1) : 0;
+}
+
 int jpc_tsfb_synthesize2(jpc_tsfb_t *tsfb, int *a, int xstart, int ystart,
   int width, int height, int stride, int numlvls)
 {
@@ -130,6 +130,9 @@ int jpc_tsfb_analyze(jpc_tsfb_t *tsfb, jas_seq2d_t *x);
 /* Perform synthesis. */
 int jpc_tsfb_synthesize(jpc_tsfb_t *tsfb, jas_seq2d_t *x);
 
+/* IMLIB - Perform synthesis discarding the highest resolution levels. */
+int jpc_tsfb_synthesizereduced(jpc_tsfb_t *tsfb, jas_seq2d_t *x, int reduce);
+
 /* Get band information for a TSFB. */
 int jpc_tsfb_getbands(jpc_tsfb_t *tsfb, uint_fast32_t xstart,
   uint_fast32_t ystart, uint_fast32_t xend, uint_fast32_t yend,
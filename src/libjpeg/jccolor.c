@@ -11,6 +11,7 @@
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
+#include "jsimd.h"
 
 
 /* Private subobject */
@@ -172,6 +173,41 @@ rgb_ycc_convert (j_compress_ptr cinfo,
 }
 
 
+#ifdef JPEG_SIMD
+
+/*
+ * SSE2 version of rgb_ycc_convert, see jsimd_sse2.c.
+ */
+
+METHODDEF(void)
+rgb_ycc_convert_sse2 (j_compress_ptr cinfo,
+		      JSAMPARRAY input_buf, JSAMPIMAGE output_buf,
+		      JDIMENSION output_row, int num_rows)
+{
+  while (--num_rows >= 0) {
+    jsimd_rgb_ycc_row_sse2(*input_buf++, output_buf[0][output_row],
+			   output_buf[1][output_row], output_buf[2][output_row],
+			   cinfo->image_width);
+    output_row++;
+  }
+}
+
+/* SSE2 and scalar variants of the color conversion, see jsimd.h. */
+
+typedef JMETHOD(void, color_convert_ptr,
+		(j_compress_ptr cinfo, JSAMPARRAY input_buf,
+		 JSAMPIMAGE output_buf, JDIMENSION output_row, int num_rows));
+
+static const imCPUVariant rgb_ycc_variants[] = {
+  { IM_CPU_SSE2, (imCPUFunc) rgb_ycc_convert_sse2 },
+  { 0, (imCPUFunc) rgb_ycc_convert }
+};
+static imCPUKernel rgb_ycc_kernel =
+  IM_CPU_KERNEL("JPEGRgbYcc", rgb_ycc_variants);
+
+#endif /* JPEG_SIMD */
+
+
 /**************** Cases other than RGB -> YCbCr **************/
 
 
@@ -421,7 +457,12 @@ jinit_color_converter (j_compress_ptr cinfo)
       ERREXIT(cinfo, JERR_BAD_J_COLORSPACE);
     if (cinfo->in_color_space == JCS_RGB) {
       cconvert->pub.start_pass = rgb_ycc_start;
+#ifdef JPEG_SIMD
+      cconvert->pub.color_convert =
+	(color_convert_ptr) jsimd_select(&rgb_ycc_kernel);
+#else
       cconvert->pub.color_convert = rgb_ycc_convert;
+#endif
     } else if (cinfo->in_color_space == JCS_YCbCr)
       cconvert->pub.color_convert = null_convert;
     else
@@ -15,6 +15,7 @@
 #include "jinclude.h"
 #include "jpeglib.h"
 #include "jdct.h"		/* Private declarations for DCT subsystem */
+#include "jsimd.h"
 
 
 /* Private subobject for this module */
@@ -176,6 +177,20 @@ forward_DCT_float (j_compress_ptr cinfo, jpeg_component_info * compptr,
  * first scan.  Hence all components should be examined here.
  */
 
+#ifdef JPEG_SIMD
+
+/* SSE2 and scalar variants of the accurate integer FDCT, see jsimd.h. */
+
+static const imCPUVariant fdct_islow_variants[] = {
+  { IM_CPU_SSE2, (imCPUFunc) jsimd_fdct_islow_sse2 },
+  { 0, (imCPUFunc) jpeg_fdct_islow }
+};
+static imCPUKernel fdct_islow_kernel =
+  IM_CPU_KERNEL("JPEGFdctIslow", fdct_islow_variants);
+
+#endif /* JPEG_SIMD */
+
+
 METHODDEF(void)
 start_pass_fdctmgr (j_compress_ptr cinfo)
 {
@@ -320,7 +335,12 @@ start_pass_fdctmgr (j_compress_ptr cinfo)
       switch (cinfo->dct_method) {
 #ifdef DCT_ISLOW_SUPPORTED
       case JDCT_ISLOW:
+#ifdef JPEG_SIMD
+	fdct->do_dct[ci] =
+	  (forward_DCT_method_ptr) jsimd_select(&fdct_islow_kernel);
+#else
 	fdct->do_dct[ci] = jpeg_fdct_islow;
+#endif
 	method = JDCT_ISLOW;
 	break;
 #endif
@@ -11,6 +11,7 @@
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
+#include "jsimd.h"
 
 
 /* Private subobject */
@@ -23,6 +24,9 @@ typedef struct {
   int * Cb_b_tab;		/* => table for Cb to B conversion */
   INT32 * Cr_g_tab;		/* => table for Cr to G conversion */
   INT32 * Cb_g_tab;		/* => table for Cb to G conversion */
+
+  /* Distance between output planes, see jpeg_set_planar_output */
+  size_t plane_size;
 } my_color_deconverter;
 
 typedef my_color_deconverter * my_cconvert_ptr;
@@ -157,6 +161,45 @@ ycc_rgb_convert (j_decompress_ptr cinfo,
 }
 
 
+#ifdef JPEG_SIMD
+
+/*
+ * SSE2 version of ycc_rgb_convert, see jsimd_sse2.c.
+ */
+
+METHODDEF(void)
+ycc_rgb_convert_sse2 (j_decompress_ptr cinfo,
+		      JSAMPIMAGE input_buf, JDIMENSION input_row,
+		      JSAMPARRAY output_buf, int num_rows)
+{
+  JSAMPROW outptr;
+
+  while (--num_rows >= 0) {
+    outptr = *output_buf++;
+    jsimd_ycc_rgb_row_sse2(input_buf[0][input_row], input_buf[1][input_row],
+			   input_buf[2][input_row], outptr + RGB_RED,
+			   outptr + RGB_GREEN, outptr + RGB_BLUE,
+			   RGB_PIXELSIZE, cinfo->output_width);
+    input_row++;
+  }
+}
+
+/* SSE2 and scalar variants of the color conversion, see jsimd.h. */
+
+typedef JMETHOD(void, color_convert_ptr,
+		(j_decompress_ptr cinfo, JSAMPIMAGE input_buf,
+		 JDIMENSION input_row, JSAMPARRAY output_buf, int num_rows));
+
+static const imCPUVariant ycc_rgb_variants[] = {
+  { IM_CPU_SSE2, (imCPUFunc) ycc_rgb_convert_sse2 },
+  { 0, (imCPUFunc) ycc_rgb_convert }
+};
+static imCPUKernel ycc_rgb_kernel =
+  IM_CPU_KERNEL("JPEGYccRgb", ycc_rgb_variants);
+
+#endif /* JPEG_SIMD */
+
+
 /**************** Cases other than YCbCr -> RGB **************/
 
 
@@ -285,6 +328,157 @@ ycck_cmyk_convert (j_decompress_ptr cinfo,
 }
 
 
+/**************** Planar output (IM extension) **************/
+
+
+/*
+ * YCbCr->RGB conversion writing each output component to its own plane.
+ * The output row addresses the first plane, the others follow at
+ * multiples of plane_size.
+ */
+
+METHODDEF(void)
+ycc_rgb_planar_convert (j_decompress_ptr cinfo,
+			JSAMPIMAGE input_buf, JDIMENSION input_row,
+			JSAMPARRAY output_buf, int num_rows)
+{
+  my_cconvert_ptr cconvert = (my_cconvert_ptr) cinfo->cconvert;
+  register int y, cb, cr;
+  register JSAMPROW outptr0, outptr1, outptr2;
+  register JSAMPROW inptr0, inptr1, inptr2;
+  register JDIMENSION col;
+  JDIMENSION num_cols = cinfo->output_width;
+  size_t plane_size = cconvert->plane_size;
+  /* copy these pointers into registers if possible */
+  register JSAMPLE * range_limit = cinfo->sample_range_limit;
+  register int * Crrtab = cconvert->Cr_r_tab;
+  register int * Cbbtab = cconvert->Cb_b_tab;
+  register INT32 * Crgtab = cconvert->Cr_g_tab;
+  register INT32 * Cbgtab = cconvert->Cb_g_tab;
+  SHIFT_TEMPS
+
+  while (--num_rows >= 0) {
+    inptr0 = input_buf[0][input_row];
+    inptr1 = input_buf[1][input_row];
+    inptr2 = input_buf[2][input_row];
+    input_row++;
+    outptr0 = *output_buf++;
+    outptr1 = outptr0 + plane_size;
+    outptr2 = outptr1 + plane_size;
+    for (col = 0; col < num_cols; col++) {
+      y  = GETJSAMPLE(inptr0[col]);
+      cb = GETJSAMPLE(inptr1[col]);
+      cr = GETJSAMPLE(inptr2[col]);
+      outptr0[col] = range_limit[y + Crrtab[cr]];
+      outptr1[col] = range_limit[y +
+			      ((int) RIGHT_SHIFT(Cbgtab[cb] + Crgtab[cr],
+						 SCALEBITS))];
+      outptr2[col] = range_limit[y + Cbbtab[cb]];
+    }
+  }
+}
+
+
+#ifdef JPEG_SIMD
+
+METHODDEF(void)
+ycc_rgb_planar_convert_sse2 (j_decompress_ptr cinfo,
+			     JSAMPIMAGE input_buf, JDIMENSION input_row,
+			     JSAMPARRAY output_buf, int num_rows)
+{
+  my_cconvert_ptr cconvert = (my_cconvert_ptr) cinfo->cconvert;
+  size_t plane_size = cconvert->plane_size;
+  JSAMPROW outptr;
+
+  while (--num_rows >= 0) {
+    outptr = *output_buf++;
+    jsimd_ycc_rgb_row_sse2(input_buf[0][input_row], input_buf[1][input_row],
+			   input_buf[2][input_row], outptr,
+			   outptr + plane_size, outptr + 2*plane_size,
+			   1, cinfo->output_width);
+    input_row++;
+  }
+}
+
+static const imCPUVariant ycc_rgb_planar_variants[] = {
+  { IM_CPU_SSE2, (imCPUFunc) ycc_rgb_planar_convert_sse2 },
+  { 0, (imCPUFunc) ycc_rgb_planar_convert }
+};
+static imCPUKernel ycc_rgb_planar_kernel =
+  IM_CPU_KERNEL("JPEGYccRgbPlanar", ycc_rgb_planar_variants);
+
+#endif /* JPEG_SIMD */
+
+
+/*
+ * No colorspace change, each component is copied to its own plane.
+ */
+
+METHODDEF(void)
+null_planar_convert (j_decompress_ptr cinfo,
+		     JSAMPIMAGE input_buf, JDIMENSION input_row,
+		     JSAMPARRAY output_buf, int num_rows)
+{
+  my_cconvert_ptr cconvert = (my_cconvert_ptr) cinfo->cconvert;
+  int ci;
+
+  while (--num_rows >= 0) {
+    for (ci = 0; ci < cinfo->num_components; ci++)
+      MEMCOPY(output_buf[0] + ci * cconvert->plane_size,
+	      input_buf[ci][input_row], cinfo->output_width * SIZEOF(JSAMPLE));
+    input_row++;
+    output_buf++;
+  }
+}
+
+
+/*
+ * Request planar output from jpeg_read_scanlines.
+ * Must be called after jpeg_start_decompress.  The scanline pointers given
+ * to jpeg_read_scanlines then address the first component and component ci
+ * is stored at ci*plane_size samples after it, so the application can
+ * decode directly to separate planes.
+ * Returns FALSE, and leaves the output interleaved, when the selected
+ * processing does not go through a separate color conversion step
+ * (merged upsampling or color quantization) or the conversion is not
+ * one of YCbCr->RGB or a null conversion.
+ */
+
+GLOBAL(boolean)
+jpeg_set_planar_output (j_decompress_ptr cinfo, size_t plane_size)
+{
+  my_cconvert_ptr cconvert = (my_cconvert_ptr) cinfo->cconvert;
+
+  if (cinfo->global_state != DSTATE_SCANNING || cconvert == NULL ||
+      cinfo->quantize_colors || cinfo->raw_data_out)
+    return FALSE;
+
+  if (cinfo->out_color_components == 1)
+    return TRUE;		/* a single plane is already planar */
+
+  if (cconvert->pub.color_convert == ycc_rgb_convert
+#ifdef JPEG_SIMD
+      || cconvert->pub.color_convert == ycc_rgb_convert_sse2
+#endif
+      ) {
+    if (RGB_RED != 0 || RGB_GREEN != 1 || RGB_BLUE != 2)
+      return FALSE;
+#ifdef JPEG_SIMD
+    cconvert->pub.color_convert =
+      (color_convert_ptr) jsimd_select(&ycc_rgb_planar_kernel);
+#else
+    cconvert->pub.color_convert = ycc_rgb_planar_convert;
+#endif
+  } else if (cconvert->pub.color_convert == null_convert)
+    cconvert->pub.color_convert = null_planar_convert;
+  else
+    return FALSE;
+
+  cconvert->plane_size = plane_size;
+  return TRUE;
+}
+
+
 /*
  * Empty method for start_pass.
  */
@@ -358,7 +552,12 @@ jinit_color_deconverter (j_decompress_ptr cinfo)
   case JCS_RGB:
     cinfo->out_color_components = RGB_PIXELSIZE;
     if (cinfo->jpeg_color_space == JCS_YCbCr) {
+#ifdef JPEG_SIMD
+      cconvert->pub.color_convert =
+	(color_convert_ptr) jsimd_select(&ycc_rgb_kernel);
+#else
       cconvert->pub.color_convert = ycc_rgb_convert;
+#endif
       build_ycc_rgb_table(cinfo);
     } else if (cinfo->jpeg_color_space == JCS_GRAYSCALE) {
       cconvert->pub.color_convert = gray_rgb_convert;
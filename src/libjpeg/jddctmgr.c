@@ -20,6 +20,7 @@
 #include "jinclude.h"
 #include "jpeglib.h"
 #include "jdct.h"		/* Private declarations for DCT subsystem */
+#include "jsimd.h"
 
 
 /*
@@ -86,6 +87,36 @@ typedef union {
  * a matching multiplier table.
  */
 
+#ifdef JPEG_SIMD
+
+/* SSE2 and scalar variants of the accurate integer IDCTs, see jsimd.h. */
+
+static const imCPUVariant idct_islow_variants[] = {
+  { IM_CPU_SSE2, (imCPUFunc) jsimd_idct_islow_sse2 },
+  { 0, (imCPUFunc) jpeg_idct_islow }
+};
+static imCPUKernel idct_islow_kernel =
+  IM_CPU_KERNEL("JPEGIdctIslow", idct_islow_variants);
+
+#ifdef IDCT_SCALING_SUPPORTED
+static const imCPUVariant idct_16x16_variants[] = {
+  { IM_CPU_SSE2, (imCPUFunc) jsimd_idct_16x16_sse2 },
+  { 0, (imCPUFunc) jpeg_idct_16x16 }
+};
+static imCPUKernel idct_16x16_kernel =
+  IM_CPU_KERNEL("JPEGIdct16x16", idct_16x16_variants);
+
+static const imCPUVariant idct_16x8_variants[] = {
+  { IM_CPU_SSE2, (imCPUFunc) jsimd_idct_16x8_sse2 },
+  { 0, (imCPUFunc) jpeg_idct_16x8 }
+};
+static imCPUKernel idct_16x8_kernel =
+  IM_CPU_KERNEL("JPEGIdct16x8", idct_16x8_variants);
+#endif
+
+#endif /* JPEG_SIMD */
+
+
 METHODDEF(void)
 start_pass (j_decompress_ptr cinfo)
 {
@@ -158,11 +189,19 @@ start_pass (j_decompress_ptr cinfo)
       method = JDCT_ISLOW;	/* jidctint uses islow-style table */
       break;
     case ((16 << 8) + 16):
+#ifdef JPEG_SIMD
+      method_ptr = (inverse_DCT_method_ptr) jsimd_select(&idct_16x16_kernel);
+#else
       method_ptr = jpeg_idct_16x16;
+#endif
       method = JDCT_ISLOW;	/* jidctint uses islow-style table */
       break;
     case ((16 << 8) + 8):
+#ifdef JPEG_SIMD
+      method_ptr = (inverse_DCT_method_ptr) jsimd_select(&idct_16x8_kernel);
+#else
       method_ptr = jpeg_idct_16x8;
+#endif
       method = JDCT_ISLOW;	/* jidctint uses islow-style table */
       break;
     case ((14 << 8) + 7):
@@ -230,7 +269,11 @@ start_pass (j_decompress_ptr cinfo)
       switch (cinfo->dct_method) {
 #ifdef DCT_ISLOW_SUPPORTED
       case JDCT_ISLOW:
+#ifdef JPEG_SIMD
+	method_ptr = (inverse_DCT_method_ptr) jsimd_select(&idct_islow_kernel);
+#else
 	method_ptr = jpeg_idct_islow;
+#endif
 	method = JDCT_ISLOW;
 	break;
 #endif
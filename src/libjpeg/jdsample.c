@@ -22,6 +22,7 @@
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
+#include "jsimd.h"
 
 
 /* Pointer to routine to upsample a single component */
@@ -286,6 +287,27 @@ h2v2_upsample (j_decompress_ptr cinfo, jpeg_component_info * compptr,
 }
 
 
+#ifdef JPEG_SIMD
+
+/* SSE2 and scalar variants of the box upsampling, see jsimd.h. */
+
+static const imCPUVariant h2v1_upsample_variants[] = {
+  { IM_CPU_SSE2, (imCPUFunc) jsimd_h2v1_upsample_sse2 },
+  { 0, (imCPUFunc) h2v1_upsample }
+};
+static imCPUKernel h2v1_upsample_kernel =
+  IM_CPU_KERNEL("JPEGH2V1Upsample", h2v1_upsample_variants);
+
+static const imCPUVariant h2v2_upsample_variants[] = {
+  { IM_CPU_SSE2, (imCPUFunc) jsimd_h2v2_upsample_sse2 },
+  { 0, (imCPUFunc) h2v2_upsample }
+};
+static imCPUKernel h2v2_upsample_kernel =
+  IM_CPU_KERNEL("JPEGH2V2Upsample", h2v2_upsample_variants);
+
+#endif /* JPEG_SIMD */
+
+
 /*
  * Module initialization routine for upsampling.
  */
@@ -337,11 +359,21 @@ jinit_upsampler (j_decompress_ptr cinfo)
     } else if (h_in_group * 2 == h_out_group &&
 	       v_in_group == v_out_group) {
       /* Special case for 2h1v upsampling */
+#ifdef JPEG_SIMD
+      upsample->methods[ci] =
+	(upsample1_ptr) jsimd_select(&h2v1_upsample_kernel);
+#else
       upsample->methods[ci] = h2v1_upsample;
+#endif
     } else if (h_in_group * 2 == h_out_group &&
 	       v_in_group * 2 == v_out_group) {
       /* Special case for 2h2v upsampling */
+#ifdef JPEG_SIMD
+      upsample->methods[ci] =
+	(upsample1_ptr) jsimd_select(&h2v2_upsample_kernel);
+#else
       upsample->methods[ci] = h2v2_upsample;
+#endif
     } else if ((h_out_group % h_in_group) == 0 &&
 	       (v_out_group % v_in_group) == 0) {
       /* Generic integral-factors upsampling method */
@@ -903,6 +903,7 @@ typedef JMETHOD(boolean, jpeg_marker_parser_method, (j_decompress_ptr cinfo));
 #define jpeg_read_scanlines	jReadScanlines
 #define jpeg_finish_decompress	jFinDecompress
 #define jpeg_read_raw_data	jReadRawData
+#define jpeg_set_planar_output	jSetPlanarOut
 #define jpeg_has_multiple_scans	jHasMultScn
 #define jpeg_start_output	jStrtOutput
 #define jpeg_finish_output	jFinOutput
@@ -1040,6 +1041,10 @@ EXTERN(JDIMENSION) jpeg_read_raw_data JPP((j_decompress_ptr cinfo,
 					   JSAMPIMAGE data,
 					   JDIMENSION max_lines));
 
+/* Planar output from jpeg_read_scanlines (IM extension, see jdcolor.c). */
+EXTERN(boolean) jpeg_set_planar_output JPP((j_decompress_ptr cinfo,
+					    size_t plane_size));
+
 /* Additional entry points for buffered-image mode. */
 EXTERN(boolean) jpeg_has_multiple_scans JPP((j_decompress_ptr cinfo));
 EXTERN(boolean) jpeg_start_output JPP((j_decompress_ptr cinfo,
@@ -0,0 +1,82 @@
+/*
+ * jsimd.h
+ *
+ * This file is not part of the Independent JPEG Group's software.
+ * It was added for the IM library.
+ *
+ * This include file declares the SSE2 versions of the integer DCT,
+ * color conversion and upsampling routines (see jsimd_sse2.c).
+ * They are compiled only when JPEG_SIMD is defined and the compiler
+ * targets a processor with SSE2.  Every routine produces exactly the
+ * same output as its portable counterpart, so the choice between them
+ * is made at run time.  Each routine and its portable counterpart are
+ * the variants of an IM kernel (see im_cpu.h), selected by jsimd_select().
+ */
+
+#if defined(JPEG_SIMD) && BITS_IN_JSAMPLE != 8
+#undef JPEG_SIMD		/* kernels handle only 8-bit samples */
+#endif
+
+#if defined(JPEG_SIMD) && !defined(__SSE2__) && !defined(_M_X64) && \
+    !defined(_M_AMD64) && !(defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#undef JPEG_SIMD		/* compiler can not generate SSE2 code */
+#endif
+
+#ifdef JPEG_SIMD
+
+#include "im_cpu.h"
+
+#ifdef NEED_SHORT_EXTERNAL_NAMES
+#define jsimd_select			jSSelect
+#define jsimd_idct_islow_sse2		jSIdctIslow
+#define jsimd_idct_16x16_sse2		jSIdct16x16
+#define jsimd_idct_16x8_sse2		jSIdct16x8
+#define jsimd_fdct_islow_sse2		jSFdctIslow
+#define jsimd_ycc_rgb_row_sse2		jSYccRgbRow
+#define jsimd_rgb_ycc_row_sse2		jSRgbYccRow
+#define jsimd_h2v1_upsample_sse2	jSH2V1Upsample
+#define jsimd_h2v2_upsample_sse2	jSH2V2Upsample
+#endif /* NEED_SHORT_EXTERNAL_NAMES */
+
+/* Returns the variant of the kernel for the current processor features,
+ * the kernel is registered in the first call.  The variants are the SSE2
+ * routine and the portable one, which must be the last.
+ * Setting the environment variable JSIMD_FORCENONE=1 selects the portable one.
+ */
+EXTERN(imCPUFunc) jsimd_select JPP((imCPUKernel * kernel));
+
+#ifdef RANGE_MASK		/* jdct.h included */
+EXTERN(void) jsimd_idct_islow_sse2
+    JPP((j_decompress_ptr cinfo, jpeg_component_info * compptr,
+	 JCOEFPTR coef_block, JSAMPARRAY output_buf, JDIMENSION output_col));
+EXTERN(void) jsimd_idct_16x16_sse2
+    JPP((j_decompress_ptr cinfo, jpeg_component_info * compptr,
+	 JCOEFPTR coef_block, JSAMPARRAY output_buf, JDIMENSION output_col));
+EXTERN(void) jsimd_idct_16x8_sse2
+    JPP((j_decompress_ptr cinfo, jpeg_component_info * compptr,
+	 JCOEFPTR coef_block, JSAMPARRAY output_buf, JDIMENSION output_col));
+EXTERN(void) jsimd_fdct_islow_sse2
+    JPP((DCTELEM * data, JSAMPARRAY sample_data, JDIMENSION start_col));
+#endif
+
+/* YCbCr->RGB for one row.  The output components are written at
+ * outptr0/1/2 and advance pixel_step samples per pixel, so this serves
+ * both interleaved (pixel_step = RGB_PIXELSIZE) and planar (1) output.
+ */
+EXTERN(void) jsimd_ycc_rgb_row_sse2
+    JPP((JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW inptr2,
+	 JSAMPROW outptr0, JSAMPROW outptr1, JSAMPROW outptr2,
+	 int pixel_step, JDIMENSION num_cols));
+/* RGB->YCbCr for one row of interleaved RGB_PIXELSIZE input. */
+EXTERN(void) jsimd_rgb_ycc_row_sse2
+    JPP((JSAMPROW inptr, JSAMPROW outptr0, JSAMPROW outptr1,
+	 JSAMPROW outptr2, JDIMENSION num_cols));
+
+EXTERN(void) jsimd_h2v1_upsample_sse2
+    JPP((j_decompress_ptr cinfo, jpeg_component_info * compptr,
+	 JSAMPARRAY input_data, JSAMPARRAY * output_data_ptr));
+EXTERN(void) jsimd_h2v2_upsample_sse2
+    JPP((j_decompress_ptr cinfo, jpeg_component_info * compptr,
+	 JSAMPARRAY input_data, JSAMPARRAY * output_data_ptr));
+
+#endif /* JPEG_SIMD */
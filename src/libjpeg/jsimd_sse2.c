@@ -0,0 +1,733 @@
+/*
+ * jsimd_sse2.c
+ *
+ * This file is not part of the Independent JPEG Group's software.
+ * It was added for the IM library.
+ *
+ * This file contains SSE2 versions of the most expensive decoding and
+ * encoding steps: the accurate integer IDCT for the 8x8, 16x16 and 16x8
+ * output sizes (the last two are used for the "fancy" upsampling of
+ * subsampled chroma), the accurate integer FDCT, YCbCr<->RGB color
+ * conversion and the 2h1v and 2h2v box upsampling.
+ *
+ * The integer DCTs in jidctint.c and jfdctint.c compute each pass
+ * with exact integer products and sums, rounding only in the final
+ * descale.  Each pass is therefore an integer matrix product followed
+ * by the same descale, and the matrices below are the expanded
+ * butterflies of those routines.  The products are computed with
+ * _mm_madd_epi16 in 32 bits from 16-bit inputs, so the results are bit
+ * exact while the dequantized coefficients and the intermediate values
+ * fit in 15 bits and the outputs are inside the range where the scalar
+ * range limit table clamps.  This is the case for any valid baseline or
+ * progressive 8-bit JPEG file.  Each IDCT checks those ranges and, when
+ * any value is outside them, the block is computed again by the scalar
+ * routine, so the results are bit exact for all inputs.
+ * The color conversions reproduce the table arithmetic of jdcolor.c
+ * and jccolor.c exactly.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jdct.h"		/* Private declarations for DCT subsystem */
+#include "jsimd.h"
+
+#ifdef JPEG_SIMD
+
+#include <stdlib.h>
+#include <emmintrin.h>
+
+#include "im_cpu.h"
+
+
+GLOBAL(imCPUFunc)
+jsimd_select (imCPUKernel * kernel)
+{
+  static int force_none = -1;
+  imCPUFunc func;
+
+  if (force_none == -1) {
+    char * env = getenv("JSIMD_FORCENONE");
+    force_none = (env && env[0] == '1' && env[1] == 0);
+  }
+
+  /* detected by IM, also limited by the IM_CPU environment variable,
+     always called so the kernel is registered */
+  func = imCPUKernelSelect(kernel);
+
+  if (force_none)
+    return kernel->variant[kernel->count-1].func;
+
+  return func;
+}
+
+
+/**************** Integer DCT ****************/
+
+
+#define CONST_BITS  13
+#define PASS1_BITS  2
+
+/* IDCT matrices, one row for each pair of outputs (p, N-1-p).
+ * The first four values multiply the even inputs 0, 2, 4, 6 and the last
+ * four the odd inputs 1, 3, 5, 7.  Output p is even+odd, N-1-p even-odd.
+ */
+
+static const short idct_8_coef[4][8] = {
+  {   8192,  10703,   8192,   4433,  11363,   9633,   6437,   2260 },
+  {   8192,   4433,  -8192, -10704,   9633,  -2259, -11362,  -6436 },
+  {   8192,  -4433,  -8192,  10704,   6437, -11362,   2261,   9633 },
+  {   8192, -10703,   8192,  -4433,   2260,  -6436,   9633, -11363 }
+};
+
+static const short idct_16_coef[8][8] = {
+  {   8192,  11363,  10703,   9632,  11529,  11086,  10217,   8956 },
+  {   8192,   9633,   4433,  -2260,  11086,   7350,   1136,  -5461 },
+  {   8192,   6437,  -4433, -11363,  10217,   1136,  -8955, -11086 },
+  {   8192,   2260, -10703,  -6436,   8956,  -5461, -11086,   1137 },
+  {   8192,  -2260, -10703,   6436,   7350, -10217,  -3363,  11529 },
+  {   8192,  -6437,  -4433,  11363,   5461, -11529,   7349,   3363 },
+  {   8192,  -9633,   4433,   2260,   3363,  -8955,  11529, -10217 },
+  {   8192, -11363,  10703,  -9632,   1136,  -3363,   5461,  -7350 }
+};
+
+/* FDCT matrix, one row for each pair of outputs (2i, 2i+1).
+ * The first four values multiply the sums in[k]+in[7-k] for the even output,
+ * the last four the differences in[k]-in[7-k] for the odd output.
+ */
+
+static const short fdct_8_coef[4][8] = {
+  {   8192,   8192,   8192,   8192,  11363,   9633,   6437,   2260 },
+  {  10703,   4433,  -4433, -10703,   9633,  -2259, -11362,  -6436 },
+  {   8192,  -8192,  -8192,   8192,   6437, -11362,   2261,   9633 },
+  {   4433, -10704,  10704,  -4433,   2260,  -6436,   9633, -11363 }
+};
+
+
+/* Accumulates in acc the 32-bit lanes of v outside [-2^(bits-1), 2^(bits-1)-1],
+ * acc is zero only if all of them are inside.
+ */
+
+#define RANGE_CHECK(acc, v, bits) \
+  ((acc) = _mm_or_si128((acc), _mm_srli_epi32( \
+      _mm_add_epi32((v), _mm_set1_epi32(1 << ((bits)-1))), (bits))))
+
+#define RANGE_OUTSIDE(acc) \
+  (_mm_movemask_epi8(_mm_cmpeq_epi32((acc), _mm_setzero_si128())) != 0xFFFF)
+
+/* The inputs and the outputs of the first pass must fit in 15 bits,
+ * so the madd sums of 16383*81678 (the largest row of coefficients)
+ * do not overflow.  The outputs of the second pass must be inside the
+ * range where the sample range limit table of the scalar routines clamps.
+ */
+
+#define IDCT_IN_BITS   15
+#define IDCT_OUT_BITS  (BITS_IN_JSAMPLE+2)
+
+
+/* Transpose an 8x8 matrix of 16-bit elements. */
+
+LOCAL(void)
+transpose_8x8 (__m128i * r)
+{
+  __m128i a0 = _mm_unpacklo_epi16(r[0], r[1]);
+  __m128i a1 = _mm_unpackhi_epi16(r[0], r[1]);
+  __m128i a2 = _mm_unpacklo_epi16(r[2], r[3]);
+  __m128i a3 = _mm_unpackhi_epi16(r[2], r[3]);
+  __m128i a4 = _mm_unpacklo_epi16(r[4], r[5]);
+  __m128i a5 = _mm_unpackhi_epi16(r[4], r[5]);
+  __m128i a6 = _mm_unpacklo_epi16(r[6], r[7]);
+  __m128i a7 = _mm_unpackhi_epi16(r[6], r[7]);
+
+  __m128i b0 = _mm_unpacklo_epi32(a0, a2);
+  __m128i b1 = _mm_unpackhi_epi32(a0, a2);
+  __m128i b2 = _mm_unpacklo_epi32(a1, a3);
+  __m128i b3 = _mm_unpackhi_epi32(a1, a3);
+  __m128i b4 = _mm_unpacklo_epi32(a4, a6);
+  __m128i b5 = _mm_unpackhi_epi32(a4, a6);
+  __m128i b6 = _mm_unpacklo_epi32(a5, a7);
+  __m128i b7 = _mm_unpackhi_epi32(a5, a7);
+
+  r[0] = _mm_unpacklo_epi64(b0, b4);
+  r[1] = _mm_unpackhi_epi64(b0, b4);
+  r[2] = _mm_unpacklo_epi64(b1, b5);
+  r[3] = _mm_unpackhi_epi64(b1, b5);
+  r[4] = _mm_unpacklo_epi64(b2, b6);
+  r[5] = _mm_unpackhi_epi64(b2, b6);
+  r[6] = _mm_unpacklo_epi64(b3, b7);
+  r[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+
+/*
+ * One IDCT pass over 8 columns: in[0..7] hold the 8 input coefficients of
+ * each column, out[0..count-1] receive the count (8 or 16) descaled outputs.
+ * The descaled outputs outside range_bits are accumulated in range.
+ */
+
+LOCAL(void)
+idct_pass (const __m128i * in, __m128i * out, const short (*coef)[8],
+	   int count, __m128i fudge, int shift,
+	   __m128i * range, int range_bits)
+{
+  __m128i e0l = _mm_unpacklo_epi16(in[0], in[2]);
+  __m128i e0h = _mm_unpackhi_epi16(in[0], in[2]);
+  __m128i e1l = _mm_unpacklo_epi16(in[4], in[6]);
+  __m128i e1h = _mm_unpackhi_epi16(in[4], in[6]);
+  __m128i o0l = _mm_unpacklo_epi16(in[1], in[3]);
+  __m128i o0h = _mm_unpackhi_epi16(in[1], in[3]);
+  __m128i o1l = _mm_unpacklo_epi16(in[5], in[7]);
+  __m128i o1h = _mm_unpackhi_epi16(in[5], in[7]);
+  __m128i sh = _mm_cvtsi32_si128(shift);
+  int p;
+
+  for (p = 0; p < count/2; p++) {
+    __m128i c = _mm_loadu_si128((const __m128i *) coef[p]);
+    __m128i c0 = _mm_shuffle_epi32(c, 0x00);
+    __m128i c1 = _mm_shuffle_epi32(c, 0x55);
+    __m128i c2 = _mm_shuffle_epi32(c, 0xAA);
+    __m128i c3 = _mm_shuffle_epi32(c, 0xFF);
+
+    __m128i el = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(e0l, c0),
+					     _mm_madd_epi16(e1l, c1)), fudge);
+    __m128i eh = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(e0h, c0),
+					     _mm_madd_epi16(e1h, c1)), fudge);
+    __m128i ol = _mm_add_epi32(_mm_madd_epi16(o0l, c2), _mm_madd_epi16(o1l, c3));
+    __m128i oh = _mm_add_epi32(_mm_madd_epi16(o0h, c2), _mm_madd_epi16(o1h, c3));
+
+    __m128i pl = _mm_sra_epi32(_mm_add_epi32(el, ol), sh);
+    __m128i ph = _mm_sra_epi32(_mm_add_epi32(eh, oh), sh);
+    __m128i ml = _mm_sra_epi32(_mm_sub_epi32(el, ol), sh);
+    __m128i mh = _mm_sra_epi32(_mm_sub_epi32(eh, oh), sh);
+
+    RANGE_CHECK(*range, pl, range_bits);
+    RANGE_CHECK(*range, ph, range_bits);
+    RANGE_CHECK(*range, ml, range_bits);
+    RANGE_CHECK(*range, mh, range_bits);
+
+    out[p] = _mm_packs_epi32(pl, ph);
+    out[count-1-p] = _mm_packs_epi32(ml, mh);
+  }
+}
+
+
+/* Load the coefficient block and dequantize it, one row per register.
+ * Returns the range accumulator of the quantization values and of the
+ * exact 32-bit products.
+ */
+
+LOCAL(__m128i)
+idct_dequantize (jpeg_component_info * compptr, JCOEFPTR coef_block,
+		 __m128i * in)
+{
+  ISLOW_MULT_TYPE * quantptr = (ISLOW_MULT_TYPE *) compptr->dct_table;
+  __m128i range = _mm_setzero_si128();
+  int row;
+
+  for (row = 0; row < DCTSIZE; row++) {
+    __m128i q0 = _mm_loadu_si128((const __m128i *) (quantptr + row*DCTSIZE));
+    __m128i q1 = _mm_loadu_si128((const __m128i *) (quantptr + row*DCTSIZE + 4));
+    __m128i q = _mm_packs_epi32(q0, q1);
+    __m128i c = _mm_loadu_si128((const __m128i *) (coef_block + row*DCTSIZE));
+    __m128i lo = _mm_mullo_epi16(c, q);
+    __m128i hi = _mm_mulhi_epi16(c, q);
+
+    RANGE_CHECK(range, q0, IDCT_IN_BITS);
+    RANGE_CHECK(range, q1, IDCT_IN_BITS);
+    RANGE_CHECK(range, _mm_unpacklo_epi16(lo, hi), IDCT_IN_BITS);
+    RANGE_CHECK(range, _mm_unpackhi_epi16(lo, hi), IDCT_IN_BITS);
+
+    in[row] = lo;
+  }
+
+  return range;
+}
+
+
+/* Column pass fudge and row pass fudge, see jidctint.c */
+
+#define IDCT_PASS1_FUDGE  _mm_set1_epi32(ONE << (CONST_BITS-PASS1_BITS-1))
+#define IDCT_PASS1_SHIFT  (CONST_BITS-PASS1_BITS)
+#define IDCT_PASS2_FUDGE  _mm_set1_epi32((ONE << (PASS1_BITS+2)) << CONST_BITS)
+#define IDCT_PASS2_SHIFT  (CONST_BITS+PASS1_BITS+3)
+
+
+/* Store 8 rows of 8 or 16 samples, given as transposed 16-bit columns. */
+
+LOCAL(void)
+idct_store (__m128i * left, __m128i * right, JSAMPARRAY output_buf,
+	    JDIMENSION output_col)
+{
+  __m128i center = _mm_set1_epi16(CENTERJSAMPLE);
+  int row;
+
+  transpose_8x8(left);
+  if (right)
+    transpose_8x8(right);
+
+  for (row = 0; row < 8; row++) {
+    JSAMPROW outptr = output_buf[row] + output_col;
+    __m128i l = _mm_adds_epi16(left[row], center);
+    if (right) {
+      __m128i r = _mm_adds_epi16(right[row], center);
+      _mm_storeu_si128((__m128i *) outptr, _mm_packus_epi16(l, r));
+    } else
+      _mm_storel_epi64((__m128i *) outptr, _mm_packus_epi16(l, l));
+  }
+}
+
+
+GLOBAL(void)
+jsimd_idct_islow_sse2 (j_decompress_ptr cinfo, jpeg_component_info * compptr,
+		       JCOEFPTR coef_block,
+		       JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  __m128i in[8], ws[8], out[8];
+  __m128i range = idct_dequantize(compptr, coef_block, in);
+
+  /* Pass 1: process columns from input. */
+  idct_pass(in, ws, idct_8_coef, 8, IDCT_PASS1_FUDGE, IDCT_PASS1_SHIFT,
+	    &range, IDCT_IN_BITS);
+
+  /* Pass 2: process rows. */
+  transpose_8x8(ws);
+  idct_pass(ws, out, idct_8_coef, 8, IDCT_PASS2_FUDGE, IDCT_PASS2_SHIFT,
+	    &range, IDCT_OUT_BITS);
+
+  if (RANGE_OUTSIDE(range)) {
+    jpeg_idct_islow(cinfo, compptr, coef_block, output_buf, output_col);
+    return;
+  }
+
+  idct_store(out, NULL, output_buf, output_col);
+}
+
+
+#ifdef IDCT_SCALING_SUPPORTED
+
+GLOBAL(void)
+jsimd_idct_16x16_sse2 (j_decompress_ptr cinfo, jpeg_component_info * compptr,
+		       JCOEFPTR coef_block,
+		       JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  __m128i in[8], ws[16], out[2][16];
+  __m128i range = idct_dequantize(compptr, coef_block, in);
+  int half;
+
+  /* Pass 1: process columns from input, 16 output rows. */
+  idct_pass(in, ws, idct_16_coef, 16, IDCT_PASS1_FUDGE, IDCT_PASS1_SHIFT,
+	    &range, IDCT_IN_BITS);
+
+  /* Pass 2: process 16 rows, 8 at a time,
+     all of them checked before anything is stored. */
+  for (half = 0; half < 2; half++) {
+    transpose_8x8(ws + 8*half);
+    idct_pass(ws + 8*half, out[half], idct_16_coef, 16,
+	      IDCT_PASS2_FUDGE, IDCT_PASS2_SHIFT, &range, IDCT_OUT_BITS);
+  }
+
+  if (RANGE_OUTSIDE(range)) {
+    jpeg_idct_16x16(cinfo, compptr, coef_block, output_buf, output_col);
+    return;
+  }
+
+  for (half = 0; half < 2; half++)
+    idct_store(out[half], out[half] + 8, output_buf + 8*half, output_col);
+}
+
+
+GLOBAL(void)
+jsimd_idct_16x8_sse2 (j_decompress_ptr cinfo, jpeg_component_info * compptr,
+		      JCOEFPTR coef_block,
+		      JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  __m128i in[8], ws[8], out[16];
+  __m128i range = idct_dequantize(compptr, coef_block, in);
+
+  /* Pass 1: process columns from input, 8-point IDCT. */
+  idct_pass(in, ws, idct_8_coef, 8, IDCT_PASS1_FUDGE, IDCT_PASS1_SHIFT,
+	    &range, IDCT_IN_BITS);
+
+  /* Pass 2: process 8 rows, 16-point IDCT. */
+  transpose_8x8(ws);
+  idct_pass(ws, out, idct_16_coef, 16, IDCT_PASS2_FUDGE, IDCT_PASS2_SHIFT,
+	    &range, IDCT_OUT_BITS);
+
+  if (RANGE_OUTSIDE(range)) {
+    jpeg_idct_16x8(cinfo, compptr, coef_block, output_buf, output_col);
+    return;
+  }
+
+  idct_store(out, out + 8, output_buf, output_col);
+}
+
+#endif /* IDCT_SCALING_SUPPORTED */
+
+
+/*
+ * One FDCT pass over 8 lanes, outputs are left in 32 bits.
+ * fudge0 is the rounding term of output 0 (it also removes the
+ * unsigned->signed offset in the first pass).
+ */
+
+LOCAL(void)
+fdct_pass (const __m128i * in, __m128i * outl, __m128i * outh,
+	   __m128i fudge0, __m128i fudge, int shift)
+{
+  __m128i s0 = _mm_add_epi16(in[0], in[7]);
+  __m128i s1 = _mm_add_epi16(in[1], in[6]);
+  __m128i s2 = _mm_add_epi16(in[2], in[5]);
+  __m128i s3 = _mm_add_epi16(in[3], in[4]);
+  __m128i d0 = _mm_sub_epi16(in[0], in[7]);
+  __m128i d1 = _mm_sub_epi16(in[1], in[6]);
+  __m128i d2 = _mm_sub_epi16(in[2], in[5]);
+  __m128i d3 = _mm_sub_epi16(in[3], in[4]);
+  __m128i s01l = _mm_unpacklo_epi16(s0, s1), s01h = _mm_unpackhi_epi16(s0, s1);
+  __m128i s23l = _mm_unpacklo_epi16(s2, s3), s23h = _mm_unpackhi_epi16(s2, s3);
+  __m128i d01l = _mm_unpacklo_epi16(d0, d1), d01h = _mm_unpackhi_epi16(d0, d1);
+  __m128i d23l = _mm_unpacklo_epi16(d2, d3), d23h = _mm_unpackhi_epi16(d2, d3);
+  __m128i sh = _mm_cvtsi32_si128(shift);
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    __m128i c = _mm_loadu_si128((const __m128i *) fdct_8_coef[i]);
+    __m128i c0 = _mm_shuffle_epi32(c, 0x00);
+    __m128i c1 = _mm_shuffle_epi32(c, 0x55);
+    __m128i c2 = _mm_shuffle_epi32(c, 0xAA);
+    __m128i c3 = _mm_shuffle_epi32(c, 0xFF);
+    __m128i f = i == 0 ? fudge0 : fudge;
+
+    outl[2*i] = _mm_sra_epi32(_mm_add_epi32(_mm_add_epi32(
+	_mm_madd_epi16(s01l, c0), _mm_madd_epi16(s23l, c1)), f), sh);
+    outh[2*i] = _mm_sra_epi32(_mm_add_epi32(_mm_add_epi32(
+	_mm_madd_epi16(s01h, c0), _mm_madd_epi16(s23h, c1)), f), sh);
+    outl[2*i+1] = _mm_sra_epi32(_mm_add_epi32(_mm_add_epi32(
+	_mm_madd_epi16(d01l, c2), _mm_madd_epi16(d23l, c3)), fudge), sh);
+    outh[2*i+1] = _mm_sra_epi32(_mm_add_epi32(_mm_add_epi32(
+	_mm_madd_epi16(d01h, c2), _mm_madd_epi16(d23h, c3)), fudge), sh);
+  }
+}
+
+
+GLOBAL(void)
+jsimd_fdct_islow_sse2 (DCTELEM * data, JSAMPARRAY sample_data,
+		       JDIMENSION start_col)
+{
+  __m128i zero = _mm_setzero_si128();
+  __m128i rows[8], outl[8], outh[8];
+  int i;
+
+  for (i = 0; i < DCTSIZE; i++) {
+    __m128i s = _mm_loadl_epi64((const __m128i *) (sample_data[i] + start_col));
+    rows[i] = _mm_unpacklo_epi8(s, zero);
+  }
+
+  /* Pass 1: process rows.
+   * The outputs are scaled up by 2**PASS1_BITS as in jfdctint.c.
+   */
+  transpose_8x8(rows);
+  fdct_pass(rows, outl, outh,
+	    _mm_set1_epi32((ONE << (CONST_BITS-PASS1_BITS-1)) -
+			   ((8 * CENTERJSAMPLE) << CONST_BITS)),
+	    _mm_set1_epi32(ONE << (CONST_BITS-PASS1_BITS-1)),
+	    CONST_BITS-PASS1_BITS);
+  for (i = 0; i < DCTSIZE; i++)
+    rows[i] = _mm_packs_epi32(outl[i], outh[i]);
+
+  /* Pass 2: process columns. */
+  transpose_8x8(rows);
+  fdct_pass(rows, outl, outh,
+	    _mm_set1_epi32(ONE << (CONST_BITS+PASS1_BITS-1)),
+	    _mm_set1_epi32(ONE << (CONST_BITS+PASS1_BITS-1)),
+	    CONST_BITS+PASS1_BITS);
+
+  for (i = 0; i < DCTSIZE; i++) {
+    _mm_storeu_si128((__m128i *) (data + i*DCTSIZE), outl[i]);
+    _mm_storeu_si128((__m128i *) (data + i*DCTSIZE + 4), outh[i]);
+  }
+}
+
+
+/**************** Color conversion ****************/
+
+
+#undef FIX			/* jdct.h version uses CONST_BITS */
+
+#define SCALEBITS	16
+#define ONE_HALF	((INT32) 1 << (SCALEBITS-1))
+#define FIX(x)		((INT32) ((x) * (1L<<SCALEBITS) + 0.5))
+
+/* Pack two 16-bit constants as a _mm_madd_epi16 pair */
+#define PAIR(a,b)	_mm_set1_epi32((int) (((unsigned int) (b) << 16) | \
+					      ((unsigned int) (a) & 0xFFFF)))
+
+/* The YCbCr->RGB constants of jdcolor.c do not fit in 16 bits,
+ * so they are split into a multiple of 2**16 and a remainder:
+ *   FIX(1.40200) = 1*65536 + 26345
+ *   FIX(1.77200) = 2*65536 - 14942
+ *   FIX(0.71414) = 1*65536 - 18734
+ * The ONE_HALF rounding is applied as 2 * 16384 inside the products.
+ */
+
+LOCAL(__m128i)
+ycc_rgb_4 (__m128i x, __m128i xshift, __m128i c)
+{
+  return _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(x, c), xshift), SCALEBITS);
+}
+
+
+GLOBAL(void)
+jsimd_ycc_rgb_row_sse2 (JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW inptr2,
+			JSAMPROW outptr0, JSAMPROW outptr1, JSAMPROW outptr2,
+			int pixel_step, JDIMENSION num_cols)
+{
+  __m128i zero = _mm_setzero_si128();
+  __m128i center = _mm_set1_epi16(CENTERJSAMPLE);
+  __m128i two = _mm_set1_epi16(2);
+  __m128i cr_r = PAIR(FIX(1.40200) - 65536, ONE_HALF/2);
+  __m128i cb_b = PAIR(FIX(1.77200) - 2*65536, ONE_HALF/2);
+  __m128i cbcr_g = PAIR(- FIX(0.34414), 65536 - FIX(0.71414));
+  __m128i half = _mm_set1_epi32(ONE_HALF);
+  JSAMPLE r[16], g[16], b[16];
+  JDIMENSION col = 0;
+  int i;
+
+  for (; col + 16 <= num_cols; col += 16) {
+    __m128i y8 = _mm_loadu_si128((const __m128i *) (inptr0 + col));
+    __m128i cb8 = _mm_loadu_si128((const __m128i *) (inptr1 + col));
+    __m128i cr8 = _mm_loadu_si128((const __m128i *) (inptr2 + col));
+    __m128i rgb[3][2];
+    int h;
+
+    for (h = 0; h < 2; h++) {
+      __m128i y, cb, cr, t, lo, hi;
+      if (h == 0) {
+	y = _mm_unpacklo_epi8(y8, zero);
+	cb = _mm_sub_epi16(_mm_unpacklo_epi8(cb8, zero), center);
+	cr = _mm_sub_epi16(_mm_unpacklo_epi8(cr8, zero), center);
+      } else {
+	y = _mm_unpackhi_epi8(y8, zero);
+	cb = _mm_sub_epi16(_mm_unpackhi_epi8(cb8, zero), center);
+	cr = _mm_sub_epi16(_mm_unpackhi_epi8(cr8, zero), center);
+      }
+
+      /* R = y + ((FIX(1.40200) * cr + ONE_HALF) >> 16) */
+      lo = ycc_rgb_4(_mm_unpacklo_epi16(cr, two), _mm_unpacklo_epi16(zero, cr), cr_r);
+      hi = ycc_rgb_4(_mm_unpackhi_epi16(cr, two), _mm_unpackhi_epi16(zero, cr), cr_r);
+      rgb[0][h] = _mm_add_epi16(y, _mm_packs_epi32(lo, hi));
+
+      /* G = y + ((- FIX(0.34414) * cb - FIX(0.71414) * cr + ONE_HALF) >> 16) */
+      t = _mm_unpacklo_epi16(zero, cr);
+      lo = ycc_rgb_4(_mm_unpacklo_epi16(cb, cr), _mm_sub_epi32(half, t), cbcr_g);
+      t = _mm_unpackhi_epi16(zero, cr);
+      hi = ycc_rgb_4(_mm_unpackhi_epi16(cb, cr), _mm_sub_epi32(half, t), cbcr_g);
+      rgb[1][h] = _mm_add_epi16(y, _mm_packs_epi32(lo, hi));
+
+      /* B = y + ((FIX(1.77200) * cb + ONE_HALF) >> 16) */
+      lo = ycc_rgb_4(_mm_unpacklo_epi16(cb, two),
+		     _mm_slli_epi32(_mm_unpacklo_epi16(zero, cb), 1), cb_b);
+      hi = ycc_rgb_4(_mm_unpackhi_epi16(cb, two),
+		     _mm_slli_epi32(_mm_unpackhi_epi16(zero, cb), 1), cb_b);
+      rgb[2][h] = _mm_add_epi16(y, _mm_packs_epi32(lo, hi));
+    }
+
+    /* range limit and store */
+    if (pixel_step == 1) {
+      _mm_storeu_si128((__m128i *) (outptr0 + col), _mm_packus_epi16(rgb[0][0], rgb[0][1]));
+      _mm_storeu_si128((__m128i *) (outptr1 + col), _mm_packus_epi16(rgb[1][0], rgb[1][1]));
+      _mm_storeu_si128((__m128i *) (outptr2 + col), _mm_packus_epi16(rgb[2][0], rgb[2][1]));
+    } else {
+      JDIMENSION offset = col * pixel_step;
+      _mm_storeu_si128((__m128i *) r, _mm_packus_epi16(rgb[0][0], rgb[0][1]));
+      _mm_storeu_si128((__m128i *) g, _mm_packus_epi16(rgb[1][0], rgb[1][1]));
+      _mm_storeu_si128((__m128i *) b, _mm_packus_epi16(rgb[2][0], rgb[2][1]));
+      for (i = 0; i < 16; i++, offset += pixel_step) {
+	outptr0[offset] = r[i];
+	outptr1[offset] = g[i];
+	outptr2[offset] = b[i];
+      }
+    }
+  }
+
+  /* remaining pixels, same arithmetic as jdcolor.c */
+  for (; col < num_cols; col++) {
+    int y  = GETJSAMPLE(inptr0[col]);
+    int cb = GETJSAMPLE(inptr1[col]) - CENTERJSAMPLE;
+    int cr = GETJSAMPLE(inptr2[col]) - CENTERJSAMPLE;
+    int v;
+    JDIMENSION offset = col * pixel_step;
+
+    v = y + (int) ((FIX(1.40200) * cr + ONE_HALF) >> SCALEBITS);
+    outptr0[offset] = (JSAMPLE) (v < 0 ? 0 : v > MAXJSAMPLE ? MAXJSAMPLE : v);
+    v = y + (int) ((- FIX(0.34414) * cb - FIX(0.71414) * cr + ONE_HALF) >> SCALEBITS);
+    outptr1[offset] = (JSAMPLE) (v < 0 ? 0 : v > MAXJSAMPLE ? MAXJSAMPLE : v);
+    v = y + (int) ((FIX(1.77200) * cb + ONE_HALF) >> SCALEBITS);
+    outptr2[offset] = (JSAMPLE) (v < 0 ? 0 : v > MAXJSAMPLE ? MAXJSAMPLE : v);
+  }
+}
+
+
+/* The RGB->YCbCr constants of jccolor.c, those above 2**15 are split:
+ *   FIX(0.58700) = 32768 + 5702
+ *   FIX(0.50000) = 32768
+ * and the Y rounding ONE_HALF is applied as 2 * 16384.
+ */
+
+#define CBCR_OFFSET	((INT32) CENTERJSAMPLE << SCALEBITS)
+
+LOCAL(__m128i)
+rgb_ycc_4 (__m128i p01, __m128i c01, __m128i p23, __m128i c23, __m128i add)
+{
+  return _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(p01, c01),
+						    _mm_madd_epi16(p23, c23)),
+				      add), SCALEBITS);
+}
+
+
+GLOBAL(void)
+jsimd_rgb_ycc_row_sse2 (JSAMPROW inptr, JSAMPROW outptr0, JSAMPROW outptr1,
+			JSAMPROW outptr2, JDIMENSION num_cols)
+{
+  __m128i zero = _mm_setzero_si128();
+  __m128i two = _mm_set1_epi16(2);
+  __m128i y_rg = PAIR(FIX(0.29900), FIX(0.58700) - 32768);
+  __m128i y_b2 = PAIR(FIX(0.11400), ONE_HALF/2);
+  __m128i cb_rg = PAIR(- FIX(0.16874), - FIX(0.33126));
+  __m128i cr_gb = PAIR(- FIX(0.41869), - FIX(0.08131));
+  __m128i cbcr_add = _mm_set1_epi32(CBCR_OFFSET + ONE_HALF - 1);
+  JSAMPLE r[16], g[16], b[16];
+  JDIMENSION col = 0;
+  int i;
+
+  for (; col + 16 <= num_cols; col += 16) {
+    __m128i r8, g8, b8, out[3][2];
+    int h;
+
+    for (i = 0; i < 16; i++, inptr += RGB_PIXELSIZE) {
+      r[i] = inptr[RGB_RED];
+      g[i] = inptr[RGB_GREEN];
+      b[i] = inptr[RGB_BLUE];
+    }
+    r8 = _mm_loadu_si128((const __m128i *) r);
+    g8 = _mm_loadu_si128((const __m128i *) g);
+    b8 = _mm_loadu_si128((const __m128i *) b);
+
+    for (h = 0; h < 2; h++) {
+      __m128i rw, gw, bw, rg, gb, b2, r15, g15, b15;
+      __m128i lo[3], hi[3];
+      if (h == 0) {
+	rw = _mm_unpacklo_epi8(r8, zero);
+	gw = _mm_unpacklo_epi8(g8, zero);
+	bw = _mm_unpacklo_epi8(b8, zero);
+      } else {
+	rw = _mm_unpackhi_epi8(r8, zero);
+	gw = _mm_unpackhi_epi8(g8, zero);
+	bw = _mm_unpackhi_epi8(b8, zero);
+      }
+
+      /* low 4 pixels */
+      rg = _mm_unpacklo_epi16(rw, gw);
+      gb = _mm_unpacklo_epi16(gw, bw);
+      b2 = _mm_unpacklo_epi16(bw, two);
+      r15 = _mm_srli_epi32(_mm_unpacklo_epi16(zero, rw), 1);
+      g15 = _mm_srli_epi32(_mm_unpacklo_epi16(zero, gw), 1);
+      b15 = _mm_srli_epi32(_mm_unpacklo_epi16(zero, bw), 1);
+      lo[0] = rgb_ycc_4(rg, y_rg, b2, y_b2, g15);
+      lo[1] = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(rg, cb_rg), b15),
+					   cbcr_add), SCALEBITS);
+      lo[2] = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(gb, cr_gb), r15),
+					   cbcr_add), SCALEBITS);
+
+      /* high 4 pixels */
+      rg = _mm_unpackhi_epi16(rw, gw);
+      gb = _mm_unpackhi_epi16(gw, bw);
+      b2 = _mm_unpackhi_epi16(bw, two);
+      r15 = _mm_srli_epi32(_mm_unpackhi_epi16(zero, rw), 1);
+      g15 = _mm_srli_epi32(_mm_unpackhi_epi16(zero, gw), 1);
+      b15 = _mm_srli_epi32(_mm_unpackhi_epi16(zero, bw), 1);
+      hi[0] = rgb_ycc_4(rg, y_rg, b2, y_b2, g15);
+      hi[1] = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(rg, cb_rg), b15),
+					   cbcr_add), SCALEBITS);
+      hi[2] = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(gb, cr_gb), r15),
+					   cbcr_add), SCALEBITS);
+
+      out[0][h] = _mm_packs_epi32(lo[0], hi[0]);
+      out[1][h] = _mm_packs_epi32(lo[1], hi[1]);
+      out[2][h] = _mm_packs_epi32(lo[2], hi[2]);
+    }
+
+    _mm_storeu_si128((__m128i *) (outptr0 + col), _mm_packus_epi16(out[0][0], out[0][1]));
+    _mm_storeu_si128((__m128i *) (outptr1 + col), _mm_packus_epi16(out[1][0], out[1][1]));
+    _mm_storeu_si128((__m128i *) (outptr2 + col), _mm_packus_epi16(out[2][0], out[2][1]));
+  }
+
+  /* remaining pixels, same arithmetic as jccolor.c */
+  for (; col < num_cols; col++, inptr += RGB_PIXELSIZE) {
+    INT32 rv = GETJSAMPLE(inptr[RGB_RED]);
+    INT32 gv = GETJSAMPLE(inptr[RGB_GREEN]);
+    INT32 bv = GETJSAMPLE(inptr[RGB_BLUE]);
+    outptr0[col] = (JSAMPLE)
+      ((FIX(0.29900) * rv + FIX(0.58700) * gv + FIX(0.11400) * bv + ONE_HALF)
+       >> SCALEBITS);
+    outptr1[col] = (JSAMPLE)
+      ((- FIX(0.16874) * rv - FIX(0.33126) * gv + FIX(0.50000) * bv +
+	CBCR_OFFSET + ONE_HALF-1) >> SCALEBITS);
+    outptr2[col] = (JSAMPLE)
+      ((FIX(0.50000) * rv - FIX(0.41869) * gv - FIX(0.08131) * bv +
+	CBCR_OFFSET + ONE_HALF-1) >> SCALEBITS);
+  }
+}
+
+
+/**************** Upsampling ****************/
+
+
+/* Duplicate each input sample of one row, as h2v1_upsample in jdsample.c */
+
+LOCAL(void)
+upsample_row_h2 (JSAMPROW inptr, JSAMPROW outptr, JDIMENSION output_width)
+{
+  JDIMENSION col = 0;
+
+  for (; col + 32 <= output_width; col += 32, inptr += 16) {
+    __m128i s = _mm_loadu_si128((const __m128i *) inptr);
+    _mm_storeu_si128((__m128i *) (outptr + col), _mm_unpacklo_epi8(s, s));
+    _mm_storeu_si128((__m128i *) (outptr + col + 16), _mm_unpackhi_epi8(s, s));
+  }
+
+  for (; col < output_width; col += 2, inptr++) {
+    outptr[col] = *inptr;
+    outptr[col+1] = *inptr;
+  }
+}
+
+
+GLOBAL(void)
+jsimd_h2v1_upsample_sse2 (j_decompress_ptr cinfo, jpeg_component_info * compptr,
+			  JSAMPARRAY input_data, JSAMPARRAY * output_data_ptr)
+{
+  JSAMPARRAY output_data = *output_data_ptr;
+  int outrow;
+
+  for (outrow = 0; outrow < cinfo->max_v_samp_factor; outrow++)
+    upsample_row_h2(input_data[outrow], output_data[outrow], cinfo->output_width);
+}
+
+
+GLOBAL(void)
+jsimd_h2v2_upsample_sse2 (j_decompress_ptr cinfo, jpeg_component_info * compptr,
+			  JSAMPARRAY input_data, JSAMPARRAY * output_data_ptr)
+{
+  JSAMPARRAY output_data = *output_data_ptr;
+  int inrow, outrow;
+
+  inrow = outrow = 0;
+  while (outrow < cinfo->max_v_samp_factor) {
+    upsample_row_h2(input_data[inrow], output_data[outrow], cinfo->output_width);
+    upsample_row_h2(input_data[inrow], output_data[outrow+1], cinfo->output_width);
+    inrow++;
+    outrow += 2;
+  }
+}
+
+#endif /* JPEG_SIMD */
@@ -153,6 +153,19 @@ static int imluaFileLoadImageFrame (lua_State *L)
   return 1;
 }
 
+/*****************************************************************************\
+ file:SetPrefetch()
+\*****************************************************************************/
+static int imluaFileSetPrefetch (lua_State *L)
+{
+  imFile *ifile = imlua_checkfile(L, 1);
+  int prefetch = lua_toboolean(L, 2);
+
+  imFileSetPrefetch(ifile, prefetch);
+
+  return 0;
+}
+
 /*****************************************************************************\
  file:LoadImageRegion()
 \*****************************************************************************/
@@ -758,6 +771,7 @@ static const luaL_Reg imfile_metalib[] = {
   {"LoadImageRegion", imluaFileLoadImageRegion},
   {"LoadBitmap", imluaFileLoadBitmap},
   {"LoadBitmapFrame", imluaFileLoadBitmapFrame},
+  {"SetPrefetch", imluaFileSetPrefetch},
   {"SaveImage", imluaFileSaveImage},
   {"GetInfo", imluaFileGetInfo},
   {"SetInfo", imluaFileSetInfo},
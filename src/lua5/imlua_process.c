@@ -3506,6 +3506,12 @@ static int imlua_ProcessOpenMPSetNumThreads(lua_State *L)
   return 1;
 }
 
+static int imlua_ProcessOpenMPCalibrate(lua_State *L)
+{
+  lua_pushinteger(L, imProcessOpenMPCalibrate());
+  return 1;
+}
+
 static const luaL_Reg improcess_lib[] = {
   {"CalcRMSError", imluaCalcRMSError},
   {"CalcSNR", imluaCalcSNR},
@@ -3682,6 +3688,7 @@ static const luaL_Reg improcess_lib[] = {
   
   {"ProcessOpenMPSetMinCount", imlua_ProcessOpenMPSetMinCount},
   {"ProcessOpenMPSetNumThreads", imlua_ProcessOpenMPSetNumThreads},
+  {"ProcessOpenMPCalibrate", imlua_ProcessOpenMPCalibrate},
 
   {NULL, NULL}
 };
@@ -14,10 +14,15 @@
 #include "im_process_pnt.h"
 #include "im_math_op.h"
 #include "im_color.h"
+#include "im_cpu.h"
 
 #include <stdlib.h>
 #include <memory.h>
 
+#if defined(IM_CPU_X86)
+#include <immintrin.h>
+#endif
+
 
 template <class T1, class T2, class T3> 
 static void DoBinaryOp(T1 *map1, T2 *map2, T3 *map, int count, int op)
@@ -85,60 +90,141 @@ static void DoBinaryOp(T1 *map1, T2 *map2, T3 *map, int count, int op)
   }
 }
 
-static void DoBinaryOpByte(imbyte *map1, imbyte *map2, imbyte *map, int count, int op)
+/* Byte operations that are cropped to 0-255, 
+   the variants use saturated arithmetic with the same results. */
+typedef void (*iByteOpFunc)(const imbyte *map1, const imbyte *map2, imbyte *map, int count, int op);
+
+static void iByteOpGeneric(const imbyte *map1, const imbyte *map2, imbyte *map, int count, int op)
 {
   int i;
 
   switch(op)
   {
   case IM_BIN_ADD:
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
-#endif
     for (i = 0; i < count; i++)
       map[i] = (imbyte)crop_byte(add_op((int)map1[i], (int)map2[i]));
     break;
   case IM_BIN_SUB:
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
-#endif
     for (i = 0; i < count; i++)
       map[i] = (imbyte)crop_byte(sub_op((int)map1[i], (int)map2[i]));
     break;
-  case IM_BIN_MUL:
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
-#endif
+  case IM_BIN_DIFF:
     for (i = 0; i < count; i++)
-      map[i] = (imbyte)crop_byte(mul_op((int)map1[i], (int)map2[i]));
+      map[i] = (imbyte)diff_op((int)map1[i], (int)map2[i]);
     break;
-  case IM_BIN_DIV:
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
-#endif
+  case IM_BIN_MIN:
     for (i = 0; i < count; i++)
-      map[i] = (imbyte)crop_byte(div_op((int)map1[i], (int)map2[i]));
+      map[i] = min_op(map1[i], map2[i]);
     break;
-  case IM_BIN_DIFF:
+  case IM_BIN_MAX:
+    for (i = 0; i < count; i++)
+      map[i] = max_op(map1[i], map2[i]);
+    break;
+  }
+}
+
+#if defined(IM_CPU_X86)
+IM_CPU_TARGET("sse2")
+static void iByteOpSSE2(const imbyte *map1, const imbyte *map2, imbyte *map, int count, int op)
+{
+  int i = 0;
+
+  for (; i + 16 <= count; i += 16)
+  {
+    __m128i a = _mm_loadu_si128((const __m128i*)(map1 + i));
+    __m128i b = _mm_loadu_si128((const __m128i*)(map2 + i));
+    __m128i r;
+
+    switch(op)
+    {
+    case IM_BIN_ADD:  r = _mm_adds_epu8(a, b); break;
+    case IM_BIN_SUB:  r = _mm_subs_epu8(a, b); break;
+    case IM_BIN_DIFF: r = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a)); break;
+    case IM_BIN_MIN:  r = _mm_min_epu8(a, b); break;
+    default:          r = _mm_max_epu8(a, b); break;
+    }
+
+    _mm_storeu_si128((__m128i*)(map + i), r);
+  }
+
+  iByteOpGeneric(map1 + i, map2 + i, map + i, count - i, op);
+}
+
+IM_CPU_TARGET("avx2")
+static void iByteOpAVX2(const imbyte *map1, const imbyte *map2, imbyte *map, int count, int op)
+{
+  int i = 0;
+
+  for (; i + 32 <= count; i += 32)
+  {
+    __m256i a = _mm256_loadu_si256((const __m256i*)(map1 + i));
+    __m256i b = _mm256_loadu_si256((const __m256i*)(map2 + i));
+    __m256i r;
+
+    switch(op)
+    {
+    case IM_BIN_ADD:  r = _mm256_adds_epu8(a, b); break;
+    case IM_BIN_SUB:  r = _mm256_subs_epu8(a, b); break;
+    case IM_BIN_DIFF: r = _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a)); break;
+    case IM_BIN_MIN:  r = _mm256_min_epu8(a, b); break;
+    default:          r = _mm256_max_epu8(a, b); break;
+    }
+
+    _mm256_storeu_si256((__m256i*)(map + i), r);
+  }
+
+  iByteOpGeneric(map1 + i, map2 + i, map + i, count - i, op);
+}
+#endif
+
+static const imCPUVariant iByteOpVariant[] = {
+#if defined(IM_CPU_X86)
+  { IM_CPU_AVX2, (imCPUFunc)iByteOpAVX2 },
+  { IM_CPU_SSE2, (imCPUFunc)iByteOpSSE2 },
+#endif
+  { 0, (imCPUFunc)iByteOpGeneric }
+};
+
+static imCPUKernel iByteOpKernel = IM_CPU_KERNEL("ArithmeticOpByte", iByteOpVariant);
+
+#define IM_BYTEOP_BLOCK 65536
+
+static void DoBinaryOpByte(imbyte *map1, imbyte *map2, imbyte *map, int count, int op)
+{
+  int i;
+
+  if (op == IM_BIN_ADD || op == IM_BIN_SUB || op == IM_BIN_DIFF || op == IM_BIN_MIN || op == IM_BIN_MAX)
+  {
+    iByteOpFunc func = (iByteOpFunc)imCPUKernelSelect(&iByteOpKernel);
+    int block_count = (count + IM_BYTEOP_BLOCK - 1) / IM_BYTEOP_BLOCK;
+
 #ifdef _OPENMP
 #pragma omp parallel for if (IM_OMP_MINCOUNT(count))
 #endif
-    for (i = 0; i < count; i++)
-      map[i] = (imbyte)crop_byte(diff_op((int)map1[i], (int)map2[i]));
-    break;
-  case IM_BIN_MIN:
+    for (i = 0; i < block_count; i++)
+    {
+      int start = i * IM_BYTEOP_BLOCK;
+      int size = count - start < IM_BYTEOP_BLOCK? count - start: IM_BYTEOP_BLOCK;
+      func(map1 + start, map2 + start, map + start, size, op);
+    }
+    return;
+  }
+
+  switch(op)
+  {
+  case IM_BIN_MUL:
 #ifdef _OPENMP
 #pragma omp parallel for if (IM_OMP_MINCOUNT(count))
 #endif
     for (i = 0; i < count; i++)
-      map[i] = (imbyte)crop_byte(min_op((int)map1[i], (int)map2[i]));
+      map[i] = (imbyte)crop_byte(mul_op((int)map1[i], (int)map2[i]));
     break;
-  case IM_BIN_MAX:
+  case IM_BIN_DIV:
 #ifdef _OPENMP
 #pragma omp parallel for if (IM_OMP_MINCOUNT(count))
 #endif
     for (i = 0; i < count; i++)
-      map[i] = (imbyte)crop_byte(max_op((int)map1[i], (int)map2[i]));
+      map[i] = (imbyte)crop_byte(div_op((int)map1[i], (int)map2[i]));
     break;
   case IM_BIN_POW:
 #ifdef _OPENMP
@@ -997,6 +1083,7 @@ int imProcessAutoCovariance(const imImage* src_image, const imImage* mean_image,
 
   int counter = imProcessCounterBegin("Auto Convariance");
   imCounterTotal(counter, src_image->depth*src_image->height, "Processing...");
+  imProcessCounterImage(counter, src_image);
 
   for (int i = 0; i < src_image->depth; i++)
   {
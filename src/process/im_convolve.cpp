@@ -210,31 +210,18 @@ void imProcessRotateKernel(imImage* kernel)
 }
 
 template <class T, class KT, class CT> 
-static int DoCompassConvolve(T* map, T* new_map, int width, int height, KT* orig_kernel_map, int kernel_size, int counter, CT)
+struct iCompassConvolveLine
 {
-  KT total, *kernel_line;
-
-  // duplicate the kernel data so we can rotate it
-  int ksize = kernel_size*kernel_size*sizeof(KT);
-  KT* kernel_map = (KT*)malloc(ksize);
-  memcpy(kernel_map, orig_kernel_map, ksize);
-
-  int ks2 = kernel_size/2;
-
-  total = iKernelTotal(kernel_map, kernel_size, kernel_size);
+  T *map, *new_map;
+  int width, height;
+  KT* kernel_maps;   // the 8 rotations of the kernel
+  int kernel_size;
+  KT total;
 
-  IM_INT_PROCESSING;
-
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
-#endif
-  for(int j = 0; j < height; j++)
+  void operator()(int j)
   {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_BEGIN_PROCESSING;
-
+    int ks2 = kernel_size/2;
+    int kcount = kernel_size*kernel_size;
     int new_offset = j * width;
 
     for(int i = 0; i < width; i++)
@@ -243,13 +230,14 @@ static int DoCompassConvolve(T* map, T* new_map, int width, int height, KT* orig
 
       for(int k = 0; k < 8; k++) // Rotate 8 times
       {
+        KT* kernel_map = kernel_maps + k*kcount;
         CT value = 0;
       
         for(int y = -ks2; y <= ks2; y++)
         {
           int offset;
 
-          kernel_line = kernel_map + (y+ks2)*kernel_size;
+          KT* kernel_line = kernel_map + (y+ks2)*kernel_size;
 
           if (j + y < 0)             // pass the bottom border
             offset = -(y + j + 1) * width;
@@ -271,8 +259,6 @@ static int DoCompassConvolve(T* map, T* new_map, int width, int height, KT* orig
 
         if (abs_op(value) > max_value)
           max_value = abs_op(value);
-
-        iKernelRotate(kernel_map, kernel_size);
       }  
 
       max_value /= total;
@@ -283,16 +269,42 @@ static int DoCompassConvolve(T* map, T* new_map, int width, int height, KT* orig
       else
         new_map[new_offset + i] = (T)max_value;
     }    
+  }
+};
 
-    IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_END_PROCESSING;
+template <class T, class KT, class CT> 
+static int DoCompassConvolve(T* map, T* new_map, int width, int height, KT* orig_kernel_map, int kernel_size, int counter, CT)
+{
+  // compute the 8 rotations of the kernel before the loop, 
+  // so the lines can be processed in any order
+  int kcount = kernel_size*kernel_size;
+  KT* kernel_maps = (KT*)malloc(8*kcount*sizeof(KT));
+  if (!kernel_maps)
+    return 0;
+
+  memcpy(kernel_maps, orig_kernel_map, kcount*sizeof(KT));
+  for(int k = 1; k < 8; k++)
+  {
+    memcpy(kernel_maps + k*kcount, kernel_maps + (k-1)*kcount, kcount*sizeof(KT));
+    iKernelRotate(kernel_maps + k*kcount, kernel_size);
   }
 
-  free(kernel_map);
-  return processing;
+  iCompassConvolveLine<T, KT, CT> line_op;
+  line_op.map = map;
+  line_op.new_map = new_map;
+  line_op.width = width;
+  line_op.height = height;
+  line_op.kernel_maps = kernel_maps;
+  line_op.kernel_size = kernel_size;
+  line_op.total = iKernelTotal(orig_kernel_map, kernel_size, kernel_size);
+
+  imProcessCounterMemory(counter, 8*kcount*sizeof(KT));
+
+  double cost = (double)width*height*8*kcount;
+  int ret = imProcessLines(height, counter, line_op, cost);
+
+  free(kernel_maps);
+  return ret;
 }
 
 int imProcessCompassConvolve(const imImage* src_image, imImage* dst_image, imImage *kernel)
@@ -303,6 +315,7 @@ int imProcessCompassConvolve(const imImage* src_image, imImage* dst_image, imIma
   const char* msg = (const char*)imImageGetAttribute(kernel, "Description", NULL, NULL);
   if (!msg) msg = "Filtering...";
   imCounterTotal(counter, src_image->depth*src_image->height, msg);
+  imProcessCounterImage(counter, src_image);
 
   for (int i = 0; i < src_image->depth; i++)
   {
@@ -356,31 +369,16 @@ int imProcessCompassConvolve(const imImage* src_image, imImage* dst_image, imIma
 }
 
 template <class T, class KT, class CT> 
-static int DoConvolveDual(T* map, T* new_map, int width, int height, KT* kernel_map1, KT* kernel_map2, int kernel_width, int kernel_height, int counter, CT)
+struct iConvolveDualLine
 {
-  KT total1, total2, *kernel_line;
+  T *map, *new_map;
+  int width, height;
+  KT *kernel_map1, *kernel_map2;
+  int kernel_width, kw2, kh2;
+  KT total1, total2;
 
-  int kh2 = kernel_height/2;
-  int kw2 = kernel_width/2;
-
-  if (kernel_height % 2 == 0) kh2--;
-  if (kernel_width % 2 == 0) kw2--;
-
-  total1 = iKernelTotal(kernel_map1, kernel_width, kernel_height);
-  total2 = iKernelTotal(kernel_map2, kernel_width, kernel_height);
-
-  IM_INT_PROCESSING;
-
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
-#endif
-  for(int j = 0; j < height; j++)
+  void operator()(int j)
   {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_BEGIN_PROCESSING;
-
     int new_offset = j * width;
 
     for(int i = 0; i < width; i++)
@@ -391,6 +389,7 @@ static int DoConvolveDual(T* map, T* new_map, int width, int height, KT* kernel_
       for(int y = -kh2; y <= kh2; y++)
       {
         int offset, x;
+        KT* kernel_line;
 
         if (j + y < 0)             // pass the bottom border
           offset = -(y + j + 1) * width;
@@ -433,43 +432,46 @@ static int DoConvolveDual(T* map, T* new_map, int width, int height, KT* kernel_
       else
         new_map[new_offset + i] = (T)value;
     }    
-
-    IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_END_PROCESSING;
   }
+};
 
-  return processing;
-}
-
-template <class T, class KT> 
-static int DoConvolveDualCpx(imComplex<T>* map, imComplex<T>* new_map, int width, int height, KT* kernel_map1, KT* kernel_map2, int kernel_width, int kernel_height, int counter)
+template <class T, class KT, class CT> 
+static int DoConvolveDual(T* map, T* new_map, int width, int height, KT* kernel_map1, KT* kernel_map2, int kernel_width, int kernel_height, int counter, CT)
 {
-  KT total1, total2, *kernel_line;
-
   int kh2 = kernel_height/2;
   int kw2 = kernel_width/2;
 
   if (kernel_height % 2 == 0) kh2--;
   if (kernel_width % 2 == 0) kw2--;
 
-  total1 = iKernelTotal(kernel_map1, kernel_width, kernel_height);
-  total2 = iKernelTotal(kernel_map2, kernel_width, kernel_height);
+  iConvolveDualLine<T, KT, CT> line_op;
+  line_op.map = map;
+  line_op.new_map = new_map;
+  line_op.width = width;
+  line_op.height = height;
+  line_op.kernel_map1 = kernel_map1;
+  line_op.kernel_map2 = kernel_map2;
+  line_op.kernel_width = kernel_width;
+  line_op.kw2 = kw2;
+  line_op.kh2 = kh2;
+  line_op.total1 = iKernelTotal(kernel_map1, kernel_width, kernel_height);
+  line_op.total2 = iKernelTotal(kernel_map2, kernel_width, kernel_height);
+
+  double cost = (double)width*height*2*kernel_width*kernel_height*imProcessTypeCost(map);
+  return imProcessLines(height, counter, line_op, cost);
+}
 
-  IM_INT_PROCESSING;
+template <class T, class KT> 
+struct iConvolveDualCpxLine
+{
+  imComplex<T> *map, *new_map;
+  int width, height;
+  KT *kernel_map1, *kernel_map2;
+  int kernel_width, kw2, kh2;
+  KT total1, total2;
 
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
-#endif
-  for(int j = 0; j < height; j++)
+  void operator()(int j)
   {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_BEGIN_PROCESSING;
-
     int new_offset = j * width;
 
     for(int i = 0; i < width; i++)
@@ -480,6 +482,7 @@ static int DoConvolveDualCpx(imComplex<T>* map, imComplex<T>* new_map, int width
       for(int y = -kh2; y <= kh2; y++)
       {
         int offset, x;
+        KT* kernel_line;
 
         if (j + y < 0)             // pass the bottom border
           offset = -(y + j + 1) * width;
@@ -516,15 +519,33 @@ static int DoConvolveDualCpx(imComplex<T>* map, imComplex<T>* new_map, int width
 
       new_map[new_offset + i] = sqrt(value1*value1 + value2*value2);
     }    
-
-    IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_END_PROCESSING;
   }
+};
+
+template <class T, class KT> 
+static int DoConvolveDualCpx(imComplex<T>* map, imComplex<T>* new_map, int width, int height, KT* kernel_map1, KT* kernel_map2, int kernel_width, int kernel_height, int counter)
+{
+  int kh2 = kernel_height/2;
+  int kw2 = kernel_width/2;
+
+  if (kernel_height % 2 == 0) kh2--;
+  if (kernel_width % 2 == 0) kw2--;
 
-  return processing;
+  iConvolveDualCpxLine<T, KT> line_op;
+  line_op.map = map;
+  line_op.new_map = new_map;
+  line_op.width = width;
+  line_op.height = height;
+  line_op.kernel_map1 = kernel_map1;
+  line_op.kernel_map2 = kernel_map2;
+  line_op.kernel_width = kernel_width;
+  line_op.kw2 = kw2;
+  line_op.kh2 = kh2;
+  line_op.total1 = iKernelTotal(kernel_map1, kernel_width, kernel_height);
+  line_op.total2 = iKernelTotal(kernel_map2, kernel_width, kernel_height);
+
+  double cost = (double)width*height*2*kernel_width*kernel_height*imProcessTypeCost(map);
+  return imProcessLines(height, counter, line_op, cost);
 }
 
 int imProcessConvolveDual(const imImage* src_image, imImage* dst_image, const imImage *kernel1, const imImage *kernel2)
@@ -533,6 +554,7 @@ int imProcessConvolveDual(const imImage* src_image, imImage* dst_image, const im
   const char* msg = (const char*)imImageGetAttribute(kernel1, "Description", NULL, NULL);
   if (!msg) msg = "Filtering...";
   imCounterTotal(counter, src_image->depth*src_image->height, msg);
+  imProcessCounterImage(counter, src_image);
 
   int ret = 0;
 
@@ -600,30 +622,16 @@ int imProcessConvolveDual(const imImage* src_image, imImage* dst_image, const im
 }
 
 template <class T, class KT, class CT> 
-static int DoConvolve(T* map, T* new_map, int width, int height, KT* kernel_map, int kernel_width, int kernel_height, int counter, CT)
+struct iConvolveLine
 {
-  KT total, *kernel_line;
-
-  int kh2 = kernel_height/2;
-  int kw2 = kernel_width/2;
+  T *map, *new_map;
+  int width, height;
+  KT* kernel_map;
+  int kernel_width, kw2, kh2;
+  KT total;
 
-  if (kernel_height % 2 == 0) kh2--;
-  if (kernel_width % 2 == 0) kw2--;
-
-  total = iKernelTotal(kernel_map, kernel_width, kernel_height);
-
-  IM_INT_PROCESSING;
-
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
-#endif
-  for(int j = 0; j < height; j++)
+  void operator()(int j)
   {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_BEGIN_PROCESSING;
-
     int new_offset = j * width;
 
     for(int i = 0; i < width; i++)
@@ -634,7 +642,7 @@ static int DoConvolve(T* map, T* new_map, int width, int height, KT* kernel_map,
       {
         int offset;
 
-        kernel_line = kernel_map + (y+kh2)*kernel_width;
+        KT* kernel_line = kernel_map + (y+kh2)*kernel_width;
 
         if (j + y < 0)             // pass the bottom border
           offset = -(y + j + 1) * width;
@@ -662,42 +670,44 @@ static int DoConvolve(T* map, T* new_map, int width, int height, KT* kernel_map,
       else
         new_map[new_offset + i] = (T)value;
     }    
-
-    IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_END_PROCESSING;
   }
+};
 
-  return processing;
-}
-
-template <class T, class KT> 
-static int DoConvolveCpx(imComplex<T>* map, imComplex<T>* new_map, int width, int height, KT* kernel_map, int kernel_width, int kernel_height, int counter)
+template <class T, class KT, class CT> 
+static int DoConvolve(T* map, T* new_map, int width, int height, KT* kernel_map, int kernel_width, int kernel_height, int counter, CT)
 {
-  KT total, *kernel_line;
-
   int kh2 = kernel_height/2;
   int kw2 = kernel_width/2;
 
   if (kernel_height % 2 == 0) kh2--;
   if (kernel_width % 2 == 0) kw2--;
 
-  total = iKernelTotal(kernel_map, kernel_width, kernel_height);
+  iConvolveLine<T, KT, CT> line_op;
+  line_op.map = map;
+  line_op.new_map = new_map;
+  line_op.width = width;
+  line_op.height = height;
+  line_op.kernel_map = kernel_map;
+  line_op.kernel_width = kernel_width;
+  line_op.kw2 = kw2;
+  line_op.kh2 = kh2;
+  line_op.total = iKernelTotal(kernel_map, kernel_width, kernel_height);
+
+  double cost = (double)width*height*kernel_width*kernel_height*imProcessTypeCost(map);
+  return imProcessLines(height, counter, line_op, cost);
+}
 
-  IM_INT_PROCESSING;
+template <class T, class KT> 
+struct iConvolveCpxLine
+{
+  imComplex<T> *map, *new_map;
+  int width, height;
+  KT* kernel_map;
+  int kernel_width, kw2, kh2;
+  KT total;
 
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
-#endif
-  for(int j = 0; j < height; j++)
+  void operator()(int j)
   {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_BEGIN_PROCESSING;
-
     int new_offset = j * width;
 
     for(int i = 0; i < width; i++)
@@ -708,7 +718,7 @@ static int DoConvolveCpx(imComplex<T>* map, imComplex<T>* new_map, int width, in
       {
         int offset;
 
-        kernel_line = kernel_map + (y+kh2)*kernel_width;
+        KT* kernel_line = kernel_map + (y+kh2)*kernel_width;
 
         if (j + y < 0)             // pass the bottom border
           offset = -(y + j + 1) * width;
@@ -732,15 +742,31 @@ static int DoConvolveCpx(imComplex<T>* map, imComplex<T>* new_map, int width, in
 
       new_map[new_offset + i] = value;
     }    
-
-    IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_END_PROCESSING;
   }
+};
+
+template <class T, class KT> 
+static int DoConvolveCpx(imComplex<T>* map, imComplex<T>* new_map, int width, int height, KT* kernel_map, int kernel_width, int kernel_height, int counter)
+{
+  int kh2 = kernel_height/2;
+  int kw2 = kernel_width/2;
+
+  if (kernel_height % 2 == 0) kh2--;
+  if (kernel_width % 2 == 0) kw2--;
 
-  return processing;
+  iConvolveCpxLine<T, KT> line_op;
+  line_op.map = map;
+  line_op.new_map = new_map;
+  line_op.width = width;
+  line_op.height = height;
+  line_op.kernel_map = kernel_map;
+  line_op.kernel_width = kernel_width;
+  line_op.kw2 = kw2;
+  line_op.kh2 = kh2;
+  line_op.total = iKernelTotal(kernel_map, kernel_width, kernel_height);
+
+  double cost = (double)width*height*kernel_width*kernel_height*imProcessTypeCost(map);
+  return imProcessLines(height, counter, line_op, cost);
 }
 
 static int DoConvolveStep(const imImage* src_image, imImage* dst_image, const imImage *kernel, int counter)
@@ -814,6 +840,7 @@ int imProcessConvolve(const imImage* src_image, imImage* dst_image, const imImag
   const char* msg = (const char*)imImageGetAttribute(kernel, "Description", NULL, NULL);
   if (!msg) msg = "Filtering...";
   imCounterTotal(counter, src_image->depth*src_image->height, msg);
+  imProcessCounterImage(counter, src_image);
 
   int ret = DoConvolveStep(src_image, dst_image, kernel, counter);
 
@@ -832,6 +859,8 @@ int imProcessConvolveRep(const imImage* src_image, imImage* dst_image, const imI
   const char* msg = (const char*)imImageGetAttribute(kernel, "Description", NULL, NULL);
   if (!msg) msg = "Filtering...";
   imCounterTotal(counter, src_image->depth*src_image->height*ntimes, msg);
+  imProcessCounterImage(counter, src_image);
+  imProcessCounterMemory(counter, AuxImage->size);
 
   const imImage *image1 = src_image;
   imImage *image2 = dst_image;
@@ -868,36 +897,16 @@ int imProcessConvolveRep(const imImage* src_image, imImage* dst_image, const imI
 }
 
 template <class T, class KT, class CT> 
-static int DoConvolveSep(T* map, T* new_map, int width, int height, KT* kernel_map, int kernel_width, int kernel_height, int counter, CT)
+struct iConvolveSepColumnLine
 {
-  KT totalH, totalW, *kernel_line;
-  T* aux_line;
-
-  int kh2 = kernel_height/2;
-  int kw2 = kernel_width/2;
-
-  if (kernel_height % 2 == 0) kh2--;
-  if (kernel_width % 2 == 0) kw2--;
-
-  // use only the first line and the first column of the kernel
-
-  totalH = iKernelTotalH(kernel_map, kernel_width, kernel_height);
-  totalW = iKernelTotalW(kernel_map, kernel_width);
-
-  aux_line = (T*)malloc(width*sizeof(T));
+  T *map, *new_map;
+  int width, height;
+  KT* kernel_map;
+  int kernel_width, kh2;
+  KT totalH;
 
-  IM_INT_PROCESSING;
-
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
-#endif
-  for(int j = 0; j < height; j++)
+  void operator()(int j)
   {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_BEGIN_PROCESSING;
-
     int new_offset = j * width;
 
     for(int i = 0; i < width; i++)
@@ -910,7 +919,7 @@ static int DoConvolveSep(T* map, T* new_map, int width, int height, KT* kernel_m
       {
         int offset;
 
-        kernel_line = kernel_map + (y+kh2)*kernel_width;  // Use only the first column
+        KT* kernel_line = kernel_map + (y+kh2)*kernel_width;  // Use only the first column
 
         if (j + y < 0)             // pass the bottom border
           offset = -(y + j + 1) * width;
@@ -931,40 +940,33 @@ static int DoConvolveSep(T* map, T* new_map, int width, int height, KT* kernel_m
       else
         new_map[new_offset + i] = (T)value;
     }    
-
-    IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_END_PROCESSING;
   }
+};
 
-  if (!processing)
-  {
-    free(aux_line);
-    return 0;
-  }
+template <class T, class KT, class CT> 
+struct iConvolveSepLineLine
+{
+  T *new_map;
+  int width;
+  KT* kernel_map;
+  int kw2;
+  KT totalW;
 
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
-#endif
-  for(int j = 0; j < height; j++)
+  void operator()(int j, void* buffer)
   {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_BEGIN_PROCESSING;
-
     int offset = j * width;
     int new_offset = offset;
 
+    // the line is changed in place, so an auxiliar line is used
+    T* aux_line = (T*)buffer;
+
     for(int i = 0; i < width; i++)
     {
       CT value = 0;
 
-      // second pass, only for lines, but has to use an auxiliar buffer
+      // second pass, only for lines
     
-      kernel_line = kernel_map;  // Use only the first line
+      KT* kernel_line = kernel_map;  // Use only the first line
 
       for(int x = -kw2; x <= kw2; x++)
       {
@@ -986,25 +988,12 @@ static int DoConvolveSep(T* map, T* new_map, int width, int height, KT* kernel_m
     }    
 
     memcpy(new_map + new_offset, aux_line, width*sizeof(T));
-
-    IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_END_PROCESSING;
   }
+};
 
-  free(aux_line);
-  return processing;
-}
-
-
-template <class T, class KT> 
-static int DoConvolveSepCpx(imComplex<T>* map, imComplex<T>* new_map, int width, int height, KT* kernel_map, int kernel_width, int kernel_height, int counter)
+template <class T, class KT, class CT> 
+static int DoConvolveSep(T* map, T* new_map, int width, int height, KT* kernel_map, int kernel_width, int kernel_height, int counter, CT)
 {
-  KT totalH, totalW, *kernel_line;
-  imComplex<T>* aux_line;
-
   int kh2 = kernel_height/2;
   int kw2 = kernel_width/2;
 
@@ -1013,23 +1002,41 @@ static int DoConvolveSepCpx(imComplex<T>* map, imComplex<T>* new_map, int width,
 
   // use only the first line and the first column of the kernel
 
-  totalH = iKernelTotalH(kernel_map, kernel_width, kernel_height);
-  totalW = iKernelTotalW(kernel_map, kernel_width);
+  iConvolveSepColumnLine<T, KT, CT> column_op;
+  column_op.map = map;
+  column_op.new_map = new_map;
+  column_op.width = width;
+  column_op.height = height;
+  column_op.kernel_map = kernel_map;
+  column_op.kernel_width = kernel_width;
+  column_op.kh2 = kh2;
+  column_op.totalH = iKernelTotalH(kernel_map, kernel_width, kernel_height);
+
+  if (!imProcessLines(height, counter, column_op, (double)width*height*kernel_height*imProcessTypeCost(map)))
+    return 0;
 
-  aux_line = (imComplex<T>*)malloc(width*sizeof(imComplex<T>));
+  iConvolveSepLineLine<T, KT, CT> line_op;
+  line_op.new_map = new_map;
+  line_op.width = width;
+  line_op.kernel_map = kernel_map;
+  line_op.kw2 = kw2;
+  line_op.totalW = iKernelTotalW(kernel_map, kernel_width);
 
-  IM_INT_PROCESSING;
+  // one auxiliary line is allocated for each band of lines
+  return imProcessLinesBuffer(height, counter, line_op, (double)width*height*kernel_width*imProcessTypeCost(map), width*sizeof(*map));
+}
 
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
-#endif
-  for(int j = 0; j < height; j++)
-  {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_BEGIN_PROCESSING;
+template <class T, class KT> 
+struct iConvolveSepCpxColumnLine
+{
+  imComplex<T> *map, *new_map;
+  int width, height;
+  KT* kernel_map;
+  int kernel_width, kh2;
+  KT totalH;
 
+  void operator()(int j)
+  {
     int new_offset = j * width;
 
     for(int i = 0; i < width; i++)
@@ -1042,7 +1049,7 @@ static int DoConvolveSepCpx(imComplex<T>* map, imComplex<T>* new_map, int width,
       {
         int offset;
 
-        kernel_line = kernel_map + (y+kh2)*kernel_width;
+        KT* kernel_line = kernel_map + (y+kh2)*kernel_width;
 
         if (j + y < 0)             // pass the bottom border
           offset = -(y + j + 1) * width;
@@ -1059,41 +1066,34 @@ static int DoConvolveSepCpx(imComplex<T>* map, imComplex<T>* new_map, int width,
 
       new_map[new_offset + i] = value;
     }    
-
-    IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_END_PROCESSING;
   }
+};
 
-  if (!processing)
-  {
-    free(aux_line);
-    return 0;
-  }
+template <class T, class KT> 
+struct iConvolveSepCpxLineLine
+{
+  imComplex<T> *new_map;
+  int width;
+  KT* kernel_map;
+  int kw2;
+  KT totalW;
 
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
-#endif
-  for(int j = 0; j < height; j++)
+  void operator()(int j, void* buffer)
   {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_BEGIN_PROCESSING;
-
     int offset = j * width;
     int new_offset = offset;
 
+    // the line is changed in place, so an auxiliar line is used
+    imComplex<T>* aux_line = (imComplex<T>*)buffer;
+
     for(int i = 0; i < width; i++)
     {
       int x;
       imComplex<T> value = 0;
 
-      // second pass, only for lines, but has to use an auxiliar buffer
+      // second pass, only for lines
     
-      kernel_line = kernel_map;
+      KT* kernel_line = kernel_map;
     
       for(x = -kw2; x <= kw2; x++)
       {
@@ -1111,16 +1111,42 @@ static int DoConvolveSepCpx(imComplex<T>* map, imComplex<T>* new_map, int width,
     }    
 
     memcpy(new_map + new_offset, aux_line, width*sizeof(imComplex<T>));
-
-    IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_END_PROCESSING;
   }
+};
+
+template <class T, class KT> 
+static int DoConvolveSepCpx(imComplex<T>* map, imComplex<T>* new_map, int width, int height, KT* kernel_map, int kernel_width, int kernel_height, int counter)
+{
+  int kh2 = kernel_height/2;
+  int kw2 = kernel_width/2;
+
+  if (kernel_height % 2 == 0) kh2--;
+  if (kernel_width % 2 == 0) kw2--;
+
+  // use only the first line and the first column of the kernel
+
+  iConvolveSepCpxColumnLine<T, KT> column_op;
+  column_op.map = map;
+  column_op.new_map = new_map;
+  column_op.width = width;
+  column_op.height = height;
+  column_op.kernel_map = kernel_map;
+  column_op.kernel_width = kernel_width;
+  column_op.kh2 = kh2;
+  column_op.totalH = iKernelTotalH(kernel_map, kernel_width, kernel_height);
+
+  if (!imProcessLines(height, counter, column_op, (double)width*height*kernel_height*imProcessTypeCost(map)))
+    return 0;
+
+  iConvolveSepCpxLineLine<T, KT> line_op;
+  line_op.new_map = new_map;
+  line_op.width = width;
+  line_op.kernel_map = kernel_map;
+  line_op.kw2 = kw2;
+  line_op.totalW = iKernelTotalW(kernel_map, kernel_width);
 
-  free(aux_line);
-  return processing;
+  // one auxiliary line is allocated for each band of lines
+  return imProcessLinesBuffer(height, counter, line_op, (double)width*height*kernel_width*imProcessTypeCost(map), width*sizeof(*map));
 }
 
 int imProcessConvolveSep(const imImage* src_image, imImage* dst_image, const imImage *kernel)
@@ -1129,6 +1155,7 @@ int imProcessConvolveSep(const imImage* src_image, imImage* dst_image, const imI
   const char* msg = (const char*)imImageGetAttribute(kernel, "Description", NULL, NULL);
   if (!msg) msg = "Filtering...";
   imCounterTotal(counter, 2*src_image->depth*src_image->height, msg);
+  imProcessCounterImage(counter, src_image);
 
   int ret = 0;
 
@@ -1567,6 +1594,7 @@ int imProcessMeanConvolve(const imImage* src_image, imImage* dst_image, int ks)
 {
   int counter = imProcessCounterBegin("Mean Convolve");
   imCounterTotal(counter, src_image->depth*src_image->height, "Filtering...");
+  imProcessCounterImage(counter, src_image);
 
   imImage* kernel = imImageCreate(ks, ks, IM_GRAY, IM_INT);
 
@@ -20,32 +20,18 @@
 
 
 template <class T, class DT> 
-static int DoConvolveRankFunc(T *map, DT* new_map, int width, int height, int kw, int kh, T (*func)(T* value, int count, int center), int counter)
+struct iConvolveRankLine
 {
-  int tcount = IM_MAX_THREADS;
-  T* value = new T[kw*kh*tcount];
+  T *map;
+  DT* new_map;
+  int width, height;
+  int kw, kh, kw1, kh1, kw2, kh2;
+  T (*func)(T* value, int count, int center);
 
-  int kh2 = kh/2;
-  int kw2 = kw/2;
-  int kh1 = -kh2;
-  int kw1 = -kw2;
-  if (kh%2==0) kh2--;  // if not odd decrease 1
-  if (kw%2==0) kw2--;
-
-  IM_INT_PROCESSING;
-
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
-#endif
-  for(int j = 0; j < height; j++)
+  void operator()(int j)
   {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_BEGIN_PROCESSING;
-
     int new_offset = j * width;
-    int toffset = IM_THREAD_NUM*(kw*kh);
+    T* value = new T[kw*kh];
 
     for(int i = 0; i < width; i++)
     {
@@ -69,23 +55,47 @@ static int DoConvolveRankFunc(T *map, DT* new_map, int width, int height, int kw
           if (x == 0 && y == 0)
             c = v;
 
-          value[toffset + v] = map[offset + (i + x)];
+          value[v] = map[offset + (i + x)];
           v++;
         }
       }
       
-      new_map[new_offset + i] = (DT)func(value + toffset, v, c);
+      new_map[new_offset + i] = (DT)func(value, v, c);
     }    
 
-    IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_END_PROCESSING;
+    delete[] value;
   }
+};
+
+template <class T, class DT> 
+static int DoConvolveRankFunc(T *map, DT* new_map, int width, int height, int kw, int kh, T (*func)(T* value, int count, int center), int counter)
+{
+  int kh2 = kh/2;
+  int kw2 = kw/2;
+  int kh1 = -kh2;
+  int kw1 = -kw2;
+  if (kh%2==0) kh2--;  // if not odd decrease 1
+  if (kw%2==0) kw2--;
+
+  iConvolveRankLine<T, DT> line_op;
+  line_op.map = map;
+  line_op.new_map = new_map;
+  line_op.width = width;
+  line_op.height = height;
+  line_op.kw = kw;
+  line_op.kh = kh;
+  line_op.kw1 = kw1;
+  line_op.kh1 = kh1;
+  line_op.kw2 = kw2;
+  line_op.kh2 = kh2;
+  line_op.func = func;
+
+  // one neighborhood buffer is allocated for each line
+  imProcessCounterMemory(counter, (double)height*kw*kh*sizeof(T));
 
-  delete[] value;
-  return processing;
+  // sorting the neighborhood costs more than a sum
+  double cost = (double)width*height*kw*kh*4;
+  return imProcessLines(height, counter, line_op, cost);
 }
 
 static int compare_imFloat(const void *elem1, const void *elem2) 
@@ -221,6 +231,7 @@ int imProcessMedianConvolve(const imImage* src_image, imImage* dst_image, int ks
 
   counter = imProcessCounterBegin("Median Filter");
   imCounterTotal(counter, src_image->depth*src_image->height, "Filtering...");
+  imProcessCounterImage(counter, src_image);
 
   for (i = 0; i < src_image->depth; i++)
   {
@@ -316,6 +327,7 @@ int imProcessRangeConvolve(const imImage* src_image, imImage* dst_image, int ks)
 
   counter = imProcessCounterBegin("Range Filter");
   imCounterTotal(counter, src_image->depth*src_image->height, "Filtering...");
+  imProcessCounterImage(counter, src_image);
 
   for (i = 0; i < src_image->depth; i++)
   {
@@ -474,6 +486,7 @@ int imProcessRangeContrastThreshold(const imImage* src_image, imImage* dst_image
   int ret = 0;
   int counter = imProcessCounterBegin("Range Contrast Threshold");
   imCounterTotal(counter, src_image->depth*src_image->height, "Filtering...");
+  imProcessCounterImage(counter, src_image);
 
   thresAux = min_range;
 
@@ -567,6 +580,7 @@ int imProcessLocalMaxThreshold(const imImage* src_image, imImage* dst_image, int
   int ret = 0;
   int counter = imProcessCounterBegin("Local Max Threshold");
   imCounterTotal(counter, src_image->depth*src_image->height, "Filtering...");
+  imProcessCounterImage(counter, src_image);
 
   thresAux = min_thres;
 
@@ -681,6 +695,7 @@ int imProcessRankClosestConvolve(const imImage* src_image, imImage* dst_image, i
 
   counter = imProcessCounterBegin("Rank Closest");
   imCounterTotal(counter, src_image->depth*src_image->height, "Filtering...");
+  imProcessCounterImage(counter, src_image);
 
   for (i = 0; i < src_image->depth; i++)
   {
@@ -776,6 +791,7 @@ int imProcessRankMaxConvolve(const imImage* src_image, imImage* dst_image, int k
 
   counter = imProcessCounterBegin("Rank Max");
   imCounterTotal(counter, src_image->depth*src_image->height, "Filtering...");
+  imProcessCounterImage(counter, src_image);
 
   for (i = 0; i < src_image->depth; i++)
   {
@@ -871,6 +887,7 @@ int imProcessRankMinConvolve(const imImage* src_image, imImage* dst_image, int k
 
   counter = imProcessCounterBegin("Rank Min");
   imCounterTotal(counter, src_image->depth*src_image->height, "Filtering...");
+  imProcessCounterImage(counter, src_image);
 
   for (i = 0; i < src_image->depth; i++)
   {
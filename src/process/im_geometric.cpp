@@ -522,6 +522,7 @@ int imProcessRadial(const imImage* src_image, imImage* dst_image, float k1, int
   int counter = imProcessCounterBegin("Radial Distort");
   int src_depth = src_image->has_alpha && dst_image->has_alpha? src_image->depth+1: src_image->depth;
   imCounterTotal(counter, src_depth*dst_image->height, "Processing...");  /* size of the target image */
+  imProcessCounterImage(counter, dst_image);
 
   for (int i = 0; i < src_depth; i++)
   {
@@ -569,6 +570,7 @@ int imProcessSwirl(const imImage* src_image, imImage* dst_image, float k, int or
   int counter = imProcessCounterBegin("Swirl Distort");
   int src_depth = src_image->has_alpha && dst_image->has_alpha? src_image->depth+1: src_image->depth;
   imCounterTotal(counter, src_depth*dst_image->height, "Processing...");  /* size of the target image */
+  imProcessCounterImage(counter, dst_image);
 
   for (int i = 0; i < src_depth; i++)
   {
@@ -655,6 +657,7 @@ int imProcessRotate(const imImage* src_image, imImage* dst_image, double cos0, d
   int counter = imProcessCounterBegin("Rotate");
   int src_depth = src_image->has_alpha && dst_image->has_alpha? src_image->depth+1: src_image->depth;
   imCounterTotal(counter, src_depth*dst_image->height, "Processing...");  /* size of the target image */
+  imProcessCounterImage(counter, dst_image);
 
   if (src_image->color_space == IM_MAP)
   {
@@ -709,6 +712,7 @@ int imProcessRotateRef(const imImage* src_image, imImage* dst_image, double cos0
   int counter = imProcessCounterBegin("RotateRef");
   int src_depth = src_image->has_alpha && dst_image->has_alpha? src_image->depth+1: src_image->depth;
   imCounterTotal(counter, src_depth*dst_image->height, "Processing...");  /* size of the target image */
+  imProcessCounterImage(counter, dst_image);
 
   if (src_image->color_space == IM_MAP)
   {
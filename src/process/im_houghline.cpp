@@ -10,6 +10,7 @@
 #include <im_convert.h>
 #include <im_counter.h>
 
+#include "im_process_counter.h"
 #include "im_process_glo.h"
 
 #include <stdlib.h>
@@ -366,12 +367,13 @@ static void drawLine(imImage* image, int theta, int rho)
 
 int imProcessHoughLines(const imImage* src_image, imImage *dst_image)
 {
-  int counter = imCounterBegin("Hough Line Transform");
+  int counter = imProcessCounterBegin("Hough Line Transform");
   imCounterTotal(counter, src_image->height, "Processing...");
+  imProcessCounterImage(counter, src_image);
 
   int ret = houghLine(src_image, dst_image, counter);
 
-  imCounterEnd(counter);
+  imProcessCounterEnd(counter);
 
   return ret;
 }
@@ -19,25 +19,16 @@
 #include <math.h>
 
 
-static int DoBinMorphConvolve(imbyte *map, imbyte* new_map, int width, int height, const imImage* kernel, int counter, int hit_value, int miss_value)
+struct iBinMorphConvolveLine
 {
-  int kh2 = kernel->height/2;
-  int kw2 = kernel->width/2;
-
-  int* kernel_data = (int*)kernel->data[0];
+  imbyte *map, *new_map;
+  int width, height;
+  int* kernel_data;
+  int kw, kw2, kh2;
+  int hit_value, miss_value;
 
-  IM_INT_PROCESSING;
-
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
-#endif
-  for(int j = 0; j < height; j++)
+  void operator()(int j)
   {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_BEGIN_PROCESSING;
-
     int new_offset = j * width;
 
     for(int i = 0; i < width; i++)
@@ -47,7 +38,7 @@ static int DoBinMorphConvolve(imbyte *map, imbyte* new_map, int width, int heigh
       for(int y = -kh2; y <= kh2 && hit; y++)
       {
         int offset;
-        int* kernel_line = kernel_data + (y+kh2)*kernel->width;
+        int* kernel_line = kernel_data + (y+kh2)*kw;
 
         if ((j + y < 0) ||       // pass the bottom border
             (j + y >= height))   // pass the top border
@@ -74,15 +65,25 @@ static int DoBinMorphConvolve(imbyte *map, imbyte* new_map, int width, int heigh
 
       new_map[new_offset + i] = (imbyte)(hit? hit_value: miss_value);
     }    
-
-    IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_END_PROCESSING;
   }
+};
 
-  return processing;
+static int DoBinMorphConvolve(imbyte *map, imbyte* new_map, int width, int height, const imImage* kernel, int counter, int hit_value, int miss_value)
+{
+  iBinMorphConvolveLine line_op;
+  line_op.map = map;
+  line_op.new_map = new_map;
+  line_op.width = width;
+  line_op.height = height;
+  line_op.kernel_data = (int*)kernel->data[0];
+  line_op.kw = kernel->width;
+  line_op.kh2 = kernel->height/2;
+  line_op.kw2 = kernel->width/2;
+  line_op.hit_value = hit_value;
+  line_op.miss_value = miss_value;
+
+  double cost = (double)width*height*kernel->width*kernel->height;
+  return imProcessLines(height, counter, line_op, cost);
 }
 
 int imProcessBinMorphConvolve(const imImage* src_image, imImage* dst_image, const imImage *kernel, int hit_white, int iter)
@@ -106,9 +107,13 @@ int imProcessBinMorphConvolve(const imImage* src_image, imImage* dst_image, cons
   const char* msg = (const char*)imImageGetAttribute(kernel, "Description", NULL, NULL);
   if (!msg) msg = "Processing...";
   imCounterTotal(counter, src_image->height*iter, msg);
+  imProcessCounterImage(counter, src_image);
 
   if (iter > 1)
+  {
     tmp = malloc(src_image->size);
+    imProcessCounterMemory(counter, src_image->size);
+  }
 
   for (j = 0; j < iter; j++)
   {
@@ -21,26 +21,16 @@
 
 
 template <class T, class DT> 
-static int DoGrayMorphConvolve(T *map, T* new_map, int width, int height, const imImage* kernel, int counter, int ismax, DT)
+struct iGrayMorphConvolveLine
 {
-  int kw = kernel->width;
-  int kh2 = kernel->height/2;
-  int kw2 = kernel->width/2;
-
-  DT* kernel_data = (DT*)kernel->data[0];
+  T *map, *new_map;
+  int width, height;
+  DT* kernel_data;
+  int kw, kw2, kh2;
+  int ismax;
 
-  IM_INT_PROCESSING;
-
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
-#endif
-  for(int j = 0; j < height; j++)
+  void operator()(int j)
   {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_BEGIN_PROCESSING;
-
     int new_offset = j * width;
 
     for(int i = 0; i < width; i++)
@@ -106,15 +96,25 @@ static int DoGrayMorphConvolve(T *map, T* new_map, int width, int height, const
           new_map[new_offset + i] = (T)min;
       }
     }    
-
-    IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_END_PROCESSING;
   }
+};
 
-  return processing;
+template <class T, class DT> 
+static int DoGrayMorphConvolve(T *map, T* new_map, int width, int height, const imImage* kernel, int counter, int ismax, DT)
+{
+  iGrayMorphConvolveLine<T, DT> line_op;
+  line_op.map = map;
+  line_op.new_map = new_map;
+  line_op.width = width;
+  line_op.height = height;
+  line_op.kernel_data = (DT*)kernel->data[0];
+  line_op.kw = kernel->width;
+  line_op.kh2 = kernel->height/2;
+  line_op.kw2 = kernel->width/2;
+  line_op.ismax = ismax;
+
+  double cost = (double)width*height*kernel->width*kernel->height;
+  return imProcessLines(height, counter, line_op, cost);
 }
 
 int imProcessGrayMorphConvolve(const imImage* src_image, imImage* dst_image, const imImage *kernel, int ismax)
@@ -125,6 +125,7 @@ int imProcessGrayMorphConvolve(const imImage* src_image, imImage* dst_image, con
   const char* msg = (const char*)imImageGetAttribute(kernel, "Description", NULL, NULL);
   if (!msg) msg = "Processing...";
   imCounterTotal(counter, src_image->depth*src_image->height, msg);
+  imProcessCounterImage(counter, src_image);
 
   imImage* fkernel = NULL;
     
@@ -0,0 +1,672 @@
+/** \file
+ * \brief Point Operations Pipeline
+ *
+ * See Copyright Notice in im_lib.h
+ */
+
+
+#include <im.h>
+#include <im_util.h>
+#include <im_math.h>
+#include <im_color.h>
+
+#include "im_process_counter.h"
+#include "im_process_pnt.h"
+#include "im_math_op.h"
+
+#include <stdlib.h>
+#include <memory.h>
+#include <math.h>
+
+
+/* Pixels of each plane processed by all the stages before the next ones.
+   IM_PIPELINE_MAXDEPTH planes of floats fit in the L1 cache. */
+#define IM_PIPELINE_TILE      512
+#define IM_PIPELINE_MAXDEPTH  4
+
+enum { IM_PIPE_UNARY, IM_PIPE_CONST, IM_PIPE_GAMUT, IM_PIPE_BITMASK, IM_PIPE_BITNOT, IM_PIPE_THRESHOLD, IM_PIPE_COLOR };
+
+struct iPipelineStage
+{
+  int type, op;
+  float value;
+  float params[5];    /* tone gamut parameters, including min and max */
+};
+
+struct _imProcessPipeline
+{
+  iPipelineStage* stage;
+  int count, size;
+  int error;          /* a stage could not be added */
+};
+
+imProcessPipeline* imProcessPipelineCreate(void)
+{
+  imProcessPipeline* pipeline = (imProcessPipeline*)malloc(sizeof(imProcessPipeline));
+  if (!pipeline)
+    return NULL;
+
+  pipeline->stage = NULL;
+  pipeline->count = 0;
+  pipeline->size = 0;
+  pipeline->error = 0;
+  return pipeline;
+}
+
+void imProcessPipelineDestroy(imProcessPipeline* pipeline)
+{
+  if (pipeline->stage) free(pipeline->stage);
+  free(pipeline);
+}
+
+static iPipelineStage* iPipelineAdd(imProcessPipeline* pipeline, int type, int op, float value)
+{
+  if (pipeline->count == pipeline->size)
+  {
+    int size = pipeline->size + 8;
+    iPipelineStage* stage = (iPipelineStage*)realloc(pipeline->stage, size*sizeof(iPipelineStage));
+    if (!stage)
+    {
+      pipeline->error = 1;
+      return NULL;
+    }
+
+    pipeline->stage = stage;
+    pipeline->size = size;
+  }
+
+  iPipelineStage* stage = pipeline->stage + pipeline->count;
+  memset(stage, 0, sizeof(iPipelineStage));
+  stage->type = type;
+  stage->op = op;
+  stage->value = value;
+  pipeline->count++;
+  return stage;
+}
+
+void imProcessPipelineUnArithmeticOp(imProcessPipeline* pipeline, int op)
+{
+  iPipelineAdd(pipeline, IM_PIPE_UNARY, op, 0);
+}
+
+void imProcessPipelineArithmeticConstOp(imProcessPipeline* pipeline, float src_const, int op)
+{
+  iPipelineAdd(pipeline, IM_PIPE_CONST, op, src_const);
+}
+
+static int iToneGamutParamCount(int op)
+{
+  int count = (op & IM_GAMUT_MINMAX)? 2: 0;
+
+  switch (op & 0x00FF)
+  {
+  case IM_GAMUT_POW:
+  case IM_GAMUT_LOG:
+  case IM_GAMUT_EXP:
+  case IM_GAMUT_SOLARIZE:
+    return count + 1;
+  case IM_GAMUT_EXPAND:
+  case IM_GAMUT_CROP:
+  case IM_GAMUT_BRIGHTCONT:
+    return count + 2;
+  case IM_GAMUT_SLICE:
+    return count + 3;
+  }
+
+  return count;
+}
+
+void imProcessPipelineToneGamut(imProcessPipeline* pipeline, int op, float* params)
+{
+  iPipelineStage* stage = iPipelineAdd(pipeline, IM_PIPE_GAMUT, op, 0);
+  if (stage)
+  {
+    int count = iToneGamutParamCount(op);
+    for (int i = 0; i < count; i++)
+      stage->params[i] = params[i];
+  }
+}
+
+void imProcessPipelineBitMask(imProcessPipeline* pipeline, int mask, int op)
+{
+  iPipelineAdd(pipeline, IM_PIPE_BITMASK, op, (float)mask);
+}
+
+void imProcessPipelineBitwiseNot(imProcessPipeline* pipeline)
+{
+  iPipelineAdd(pipeline, IM_PIPE_BITNOT, 0, 0);
+}
+
+void imProcessPipelineThreshold(imProcessPipeline* pipeline, float level, int value)
+{
+  iPipelineAdd(pipeline, IM_PIPE_THRESHOLD, value, level);
+}
+
+void imProcessPipelineConvertColorSpace(imProcessPipeline* pipeline, int color_space)
+{
+  iPipelineAdd(pipeline, IM_PIPE_COLOR, color_space, 0);
+}
+
+/* A stage with its constants computed for the source image. */
+struct iPipelineStep
+{
+  int type, op;
+  int mask;
+  float value;
+  float min, max, range;
+  float a, b;
+  int bin;
+};
+
+static void iPipelineToneGamutStep(const iPipelineStage* stage, iPipelineStep* step, float src_min, float src_max)
+{
+  const float* args = stage->params;
+  float min = src_min, max = src_max;
+
+  if (stage->op & IM_GAMUT_MINMAX)
+  {
+    min = args[0];
+    max = args[1];
+    args += 2;
+  }
+
+  float range = max - min;
+  step->op = stage->op & 0x00FF;
+  step->min = min;
+  step->max = max;
+  step->range = range;
+
+  switch (step->op)
+  {
+  case IM_GAMUT_POW:
+    step->a = args[0];
+    break;
+  case IM_GAMUT_LOG:
+    step->a = args[0];
+    step->b = (float)log(args[0] + 1);
+    break;
+  case IM_GAMUT_EXP:
+    step->a = args[0];
+    step->b = (float)(exp(args[0]) - 1);
+    break;
+  case IM_GAMUT_SOLARIZE:
+    step->value = ((100 - args[0]) * range) / 100.0f + min;
+    step->a = (step->value - min) / (step->value - max);
+    step->b = (step->value * range) / (max - step->value);
+    break;
+  case IM_GAMUT_SLICE:
+  case IM_GAMUT_CROP:
+  case IM_GAMUT_EXPAND:
+    {
+      float start = args[0], end = args[1];
+      if (start > end) { float tmp = end; end = start; start = tmp; }
+      if (end > max) end = max;
+      if (start < min) start = min;
+      step->a = start;
+      step->b = end;
+      if (step->op == IM_GAMUT_SLICE)
+        step->bin = (int)args[2];
+      else if (step->op == IM_GAMUT_EXPAND)
+        step->value = range / (end - start);
+      break;
+    }
+  case IM_GAMUT_BRIGHTCONT:
+    step->a = (float)tan((45 + args[1] * 0.449999) / 57.2957795);
+    step->b = (args[0] * range) / 100.0f + range * (1.0f - step->a) / 2.0f;
+    break;
+  }
+}
+
+static inline float iPipelineCrop(float v, float min, float max)
+{
+  if (v < min) return min;
+  if (v > max) return max;
+  return v;
+}
+
+static void iPipelineUnary(float* map, int count, int op)
+{
+  int i;
+  switch (op)
+  {
+  case IM_UN_ABS:
+    for (i = 0; i < count; i++) map[i] = abs_op(map[i]);
+    break;
+  case IM_UN_LESS:
+    for (i = 0; i < count; i++) map[i] = less_op(map[i]);
+    break;
+  case IM_UN_INV:
+    for (i = 0; i < count; i++) map[i] = inv_op(map[i]);
+    break;
+  case IM_UN_SQR:
+    for (i = 0; i < count; i++) map[i] = sqr_op(map[i]);
+    break;
+  case IM_UN_SQRT:
+    for (i = 0; i < count; i++) map[i] = sqrt_op(map[i]);
+    break;
+  case IM_UN_LOG:
+    for (i = 0; i < count; i++) map[i] = log_op(map[i]);
+    break;
+  case IM_UN_EXP:
+    for (i = 0; i < count; i++) map[i] = exp_op(map[i]);
+    break;
+  case IM_UN_SIN:
+    for (i = 0; i < count; i++) map[i] = sin_op(map[i]);
+    break;
+  case IM_UN_COS:
+    for (i = 0; i < count; i++) map[i] = cos_op(map[i]);
+    break;
+  case IM_UN_POSITIVES:
+    for (i = 0; i < count; i++) map[i] = map[i] > 0? map[i]: 0;
+    break;
+  case IM_UN_NEGATIVES:
+    for (i = 0; i < count; i++) map[i] = map[i] > 0? 0: map[i];
+    break;
+  /* IM_UN_EQL, IM_UN_CONJ and IM_UN_CPXNORM do nothing for real values */
+  }
+}
+
+static void iPipelineConst(float* map, int count, float value, int op)
+{
+  int i;
+  switch (op)
+  {
+  case IM_BIN_ADD:
+    for (i = 0; i < count; i++) map[i] = add_op(map[i], value);
+    break;
+  case IM_BIN_SUB:
+    for (i = 0; i < count; i++) map[i] = sub_op(map[i], value);
+    break;
+  case IM_BIN_MUL:
+    for (i = 0; i < count; i++) map[i] = mul_op(map[i], value);
+    break;
+  case IM_BIN_DIV:
+    for (i = 0; i < count; i++) map[i] = div_op(map[i], value);
+    break;
+  case IM_BIN_DIFF:
+    for (i = 0; i < count; i++) map[i] = diff_op(map[i], value);
+    break;
+  case IM_BIN_POW:
+    for (i = 0; i < count; i++) map[i] = pow_op(map[i], value);
+    break;
+  case IM_BIN_MIN:
+    for (i = 0; i < count; i++) map[i] = min_op(map[i], value);
+    break;
+  case IM_BIN_MAX:
+    for (i = 0; i < count; i++) map[i] = max_op(map[i], value);
+    break;
+  }
+}
+
+static void iPipelineToneGamut(float* map, int count, const iPipelineStep* step)
+{
+  int i;
+  float min = step->min, max = step->max, range = step->range;
+  float a = step->a, b = step->b;
+
+  switch (step->op)
+  {
+  case IM_GAMUT_NORMALIZE:
+    if (min < 0 || max > 1)  // else already normalized
+    {
+      for (i = 0; i < count; i++)
+        map[i] = (map[i] - min) / range;
+    }
+    break;
+  case IM_GAMUT_INVERT:
+    for (i = 0; i < count; i++)
+      map[i] = (1.0f - (map[i] - min) / range)*range + min;
+    break;
+  case IM_GAMUT_ZEROSTART:
+    for (i = 0; i < count; i++)
+      map[i] = map[i] - min;
+    break;
+  case IM_GAMUT_SOLARIZE:
+    for (i = 0; i < count; i++)
+    {
+      if (map[i] > step->value)
+        map[i] = map[i] * a + b;
+    }
+    break;
+  case IM_GAMUT_POW:
+    for (i = 0; i < count; i++)
+      map[i] = (float)pow((map[i] - min) / range, a)*range + min;
+    break;
+  case IM_GAMUT_LOG:
+    for (i = 0; i < count; i++)
+      map[i] = (float)(log(a * (map[i] - min) / range + 1) / b)*range + min;
+    break;
+  case IM_GAMUT_EXP:
+    for (i = 0; i < count; i++)
+      map[i] = (float)((exp(a * (map[i] - min) / range) - 1) / b)*range + min;
+    break;
+  case IM_GAMUT_SLICE:
+    for (i = 0; i < count; i++)
+    {
+      if (map[i] < a || map[i] > b)
+        map[i] = min;
+      else if (step->bin)
+        map[i] = max;
+    }
+    break;
+  case IM_GAMUT_CROP:
+    for (i = 0; i < count; i++)
+      map[i] = iPipelineCrop(map[i], a, b);
+    break;
+  case IM_GAMUT_EXPAND:
+    for (i = 0; i < count; i++)
+      map[i] = iPipelineCrop((map[i] - a)*step->value + min, min, max);
+    break;
+  case IM_GAMUT_BRIGHTCONT:
+    for (i = 0; i < count; i++)
+      map[i] = iPipelineCrop(map[i] * a + b, min, max);
+    break;
+  }
+}
+
+static void iPipelineBitMask(float* map, int count, int mask, int bits, int op)
+{
+  int i;
+  switch (op)
+  {
+  case IM_BIT_AND:
+    for (i = 0; i < count; i++) map[i] = (float)(((int)map[i] & mask) & bits);
+    break;
+  case IM_BIT_OR:
+    for (i = 0; i < count; i++) map[i] = (float)(((int)map[i] | mask) & bits);
+    break;
+  case IM_BIT_XOR:
+    for (i = 0; i < count; i++) map[i] = (float)(~((int)map[i] | mask) & bits);
+    break;
+  }
+}
+
+template <class T>
+static void iPipelineLoad(const T* src_map, float* map, int count)
+{
+  for (int i = 0; i < count; i++)
+    map[i] = (float)src_map[i];
+}
+
+template <class T>
+static void iPipelineStore(const float* map, T* dst_map, int count, float min, float max)
+{
+  for (int i = 0; i < count; i++)
+    dst_map[i] = (T)iPipelineCrop(map[i], min, max);
+}
+
+static void iPipelineStore(const float* map, float* dst_map, int count, float, float)
+{
+  memcpy(dst_map, map, count*sizeof(float));
+}
+
+static void iPipelineStore(const float* map, double* dst_map, int count, float, float)
+{
+  for (int i = 0; i < count; i++)
+    dst_map[i] = (double)map[i];
+}
+
+static void iPipelineLoadPlane(const imImage* image, int d, int offset, float* map, int count)
+{
+  switch (image->data_type)
+  {
+  case IM_BYTE:
+    iPipelineLoad((imbyte*)image->data[d] + offset, map, count);
+    break;
+  case IM_SHORT:
+    iPipelineLoad((short*)image->data[d] + offset, map, count);
+    break;
+  case IM_USHORT:
+    iPipelineLoad((imushort*)image->data[d] + offset, map, count);
+    break;
+  case IM_INT:
+    iPipelineLoad((int*)image->data[d] + offset, map, count);
+    break;
+  case IM_FLOAT:
+    memcpy(map, (float*)image->data[d] + offset, count*sizeof(float));
+    break;
+  case IM_DOUBLE:
+    iPipelineLoad((double*)image->data[d] + offset, map, count);
+    break;
+  }
+}
+
+static void iPipelineStorePlane(const float* map, imImage* image, int d, int offset, int count)
+{
+  switch (image->data_type)
+  {
+  case IM_BYTE:
+    iPipelineStore(map, (imbyte*)image->data[d] + offset, count, 0.0f, 255.0f);
+    break;
+  case IM_SHORT:
+    iPipelineStore(map, (short*)image->data[d] + offset, count, -32768.0f, 32767.0f);
+    break;
+  case IM_USHORT:
+    iPipelineStore(map, (imushort*)image->data[d] + offset, count, 0.0f, 65535.0f);
+    break;
+  case IM_INT:
+    /* the largest float smaller than INT_MAX */
+    iPipelineStore(map, (int*)image->data[d] + offset, count, -2147483648.0f, 2147483520.0f);
+    break;
+  case IM_FLOAT:
+    iPipelineStore(map, (float*)image->data[d] + offset, count, 0.0f, 0.0f);
+    break;
+  case IM_DOUBLE:
+    iPipelineStore(map, (double*)image->data[d] + offset, count, 0.0f, 0.0f);
+    break;
+  }
+}
+
+struct iPipelineLine
+{
+  const imImage* src_image;
+  imImage* dst_image;
+  const iPipelineStep* step;
+  int step_count;
+  int bits;           /* all the bits of the source data type, used by the bitwise stages */
+
+  void operator()(int y)
+  {
+    float tile[IM_PIPELINE_MAXDEPTH][IM_PIPELINE_TILE];
+    int width = src_image->width;
+
+    for (int x = 0; x < width; x += IM_PIPELINE_TILE)
+    {
+      int count = width - x;
+      if (count > IM_PIPELINE_TILE) count = IM_PIPELINE_TILE;
+      int offset = y * width + x;
+
+      int depth = src_image->depth;
+      for (int d = 0; d < depth; d++)
+        iPipelineLoadPlane(src_image, d, offset, tile[d], count);
+
+      // all the stages are applied to the tile while it is in the cache
+      for (int s = 0; s < step_count; s++)
+      {
+        const iPipelineStep* st = step + s;
+
+        if (st->type == IM_PIPE_COLOR)
+        {
+          if (st->op == IM_GRAY)
+          {
+            for (int i = 0; i < count; i++)
+              tile[0][i] = imColorRGB2Luma(tile[0][i], tile[1][i], tile[2][i]);
+            depth = 1;
+          }
+          else
+          {
+            memcpy(tile[1], tile[0], count*sizeof(float));
+            memcpy(tile[2], tile[0], count*sizeof(float));
+            depth = 3;
+          }
+          continue;
+        }
+
+        for (int d = 0; d < depth; d++)
+        {
+          float* map = tile[d];
+          switch (st->type)
+          {
+          case IM_PIPE_UNARY:
+            iPipelineUnary(map, count, st->op);
+            break;
+          case IM_PIPE_CONST:
+            iPipelineConst(map, count, st->value, st->op);
+            break;
+          case IM_PIPE_GAMUT:
+            iPipelineToneGamut(map, count, st);
+            break;
+          case IM_PIPE_BITMASK:
+            iPipelineBitMask(map, count, st->mask, bits, st->op);
+            break;
+          case IM_PIPE_BITNOT:
+            for (int i = 0; i < count; i++)
+              map[i] = (float)(~(int)map[i] & bits);
+            break;
+          case IM_PIPE_THRESHOLD:
+            for (int i = 0; i < count; i++)
+              map[i] = map[i] <= st->value? 0.0f: (float)st->op;
+            break;
+          }
+        }
+      }
+
+      for (int d = 0; d < depth; d++)
+        iPipelineStorePlane(tile[d], dst_image, d, offset, count);
+    }
+  }
+};
+
+template <class T>
+static void iPipelineMinMax(const T* map, int count, float& min, float& max)
+{
+  T tmin, tmax;
+  imMinMaxType(map, count, tmin, tmax);
+  min = (float)tmin;
+  max = (float)tmax;
+}
+
+static void iPipelineImageMinMax(const imImage* image, float& min, float& max)
+{
+  int count = image->count*image->depth;
+  switch (image->data_type)
+  {
+  case IM_BYTE:
+    iPipelineMinMax((imbyte*)image->data[0], count, min, max);
+    break;
+  case IM_SHORT:
+    iPipelineMinMax((short*)image->data[0], count, min, max);
+    break;
+  case IM_USHORT:
+    iPipelineMinMax((imushort*)image->data[0], count, min, max);
+    break;
+  case IM_INT:
+    iPipelineMinMax((int*)image->data[0], count, min, max);
+    break;
+  case IM_FLOAT:
+    iPipelineMinMax((float*)image->data[0], count, min, max);
+    break;
+  case IM_DOUBLE:
+    iPipelineMinMax((double*)image->data[0], count, min, max);
+    break;
+  }
+}
+
+static int iPipelineBits(int data_type)
+{
+  switch (data_type)
+  {
+  case IM_BYTE:
+    return 0xFF;
+  case IM_USHORT:
+    return 0xFFFF;
+  case IM_SHORT:
+  case IM_INT:
+    return ~0;
+  }
+  return 0;   /* bitwise stages are not supported */
+}
+
+int imProcessPipelineRun(const imProcessPipeline* pipeline, const imImage* src_image, imImage* dst_image)
+{
+  if (pipeline->error ||
+      src_image->data_type >= IM_CFLOAT || dst_image->data_type >= IM_CFLOAT ||
+      src_image->width != dst_image->width || src_image->height != dst_image->height ||
+      src_image->depth > IM_PIPELINE_MAXDEPTH)
+    return 0;
+
+  iPipelineStep* step = (iPipelineStep*)malloc((pipeline->count + 1)*sizeof(iPipelineStep));
+  if (!step)
+    return 0;
+
+  int bits = iPipelineBits(src_image->data_type);
+  int depth = src_image->depth;
+  int has_minmax = 0;
+  float src_min = 0, src_max = 0;
+
+  for (int s = 0; s < pipeline->count; s++)
+  {
+    const iPipelineStage* stage = pipeline->stage + s;
+    iPipelineStep* st = step + s;
+    memset(st, 0, sizeof(iPipelineStep));
+    st->type = stage->type;
+    st->op = stage->op;
+    st->value = stage->value;
+
+    if ((st->type == IM_PIPE_BITMASK || st->type == IM_PIPE_BITNOT) && bits == 0)
+    {
+      free(step);
+      return 0;
+    }
+
+    if (st->type == IM_PIPE_BITMASK)
+      st->mask = (int)stage->value;
+    else if (st->type == IM_PIPE_GAMUT)
+    {
+      if (!(stage->op & IM_GAMUT_MINMAX) && !has_minmax)
+      {
+        /* min and max of the source, computed only once */
+        iPipelineImageMinMax(src_image, src_min, src_max);
+        has_minmax = 1;
+      }
+
+      iPipelineToneGamutStep(stage, st, src_min, src_max);
+    }
+    else if (st->type == IM_PIPE_COLOR)
+    {
+      if ((st->op == IM_GRAY && depth == 3) || (st->op == IM_RGB && depth == 1))
+        depth = (st->op == IM_GRAY)? 1: 3;
+      else
+      {
+        free(step);
+        return 0;
+      }
+    }
+  }
+
+  if (depth != dst_image->depth)
+  {
+    free(step);
+    return 0;
+  }
+
+  int counter = imProcessCounterBegin("Pipeline");
+  imCounterTotal(counter, src_image->height, "Processing...");
+  imProcessCounterImage(counter, src_image);
+
+  iPipelineLine line_op;
+  line_op.src_image = src_image;
+  line_op.dst_image = dst_image;
+  line_op.step = step;
+  line_op.step_count = pipeline->count;
+  line_op.bits = bits;
+
+  // load and store are also counted
+  double cost = (double)src_image->count*src_image->depth*(pipeline->count + 1);
+  int ret = imProcessLines(src_image->height, counter, line_op, cost);
+
+  imProcessCounterEnd(counter);
+
+  free(step);
+  return ret;
+}
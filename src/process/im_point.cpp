@@ -19,41 +19,46 @@
 
 
 template <class T1, class T2> 
-static int DoUnaryPointOp(T1 *src_map, T2 *dst_map, int width, int height, int depth, imUnaryPointOpFunc func, float* params, void* userdata, int counter)
+struct iUnaryPointLine
 {
-  int count = width * height;
-  int size = count * depth;
-  IM_INT_PROCESSING;
-
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINCOUNT(size))
-#endif
-  for(int i = 0; i < size; i++)
+  T1 *src_map;
+  T2 *dst_map;
+  int width, height;
+  imUnaryPointOpFunc func;
+  float* params;
+  void* userdata;
+
+  void operator()(int line)
   {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_BEGIN_PROCESSING; 
-    
-    float dst_value;
-    int d = i%count;
-    int y = (i - d*count)%width;
-    int x = i - d*count - y*width;
-
-    if (func((float)src_map[i], &dst_value, params, userdata, x, y, d)) 
-      dst_map[i] = (T2)dst_value;
-
-    if (x == width-1)
+    // lines of all the planes, the planes are contiguous in memory
+    int d = line / height;
+    int y = line % height;
+    int offset = line * width;
+
+    for(int x = 0; x < width; x++)
     {
-      IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-      IM_END_PROCESSING;
+      float dst_value;
+      if (func((float)src_map[offset + x], &dst_value, params, userdata, x, y, d)) 
+        dst_map[offset + x] = (T2)dst_value;
     }
   }
+};
 
-  return processing;
+template <class T1, class T2> 
+static int DoUnaryPointOp(T1 *src_map, T2 *dst_map, int width, int height, int depth, imUnaryPointOpFunc func, float* params, void* userdata, int counter)
+{
+  iUnaryPointLine<T1, T2> line_op;
+  line_op.src_map = src_map;
+  line_op.dst_map = dst_map;
+  line_op.width = width;
+  line_op.height = height;
+  line_op.func = func;
+  line_op.params = params;
+  line_op.userdata = userdata;
+
+  // a function call for each pixel
+  double cost = (double)width*height*depth*4;
+  return imProcessLines(depth * height, counter, line_op, cost);
 }
 
 int imProcessUnaryPointOp(const imImage* src_image, imImage* dst_image, imUnaryPointOpFunc func, float* params, void* userdata, const char* op_name)
@@ -63,6 +68,7 @@ int imProcessUnaryPointOp(const imImage* src_image, imImage* dst_image, imUnaryP
 
   int counter = imProcessCounterBegin(op_name? op_name: "UnaryPointOp");
   imCounterTotal(counter, depth*src_image->height, "Processing...");
+  imProcessCounterImage(counter, src_image);
 
   switch(src_image->data_type)
   {
@@ -158,48 +164,53 @@ int imProcessUnaryPointOp(const imImage* src_image, imImage* dst_image, imUnaryP
 }
 
 template <class T1, class T2> 
-static int DoUnaryPointColorOp(T1 **src_map, T2 **dst_map, int width, int height, int src_depth, int dst_depth, imUnaryPointColorOpFunc func, float* params, void* userdata, int counter)
+struct iUnaryPointColorLine
 {
-  int count = width * height;
-  IM_INT_PROCESSING;
-
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
-#endif
-  for(int i = 0; i < count; i++)
+  T1 **src_map;
+  T2 **dst_map;
+  int width, src_depth, dst_depth;
+  imUnaryPointColorOpFunc func;
+  float* params;
+  void* userdata;
+
+  void operator()(int y)
   {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_BEGIN_PROCESSING; 
-    
-    int y = i%width;
-    int x = i - y*width;
-
-    int d;
-    float src_value[IM_MAXDEPTH];
-    float dst_value[IM_MAXDEPTH];
-
-    for(d = 0; d < src_depth; d++)
-      src_value[d] = (float)(src_map[d])[i];
-
-    if (func(src_value, dst_value, params, userdata, x, y))
-    {
-      for(d = 0; d < dst_depth; d++)
-        (dst_map[d])[i] = (T2)dst_value[d];
-    }
+    int offset = y * width;
 
-    if (x == width-1)
+    for(int x = 0; x < width; x++)
     {
-      IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-      IM_END_PROCESSING;
+      int d, i = offset + x;
+      float src_value[IM_MAXDEPTH];
+      float dst_value[IM_MAXDEPTH];
+
+      for(d = 0; d < src_depth; d++)
+        src_value[d] = (float)(src_map[d])[i];
+
+      if (func(src_value, dst_value, params, userdata, x, y))
+      {
+        for(d = 0; d < dst_depth; d++)
+          (dst_map[d])[i] = (T2)dst_value[d];
+      }
     }
   }
+};
 
-  return processing;
+template <class T1, class T2> 
+static int DoUnaryPointColorOp(T1 **src_map, T2 **dst_map, int width, int height, int src_depth, int dst_depth, imUnaryPointColorOpFunc func, float* params, void* userdata, int counter)
+{
+  iUnaryPointColorLine<T1, T2> line_op;
+  line_op.src_map = src_map;
+  line_op.dst_map = dst_map;
+  line_op.width = width;
+  line_op.src_depth = src_depth;
+  line_op.dst_depth = dst_depth;
+  line_op.func = func;
+  line_op.params = params;
+  line_op.userdata = userdata;
+
+  // a function call for each pixel
+  double cost = (double)width*height*(src_depth + dst_depth + 4);
+  return imProcessLines(height, counter, line_op, cost);
 }
 
 int imProcessUnaryPointColorOp(const imImage* src_image, imImage* dst_image, imUnaryPointColorOpFunc func, float* params, void* userdata, const char* op_name)
@@ -210,6 +221,7 @@ int imProcessUnaryPointColorOp(const imImage* src_image, imImage* dst_image, imU
 
   int counter = imProcessCounterBegin(op_name? op_name: "UnaryPointColorOp");
   imCounterTotal(counter, src_image->height, "Processing...");
+  imProcessCounterImage(counter, src_image);
 
   switch(src_image->data_type)
   {
@@ -305,48 +317,55 @@ int imProcessUnaryPointColorOp(const imImage* src_image, imImage* dst_image, imU
 }
 
 template <class T1, class T2> 
-static int DoMultiPointOp(T1 **src_map, T2 *dst_map, int width, int height, int depth, int src_count, imMultiPointOpFunc func, float* params, void* userdata, int counter)
+struct iMultiPointLine
 {
-  int count = width * height;
-  int size = count * depth;
-  int tcount = IM_MAX_THREADS;
-  float* src_value = new float [src_count*tcount];
-  IM_INT_PROCESSING;
-
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINCOUNT(size))
-#endif
-  for(int i = 0; i < size; i++)
+  T1 **src_map;
+  T2 *dst_map;
+  int width, height, src_count;
+  imMultiPointOpFunc func;
+  float* params;
+  void* userdata;
+
+  void operator()(int line)
   {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_BEGIN_PROCESSING; 
-    
-    float dst_value;
-    int d = i%count;
-    int y = (i - d*count)%width;
-    int x = i - d*count - y*width;
-    int toffset = IM_THREAD_NUM*src_count;
-
-    for(int j = 0; j < src_count; j++)
-      src_value[toffset + j] = (float)(src_map[j])[i];
-
-    if (func(src_value + toffset, &dst_value, params, userdata, x, y, d, src_count))
-      dst_map[i] = (T2)dst_value;
-
-    if (x == width-1)
+    // lines of all the planes, the planes are contiguous in memory
+    int d = line / height;
+    int y = line % height;
+    int offset = line * width;
+    float* src_value = new float [src_count];
+
+    for(int x = 0; x < width; x++)
     {
-      IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-      IM_END_PROCESSING;
+      float dst_value;
+      int i = offset + x;
+
+      for(int j = 0; j < src_count; j++)
+        src_value[j] = (float)(src_map[j])[i];
+
+      if (func(src_value, &dst_value, params, userdata, x, y, d, src_count))
+        dst_map[i] = (T2)dst_value;
     }
+
+    delete[] src_value;
   }
+};
 
-  delete[] src_value;
-  return processing;
+template <class T1, class T2> 
+static int DoMultiPointOp(T1 **src_map, T2 *dst_map, int width, int height, int depth, int src_count, imMultiPointOpFunc func, float* params, void* userdata, int counter)
+{
+  iMultiPointLine<T1, T2> line_op;
+  line_op.src_map = src_map;
+  line_op.dst_map = dst_map;
+  line_op.width = width;
+  line_op.height = height;
+  line_op.src_count = src_count;
+  line_op.func = func;
+  line_op.params = params;
+  line_op.userdata = userdata;
+
+  // a function call for each pixel
+  double cost = (double)width*height*depth*(src_count + 4);
+  return imProcessLines(depth * height, counter, line_op, cost);
 }
 
 int imProcessMultiPointOp(const imImage** src_image, int src_count, imImage* dst_image, imMultiPointOpFunc func, float* params, void* userdata, const char* op_name)
@@ -357,6 +376,7 @@ int imProcessMultiPointOp(const imImage** src_image, int src_count, imImage* dst
 
   int counter = imProcessCounterBegin(op_name? op_name: "MultiPointOp");
   imCounterTotal(counter, src_image[0]->depth*src_image[0]->height, "Processing...");
+  imProcessCounterImage(counter, src_image[0]);
 
   for(int i = 0; i < src_count; i++)
     src_map[i] = src_image[i]->data[0];
@@ -457,52 +477,59 @@ int imProcessMultiPointOp(const imImage** src_image, int src_count, imImage* dst
 }
 
 template <class T1, class T2> 
-static int DoMultiPointColorOp(T1 ***src_map, T2 **dst_map, int width, int height, int src_depth, int dst_depth, int src_count, imMultiPointColorOpFunc func, float* params, void* userdata, int counter)
+struct iMultiPointColorLine
 {
-  int count = width * height;
-  int tcount = IM_MAX_THREADS;
-  float* src_value = new float [src_count*src_depth*tcount];
-  IM_INT_PROCESSING;
-
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
-#endif
-  for(int i = 0; i < count; i++)
+  T1 ***src_map;
+  T2 **dst_map;
+  int width, src_depth, dst_depth, src_count;
+  imMultiPointColorOpFunc func;
+  float* params;
+  void* userdata;
+
+  void operator()(int y)
   {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_BEGIN_PROCESSING; 
-    
-    float dst_value[IM_MAXDEPTH];
-    int y = i%width;
-    int x = i - y*width;
-    int toffset = IM_THREAD_NUM*(src_count*src_depth);
-
-    for(int j = 0; j < src_count; j++)
-    {
-      for(int d = 0; d < src_depth; d++)
-        src_value[toffset + j*src_depth + d] = (float)((src_map[j])[d])[i];
-    }
+    int offset = y * width;
+    float* src_value = new float [src_count*src_depth];
 
-    if (func(src_value + toffset, dst_value, params, userdata, x, y, src_count, src_depth, dst_depth))
+    for(int x = 0; x < width; x++)
     {
-      for(int d = 0; d < dst_depth; d++)
-        (dst_map[d])[i] = (T2)dst_value[d];
+      float dst_value[IM_MAXDEPTH];
+      int i = offset + x;
+
+      for(int j = 0; j < src_count; j++)
+      {
+        for(int d = 0; d < src_depth; d++)
+          src_value[j*src_depth + d] = (float)((src_map[j])[d])[i];
+      }
+
+      if (func(src_value, dst_value, params, userdata, x, y, src_count, src_depth, dst_depth))
+      {
+        for(int d = 0; d < dst_depth; d++)
+          (dst_map[d])[i] = (T2)dst_value[d];
+      }
     }
 
-    if (x == width-1)
-    {
-      IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-      IM_END_PROCESSING;
-    }
+    delete[] src_value;
   }
+};
 
-  delete[] src_value;
-  return processing;
+template <class T1, class T2> 
+static int DoMultiPointColorOp(T1 ***src_map, T2 **dst_map, int width, int height, int src_depth, int dst_depth, int src_count, imMultiPointColorOpFunc func, float* params, void* userdata, int counter)
+{
+  iMultiPointColorLine<T1, T2> line_op;
+  line_op.src_map = src_map;
+  line_op.dst_map = dst_map;
+  line_op.width = width;
+  line_op.src_depth = src_depth;
+  line_op.dst_depth = dst_depth;
+  line_op.src_count = src_count;
+  line_op.func = func;
+  line_op.params = params;
+  line_op.userdata = userdata;
+
+  // a function call for each pixel
+  double cost = (double)width*height*(src_count*src_depth + dst_depth + 4);
+  return imProcessLines(height, counter, line_op, cost);
 }
 
 int imProcessMultiPointColorOp(const imImage** src_image, int src_count, imImage* dst_image, imMultiPointColorOpFunc func, float* params, void* userdata, const char* op_name)
@@ -514,6 +541,7 @@ int imProcessMultiPointColorOp(const imImage** src_image, int src_count, imImage
 
   int counter = imProcessCounterBegin(op_name? op_name: "MultiPointColorOp");
   imCounterTotal(counter, src_image[0]->height, "Processing...");
+  imProcessCounterImage(counter, src_image[0]);
 
   for(int i = 0; i < src_count; i++)
     src_map[i] = src_image[i]->data;
@@ -613,3 +641,115 @@ int imProcessMultiPointColorOp(const imImage** src_image, int src_count, imImage
   return ret;
 }
 
+
+struct iUnaryPointLineOp
+{
+  const imImage* src_image;
+  imImage* dst_image;
+  int src_depth, dst_depth;
+  imUnaryPointLineOpFunc func;
+  float* params;
+  void* userdata;
+  volatile int abort;
+
+  void operator()(int y)
+  {
+    const void* src_line[IM_MAXDEPTH];
+    void* dst_line[IM_MAXDEPTH];
+
+    if (imThreadAtomicGet(&abort))
+      return;
+
+    for (int d = 0; d < src_depth; d++)
+      src_line[d] = (imbyte*)src_image->data[d] + y * src_image->line_size;
+    for (int d = 0; d < dst_depth; d++)
+      dst_line[d] = (imbyte*)dst_image->data[d] + y * dst_image->line_size;
+
+    if (!func(src_line, dst_line, src_image->width, params, userdata, y))
+      imThreadAtomicSet(&abort, 1);
+  }
+};
+
+int imProcessUnaryPointLineOp(const imImage* src_image, imImage* dst_image, imUnaryPointLineOpFunc func, float* params, void* userdata, const char* op_name)
+{
+  iUnaryPointLineOp line_op;
+  line_op.src_image = src_image;
+  line_op.dst_image = dst_image;
+  line_op.src_depth = src_image->has_alpha && dst_image->has_alpha? src_image->depth+1: src_image->depth;
+  line_op.dst_depth = dst_image->has_alpha? dst_image->depth+1: dst_image->depth;
+  line_op.func = func;
+  line_op.params = params;
+  line_op.userdata = userdata;
+  line_op.abort = 0;
+
+  int counter = imProcessCounterBegin(op_name? op_name: "UnaryPointLineOp");
+  imCounterTotal(counter, src_image->height, "Processing...");
+  imProcessCounterImage(counter, src_image);
+
+  // a function call for each line, the cost is the same of a simple arithmetic operation
+  double cost = (double)src_image->count*(line_op.src_depth + line_op.dst_depth);
+  int ret = imProcessLines(src_image->height, counter, line_op, cost);
+
+  imProcessCounterEnd(counter);
+
+  return ret && !line_op.abort;
+}
+
+struct iMultiPointLineOp
+{
+  const imImage** src_image;
+  imImage* dst_image;
+  int src_count, src_depth, dst_depth;
+  imMultiPointLineOpFunc func;
+  float* params;
+  void* userdata;
+  volatile int abort;
+
+  void operator()(int y)
+  {
+    if (imThreadAtomicGet(&abort))
+      return;
+
+    const void** src_line = new const void* [src_count*src_depth];
+    void* dst_line[IM_MAXDEPTH];
+
+    for (int j = 0; j < src_count; j++)
+    {
+      for (int d = 0; d < src_depth; d++)
+        src_line[j*src_depth + d] = (imbyte*)src_image[j]->data[d] + y * src_image[j]->line_size;
+    }
+    for (int d = 0; d < dst_depth; d++)
+      dst_line[d] = (imbyte*)dst_image->data[d] + y * dst_image->line_size;
+
+    if (!func(src_line, dst_line, dst_image->width, params, userdata, y, src_count, src_depth))
+      imThreadAtomicSet(&abort, 1);
+
+    delete[] src_line;
+  }
+};
+
+int imProcessMultiPointLineOp(const imImage** src_image, int src_count, imImage* dst_image, imMultiPointLineOpFunc func, float* params, void* userdata, const char* op_name)
+{
+  iMultiPointLineOp line_op;
+  line_op.src_image = src_image;
+  line_op.dst_image = dst_image;
+  line_op.src_count = src_count;
+  line_op.src_depth = src_image[0]->has_alpha && dst_image->has_alpha? src_image[0]->depth+1: src_image[0]->depth;
+  line_op.dst_depth = dst_image->has_alpha? dst_image->depth+1: dst_image->depth;
+  line_op.func = func;
+  line_op.params = params;
+  line_op.userdata = userdata;
+  line_op.abort = 0;
+
+  int counter = imProcessCounterBegin(op_name? op_name: "MultiPointLineOp");
+  imCounterTotal(counter, dst_image->height, "Processing...");
+  imProcessCounterImage(counter, src_image[0]);
+
+  // a function call for each line, the cost is the same of a simple arithmetic operation
+  double cost = (double)dst_image->count*(src_count*line_op.src_depth + line_op.dst_depth);
+  int ret = imProcessLines(dst_image->height, counter, line_op, cost);
+
+  imProcessCounterEnd(counter);
+
+  return ret && !line_op.abort;
+}
@@ -10,12 +10,16 @@
 #include <memory.h>
 
 
-int im_process_mincount = 250000;   /* 500*500 image size */
+int im_process_mincount = 250000;   /* 500*500 image size, until calibrated */
+
+/* 0 = not calibrated, 1 = calibrated or being calibrated, or set by the application */
+static volatile int im_process_calibrated = 0;
 
 int imProcessOpenMPSetMinCount(int min_count)
 {
   int old_imin_count = im_process_mincount;
   im_process_mincount = min_count;
+  imThreadAtomicSet(&im_process_calibrated, 1);  /* the application value is not replaced by the calibration */
   return old_imin_count;
 }
 
@@ -33,43 +37,94 @@ int imProcessOpenMPSetNumThreads(int count)
 
 #ifdef _OPENMP
 
-int imCounterBegin_OMP(const char* title)
+#define IM_CALIBRATE_WIDTH     256
+#define IM_CALIBRATE_MAXLINES  4096   /* 1M pixels */
+
+static int iCalibrateBand(void* user_data, int start, int end)
 {
-  if (!imCounterHasCallback()) 
-    return -1;
-
-  int counter = imCounterBegin(title);
-  omp_lock_t* lck = new omp_lock_t;
-  omp_init_lock(lck);
-  imCounterSetUserData(counter, (void*)lck);
-  return counter;
+  float* map = (float*)user_data;
+  for (int i = start*IM_CALIBRATE_WIDTH; i < end*IM_CALIBRATE_WIDTH; i++)
+    map[i] = map[i]*0.5f + 1.0f;   /* cost 1 */
+  return 1;
 }
 
-void imCounterEnd_OMP(int counter)
+static double iCalibrateTime(float* map, int lines, int threads)
 {
-  if (counter == -1 || !imCounterHasCallback()) 
-    return;
-
-  omp_lock_t* lck = (omp_lock_t*)imCounterGetUserData(counter);
-  omp_destroy_lock(lck);
-  delete lck;
-  imCounterSetUserData(counter, NULL);
-  imCounterEnd(counter);
+  double best = -1;
+  for (int i = 0; i < 5; i++)
+  {
+    double t = omp_get_wtime();
+    imThreadParallelBands(lines, 0, threads, iCalibrateBand, map);
+    t = omp_get_wtime() - t;
+
+    if (best < 0 || t < best)
+      best = t;
+  }
+  return best;
 }
 
-int imCounterInc_OMP(int counter)
+#endif
+
+int imProcessOpenMPCalibrate(void)
 {
-  int processing;
+#ifdef _OPENMP
+  imThreadAtomicSet(&im_process_calibrated, 1);
 
-  if (counter == -1 || !imCounterHasCallback()) 
-    return 1;
+  if (omp_get_max_threads() < 2 || imThreadCount() < 2)
+    return im_process_mincount;   /* nothing to calibrate */
+
+  float* map = (float*)calloc(IM_CALIBRATE_MAXLINES*IM_CALIBRATE_WIDTH, sizeof(float));
+  if (!map)
+    return im_process_mincount;
+
+  /* start the thread pool, so its creation is not measured */
+  iCalibrateTime(map, 2, 2);
+
+  /* the smallest size where 2 threads are faster than 1,
+     with a margin for the variations of the measure */
+  int min_count = 2*IM_CALIBRATE_MAXLINES*IM_CALIBRATE_WIDTH;
+  for (int lines = 2; lines <= IM_CALIBRATE_MAXLINES; lines *= 2)
+  {
+    double serial = iCalibrateTime(map, lines, 1);
+    double parallel = iCalibrateTime(map, lines, 2);
+    if (parallel < 0.8*serial)
+    {
+      min_count = lines*IM_CALIBRATE_WIDTH;
+      break;
+    }
+  }
+
+  free(map);
 
-  omp_lock_t* lck = (omp_lock_t*)imCounterGetUserData(counter);
-  omp_set_lock(lck);
-  processing = imCounterInc(counter);
-  omp_unset_lock(lck);
-    
-  return processing;
+  im_process_mincount = min_count;
+  return min_count;
+#else
+  return im_process_mincount;
+#endif
 }
 
+int imProcessThreadCount(double cost)
+{
+#ifdef _OPENMP
+  if (imThreadAtomicCompareExchange(&im_process_calibrated, 0, 1))
+    imProcessOpenMPCalibrate();
+
+  int max_threads = omp_get_max_threads();
+  int min_count = im_process_mincount;
+  if (min_count <= 0)
+    return max_threads;
+
+  if (cost <= min_count)
+    return 1;
+
+  /* at min_count 2 threads are faster than 1,
+     each half of min_count can use one more thread */
+  double threads = 2*cost/min_count;
+  if (threads > max_threads)
+    return max_threads;
+  return (int)threads;
+#else
+  (void)cost;
+  return 1;
 #endif
+}
@@ -24,24 +24,27 @@ extern int im_process_mincount;
 
 int imProcessOpenMPSetMinCount(int min_count);
 int imProcessOpenMPSetNumThreads(int count);
+int imProcessOpenMPCalibrate(void);
+
+/* Cost model used by imProcessLines. 
+   cost is the number of pixels times the relative cost of each pixel, 
+   1 is the cost of a simple arithmetic point operation.
+   Returns the number of threads for the loop, 1 if it must run in the current thread. 
+   im_process_mincount is calibrated in the first call, unless set by imProcessOpenMPSetMinCount. 
+   Returns always 1 if OpenMP is not enabled. */
+int imProcessThreadCount(double cost);
 
 #define IM_INT_PROCESSING     int processing = 1;
 
 #ifdef _OPENMP
 
+/* imCounterInc can be called by several threads, it does not lock. */
 #define IM_BEGIN_PROCESSING   if (processing) {
-#define IM_COUNT_PROCESSING   if (!imCounterInc_OMP(counter)) { processing = 0;
+#define IM_COUNT_PROCESSING   if (!imCounterInc(counter)) { processing = 0;
 #define IM_END_PROCESSING     }}
 #define IM_MAX_THREADS        omp_get_max_threads()
 #define IM_THREAD_NUM         omp_get_thread_num()
 
-int  imCounterBegin_OMP(const char* title);
-void imCounterEnd_OMP(int counter);
-int  imCounterInc_OMP(int counter);
-
-#define imProcessCounterBegin imCounterBegin_OMP
-#define imProcessCounterEnd   imCounterEnd_OMP
-
 #else
 
 /*
@@ -54,14 +57,167 @@ int  imCounterInc_OMP(int counter);
 #define IM_MAX_THREADS 1
 #define IM_THREAD_NUM  0
 
-#define imProcessCounterBegin imCounterBegin
-#define imProcessCounterEnd   imCounterEnd
+#endif
+
+/* Reports the pixels and bytes of the image processed by the operation. */
+#define imProcessCounterImage(_counter, _image) \
+  imCounterProfileAdd(_counter, (double)(_image)->count*(_image)->depth, (double)(_image)->size, 0, 0)
+
+/* Reports the temporary memory allocated by the operation. */
+#define imProcessCounterMemory(_counter, _size) \
+  imCounterProfileAdd(_counter, 0, 0, 0, (double)(_size))
+
 
+#if defined(__cplusplus)
+}
 #endif
 
 
 #if defined(__cplusplus)
+
+#include <stdlib.h>
+#include <im_complex.h>
+
+#include "im_thread.h"
+
+/* The operations that use the counter are also measured by the profile, see imCounterProfileBegin. */
+inline int imProcessCounterBegin(const char* name)
+{
+  int counter = imCounterBegin(name);
+  imCounterProfileBegin(counter, name);
+  return counter;
+}
+
+inline void imProcessCounterEnd(int counter)
+{
+  imCounterProfileEnd(counter);
+  imCounterEnd(counter);
 }
+
+/* The CPU time of each band is added to the profile when the operation is measured, 
+   the bands processed by the thread that started the operation are ignored by imCounterProfileAddCPUTime. */
+inline double imProcessBandCPUTimeBegin(int profile)
+{
+  return profile? imThreadCPUTime(): 0;
+}
+
+inline void imProcessBandCPUTimeEnd(int counter, int profile, double cpu_time)
+{
+  if (profile)
+    imCounterProfileAddCPUTime(counter, imThreadCPUTime() - cpu_time);
+}
+
+template <class LineOp>
+struct imProcessLinesData
+{
+  LineOp* op;
+  int counter, profile;
+};
+
+template <class LineOp>
+static int imProcessLinesBand(void* user_data, int start, int end)
+{
+  imProcessLinesData<LineOp>* data = (imProcessLinesData<LineOp>*)user_data;
+  double cpu_time = imProcessBandCPUTimeBegin(data->profile);
+
+  int ret = 1;
+  for (int line = start; line < end; line++)
+  {
+    (*data->op)(line);
+
+    if (!imCounterInc(data->counter))
+    {
+      ret = 0;
+      break;
+    }
+  }
+
+  imProcessBandCPUTimeEnd(data->counter, data->profile, cpu_time);
+  return ret;
+}
+
+/* Calls op(line) for each line in [0,line_count) and increments the counter after each line. 
+   Lines are distributed among the threads of the band scheduler of "im_thread.h", 
+   so op must write only its own line. 
+   cost is the cost of all the lines, see imProcessThreadCount. 
+   Returns zero if the counter was aborted, the remaining lines are skipped. */
+template <class LineOp>
+static int imProcessLines(int line_count, int counter, LineOp& op, double cost)
+{
+  imProcessLinesData<LineOp> data;
+  data.op = &op;
+  data.counter = counter;
+  data.profile = imCounterProfileIsActive(counter);
+
+  int thread_count = imProcessThreadCount(cost);
+  imCounterProfileAdd(counter, 0, 0, thread_count < imThreadCount()? thread_count: imThreadCount(), 0);
+
+  return imThreadParallelBands(line_count, 0, thread_count, imProcessLinesBand<LineOp>, &data);
+}
+
+template <class LineOp>
+struct imProcessLinesBufferData
+{
+  LineOp* op;
+  int counter, profile;
+  size_t buffer_size;
+};
+
+template <class LineOp>
+static int imProcessLinesBufferBand(void* user_data, int start, int end)
+{
+  imProcessLinesBufferData<LineOp>* data = (imProcessLinesBufferData<LineOp>*)user_data;
+  void* buffer = malloc(data->buffer_size);
+  if (!buffer)
+    return 0;
+
+  double cpu_time = imProcessBandCPUTimeBegin(data->profile);
+
+  int ret = 1;
+  for (int line = start; line < end; line++)
+  {
+    (*data->op)(line, buffer);
+
+    if (!imCounterInc(data->counter))
+    {
+      ret = 0;
+      break;
+    }
+  }
+
+  imProcessBandCPUTimeEnd(data->counter, data->profile, cpu_time);
+
+  free(buffer);
+  return ret;
+}
+
+/* Same as imProcessLines, but op(line, buffer) also receives a temporary buffer of buffer_size bytes, 
+   allocated once for each band of lines and shared by the lines of the band. 
+   The memory of the buffers used at the same time is reported to the counter. 
+   Returns zero also if a buffer could not be allocated, the remaining lines are skipped. */
+template <class LineOp>
+static int imProcessLinesBuffer(int line_count, int counter, LineOp& op, double cost, size_t buffer_size)
+{
+  imProcessLinesBufferData<LineOp> data;
+  data.op = &op;
+  data.counter = counter;
+  data.profile = imCounterProfileIsActive(counter);
+  data.buffer_size = buffer_size;
+
+  int thread_count = imProcessThreadCount(cost);
+  if (thread_count > imThreadCount()) thread_count = imThreadCount();
+  imCounterProfileAdd(counter, 0, 0, thread_count, (double)thread_count*buffer_size);
+
+  return imThreadParallelBands(line_count, 0, thread_count, imProcessLinesBufferBand<LineOp>, &data);
+}
+
+/* Relative cost of the arithmetic of each data type, 
+   complex values do about 4 times more operations. */
+template <class T>
+inline double imProcessTypeCost(const T*) { return 1; }
+template <class T>
+inline double imProcessTypeCost(const imComplex<T>*) { return 4; }
+
 #endif
 
 #endif
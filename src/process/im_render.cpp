@@ -59,6 +59,7 @@ int imProcessRenderCondOp(imImage* image, imRenderCondFunc render_func, const ch
 
   int counter = imProcessCounterBegin(render_name);
   imCounterTotal(counter, image->depth*image->height, "Rendering...");
+  imProcessCounterImage(counter, image);
 
   for (int d = 0; d < image->depth; d++)
   {
@@ -142,6 +143,7 @@ int imProcessRenderOp(imImage* image, imRenderFunc render_func, const char* rend
 
   int counter = imProcessCounterBegin(render_name);
   imCounterTotal(counter, image->depth*image->height, "Rendering...");
+  imProcessCounterImage(counter, image);
 
   for (int d = 0; d < image->depth; d++)
   {
@@ -24,25 +24,18 @@ static inline void iResizeInverse(int x, int y, float *xl, float *yl, float x_in
 }
 
 template <class DT, class DTU> 
-static int iResize(int src_width, int src_height, const DT *src_map, 
-                         int dst_width, int dst_height, DT *dst_map, 
-                         DTU Dummy, int order, int counter)
+struct iResizeLine
 {
-  float x_invfactor = float(src_width)/float(dst_width);
-  float y_invfactor = float(src_height)/float(dst_height);
-
-  IM_INT_PROCESSING;
-
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINHEIGHT(dst_height))
-#endif
-  for (int y = 0; y < dst_height; y++)
+  int src_width, src_height;
+  const DT *src_map;
+  int dst_width;
+  DT *dst_map;
+  float x_invfactor, y_invfactor;
+  int order;
+  DTU Dummy;
+
+  void operator()(int y)
   {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_BEGIN_PROCESSING;
-
     int line_offset = y*dst_width;
 
     for (int x = 0; x < dst_width; x++)
@@ -61,45 +54,44 @@ static int iResize(int src_width, int src_height, const DT *src_map,
           dst_map[line_offset+x] = imZeroOrderInterpolation(src_width, src_height, src_map, xl, yl);
       }
     }
-
-    IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_END_PROCESSING;
   }
-
-  return processing;
-}
+};
 
 template <class DT, class DTU> 
-static int iReduce(int src_width, int src_height, const DT *src_map, 
+static int iResize(int src_width, int src_height, const DT *src_map, 
                          int dst_width, int dst_height, DT *dst_map, 
                          DTU Dummy, int order, int counter)
 {
-  float x_invfactor = float(src_width)/float(dst_width);
-  float y_invfactor = float(src_height)/float(dst_height);
-
-  float xl0, yl0;
-  iResizeInverse(1, 1, &xl0, &yl0, x_invfactor, y_invfactor);
-  float xl1, yl1;
-  iResizeInverse(2, 2, &xl1, &yl1, x_invfactor, y_invfactor);
-  
-  float box_width = xl1 - xl0;
-  float box_height = yl1 - yl0;
-
-  IM_INT_PROCESSING;
+  iResizeLine<DT, DTU> line_op;
+  line_op.src_width = src_width;
+  line_op.src_height = src_height;
+  line_op.src_map = src_map;
+  line_op.dst_width = dst_width;
+  line_op.dst_map = dst_map;
+  line_op.x_invfactor = float(src_width)/float(dst_width);
+  line_op.y_invfactor = float(src_height)/float(dst_height);
+  line_op.order = order;
+  line_op.Dummy = Dummy;
+
+  // number of source pixels used for each pixel
+  double cost = (double)dst_width*dst_height*(order == 3? 16: (order == 1? 4: 1))*imProcessTypeCost(dst_map);
+  return imProcessLines(dst_height, counter, line_op, cost);
+}
 
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINHEIGHT(dst_height))
-#endif
-  for (int y = 0; y < dst_height; y++)
+template <class DT, class DTU> 
+struct iReduceLine
+{
+  int src_width, src_height;
+  const DT *src_map;
+  int dst_width;
+  DT *dst_map;
+  float x_invfactor, y_invfactor;
+  float box_width, box_height;
+  int order;
+  DTU Dummy;
+
+  void operator()(int y)
   {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_BEGIN_PROCESSING;
-
     int line_offset = y*dst_width;
 
     for (int x = 0; x < dst_width; x++)
@@ -116,15 +108,38 @@ static int iReduce(int src_width, int src_height, const DT *src_map,
           dst_map[line_offset+x] = imBilinearDecimation(src_width, src_height, src_map, xl, yl, box_width, box_height, Dummy);
       }
     }
-
-    IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_END_PROCESSING;
   }
+};
 
-  return processing;
+template <class DT, class DTU> 
+static int iReduce(int src_width, int src_height, const DT *src_map, 
+                         int dst_width, int dst_height, DT *dst_map, 
+                         DTU Dummy, int order, int counter)
+{
+  float x_invfactor = float(src_width)/float(dst_width);
+  float y_invfactor = float(src_height)/float(dst_height);
+
+  float xl0, yl0;
+  iResizeInverse(1, 1, &xl0, &yl0, x_invfactor, y_invfactor);
+  float xl1, yl1;
+  iResizeInverse(2, 2, &xl1, &yl1, x_invfactor, y_invfactor);
+  
+  iReduceLine<DT, DTU> line_op;
+  line_op.src_width = src_width;
+  line_op.src_height = src_height;
+  line_op.src_map = src_map;
+  line_op.dst_width = dst_width;
+  line_op.dst_map = dst_map;
+  line_op.x_invfactor = x_invfactor;
+  line_op.y_invfactor = y_invfactor;
+  line_op.box_width = xl1 - xl0;
+  line_op.box_height = yl1 - yl0;
+  line_op.order = order;
+  line_op.Dummy = Dummy;
+
+  // all the source pixels are used, the bilinear decimation computes weights for each one
+  double cost = (double)src_width*src_height*(order == 0? 1: 4)*imProcessTypeCost(dst_map);
+  return imProcessLines(dst_height, counter, line_op, cost);
 }
 
 int imProcessReduce(const imImage* src_image, imImage* dst_image, int order)
@@ -134,6 +149,7 @@ int imProcessReduce(const imImage* src_image, imImage* dst_image, int order)
   const char* int_msg = (order == 1)? "Bilinear Decimation": "Zero Order Decimation";
   int src_depth = src_image->has_alpha && dst_image->has_alpha? src_image->depth+1: src_image->depth;
   imCounterTotal(counter, src_depth*dst_image->height, int_msg);
+  imProcessCounterImage(counter, dst_image);
 
   for (int i = 0; i < src_depth; i++)
   {
@@ -193,6 +209,7 @@ int imProcessResize(const imImage* src_image, imImage* dst_image, int order)
   const char* int_msg = (order == 3)? "Bicubic Interpolation": (order == 1)? "Bilinear Interpolation": "Zero Order Interpolation";
   int src_depth = src_image->has_alpha && dst_image->has_alpha? src_image->depth+1: src_image->depth;
   imCounterTotal(counter, src_depth*dst_image->height, int_msg);
+  imProcessCounterImage(counter, dst_image);
 
   for (int i = 0; i < src_depth; i++)
   {
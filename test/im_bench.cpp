@@ -0,0 +1,562 @@
+/* IM 3 sample that measures the speed of the file formats and of the main
+   processing operations using synthetic images, and writes the results in JSON.
+
+  Needs "im.lib", "im_process.lib" and "im_fftw.lib".
+
+  Usage: im_bench [-s <size>[,<size>...]] [-i <iterations>] [-g <group>[,<group>...]]
+                  [-o <json_file_name>] [-t <temp_folder>]
+
+    -s  image sizes, the images are square. Default: 256,1024
+    -i  number of times each operation is repeated, the best and the mean times are reported. Default: 3
+    -g  groups to measure. Default: all
+        format, convolve, rank, morph, resize, rotate, color, fft, analyze
+    -o  writes the JSON to the file. Default: standard output.
+    -t  folder of the temporary files used by the formats. Default: current folder.
+
+    The synthetic images depend only on their size and type,
+    so results of different releases and machines can be compared.
+    Progress is written in the standard error.
+
+    Example: im_bench -s 512,2048 -i 5 -o im_bench.json
+*/
+
+#include <im.h>
+#include <im_lib.h>
+#include <im_image.h>
+#include <im_color.h>
+#include <im_util.h>
+#include <im_convert.h>
+#include <im_kernel.h>
+#include <im_process.h>
+#include <im_cpu.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct ImageType
+{
+  const char* name;
+  int color_space, data_type;
+};
+
+enum { TYPE_GRAY, TYPE_RGB, TYPE_MAP, TYPE_BINARY, TYPE_GRAY16, TYPE_GRAYF, TYPE_RGBF, TYPE_COUNT };
+
+static const ImageType image_types[TYPE_COUNT] =
+{
+  {"gray8",   IM_GRAY,   IM_BYTE},
+  {"rgb8",    IM_RGB,    IM_BYTE},
+  {"map8",    IM_MAP,    IM_BYTE},
+  {"binary",  IM_BINARY, IM_BYTE},
+  {"gray16",  IM_GRAY,   IM_USHORT},
+  {"grayf",   IM_GRAY,   IM_FLOAT},
+  {"rgbf",    IM_RGB,    IM_FLOAT}
+};
+
+#define TYPE_BIT(_t) (1 << (_t))
+
+struct Result
+{
+  std::string group, name, type;
+  int width, height;
+  double best, mean;   /* seconds */
+  double pixels;       /* per iteration */
+  long bytes;          /* encoded size, only for formats */
+  int ok;
+};
+
+struct Options
+{
+  std::vector<int> sizes;
+  int iterations;
+  std::string groups;
+  std::string temp_folder;
+  const char* json_file_name;
+};
+
+static std::vector<Result> results;
+static Options options;
+
+static double Now()
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int UseGroup(const char* group)
+{
+  if (options.groups.empty())
+    return 1;
+
+  std::string list = "," + options.groups + ",";
+  return list.find(std::string(",") + group + ",") != std::string::npos;
+}
+
+static void AddResult(const char* group, const std::string& name, const imImage* image,
+                      const std::vector<double>& times, long bytes, int ok)
+{
+  Result r;
+  r.group = group;
+  r.name = name;
+  r.type = "";
+  for (int t = 0; t < TYPE_COUNT; t++)
+  {
+    if (image_types[t].color_space == image->color_space && image_types[t].data_type == image->data_type)
+      r.type = image_types[t].name;
+  }
+  r.width = image->width;
+  r.height = image->height;
+  r.pixels = (double)image->count*image->depth;
+  r.bytes = bytes;
+  r.ok = ok;
+
+  r.best = 0;
+  r.mean = 0;
+  for (size_t i = 0; i < times.size(); i++)
+  {
+    if (i == 0 || times[i] < r.best)
+      r.best = times[i];
+    r.mean += times[i];
+  }
+  if (!times.empty())
+    r.mean /= times.size();
+
+  results.push_back(r);
+
+  fprintf(stderr, "  %-8s %-28s %-7s %5dx%-5d %10.3f ms %s\n", group, name.c_str(), r.type.c_str(),
+          r.width, r.height, r.best*1000, ok? "": "FAILED");
+}
+
+/*********************** Synthetic Images ***********************/
+
+/* Deterministic noise, a hash of the pixel position and plane.
+   The noise functions of the library are seeded with the current time. */
+static float RenderHashNoise(int x, int y, int d, float* param)
+{
+  unsigned int h = (unsigned int)x*73856093u ^ (unsigned int)y*19349663u ^ (unsigned int)(d + 1)*83492791u;
+  h ^= h >> 13;
+  h *= 0x5bd1e995u;
+  h ^= h >> 15;
+  return (h & 0xFFFF) * param[0] / 65535.0f;
+}
+
+/* A gaussian spot with cosine waves and noise, so the images have smooth areas,
+   edges and details, like a photograph. */
+static imImage* CreateImage(int size, int type)
+{
+  const ImageType* it = image_types + type;
+
+  if (it->color_space == IM_MAP || it->color_space == IM_BINARY)
+  {
+    imImage* rgb = CreateImage(size, it->color_space == IM_MAP? TYPE_RGB: TYPE_GRAY);
+    imImage* image = imImageCreate(size, size, it->color_space, IM_BYTE);
+    if (it->color_space == IM_MAP)
+      imConvertColorSpace(rgb, image);
+    else
+      imProcessThreshold(rgb, image, 128, 1);
+    imImageDestroy(rgb);
+    return image;
+  }
+
+  imImage* image = imImageCreate(size, size, it->color_space, it->data_type);
+  imImage* waves = imImageClone(image);
+  imImage* noise = imImageClone(image);
+
+  imProcessRenderGaussian(image, size/4.0f);
+  imProcessRenderCosine(waves, size/8.0f, size/11.0f);
+  imProcessBlendConst(image, waves, image, 0.7f);
+
+  float param[1];
+  param[0] = (float)imColorMax(it->data_type);
+  imProcessRenderOp(noise, RenderHashNoise, "Hash Noise", param, 0);
+  imProcessBlendConst(image, noise, image, 0.9f);
+
+  imImageDestroy(waves);
+  imImageDestroy(noise);
+  return image;
+}
+
+/*********************** File Formats ***********************/
+
+static long FileSize(const char* file_name)
+{
+  FILE* file = fopen(file_name, "rb");
+  if (!file)
+    return 0;
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fclose(file);
+  return size;
+}
+
+static void BenchFormat(const char* format, const char* compression, const imImage* image)
+{
+  std::string file_name = options.temp_folder + "im_bench.tmp";
+  std::string name = std::string(format) + "/" + compression;
+  std::vector<double> encode_times, decode_times;
+  int ok = 1;
+
+  for (int i = 0; i < options.iterations && ok; i++)
+  {
+    int error;
+    double start = Now();
+    imFile* ifile = imFileNew(file_name.c_str(), format, &error);
+    if (ifile)
+    {
+      imFileSetInfo(ifile, compression);
+      error = imFileSaveImage(ifile, image);
+      imFileClose(ifile);
+    }
+    encode_times.push_back(Now() - start);
+
+    if (error != IM_ERR_NONE)
+      ok = 0;
+  }
+
+  long bytes = FileSize(file_name.c_str());
+  AddResult("format", name + "/encode", image, encode_times, bytes, ok);
+  if (!ok)
+  {
+    remove(file_name.c_str());
+    return;
+  }
+
+  for (int i = 0; i < options.iterations && ok; i++)
+  {
+    int error;
+    double start = Now();
+    imFile* ifile = imFileOpen(file_name.c_str(), &error);
+    if (ifile)
+    {
+      /* the format can return a different type, like a palette instead of RGB */
+      imImage* check = imFileLoadImage(ifile, 0, &error);
+      if (check) imImageDestroy(check);
+      imFileClose(ifile);
+    }
+    decode_times.push_back(Now() - start);
+
+    if (error != IM_ERR_NONE)
+      ok = 0;
+  }
+
+  AddResult("format", name + "/decode", image, decode_times, bytes, ok);
+
+  remove(file_name.c_str());
+}
+
+static void BenchFormats(imImage** images)
+{
+  char* format_list[50];
+  int format_count;
+  imFormatList(format_list, &format_count);
+
+  /* the lists returned by the library are reused in each call */
+  std::vector<std::string> formats(format_list, format_list + format_count);
+
+  for (size_t f = 0; f < formats.size(); f++)
+  {
+    for (int t = 0; t < TYPE_COUNT; t++)
+    {
+      char* comp_list[50];
+      int comp_count = 0;
+      imFormatCompressions(formats[f].c_str(), comp_list, &comp_count, image_types[t].color_space, image_types[t].data_type);
+
+      std::vector<std::string> comps(comp_list, comp_list + comp_count);
+      for (size_t c = 0; c < comps.size(); c++)
+        BenchFormat(formats[f].c_str(), comps[c].c_str(), images[t]);
+    }
+  }
+}
+
+/*********************** Processing ***********************/
+
+static imImage* iDstSame(const imImage* src)  { return imImageClone(src); }
+static imImage* iDstHalf(const imImage* src)  { return imImageCreateBased(src, src->width/2, src->height/2, -1, -1); }
+static imImage* iDstDouble(const imImage* src)  { return imImageCreateBased(src, src->width*2, src->height*2, -1, -1); }
+static imImage* iDstCFloat(const imImage* src)  { return imImageCreateBased(src, -1, -1, -1, IM_CFLOAT); }
+static imImage* iDstUShort(const imImage* src)  { return imImageCreateBased(src, -1, -1, IM_GRAY, IM_USHORT); }
+static imImage* iDstYCbCr(const imImage* src)  { return imImageCreateBased(src, -1, -1, IM_YCBCR, -1); }
+static imImage* iDstGray(const imImage* src)  { return imImageCreateBased(src, -1, -1, IM_GRAY, -1); }
+static imImage* iDstMap(const imImage* src)  { return imImageCreateBased(src, -1, -1, IM_MAP, -1); }
+static imImage* iDstFloat(const imImage* src)  { return imImageCreateBased(src, -1, -1, -1, IM_FLOAT); }
+static imImage* iDstByte(const imImage* src)  { return imImageCreateBased(src, -1, -1, -1, IM_BYTE); }
+
+static imImage* iDstRotate(const imImage* src)
+{
+  int width, height;
+  double cos0 = cos(0.5), sin0 = sin(0.5);
+  imProcessCalcRotateSize(src->width, src->height, &width, &height, cos0, sin0);
+  return imImageCreateBased(src, width, height, -1, -1);
+}
+
+static int iConvolve(const imImage* src, imImage* dst)
+{
+  imImage* kernel = imImageCreate(5, 5, IM_GRAY, IM_INT);
+  int* k = (int*)kernel->data[0];
+  for (int i = 0; i < 25; i++)
+    k[i] = 1 + (i % 5 == 2) + (i / 5 == 2);
+  int ret = imProcessConvolve(src, dst, kernel);
+  imImageDestroy(kernel);
+  return ret;
+}
+
+static int iGaussian(const imImage* src, imImage* dst) { return imProcessGaussianConvolve(src, dst, 2.0f); }
+static int iSobel(const imImage* src, imImage* dst) { return imProcessSobelConvolve(src, dst); }
+static int iMedian(const imImage* src, imImage* dst) { return imProcessMedianConvolve(src, dst, 5); }
+static int iRange(const imImage* src, imImage* dst) { return imProcessRangeConvolve(src, dst, 5); }
+static int iGrayDilate(const imImage* src, imImage* dst) { return imProcessGrayMorphDilate(src, dst, 5); }
+static int iBinDilate(const imImage* src, imImage* dst) { return imProcessBinMorphDilate(src, dst, 5, 1); }
+static int iReduce(const imImage* src, imImage* dst) { return imProcessReduce(src, dst, 1); }
+static int iResizeLinear(const imImage* src, imImage* dst) { return imProcessResize(src, dst, 1); }
+static int iResizeCubic(const imImage* src, imImage* dst) { return imProcessResize(src, dst, 3); }
+static int iRotate(const imImage* src, imImage* dst) { return imProcessRotate(src, dst, cos(0.5), sin(0.5), 1); }
+static int iColorSpace(const imImage* src, imImage* dst) { return imConvertColorSpace(src, dst) == IM_ERR_NONE; }
+static int iDataType(const imImage* src, imImage* dst) { return imConvertDataType(src, dst, IM_CPX_REAL, IM_GAMMA_LINEAR, 0, IM_CAST_MINMAX) == IM_ERR_NONE; }
+static int iFFT(const imImage* src, imImage* dst) { imProcessFFT(src, dst); return 1; }
+static int iRegions(const imImage* src, imImage* dst) { imAnalyzeFindRegions(src, dst, 8, 1); return 1; }
+
+static int iStatistics(const imImage* src, imImage* dst)
+{
+  imStats stats[4];
+  (void)dst;
+  imCalcImageStatistics(src, stats);
+  return 1;
+}
+
+static int iHistogram(const imImage* src, imImage* dst)
+{
+  static unsigned long histo[65536];
+  (void)dst;
+  for (int d = 0; d < src->depth; d++)
+    imCalcHistogram(src, histo, d, 0);
+  return 1;
+}
+
+struct ProcessOp
+{
+  const char* group;
+  const char* name;
+  int types;    /* input types, TYPE_BIT of each */
+  imImage* (*create_dst)(const imImage* src);
+  int (*func)(const imImage* src, imImage* dst);
+};
+
+#define TYPES_ALL   (TYPE_BIT(TYPE_GRAY) | TYPE_BIT(TYPE_RGB) | TYPE_BIT(TYPE_GRAY16) | TYPE_BIT(TYPE_GRAYF))
+#define TYPES_BYTE  (TYPE_BIT(TYPE_GRAY) | TYPE_BIT(TYPE_RGB))
+
+static const ProcessOp process_ops[] =
+{
+  {"convolve", "Convolve5x5",        TYPES_ALL, iDstSame, iConvolve},
+  {"convolve", "GaussianConvolve",   TYPES_ALL, iDstSame, iGaussian},
+  {"convolve", "SobelConvolve",      TYPES_ALL, iDstSame, iSobel},
+  {"rank",     "MedianConvolve5x5",  TYPES_ALL, iDstSame, iMedian},
+  {"rank",     "RangeConvolve5x5",   TYPES_ALL, iDstSame, iRange},
+  {"morph",    "GrayMorphDilate5x5", TYPES_ALL, iDstSame, iGrayDilate},
+  {"morph",    "BinMorphDilate5x5",  TYPE_BIT(TYPE_BINARY), iDstSame, iBinDilate},
+  {"resize",   "Reduce/Linear",      TYPES_ALL, iDstHalf, iReduce},
+  {"resize",   "Resize/Linear",      TYPES_ALL, iDstDouble, iResizeLinear},
+  {"resize",   "Resize/Cubic",       TYPES_ALL, iDstDouble, iResizeCubic},
+  {"rotate",   "Rotate/Linear",      TYPES_ALL, iDstRotate, iRotate},
+  {"color",    "RGB2YCbCr",          TYPE_BIT(TYPE_RGB) | TYPE_BIT(TYPE_RGBF), iDstYCbCr, iColorSpace},
+  {"color",    "RGB2Gray",           TYPE_BIT(TYPE_RGB) | TYPE_BIT(TYPE_RGBF), iDstGray, iColorSpace},
+  {"color",    "RGB2Map",            TYPE_BIT(TYPE_RGB), iDstMap, iColorSpace},
+  {"color",    "Byte2Float",         TYPES_BYTE, iDstFloat, iDataType},
+  {"color",    "Float2Byte",         TYPE_BIT(TYPE_GRAYF) | TYPE_BIT(TYPE_RGBF), iDstByte, iDataType},
+  {"fft",      "FFT",                TYPE_BIT(TYPE_GRAY) | TYPE_BIT(TYPE_GRAYF), iDstCFloat, iFFT},
+  {"analyze",  "Histogram",          TYPES_BYTE | TYPE_BIT(TYPE_GRAY16), NULL, iHistogram},
+  {"analyze",  "ImageStatistics",    TYPES_ALL, NULL, iStatistics},
+  {"analyze",  "FindRegions",        TYPE_BIT(TYPE_BINARY), iDstUShort, iRegions}
+};
+
+static void BenchProcess(const ProcessOp* op, const imImage* src)
+{
+  imImage* dst = op->create_dst? op->create_dst(src): NULL;
+  std::vector<double> times;
+  int ok = 1;
+
+  for (int i = 0; i < options.iterations && ok; i++)
+  {
+    double start = Now();
+    ok = op->func(src, dst);
+    times.push_back(Now() - start);
+  }
+
+  AddResult(op->group, op->name, src, times, 0, ok);
+
+  if (dst) imImageDestroy(dst);
+}
+
+/*********************** JSON ***********************/
+
+static void WriteJSONString(FILE* file, const std::string& str)
+{
+  fputc('"', file);
+  for (size_t i = 0; i < str.size(); i++)
+  {
+    char c = str[i];
+    if (c == '"' || c == '\\')
+      fputc('\\', file);
+    if ((unsigned char)c < 32)
+      fprintf(file, "\\u%04x", c);
+    else
+      fputc(c, file);
+  }
+  fputc('"', file);
+}
+
+static void WriteJSON(FILE* file)
+{
+  fprintf(file, "{\n");
+  fprintf(file, "  \"im_version\": \"%s\",\n", imVersion());
+  fprintf(file, "  \"cpu\": \"%s\",\n", imCPUFeatureName(imCPUFeatures()));   /* can be limited by IM_CPU */
+#ifdef _OPENMP
+  fprintf(file, "  \"openmp\": true,\n");
+#else
+  fprintf(file, "  \"openmp\": false,\n");
+#endif
+  fprintf(file, "  \"iterations\": %d,\n", options.iterations);
+  fprintf(file, "  \"results\": [\n");
+
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const Result& r = results[i];
+    fprintf(file, "    {\"group\": ");
+    WriteJSONString(file, r.group);
+    fprintf(file, ", \"name\": ");
+    WriteJSONString(file, r.name);
+    fprintf(file, ", \"type\": \"%s\", \"width\": %d, \"height\": %d, ", r.type.c_str(), r.width, r.height);
+    fprintf(file, "\"best_ms\": %.4f, \"mean_ms\": %.4f, \"mpixels_per_s\": %.3f, ",
+            r.best*1000, r.mean*1000, r.best > 0? r.pixels/(r.best*1.0e6): 0);
+    if (r.group == "format")
+      fprintf(file, "\"bytes\": %ld, ", r.bytes);
+    fprintf(file, "\"ok\": %s}%s\n", r.ok? "true": "false", i + 1 < results.size()? ",": "");
+  }
+
+  fprintf(file, "  ]\n");
+  fprintf(file, "}\n");
+}
+
+/*********************** Main ***********************/
+
+static int ParseOptions(int argc, char* argv[])
+{
+  options.iterations = 3;
+  options.json_file_name = NULL;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char* arg = argv[i];
+    if (arg[0] != '-' || arg[1] == 0 || arg[2] != 0 || i + 1 >= argc)
+    {
+      fprintf(stderr, "Invalid option \"%s\".\n", arg);
+      return 0;
+    }
+
+    const char* value = argv[++i];
+    switch (arg[1])
+    {
+    case 's':
+      {
+        const char* s = value;
+        while (*s)
+        {
+          int size = atoi(s);
+          if (size < 16)
+          {
+            fprintf(stderr, "Invalid size \"%s\".\n", value);
+            return 0;
+          }
+          options.sizes.push_back(size);
+
+          s = strchr(s, ',');
+          if (!s) break;
+          s++;
+        }
+      }
+      break;
+    case 'i':
+      options.iterations = atoi(value);
+      if (options.iterations < 1) options.iterations = 1;
+      break;
+    case 'g':
+      options.groups = value;
+      break;
+    case 'o':
+      options.json_file_name = value;
+      break;
+    case 't':
+      options.temp_folder = value;
+      if (!options.temp_folder.empty() && options.temp_folder[options.temp_folder.size()-1] != '/' &&
+          options.temp_folder[options.temp_folder.size()-1] != '\\')
+        options.temp_folder += "/";
+      break;
+    default:
+      fprintf(stderr, "Invalid option \"%s\".\n", arg);
+      return 0;
+    }
+  }
+
+  if (options.sizes.empty())
+  {
+    options.sizes.push_back(256);
+    options.sizes.push_back(1024);
+  }
+
+  return 1;
+}
+
+int main(int argc, char* argv[])
+{
+  if (!ParseOptions(argc, argv))
+    return 1;
+
+  for (size_t s = 0; s < options.sizes.size(); s++)
+  {
+    int size = options.sizes[s];
+    fprintf(stderr, "Size: %dx%d\n", size, size);
+
+    imImage* images[TYPE_COUNT];
+    for (int t = 0; t < TYPE_COUNT; t++)
+      images[t] = CreateImage(size, t);
+
+    if (UseGroup("format"))
+      BenchFormats(images);
+
+    for (int i = 0; i < (int)(sizeof(process_ops)/sizeof(process_ops[0])); i++)
+    {
+      const ProcessOp* op = process_ops + i;
+      if (!UseGroup(op->group))
+        continue;
+
+      for (int t = 0; t < TYPE_COUNT; t++)
+      {
+        if (op->types & TYPE_BIT(t))
+          BenchProcess(op, images[t]);
+      }
+    }
+
+    for (int t = 0; t < TYPE_COUNT; t++)
+      imImageDestroy(images[t]);
+  }
+
+  FILE* file = stdout;
+  if (options.json_file_name)
+  {
+    file = fopen(options.json_file_name, "w");
+    if (!file)
+    {
+      fprintf(stderr, "Error Opening File.\n");
+      return 1;
+    }
+  }
+
+  WriteJSON(file);
+
+  if (file != stdout)
+    fclose(file);
+
+  return 0;
+}
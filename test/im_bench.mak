@@ -0,0 +1,17 @@
+APPNAME = im_bench
+APPTYPE = console
+LINKER = g++
+
+SRC = im_bench.cpp
+
+USE_IM = Yes
+
+IM = ..
+
+USE_STATIC = Yes
+
+SLIB = $(IM_LIB)/libim_fftw.a $(IM_LIB)/libim_process.a
+
+ifeq ($(findstring Win, $(TEC_SYSNAME)), )
+  LIBS = pthread
+endif
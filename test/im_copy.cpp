@@ -1,23 +1,63 @@
-/* IM 3 sample that copies an image from one file to another. 
-   It is good to test the file formats read and write.
-   If the target does not supports the input image it aborts and returns an error.
+/* IM 3 sample that copies images from one file to another,
+   or transcodes a batch of files using several threads.
+   It is good to test the file formats read and write,
+   and to measure the file I/O throughput of each format.
 
-  Needs "im.lib".
+  Needs "im.lib" and a C++11 compiler (threads).
 
-  Usage: im_copy <input_file_name> <output_file_name> [<output_format> [<output_compression]]
+  Usage: im_copy <input_file_name> <output_file_name> [<output_format> [<output_compression>]]
+
+    Copies a single file, all the images in the file are copied.
+    If the target does not supports the input image it aborts and returns an error.
 
     Example: im_copy test.tif test_proc.tif
+
+  Usage: im_copy [options] -o <output_folder> <input_file_name or folder or @list_file> ...
+
+    Transcodes a batch of files. Folders are not scanned recursively.
+    A list file has one file name per line.
+    Reading, converting and writing are done by pools of threads connected by bounded queues.
+    When the output format can not store an image, it is converted to a bitmap (RGB, MAP, GRAY or BINARY).
+
+    Options:
+      -f <format>        output format (default: same as input)
+      -c <compression>   output compression (default: same as input, if the format is the same)
+      -q <quality>       JPEG quality, 0-100 (JPEGQuality attribute)
+      -z <quality>       Deflate quality, 1-9 (ZIPQuality attribute)
+      -r <count>         number of reading threads
+      -t <count>         number of converting threads
+      -w <count>         number of writing threads
+      -Q <count>         queue size in files (default: 4)
+      --bench            prints the images/s and MB/s of each stage at the end
+
+    Example: im_copy -f JPEG -q 85 -o out --bench photos
 */
 
 #include <im.h>
 #include <im_util.h>
+#include <im_image.h>
+#include <im_convert.h>
 #ifdef WIN32
 #include <im_format_avi.h>
 #include <im_format_wmv.h>
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
 #endif
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
 
 
 void PrintError(int error)
@@ -47,26 +87,16 @@ void PrintError(int error)
   }
 }
 
-int main(int argc, char* argv[])
+int SingleCopy(const char* input_file_name, const char* output_file_name, const char* output_format, const char* output_compression)
 {
-  if (argc < 3)
-  {
-    printf("Invalid number of arguments.\n");
-    return 0;
-  }
-
-#ifdef WIN32
-  imFormatRegisterAVI();
-  imFormatRegisterWMV();
-#endif
-
   void* data = NULL;
+  int max_size = 0;
   imFile* ifile = NULL;
   imFile* ofile = NULL;
 
   int error;
-  ifile = imFileOpen(argv[1], &error);
-  if (!ifile) 
+  ifile = imFileOpen(input_file_name, &error);
+  if (!ifile)
     goto man_error;
 
   char format[10];
@@ -74,18 +104,15 @@ int main(int argc, char* argv[])
   int image_count;
   imFileGetInfo(ifile, format, compression, &image_count);
 
-  ofile = imFileNew(argv[2], (argc < 3)? format: argv[3], &error);
+  ofile = imFileNew(output_file_name, output_format? output_format: format, &error);
   if (!ofile)
     goto man_error;
 
-  if (argc < 4)
-    imFileSetInfo(ofile, compression);
-  else
-    imFileSetInfo(ofile, argv[4]);
+  imFileSetInfo(ofile, output_compression? output_compression: compression);
 
   for (int i = 0; i < image_count; i++)
   {
-    int size, max_size = 0;
+    int size;
     int width, height, color_mode, data_type;
     error = imFileReadImageInfo(ifile, i, &width, &height, &color_mode, &data_type);
     if (error != IM_ERR_NONE)
@@ -102,7 +129,7 @@ int main(int argc, char* argv[])
     error = imFileReadImageData(ifile, data, 0, -1);
     if (error != IM_ERR_NONE)
       goto man_error;
-    
+
     char* attrib_list[50];
     int attrib_list_count;
     imFileGetAttributeList(ifile, attrib_list, &attrib_list_count);
@@ -119,7 +146,7 @@ int main(int argc, char* argv[])
       long palette[256];
       int palette_count;
       imFileGetPalette(ifile, palette, &palette_count);
-      imFileSetPalette(ifile, palette, palette_count);
+      imFileSetPalette(ofile, palette, palette_count);
     }
 
     error = imFileWriteImageInfo(ofile, width, height, color_mode, data_type);
@@ -132,11 +159,11 @@ int main(int argc, char* argv[])
 
     printf(".");
   }
-  printf("done");
+  printf("done\n");
 
   free(data);
-  imFileClose(ifile);  
-  imFileClose(ofile);  
+  imFileClose(ifile);
+  imFileClose(ofile);
 
   return 1;
 
@@ -147,3 +174,569 @@ man_error:
   if (ofile) imFileClose(ofile);
   return 0;
 }
+
+
+/**************************************************************************
+                          Batch Transcoder
+ **************************************************************************/
+
+typedef std::chrono::steady_clock Clock;
+
+static double Seconds(Clock::time_point start, Clock::time_point end)
+{
+  return std::chrono::duration<double>(end - start).count();
+}
+
+struct Options
+{
+  const char* output_folder;
+  const char* format;
+  const char* compression;
+  int jpeg_quality, zip_quality;
+  int read_threads, convert_threads, write_threads;
+  int queue_size;
+  int bench;
+};
+
+/* One input file, with all its images, moving through the stages. */
+struct Job
+{
+  std::string input_file_name;
+  std::string output_file_name;
+  char format[10];
+  char compression[20];
+  std::vector<imImage*> images;
+  double file_size;
+
+  ~Job()
+  {
+    for (size_t i = 0; i < images.size(); i++)
+      imImageDestroy(images[i]);
+  }
+};
+
+/* Bounded queue, Push blocks when full, Pop blocks when empty.
+   When the last producer finishes the queue is closed and Pop returns NULL. */
+class JobQueue
+{
+  std::deque<Job*> jobs;
+  std::mutex lock;
+  std::condition_variable not_full, not_empty;
+  size_t max_size;
+  int producers;
+
+public:
+  JobQueue(size_t size, int producer_count): max_size(size), producers(producer_count) {}
+
+  void Push(Job* job)
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    not_full.wait(guard, [this]{ return jobs.size() < max_size; });
+    jobs.push_back(job);
+    not_empty.notify_one();
+  }
+
+  Job* Pop()
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    not_empty.wait(guard, [this]{ return !jobs.empty() || producers == 0; });
+    if (jobs.empty())
+      return NULL;
+    Job* job = jobs.front();
+    jobs.pop_front();
+    not_full.notify_one();
+    return job;
+  }
+
+  void ProducerDone()
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    producers--;
+    if (producers == 0)
+      not_empty.notify_all();
+  }
+};
+
+/* Throughput counters of one stage.
+   "bytes" are file bytes for reading and writing, and image bytes for converting. */
+struct Stage
+{
+  const char* name;
+  std::atomic<long> files, images, errors;
+  std::atomic<long long> bytes;
+  std::mutex lock;
+  double busy;          /* sum of the time spent by all threads of the stage */
+  Clock::time_point end;
+
+  Stage(const char* stage_name): name(stage_name), files(0), images(0), errors(0), bytes(0), busy(0) {}
+
+  void AddBusy(double seconds)
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    busy += seconds;
+    end = Clock::now();
+  }
+};
+
+static std::mutex print_lock;
+
+static void JobError(Stage& stage, const std::string& file_name, int error)
+{
+  stage.errors++;
+  std::lock_guard<std::mutex> guard(print_lock);
+  printf("\n%s: ", file_name.c_str());
+  PrintError(error);
+}
+
+static double FileSize(const char* file_name)
+{
+  FILE* file = fopen(file_name, "rb");
+  if (!file)
+    return 0;
+  fseek(file, 0, SEEK_END);
+  double size = (double)ftell(file);
+  fclose(file);
+  return size;
+}
+
+static std::string OutputFileName(const Options& options, const std::string& input_file_name, const char* format)
+{
+  std::string name = input_file_name;
+  size_t pos = name.find_last_of("/\\");
+  if (pos != std::string::npos)
+    name = name.substr(pos+1);
+  pos = name.find_last_of('.');
+  if (pos != std::string::npos)
+    name = name.substr(0, pos);
+
+  /* first extension of the format, ext is like "*.tif;*.tiff;" */
+  char ext[50] = "";
+  imFormatInfo(format, NULL, ext, NULL);
+  std::string extension = ext[0]? ext + 1: std::string(".") + format;
+  pos = extension.find(';');
+  if (pos != std::string::npos)
+    extension = extension.substr(0, pos);
+
+  return std::string(options.output_folder) + "/" + name + extension;
+}
+
+static void ReadThread(const Options& options, const std::vector<std::string>& file_list, std::atomic<size_t>& next_file,
+                       Stage& stage, JobQueue& output)
+{
+  double busy = 0;
+  for (;;)
+  {
+    size_t f = next_file++;
+    if (f >= file_list.size())
+      break;
+
+    Clock::time_point start = Clock::now();
+
+    Job* job = new Job;
+    job->input_file_name = file_list[f];
+
+    int error;
+    imFile* ifile = imFileOpen(job->input_file_name.c_str(), &error);
+    if (ifile)
+    {
+      int image_count;
+      imFileGetInfo(ifile, job->format, job->compression, &image_count);
+
+      for (int i = 0; i < image_count; i++)
+      {
+        imImage* image = imFileLoadImage(ifile, i, &error);
+        if (!image)
+          break;
+        job->images.push_back(image);
+      }
+
+      imFileClose(ifile);
+    }
+
+    if (error != IM_ERR_NONE)
+    {
+      busy += Seconds(start, Clock::now());
+      JobError(stage, job->input_file_name, error);
+      delete job;
+      continue;
+    }
+
+    job->file_size = FileSize(job->input_file_name.c_str());
+    job->output_file_name = OutputFileName(options, job->input_file_name, options.format? options.format: job->format);
+
+    stage.files++;
+    stage.images += (long)job->images.size();
+    stage.bytes += (long long)job->file_size;
+    busy += Seconds(start, Clock::now());
+
+    output.Push(job);
+  }
+
+  stage.AddBusy(busy);
+  output.ProducerDone();
+}
+
+static int CanWrite(const char* format, const char* compression, int color_space, int has_alpha, int data_type)
+{
+  int color_mode = color_space;
+  if (has_alpha)
+    color_mode |= IM_ALPHA;
+  return imFormatCanWriteImage(format, compression, color_mode, data_type) == IM_ERR_NONE;
+}
+
+static int ConvertImage(const char* format, const char* compression, imImage** image)
+{
+  imImage* src_image = *image;
+
+  if (CanWrite(format, compression, src_image->color_space, src_image->has_alpha, src_image->data_type))
+    return IM_ERR_NONE;
+
+  /* try the bitmap equivalent first, then the other bitmap color spaces */
+  int color_space_list[4] = {imColorModeToBitmap(src_image->color_space), IM_RGB, IM_MAP, IM_GRAY};
+  for (int c = 0; c < 4; c++)
+  {
+    int color_space = color_space_list[c];
+    int has_alpha = src_image->has_alpha;
+
+    if (!CanWrite(format, compression, color_space, has_alpha, IM_BYTE))
+    {
+      has_alpha = 0;
+      if (!CanWrite(format, compression, color_space, has_alpha, IM_BYTE))
+        continue;
+    }
+
+    imImage* dst_image = imImageCreateBased(src_image, -1, -1, color_space, IM_BYTE);
+    if (!dst_image)
+      return IM_ERR_MEM;
+    if (!has_alpha)
+      imImageRemoveAlpha(dst_image);
+
+    int error = imConvertToBitmap(src_image, dst_image, IM_CPX_MAG, 0, 1, IM_CAST_MINMAX);
+
+    if (error != IM_ERR_NONE)
+    {
+      imImageDestroy(dst_image);
+      return error;
+    }
+
+    imImageDestroy(src_image);
+    *image = dst_image;
+    return IM_ERR_NONE;
+  }
+
+  return IM_ERR_DATA;
+}
+
+static const char* OutputCompression(const Options& options, Job* job)
+{
+  if (options.compression)
+    return options.compression;
+  if (!options.format || imStrEqual(options.format, job->format))
+    return job->compression;
+  return NULL;   /* format default */
+}
+
+static void ConvertThread(const Options& options, Stage& stage, JobQueue& input, JobQueue& output)
+{
+  double busy = 0;
+  Job* job;
+  while ((job = input.Pop()) != NULL)
+  {
+    Clock::time_point start = Clock::now();
+
+    const char* format = options.format? options.format: job->format;
+    const char* compression = OutputCompression(options, job);
+    int error = IM_ERR_NONE;
+    long long bytes = 0;
+
+    for (size_t i = 0; i < job->images.size() && error == IM_ERR_NONE; i++)
+    {
+      bytes += job->images[i]->size;
+      error = ConvertImage(format, compression, &job->images[i]);
+    }
+
+    busy += Seconds(start, Clock::now());
+
+    if (error != IM_ERR_NONE)
+    {
+      JobError(stage, job->input_file_name, error);
+      delete job;
+      continue;
+    }
+
+    stage.files++;
+    stage.images += (long)job->images.size();
+    stage.bytes += bytes;
+
+    output.Push(job);
+  }
+
+  stage.AddBusy(busy);
+  output.ProducerDone();
+}
+
+static void WriteThread(const Options& options, Stage& stage, JobQueue& input)
+{
+  double busy = 0;
+  Job* job;
+  while ((job = input.Pop()) != NULL)
+  {
+    Clock::time_point start = Clock::now();
+
+    int error;
+    imFile* ofile = imFileNew(job->output_file_name.c_str(), options.format? options.format: job->format, &error);
+    if (ofile)
+    {
+      const char* compression = OutputCompression(options, job);
+      for (size_t i = 0; i < job->images.size() && error == IM_ERR_NONE; i++)
+      {
+        if (compression)
+          imFileSetInfo(ofile, compression);
+        if (options.jpeg_quality >= 0)
+          imImageSetAttribInteger(job->images[i], "JPEGQuality", IM_INT, options.jpeg_quality);
+        if (options.zip_quality >= 0)
+          imImageSetAttribInteger(job->images[i], "ZIPQuality", IM_INT, options.zip_quality);
+
+        error = imFileSaveImage(ofile, job->images[i]);
+      }
+
+      imFileClose(ofile);
+    }
+
+    busy += Seconds(start, Clock::now());
+
+    if (error != IM_ERR_NONE)
+      JobError(stage, job->output_file_name, error);
+    else
+    {
+      stage.files++;
+      stage.images += (long)job->images.size();
+      stage.bytes += (long long)FileSize(job->output_file_name.c_str());
+
+      if (!options.bench)
+      {
+        std::lock_guard<std::mutex> guard(print_lock);
+        printf(".");
+        fflush(stdout);
+      }
+    }
+
+    delete job;
+  }
+
+  stage.AddBusy(busy);
+}
+
+static void PrintStage(Stage& stage, int thread_count, Clock::time_point start)
+{
+  double wall = Seconds(start, stage.end);
+  if (wall <= 0) wall = 1e-9;
+  double busy = stage.busy > 0? stage.busy: 1e-9;
+  double mbytes = (double)stage.bytes / (1024.0*1024.0);
+
+  printf("  %-8s threads: %2d  files: %5ld  images: %5ld  errors: %3ld  MB: %9.2f  "
+         "images/s: %8.2f  MB/s: %8.2f  (per thread busy: images/s: %8.2f  MB/s: %8.2f)\n",
+         stage.name, thread_count, (long)stage.files, (long)stage.images, (long)stage.errors, mbytes,
+         stage.images / wall, mbytes / wall,
+         stage.images / busy, mbytes / busy);
+}
+
+static void AddFolder(const char* folder, std::vector<std::string>& file_list)
+{
+#ifdef WIN32
+  WIN32_FIND_DATAA find_data;
+  std::string pattern = std::string(folder) + "\\*";
+  HANDLE handle = FindFirstFileA(pattern.c_str(), &find_data);
+  if (handle == INVALID_HANDLE_VALUE)
+    return;
+  do
+  {
+    if (!(find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+      file_list.push_back(std::string(folder) + "\\" + find_data.cFileName);
+  } while (FindNextFileA(handle, &find_data));
+  FindClose(handle);
+#else
+  DIR* dir = opendir(folder);
+  if (!dir)
+    return;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL)
+  {
+    std::string file_name = std::string(folder) + "/" + entry->d_name;
+    struct stat info;
+    if (stat(file_name.c_str(), &info) == 0 && S_ISREG(info.st_mode))
+      file_list.push_back(file_name);
+  }
+  closedir(dir);
+#endif
+}
+
+static int IsFolder(const char* name)
+{
+#ifdef WIN32
+  DWORD attrib = GetFileAttributesA(name);
+  return attrib != INVALID_FILE_ATTRIBUTES && (attrib & FILE_ATTRIBUTE_DIRECTORY);
+#else
+  struct stat info;
+  return stat(name, &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+static void AddListFile(const char* list_file_name, std::vector<std::string>& file_list)
+{
+  FILE* file = fopen(list_file_name, "r");
+  if (!file)
+  {
+    printf("%s: ", list_file_name);
+    PrintError(IM_ERR_OPEN);
+    return;
+  }
+
+  char line[4096];
+  while (fgets(line, sizeof(line), file))
+  {
+    size_t len = strlen(line);
+    while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r' || line[len-1] == ' '))
+      line[--len] = 0;
+    if (len > 0)
+      file_list.push_back(line);
+  }
+
+  fclose(file);
+}
+
+static int DefaultThreadCount()
+{
+  int count = (int)std::thread::hardware_concurrency();
+  return count > 0? count: 2;
+}
+
+int BatchCopy(int argc, char* argv[])
+{
+  Options options;
+  options.output_folder = NULL;
+  options.format = NULL;
+  options.compression = NULL;
+  options.jpeg_quality = -1;
+  options.zip_quality = -1;
+  options.read_threads = 0;
+  options.convert_threads = 0;
+  options.write_threads = 0;
+  options.queue_size = 4;
+  options.bench = 0;
+
+  std::vector<std::string> file_list;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char* arg = argv[i];
+    int has_value = i+1 < argc;
+
+    if (strcmp(arg, "--bench") == 0)
+      options.bench = 1;
+    else if (arg[0] == '-' && arg[1] != 0 && arg[2] == 0 && has_value)
+    {
+      const char* value = argv[++i];
+      switch (arg[1])
+      {
+      case 'o': options.output_folder = value; break;
+      case 'f': options.format = value; break;
+      case 'c': options.compression = value; break;
+      case 'q': options.jpeg_quality = atoi(value); break;
+      case 'z': options.zip_quality = atoi(value); break;
+      case 'r': options.read_threads = atoi(value); break;
+      case 't': options.convert_threads = atoi(value); break;
+      case 'w': options.write_threads = atoi(value); break;
+      case 'Q': options.queue_size = atoi(value); break;
+      default:
+        printf("Invalid option \"%s\".\n", arg);
+        return 0;
+      }
+    }
+    else if (arg[0] == '@')
+      AddListFile(arg+1, file_list);
+    else if (IsFolder(arg))
+      AddFolder(arg, file_list);
+    else
+      file_list.push_back(arg);
+  }
+
+  if (!options.output_folder || file_list.empty())
+  {
+    printf("Invalid number of arguments.\n");
+    return 0;
+  }
+
+  if (options.format && imFormatInfo(options.format, NULL, NULL, NULL) != IM_ERR_NONE)
+  {
+    PrintError(IM_ERR_FORMAT);
+    return 0;
+  }
+
+  /* when the stages have similar costs the threads are divided between them */
+  int thread_count = DefaultThreadCount();
+  if (options.read_threads <= 0) options.read_threads = (thread_count+2)/3;
+  if (options.convert_threads <= 0) options.convert_threads = (thread_count+2)/3;
+  if (options.write_threads <= 0) options.write_threads = (thread_count+2)/3;
+  if (options.queue_size <= 0) options.queue_size = 1;
+
+  Stage read_stage("read"), convert_stage("convert"), write_stage("write");
+  JobQueue read_queue(options.queue_size, options.read_threads);
+  JobQueue write_queue(options.queue_size, options.convert_threads);
+  std::atomic<size_t> next_file(0);
+  std::vector<std::thread> threads;
+
+  Clock::time_point start = Clock::now();
+
+  for (int i = 0; i < options.read_threads; i++)
+    threads.push_back(std::thread(ReadThread, std::cref(options), std::cref(file_list), std::ref(next_file),
+                                  std::ref(read_stage), std::ref(read_queue)));
+  for (int i = 0; i < options.convert_threads; i++)
+    threads.push_back(std::thread(ConvertThread, std::cref(options), std::ref(convert_stage),
+                                  std::ref(read_queue), std::ref(write_queue)));
+  for (int i = 0; i < options.write_threads; i++)
+    threads.push_back(std::thread(WriteThread, std::cref(options), std::ref(write_stage), std::ref(write_queue)));
+
+  for (size_t i = 0; i < threads.size(); i++)
+    threads[i].join();
+
+  double total = Seconds(start, Clock::now());
+  long errors = read_stage.errors + convert_stage.errors + write_stage.errors;
+
+  if (options.bench)
+  {
+    printf("Files: %d  Time: %.3fs  images/s: %.2f\n", (int)file_list.size(), total, write_stage.images / total);
+    PrintStage(read_stage, options.read_threads, start);
+    PrintStage(convert_stage, options.convert_threads, start);
+    PrintStage(write_stage, options.write_threads, start);
+  }
+  else
+    printf("done\n");
+
+  return errors == 0;
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 3)
+  {
+    printf("Invalid number of arguments.\n");
+    return 0;
+  }
+
+#ifdef WIN32
+  imFormatRegisterAVI();
+  imFormatRegisterWMV();
+#endif
+
+  /* forces the registration of the internal formats before starting threads */
+  imFormatInfo("TIFF", NULL, NULL, NULL);
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (argv[i][0] == '-' || argv[i][0] == '@')
+      return BatchCopy(argc, argv);
+  }
+
+  return SingleCopy(argv[1], argv[2], argc > 3? argv[3]: NULL, argc > 4? argv[4]: NULL);
+}
@@ -1,6 +1,6 @@
 APPNAME = im_copy
 APPTYPE = console
-#LINKER = g++
+LINKER = g++
 
 SRC = im_copy.cpp
 
@@ -12,4 +12,6 @@ USE_STATIC = Yes
 
 ifneq ($(findstring Win, $(TEC_SYSNAME)), )
   LIBS = im_wmv im_avi vfw32 wmvcore
+else
+  LIBS = pthread
 endif
@@ -0,0 +1,358 @@
+/* IM 3 sample that checks the processor specific variants of the kernels,
+   each variant must produce exactly the same result of the generic variant.
+
+  Needs "im.lib" and "im_process.lib".
+
+  Usage: im_cputest
+
+    For each registered kernel, the features are limited to the ones required by each variant
+    and the result is compared with the result using no features (generic).
+    Variants not supported by the processor, or disabled by the environment variable "IM_CPU", are skipped.
+    The JPEG kernels exist only when IM is compiled with USE_JPEG_SIMD,
+    and their generic variants are the same routines used with JSIMD_FORCENONE=1.
+    Returns 0 if all the variants are equal to the generic one.
+*/
+
+#include <im.h>
+#include <im_image.h>
+#include <im_util.h>
+#include <im_process.h>
+#include <im_cpu.h>
+#include <im_binfile.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* Odd sizes, so the scalar tails of the variants are also used.
+   The last ones have more than one block of 64Kb. */
+static const int sizes[][2] =
+{
+  {1, 1}, {7, 1}, {15, 3}, {17, 5}, {31, 7}, {33, 9}, {63, 11}, {65, 13}, {1001, 131}, {2049, 67}
+};
+#define SIZE_COUNT (int)(sizeof(sizes)/sizeof(sizes[0]))
+
+/* Random values, with many values at the limits to check the saturation */
+static void FillByte(imImage* image, unsigned int seed)
+{
+  imbyte* data = (imbyte*)image->data[0];
+  for (int i = 0; i < image->plane_size; i++)
+  {
+    seed = seed*1103515245 + 12345;
+    int value = (seed >> 16) & 0x1FF;
+    if (value > 255 + 64)
+      data[i] = 0;
+    else if (value > 255)
+      data[i] = 255;
+    else
+      data[i] = (imbyte)value;
+  }
+}
+
+/* Runs all the operations of the kernel with the current features,
+   the results are stored one after the other. */
+typedef void (*TestFunc)(imbyte* result, int* result_size);
+
+static void TestArithmeticOpByte(imbyte* result, int* result_size)
+{
+  static const int ops[] = {IM_BIN_ADD, IM_BIN_SUB, IM_BIN_DIFF, IM_BIN_MIN, IM_BIN_MAX};
+  int size = 0;
+
+  for (int s = 0; s < SIZE_COUNT; s++)
+  {
+    int width = sizes[s][0], height = sizes[s][1];
+    imImage* src1 = imImageCreate(width, height, IM_GRAY, IM_BYTE);
+    imImage* src2 = imImageCreate(width, height, IM_GRAY, IM_BYTE);
+    imImage* dst = imImageCreate(width, height, IM_GRAY, IM_BYTE);
+    FillByte(src1, 1 + s);
+    FillByte(src2, 1001 + s);
+
+    for (int o = 0; o < (int)(sizeof(ops)/sizeof(ops[0])); o++)
+    {
+      imImageClear(dst);
+      imProcessArithmeticOp(src1, src2, dst, ops[o]);
+
+      if (result)
+        memcpy(result + size, dst->data[0], dst->plane_size);
+      size += dst->plane_size;
+    }
+
+    imImageDestroy(src1);
+    imImageDestroy(src2);
+    imImageDestroy(dst);
+  }
+
+  *result_size = size;
+}
+
+/* Replaces all the values of the quantization tables of a JPEG stream,
+   large values make the dequantized coefficients overflow 16 bits. */
+static void PatchJPEGQuant(unsigned char* buffer, int size, int value)
+{
+  for (int i = 0; i < size - 4; i++)
+  {
+    if (buffer[i] == 0xFF && buffer[i + 1] == 0xDB)
+    {
+      int end = i + 2 + ((buffer[i + 2] << 8) | buffer[i + 3]);
+      int p = i + 4;
+      while (p < end && end <= size)
+      {
+        int precision = buffer[p] >> 4;
+        p++;
+        for (int k = 0; k < 64; k++)
+        {
+          if (precision)
+          {
+            buffer[p++] = (unsigned char)(value >> 8);
+            buffer[p++] = (unsigned char)(value & 0xFF);
+          }
+          else
+            buffer[p++] = (unsigned char)value;
+        }
+      }
+      i = end - 1;
+    }
+  }
+}
+
+/* Decodes the stream reduced by 1/scale, packed or unpacked. */
+static void DecodeJPEG(unsigned char* buffer, int buffer_size, int scale, int packed, imbyte* result, int* size)
+{
+  imBinMemoryFileName filename;
+  filename.buffer = buffer;
+  filename.size = buffer_size;
+  filename.reallocate = 0;
+
+  int error;
+  int old_mode = imBinFileSetCurrentModule(IM_MEMFILE);
+  imFile* ifile = imFileOpen((const char*)&filename, &error);
+  imBinFileSetCurrentModule(old_mode);
+  if (!ifile)
+    return;
+
+  imFileSetAttribute(ifile, "JPEGScale", IM_INT, 1, &scale);
+
+  int width, height, color_mode, data_type;
+  error = imFileReadImageInfo(ifile, 0, &width, &height, &color_mode, &data_type);
+  if (error == IM_ERR_NONE)
+  {
+    int data_size = imImageDataSize(width, height, color_mode, data_type);
+    imbyte* data = (imbyte*)calloc(data_size, 1);
+    imFileReadImageData(ifile, data, 0, packed? IM_PACKED: 0);
+
+    if (result)
+      memcpy(result + *size, data, data_size);
+    *size += data_size;
+    free(data);
+  }
+
+  imFileClose(ifile);
+}
+
+/* Encodes and decodes gray and RGB images with all the reduced scales,
+   the result is the same for all the JPEG kernels. */
+static void TestJPEG(imbyte* result, int* result_size)
+{
+  static const int images[][3] =
+  {
+    {17, 13, IM_GRAY}, {67, 45, IM_RGB}, {333, 129, IM_RGB}
+  };
+  static const int qualities[] = {75, 100};
+  int size = 0;
+
+  for (int i = 0; i < (int)(sizeof(images)/sizeof(images[0])); i++)
+  {
+    imImage* image = imImageCreate(images[i][0], images[i][1], images[i][2], IM_BYTE);
+    for (int d = 0; d < image->depth; d++)
+    {
+      imImage plane = *image;
+      plane.data = image->data + d;
+      FillByte(&plane, 2001 + 10*i + d);
+    }
+
+    for (int q = 0; q < (int)(sizeof(qualities)/sizeof(qualities[0])); q++)
+    {
+      imBinMemoryFileName filename;
+      filename.buffer = NULL;
+      filename.size = 1024;
+      filename.reallocate = 2.0f;
+
+      int error;
+      int old_mode = imBinFileSetCurrentModule(IM_MEMFILE);
+      imFile* ifile = imFileNew((const char*)&filename, "JPEG", &error);
+      imBinFileSetCurrentModule(old_mode);
+      if (!ifile)
+        continue;
+
+      int quality = qualities[q];
+      imFileSetAttribute(ifile, "JPEGQuality", IM_INT, 1, &quality);
+      imFileSaveImage(ifile, image);
+      int buffer_size = imBinFileSize((imBinFile*)imFileHandle(ifile, 0));
+      imFileClose(ifile);
+
+      if (result)
+        memcpy(result + size, &buffer_size, sizeof(int));
+      size += sizeof(int);
+
+      for (int scale = 1; scale <= 8; scale *= 2)
+      {
+        DecodeJPEG(filename.buffer, buffer_size, scale, 0, result, &size);
+        DecodeJPEG(filename.buffer, buffer_size, scale, 1, result, &size);
+      }
+
+      if (quality == 100)
+      {
+        /* the coefficients of quality 100 are not reduced,
+           so quantization values of 24 and 255 overflow some or all the blocks */
+        PatchJPEGQuant(filename.buffer, buffer_size, 24);
+        DecodeJPEG(filename.buffer, buffer_size, 1, 0, result, &size);
+        DecodeJPEG(filename.buffer, buffer_size, 2, 1, result, &size);
+        PatchJPEGQuant(filename.buffer, buffer_size, 255);
+        DecodeJPEG(filename.buffer, buffer_size, 1, 0, result, &size);
+        DecodeJPEG(filename.buffer, buffer_size, 2, 1, result, &size);
+      }
+
+      imBinMemoryRelease(filename.buffer);
+    }
+
+    imImageDestroy(image);
+  }
+
+  *result_size = size;
+}
+
+struct KernelTest
+{
+  const char* name;
+  TestFunc func;
+  int required;  /* 0 if the kernel depends on the build options or on the data */
+};
+
+static const KernelTest tests[] =
+{
+  {"ArithmeticOpByte", TestArithmeticOpByte, 1},
+  {"JPEGIdctIslow", TestJPEG, 0},
+  {"JPEGIdct16x16", TestJPEG, 0},
+  {"JPEGIdct16x8", TestJPEG, 0},
+  {"JPEGFdctIslow", TestJPEG, 0},
+  {"JPEGYccRgb", TestJPEG, 0},
+  {"JPEGYccRgbPlanar", TestJPEG, 0},
+  {"JPEGRgbYcc", TestJPEG, 0},
+  {"JPEGH2V1Upsample", TestJPEG, 0},
+  {"JPEGH2V2Upsample", TestJPEG, 0}
+};
+#define TEST_COUNT (int)(sizeof(tests)/sizeof(tests[0]))
+
+static const KernelTest* FindTest(const char* name)
+{
+  for (int t = 0; t < TEST_COUNT; t++)
+  {
+    if (strcmp(tests[t].name, name) == 0)
+      return &tests[t];
+  }
+  return NULL;
+}
+
+static int CheckKernel(const imCPUKernel* kernel, int features)
+{
+  const KernelTest* test = FindTest(kernel->name);
+  if (!test)
+  {
+    printf("%s: no test.\n", kernel->name);
+    return 1;
+  }
+
+  int size;
+  test->func(NULL, &size);
+
+  imbyte* generic_result = (imbyte*)malloc(size);
+  imbyte* result = (imbyte*)malloc(size);
+
+  imCPUSetFeatures(0);
+  test->func(generic_result, &size);
+
+  int failed = 0;
+
+  /* the last variant is the generic one */
+  for (int v = 0; v < kernel->count - 1; v++)
+  {
+    int required = kernel->variant[v].features;
+    const char* name = imCPUFeatureName(required);
+
+    if ((features & required) != required)
+    {
+      printf("%s: %s skipped, not supported.\n", kernel->name, name);
+      continue;
+    }
+
+    imCPUSetFeatures(required);
+    test->func(result, &size);
+
+    int i;
+    for (i = 0; i < size; i++)
+    {
+      if (result[i] != generic_result[i])
+        break;
+    }
+
+    if (i < size)
+    {
+      printf("%s: %s FAILED, differs from generic at byte %d (%d != %d).\n", kernel->name, name, i, (int)result[i], (int)generic_result[i]);
+      failed = 1;
+    }
+    else
+      printf("%s: %s ok.\n", kernel->name, name);
+  }
+
+  imCPUSetFeatures(-1);
+
+  free(generic_result);
+  free(result);
+  return failed;
+}
+
+int main(void)
+{
+  int features = imCPUFeatures();
+  printf("Processor features: %s\n", imCPUFeatureName(features));
+
+  /* kernels are registered when used for the first time */
+  for (int t = 0; t < TEST_COUNT; t++)
+  {
+    if (t == 0 || tests[t].func != tests[t - 1].func)
+    {
+      int size;
+      tests[t].func(NULL, &size);
+    }
+  }
+
+  int failed = 0;
+  const imCPUKernel* kernel = imCPUKernelNext(NULL);
+  while (kernel)
+  {
+    failed |= CheckKernel(kernel, features);
+    kernel = imCPUKernelNext(kernel);
+  }
+
+  for (int t = 0; t < TEST_COUNT; t++)
+  {
+    kernel = imCPUKernelNext(NULL);
+    while (kernel && strcmp(kernel->name, tests[t].name) != 0)
+      kernel = imCPUKernelNext(kernel);
+
+    if (!kernel)
+    {
+      if (tests[t].required)
+      {
+        printf("%s: FAILED, not registered.\n", tests[t].name);
+        failed = 1;
+      }
+      else
+        printf("%s: not used.\n", tests[t].name);
+    }
+  }
+
+  printf(failed? "FAILED\n": "All variants are equal to generic.\n");
+  return failed;
+}
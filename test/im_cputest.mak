@@ -0,0 +1,17 @@
+APPNAME = im_cputest
+APPTYPE = console
+LINKER = g++
+
+SRC = im_cputest.cpp
+
+USE_IM = Yes
+
+IM = ..
+
+USE_STATIC = Yes
+
+SLIB = $(IM_LIB)/libim_process.a
+
+ifeq ($(findstring Win, $(TEC_SYSNAME)), )
+  LIBS = pthread
+endif
@@ -0,0 +1,210 @@
+/* IM 3 sample that checks the C++ point expressions of "im_process_expr.h",
+   each expression must produce exactly the same result of a chain of arithmetic operations.
+
+  Needs "im.lib" and "im_process.lib".
+
+  Usage: im_exprtest
+
+    The expression "crop_byte(a*0.5f + b - c)" is evaluated on byte and float images
+    and compared with imProcessArithmeticConstOp and imProcessArithmeticOp using float images.
+    Also checks that images with different data type, size or depth are not evaluated.
+    Returns 0 if all the checks succeed.
+*/
+
+#include <im.h>
+#include <im_image.h>
+#include <im_util.h>
+#include <im_convert.h>
+#include <im_process.h>
+#include <im_process_expr.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* Odd sizes, so the bands of lines are not all equal. */
+static const int sizes[][2] =
+{
+  {1, 1}, {7, 3}, {333, 211}, {1001, 67}
+};
+#define SIZE_COUNT (int)(sizeof(sizes)/sizeof(sizes[0]))
+
+/* Random values, with many values at the limits to check the cropping */
+static void FillImage(imImage* image, unsigned int seed)
+{
+  for (int i = 0; i < image->count*image->depth; i++)
+  {
+    seed = seed*1103515245 + 12345;
+    int value = (seed >> 16) & 0x1FF;
+    if (value > 255 + 64)
+      value = 0;
+    else if (value > 255)
+      value = 255;
+
+    if (image->data_type == IM_BYTE)
+      ((imbyte*)image->data[0])[i] = (imbyte)value;
+    else
+      ((float*)image->data[0])[i] = (float)value + (float)((seed >> 8) & 0xFF) / 256.0f;
+  }
+}
+
+static int EqualImage(const imImage* image1, const imImage* image2)
+{
+  return memcmp(image1->data[0], image2->data[0], image1->size) == 0;
+}
+
+static void ConvertToFloat(const imImage* src, imImage* dst)
+{
+  if (src->data_type == IM_FLOAT)
+    imImageCopyData(src, dst);
+  else
+    imProcessConvertDataType(src, dst, 0, 0, 0, IM_CAST_DIRECT);
+}
+
+/* crop_byte(a*0.5f + b - c) computed with the arithmetic operations, in float */
+static void ReferenceChain(const imImage* a, const imImage* b, const imImage* c, imImage* dst)
+{
+  imImage* af = imImageCreateBased(a, -1, -1, -1, IM_FLOAT);
+  imImage* bf = imImageCreateBased(a, -1, -1, -1, IM_FLOAT);
+  imImage* cf = imImageCreateBased(a, -1, -1, -1, IM_FLOAT);
+  imImage* result = imImageCreateBased(a, -1, -1, -1, IM_FLOAT);
+
+  ConvertToFloat(a, af);
+  ConvertToFloat(b, bf);
+  ConvertToFloat(c, cf);
+
+  imProcessArithmeticConstOp(af, 0.5f, result, IM_BIN_MUL);
+  imProcessArithmeticOp(result, bf, result, IM_BIN_ADD);
+  imProcessArithmeticOp(result, cf, result, IM_BIN_SUB);
+
+  /* crops to 0-255, the conversion to byte truncates */
+  float* data = (float*)result->data[0];
+  for (int i = 0; i < result->count*result->depth; i++)
+    data[i] = crop_byte(data[i]);
+
+  if (dst->data_type == IM_FLOAT)
+    imImageCopyData(result, dst);
+  else
+    imProcessConvertDataType(result, dst, 0, 0, 0, IM_CAST_DIRECT);
+
+  imImageDestroy(af);
+  imImageDestroy(bf);
+  imImageDestroy(cf);
+  imImageDestroy(result);
+}
+
+template <class T>
+static int CheckExpression(int width, int height, int color_space, int data_type, T*)
+{
+  imImage* a = imImageCreate(width, height, color_space, data_type);
+  imImage* b = imImageClone(a);
+  imImage* c = imImageClone(a);
+  imImage* dst = imImageClone(a);
+  imImage* ref = imImageClone(a);
+  FillImage(a, 1 + width);
+  FillImage(b, 1001 + height);
+  FillImage(c, 2001 + color_space);
+
+  ReferenceChain(a, b, c, ref);
+
+  imExprImage<T> ea(a), eb(b), ec(c), edst(dst);
+  edst = crop_byte(ea*0.5f + eb - ec);
+
+  int failed = 0;
+  if (!EqualImage(dst, ref))
+  {
+    printf("%dx%d %s %s: FAILED, differs from the arithmetic operations.\n", width, height,
+           imColorModeSpaceName(color_space), imDataTypeName(data_type));
+    failed = 1;
+  }
+
+  /* the destination can also be in the expression */
+  imImageCopyData(a, dst);
+  edst = crop_byte(edst*0.5f + eb - ec);
+  if (!EqualImage(dst, ref))
+  {
+    printf("%dx%d %s %s in place: FAILED, differs from the arithmetic operations.\n", width, height,
+           imColorModeSpaceName(color_space), imDataTypeName(data_type));
+    failed = 1;
+  }
+
+  imImageDestroy(a);
+  imImageDestroy(b);
+  imImageDestroy(c);
+  imImageDestroy(dst);
+  imImageDestroy(ref);
+  return failed;
+}
+
+/* Images that do not match are not evaluated, the destination is not changed */
+static int CheckMismatch(void)
+{
+  imImage* a = imImageCreate(31, 17, IM_RGB, IM_BYTE);
+  imImage* dst = imImageClone(a);
+  imImage* width = imImageCreate(32, 17, IM_RGB, IM_BYTE);
+  imImage* height = imImageCreate(31, 16, IM_RGB, IM_BYTE);
+  imImage* depth = imImageCreate(31, 17, IM_GRAY, IM_BYTE);
+  imImage* type = imImageCreate(31, 17, IM_RGB, IM_FLOAT);
+  FillImage(a, 3);
+  FillImage(dst, 5);
+
+  imImage* original = imImageDuplicate(dst);
+
+  imExprImage<imbyte> ea(a), edst(dst), ewidth(width), eheight(height), edepth(depth);
+  imExprImage<imbyte> etype(type);   /* wrong template type */
+
+  int failed = 0;
+  if (!edst.Check(ea + 1) || !edst.Check(crop_byte(ea*2)) || !edst.Check(edst - ea))
+  {
+    printf("Check: FAILED, equal images rejected.\n");
+    failed = 1;
+  }
+
+  if (edst.Check(ea + ewidth) || edst.Check(eheight - ea) || edst.Check(max_op(ea, edepth)) ||
+      edst.Check(ea*etype) || etype.Check(ea + 1))
+  {
+    printf("Check: FAILED, different images accepted.\n");
+    failed = 1;
+  }
+
+  edst = ea + ewidth;
+  edst = eheight - ea;
+  edst = max_op(ea, edepth);
+  edst = ea*etype;
+  if (!EqualImage(dst, original))
+  {
+    printf("Mismatch: FAILED, different images evaluated.\n");
+    failed = 1;
+  }
+
+  imImageDestroy(a);
+  imImageDestroy(dst);
+  imImageDestroy(width);
+  imImageDestroy(height);
+  imImageDestroy(depth);
+  imImageDestroy(type);
+  imImageDestroy(original);
+  return failed;
+}
+
+int main(void)
+{
+  static const int color_spaces[] = {IM_GRAY, IM_RGB};
+  int failed = 0, count = 0;
+
+  for (int s = 0; s < SIZE_COUNT; s++)
+  {
+    for (int c = 0; c < (int)(sizeof(color_spaces)/sizeof(color_spaces[0])); c++)
+    {
+      failed |= CheckExpression(sizes[s][0], sizes[s][1], color_spaces[c], IM_BYTE, (imbyte*)0);
+      failed |= CheckExpression(sizes[s][0], sizes[s][1], color_spaces[c], IM_FLOAT, (float*)0);
+      count += 2;
+    }
+  }
+
+  failed |= CheckMismatch();
+
+  printf(failed? "FAILED\n": "All %d expressions are equal to the arithmetic operations.\n", count);
+  return failed;
+}
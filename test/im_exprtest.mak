@@ -0,0 +1,17 @@
+APPNAME = im_exprtest
+APPTYPE = console
+LINKER = g++
+
+SRC = im_exprtest.cpp
+
+USE_IM = Yes
+
+IM = ..
+
+USE_STATIC = Yes
+
+SLIB = $(IM_LIB)/libim_process.a
+
+ifeq ($(findstring Win, $(TEC_SYSNAME)), )
+  LIBS = pthread
+endif
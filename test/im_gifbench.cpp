@@ -0,0 +1,259 @@
+/* IM 3 sample that measures the GIF LZW encoder and decoder speed.
+
+  Needs "im.lib".
+
+  Usage: im_gifbench [<gif_file_name> [<iterations>]]
+
+    When a file is given its frames are decoded and encoded again,
+    otherwise a synthetic animation is used. The encoded result
+    is written to "im_gifbench.gif" in the current folder.
+
+    Example: im_gifbench sticker.gif 20
+*/
+
+#include <im.h>
+#include <im_util.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define OUT_FILE_NAME "im_gifbench.gif"
+
+struct Frame
+{
+  int width, height;
+  imbyte* data;
+  long palette[256];
+  int palette_count;
+};
+
+static void PrintError(int error)
+{
+  switch (error)
+  {
+  case IM_ERR_OPEN:
+    printf("Error Opening File.\n");
+    break;
+  case IM_ERR_MEM:
+    printf("Insufficient memory.\n");
+    break;
+  case IM_ERR_ACCESS:
+    printf("Error Accessing File.\n");
+    break;
+  case IM_ERR_DATA:
+    printf("Image type not Supported.\n");
+    break;
+  case IM_ERR_FORMAT:
+    printf("Invalid Format.\n");
+    break;
+  case IM_ERR_COMPRESS:
+    printf("Invalid or unsupported compression.\n");
+    break;
+  default:
+    printf("Unknown Error.\n");
+  }
+}
+
+/* A moving shaded disc over a gradient with some noise,
+   something between a cartoon sticker and a dithered photo. */
+static Frame* CreateFrames(int* frame_count)
+{
+  int count = 48, width = 320, height = 320;
+  Frame* frames = (Frame*)malloc(count*sizeof(Frame));
+  unsigned int seed = 1;
+
+  for (int f = 0; f < count; f++)
+  {
+    Frame* frame = frames + f;
+    frame->width = width;
+    frame->height = height;
+    frame->data = (imbyte*)malloc(width*height);
+    frame->palette_count = 256;
+    for (int i = 0; i < 256; i++)
+      frame->palette[i] = imColorEncode((imbyte)i, (imbyte)(255-i), (imbyte)(i/2));
+
+    int cx = width/4 + (f*width/2)/count;
+    int cy = height/2;
+    int r2 = (width/5)*(width/5);
+
+    for (int y = 0; y < height; y++)
+    {
+      imbyte* line = frame->data + y*width;
+      for (int x = 0; x < width; x++)
+      {
+        int dx = x - cx, dy = y - cy;
+        int d2 = dx*dx + dy*dy;
+        int value;
+
+        if (d2 < r2)
+          value = 128 + (96*d2)/r2;
+        else
+          value = (x + y)/8;
+
+        seed = seed*1103515245 + 12345;
+        if (((seed >> 16) & 7) == 0)  /* some noise */
+          value += (seed >> 20) & 3;
+
+        line[x] = (imbyte)value;
+      }
+    }
+  }
+
+  *frame_count = count;
+  return frames;
+}
+
+static Frame* LoadFrames(const char* file_name, int* frame_count)
+{
+  int error;
+  imFile* ifile = imFileOpen(file_name, &error);
+  if (!ifile)
+  {
+    PrintError(error);
+    return NULL;
+  }
+
+  int count;
+  imFileGetInfo(ifile, NULL, NULL, &count);
+  Frame* frames = (Frame*)malloc(count*sizeof(Frame));
+
+  for (int f = 0; f < count; f++)
+  {
+    Frame* frame = frames + f;
+    int color_mode, data_type;
+
+    error = imFileReadImageInfo(ifile, f, &frame->width, &frame->height, &color_mode, &data_type);
+    if (error == IM_ERR_NONE)
+    {
+      frame->data = (imbyte*)malloc(frame->width*frame->height);
+      error = imFileReadImageData(ifile, frame->data, 0, IM_MAP);
+    }
+
+    if (error != IM_ERR_NONE)
+    {
+      PrintError(error);
+      imFileClose(ifile);
+      return NULL;
+    }
+
+    imFileGetPalette(ifile, frame->palette, &frame->palette_count);
+  }
+
+  imFileClose(ifile);
+  *frame_count = count;
+  return frames;
+}
+
+static int Encode(Frame* frames, int count)
+{
+  int error;
+  imFile* ifile = imFileNew(OUT_FILE_NAME, "GIF", &error);
+  if (!ifile)
+    return error;
+
+  for (int f = 0; f < count && error == IM_ERR_NONE; f++)
+  {
+    Frame* frame = frames + f;
+    imFileSetInfo(ifile, "LZW");
+    imFileSetPalette(ifile, frame->palette, frame->palette_count);
+    error = imFileWriteImageInfo(ifile, frame->width, frame->height, IM_MAP, IM_BYTE);
+    if (error == IM_ERR_NONE)
+      error = imFileWriteImageData(ifile, frame->data);
+  }
+
+  imFileClose(ifile);
+  return error;
+}
+
+static int Decode(Frame* frames, unsigned int* checksum)
+{
+  int error, count;
+  imFile* ifile = imFileOpen(OUT_FILE_NAME, &error);
+  if (!ifile)
+    return error;
+
+  imFileGetInfo(ifile, NULL, NULL, &count);
+  *checksum = 0;
+
+  for (int f = 0; f < count && error == IM_ERR_NONE; f++)
+  {
+    int width, height, color_mode, data_type;
+    error = imFileReadImageInfo(ifile, f, &width, &height, &color_mode, &data_type);
+    if (error == IM_ERR_NONE)
+      error = imFileReadImageData(ifile, frames[f].data, 0, IM_MAP);
+
+    for (int i = 0; i < width*height; i++)
+      *checksum = *checksum*31 + frames[f].data[i];
+  }
+
+  imFileClose(ifile);
+  return error;
+}
+
+int main(int argc, char* argv[])
+{
+  int count, iterations = 10;
+  Frame* frames;
+
+  if (argc > 1)
+    frames = LoadFrames(argv[1], &count);
+  else
+    frames = CreateFrames(&count);
+
+  if (!frames)
+    return 1;
+
+  if (argc > 2)
+    iterations = atoi(argv[2]);
+
+  double pixels = 0;
+  for (int f = 0; f < count; f++)
+    pixels += (double)frames[f].width*frames[f].height;
+  pixels *= iterations;
+
+  clock_t start = clock();
+  for (int i = 0; i < iterations; i++)
+  {
+    int error = Encode(frames, count);
+    if (error != IM_ERR_NONE)
+    {
+      PrintError(error);
+      return 1;
+    }
+  }
+  double encode_time = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  unsigned int checksum = 0;
+  start = clock();
+  for (int i = 0; i < iterations; i++)
+  {
+    int error = Decode(frames, &checksum);
+    if (error != IM_ERR_NONE)
+    {
+      PrintError(error);
+      return 1;
+    }
+  }
+  double decode_time = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  FILE* file = fopen(OUT_FILE_NAME, "rb");
+  long size = 0;
+  if (file)
+  {
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fclose(file);
+  }
+
+  printf("Frames: %d  Iterations: %d  File Size: %ld  Checksum: %08X\n", count, iterations, size, checksum);
+  printf("Encode: %.3fs  %.1f Mpixels/s\n", encode_time, pixels / (encode_time * 1.0e6));
+  printf("Decode: %.3fs  %.1f Mpixels/s\n", decode_time, pixels / (decode_time * 1.0e6));
+
+  for (int f = 0; f < count; f++)
+    free(frames[f].data);
+  free(frames);
+
+  return 0;
+}
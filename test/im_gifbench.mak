@@ -0,0 +1,11 @@
+APPNAME = im_gifbench
+APPTYPE = console
+LINKER = g++
+
+SRC = im_gifbench.cpp
+
+USE_IM = Yes
+
+IM = ..
+
+USE_STATIC = Yes
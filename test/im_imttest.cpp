@@ -0,0 +1,275 @@
+/* IM 3 sample that checks the IMT format, writing and reading back several images.
+
+  Needs "im.lib".
+
+  Usage: im_imttest [temp_file]
+
+    For each data type, color mode, compression and tile size an image is saved
+    and loaded again, the data must be exactly the same.
+    Also reads views of the image and files with invalid headers.
+    The default temporary file is "im_imttest.imt", it is removed at the end.
+    Returns 0 if all the checks succeed.
+*/
+
+#include <im.h>
+#include <im_image.h>
+#include <im_util.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static const char* file_name = "im_imttest.imt";
+
+/* Random values in all the bytes, so all the bits of all data types are checked */
+static void FillImage(imImage* image, unsigned int seed)
+{
+  imbyte* data = (imbyte*)image->data[0];
+  int size = image->has_alpha? image->size + image->plane_size: image->size;
+  for (int i = 0; i < size; i++)
+  {
+    seed = seed*1103515245 + 12345;
+    /* repeated runs, so the compressors have something to do */
+    data[i] = (imbyte)(((seed >> 16) & 0x3) == 0? i/7: seed >> 16);
+  }
+}
+
+static int EqualImage(const imImage* image1, const imImage* image2)
+{
+  if (image1->width != image2->width || image1->height != image2->height ||
+      image1->color_space != image2->color_space || image1->data_type != image2->data_type ||
+      image1->has_alpha != image2->has_alpha)
+    return 0;
+
+  int size = image1->has_alpha? image1->size + image1->plane_size: image1->size;
+  return memcmp(image1->data[0], image2->data[0], size) == 0;
+}
+
+static int SaveImage(imImage* image, const char* compression, int tile_width, int tile_height, int frames)
+{
+  int error;
+  imFile* ifile = imFileNew(file_name, "IMT", &error);
+  if (!ifile)
+    return error;
+
+  imFileSetInfo(ifile, compression);
+  if (tile_width)
+  {
+    imFileSetAttribute(ifile, "TileWidth", IM_INT, 1, &tile_width);
+    imFileSetAttribute(ifile, "TileHeight", IM_INT, 1, &tile_height);
+  }
+
+  for (int f = 0; f < frames && !error; f++)
+    error = imFileSaveImage(ifile, image);
+
+  imFileClose(ifile);
+  return error;
+}
+
+static int CheckRoundTrip(int width, int height, int color_mode, int data_type, const char* compression, int tile_width, int tile_height)
+{
+  imImage* image = imImageCreate(width, height, imColorModeSpace(color_mode), data_type);
+  if (imColorModeHasAlpha(color_mode))
+    imImageAddAlpha(image);
+  FillImage(image, width*31 + height*7 + color_mode + data_type);
+
+  /* a gray palette would be saved as GRAY */
+  if (image->color_space == IM_MAP)
+  {
+    for (int i = 0; i < 256; i++)
+      image->palette[i] = imColorEncode((imbyte)i, (imbyte)(255 - i), (imbyte)(i/2));
+  }
+
+  int frames = 2, failed = 0;
+  int error = SaveImage(image, compression, tile_width, tile_height, frames);
+
+  imFile* ifile = error? NULL: imFileOpen(file_name, &error);
+  if (ifile)
+  {
+    char format[10], comp[20];
+    int image_count;
+    imFileGetInfo(ifile, format, comp, &image_count);
+    if (image_count != frames)
+      error = IM_ERR_DATA;
+
+    for (int f = 0; f < image_count && !error; f++)
+    {
+      imImage* read_image = imFileLoadImage(ifile, f, &error);
+      if (read_image)
+      {
+        if (!EqualImage(image, read_image))
+          error = IM_ERR_DATA;
+        imImageDestroy(read_image);
+      }
+    }
+
+    imFileClose(ifile);
+  }
+
+  if (error)
+  {
+    printf("%dx%d %s %s %s tile %dx%d: FAILED (error %d).\n", width, height, imColorModeSpaceName(color_mode),
+           imDataTypeName(data_type), compression, tile_width, tile_height, error);
+    failed = 1;
+  }
+
+  imImageDestroy(image);
+  return failed;
+}
+
+/* The view is in top down coordinates, the image lines are from bottom to top */
+static int CheckView(int xmin, int xmax, int ymin, int ymax)
+{
+  int width = 300, height = 200;
+  imImage* image = imImageCreate(width, height, IM_RGB, IM_USHORT);
+  FillImage(image, 77);
+
+  int error = SaveImage(image, "LZF", 64, 32, 1);
+  int failed = 0;
+
+  imFile* ifile = error? NULL: imFileOpen(file_name, &error);
+  if (ifile)
+  {
+    int w, h, color_mode, data_type;
+    error = imFileReadImageInfo(ifile, 0, &w, &h, &color_mode, &data_type);
+    imFileSetAttribute(ifile, "ViewXmin", IM_INT, 1, &xmin);
+    imFileSetAttribute(ifile, "ViewXmax", IM_INT, 1, &xmax);
+    imFileSetAttribute(ifile, "ViewYmin", IM_INT, 1, &ymin);
+    imFileSetAttribute(ifile, "ViewYmax", IM_INT, 1, &ymax);
+
+    int view_width = xmax - xmin + 1, view_height = ymax - ymin + 1;
+    imImage* view = imImageCreate(view_width, view_height, IM_RGB, IM_USHORT);
+    if (!error)
+      error = imFileReadImageData(ifile, view->data[0], 0, 0);
+
+    for (int d = 0; d < 3 && !error; d++)
+    {
+      imushort* view_data = (imushort*)view->data[d];
+      imushort* image_data = (imushort*)image->data[d];
+      for (int r = 0; r < view_height && !error; r++)
+      {
+        int y = ymin + view_height-1 - r;    /* top down line of the image */
+        if (memcmp(view_data + r*view_width, image_data + (height-1 - y)*width + xmin, view_width*sizeof(imushort)) != 0)
+          error = IM_ERR_DATA;
+      }
+    }
+
+    imImageDestroy(view);
+    imFileClose(ifile);
+  }
+
+  if (error)
+  {
+    printf("View %d-%d %d-%d: FAILED (error %d).\n", xmin, xmax, ymin, ymax, error);
+    failed = 1;
+  }
+
+  imImageDestroy(image);
+  return failed;
+}
+
+static void WriteInt(FILE* file, long offset, int value)
+{
+  fseek(file, offset, SEEK_SET);
+  fwrite(&value, sizeof(int), 1, file);
+}
+
+/* Headers with sizes that do not fit in the file must be rejected */
+static int CheckInvalidHeader(int width, int height, int tile_width, int tile_height)
+{
+  imImage* image = imImageCreate(1024, 1024, IM_GRAY, IM_BYTE);
+  int error = SaveImage(image, "NONE", 0, 0, 1);
+  imImageDestroy(image);
+  if (error)
+  {
+    printf("Invalid header %dx%d tile %dx%d: FAILED to save (error %d).\n", width, height, tile_width, tile_height, error);
+    return 1;
+  }
+
+  /* written in the CPU byte order, the image header is at first_image_offset */
+  FILE* file = fopen(file_name, "r+b");
+  unsigned int first_offset = 0;
+  fseek(file, 12, SEEK_SET);
+  if (fread(&first_offset, sizeof(int), 1, file) != 1)
+    first_offset = 0;
+  WriteInt(file, first_offset + 4, width);
+  WriteInt(file, first_offset + 8, height);
+  WriteInt(file, first_offset + 24, tile_width);
+  WriteInt(file, first_offset + 28, tile_height);
+  fclose(file);
+
+  imFile* ifile = imFileOpen(file_name, &error);
+  if (ifile)
+  {
+    int w, h, color_mode, data_type;
+    error = imFileReadImageInfo(ifile, 0, &w, &h, &color_mode, &data_type);
+    imFileClose(ifile);
+  }
+
+  if (error == IM_ERR_NONE)
+  {
+    printf("Invalid header %dx%d tile %dx%d: FAILED, accepted.\n", width, height, tile_width, tile_height);
+    return 1;
+  }
+
+  return 0;
+}
+
+int main(int argc, char* argv[])
+{
+  static const int color_modes[] = {IM_GRAY, IM_RGB, IM_RGB | IM_ALPHA, IM_MAP, IM_CMYK};
+  static const int data_types[] = {IM_BYTE, IM_USHORT, IM_INT, IM_FLOAT, IM_CFLOAT, IM_DOUBLE};
+  static const char* compressions[] = {"NONE", "DEFLATE", "LZF"};
+  static const int sizes[][2] = {{1, 1}, {133, 71}, {300, 200}};
+  static const int tiles[][2] = {{0, 0}, {37, 19}, {1, 1}};
+  int failed = 0, count = 0;
+
+  if (argc > 1)
+    file_name = argv[1];
+
+  for (int s = 0; s < (int)(sizeof(sizes)/sizeof(sizes[0])); s++)
+  {
+    for (int t = 0; t < (int)(sizeof(tiles)/sizeof(tiles[0])); t++)
+    {
+      /* 1x1 tiles only for the small images */
+      int tile_width = tiles[t][0], tile_height = tiles[t][1];
+      if (tile_width == 1 && sizes[s][0] > 1)
+        continue;
+      if (tile_width > sizes[s][0] || tile_height > sizes[s][1])
+        continue;
+
+      for (int c = 0; c < (int)(sizeof(color_modes)/sizeof(color_modes[0])); c++)
+      {
+        for (int d = 0; d < (int)(sizeof(data_types)/sizeof(data_types[0])); d++)
+        {
+          if (!imImageCheckFormat(color_modes[c], data_types[d]))
+            continue;
+
+          for (int p = 0; p < (int)(sizeof(compressions)/sizeof(compressions[0])); p++)
+          {
+            failed |= CheckRoundTrip(sizes[s][0], sizes[s][1], color_modes[c], data_types[d], compressions[p], tile_width, tile_height);
+            count++;
+          }
+        }
+      }
+    }
+  }
+
+  failed |= CheckView(0, 299, 0, 199);
+  failed |= CheckView(10, 100, 20, 150);
+  failed |= CheckView(64, 127, 32, 63);
+  failed |= CheckView(299, 299, 199, 199);
+
+  /* the tile count overflows an int */
+  failed |= CheckInvalidHeader(65537, 65536, 1, 1);
+  /* more tiles than the file can hold */
+  failed |= CheckInvalidHeader(30000, 30000, 1, 1);
+  /* the image size overflows an int */
+  failed |= CheckInvalidHeader(1 << 20, 1 << 12, 1024, 1024);
+
+  remove(file_name);
+
+  printf(failed? "FAILED\n": "All %d images are equal, views and invalid headers ok.\n", count);
+  return failed;
+}
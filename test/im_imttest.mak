@@ -0,0 +1,15 @@
+APPNAME = im_imttest
+APPTYPE = console
+LINKER = g++
+
+SRC = im_imttest.cpp
+
+USE_IM = Yes
+
+IM = ..
+
+USE_STATIC = Yes
+
+ifeq ($(findstring Win, $(TEC_SYSNAME)), )
+  LIBS = pthread
+endif
@@ -0,0 +1,196 @@
+/* IM 3 sample that measures the data compression speed,
+   of a single buffer and of independent blocks compressed in parallel.
+
+  Needs "im.lib" and "im_lzo.lib".
+
+  Usage: im_zbench [<file_name> [<block_size_kb> [<iterations>]]]
+
+    When a file is given its contents are compressed,
+    otherwise a synthetic 16 bits image of 64Mb is used.
+    Use "-" as file name to keep the synthetic data.
+
+    Example: im_zbench image.raw 256 3
+*/
+
+#include <im.h>
+#include <im_util.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+struct Method
+{
+  const char* name;
+  int method, quality;
+};
+
+static const Method methods[] =
+{
+  {"ZIP-1", IM_COMPRESS_DEFLATE, 1},
+  {"ZIP-6", IM_COMPRESS_DEFLATE, 6},
+  {"ZIP-9", IM_COMPRESS_DEFLATE, 9},
+  {"LZF",   IM_COMPRESS_LZF, 0},
+  {"LZO",   IM_COMPRESS_LZO, 0}
+};
+
+static double Now()
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* A smooth gradient with some noise, like an intermediate processing result. */
+static unsigned char* CreateData(int* size)
+{
+  int width = 4096, height = 8192;
+  unsigned short* data = (unsigned short*)malloc(width*height*sizeof(unsigned short));
+  unsigned int seed = 1;
+
+  for (int y = 0; y < height; y++)
+  {
+    unsigned short* line = data + y*width;
+    for (int x = 0; x < width; x++)
+    {
+      seed = seed*1103515245 + 12345;
+      line[x] = (unsigned short)((x + y)/4 + ((seed >> 16) & 3));
+    }
+  }
+
+  *size = width*height*sizeof(unsigned short);
+  return (unsigned char*)data;
+}
+
+static unsigned char* LoadData(const char* file_name, int* size)
+{
+  FILE* file = fopen(file_name, "rb");
+  if (!file)
+  {
+    printf("Error Opening File.\n");
+    return NULL;
+  }
+
+  fseek(file, 0, SEEK_END);
+  *size = (int)ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  unsigned char* data = (unsigned char*)malloc(*size);
+  if (!data || fread(data, 1, *size, file) != (size_t)*size)
+  {
+    printf("Error Accessing File.\n");
+    fclose(file);
+    free(data);
+    return NULL;
+  }
+
+  fclose(file);
+  return data;
+}
+
+static int CompressSingle(const Method* m, const unsigned char* src, int src_size, unsigned char* dst, int dst_size)
+{
+  switch (m->method)
+  {
+  case IM_COMPRESS_DEFLATE:
+    return imCompressDataZ(src, src_size, dst, dst_size, m->quality);
+  case IM_COMPRESS_LZF:
+    return imCompressDataLZF(src, src_size, dst, dst_size);
+  case IM_COMPRESS_LZO:
+    return imCompressDataLZO(src, src_size, dst, dst_size);
+  }
+  return 0;
+}
+
+static int UnCompressSingle(const Method* m, const unsigned char* src, int src_size, unsigned char* dst, int dst_size)
+{
+  switch (m->method)
+  {
+  case IM_COMPRESS_DEFLATE:
+    return imCompressDataUnZ(src, src_size, dst, dst_size);
+  case IM_COMPRESS_LZF:
+    return imCompressDataUnLZF(src, src_size, dst, dst_size);
+  case IM_COMPRESS_LZO:
+    return imCompressDataUnLZO(src, src_size, dst, dst_size);
+  }
+  return 0;
+}
+
+static void PrintResult(const char* name, const char* mode, double mb, int size, int comp_size, 
+                        double comp_time, double uncomp_time, int ok)
+{
+  printf("%-6s %-7s  %6.2f%%  %8.1f MB/s  %8.1f MB/s  %s\n", name, mode,
+         (100.0*comp_size)/size, mb/comp_time, mb/uncomp_time, ok? "": "MISMATCH");
+}
+
+int main(int argc, char* argv[])
+{
+  int size, block_size = 0, iterations = 3;
+  unsigned char* data;
+
+  if (argc > 1 && strcmp(argv[1], "-") != 0)
+    data = LoadData(argv[1], &size);
+  else
+    data = CreateData(&size);
+
+  if (!data)
+    return 1;
+
+  if (argc > 2)
+    block_size = atoi(argv[2])*1024;
+  if (argc > 3)
+    iterations = atoi(argv[3]);
+  if (iterations < 1)
+    iterations = 1;
+
+  /* the LZO functions are in a separate library, they must be registered to be used by blocks */
+  imCompressSetLZO(imCompressDataLZO, imCompressDataUnLZO);
+
+  int dst_size = imCompressDataBlocksSize(size, block_size);
+  unsigned char* dst = (unsigned char*)malloc(dst_size);
+  unsigned char* check = (unsigned char*)malloc(size);
+  double mb = (double)size*iterations / (1024.0*1024.0);
+
+  printf("Size: %d bytes  Block Size: %d Kb  Iterations: %d\n", size, block_size? block_size/1024: 512, iterations);
+  printf("Method Mode        Ratio      Compress    Uncompress\n");
+
+  for (int i = 0; i < (int)(sizeof(methods)/sizeof(methods[0])); i++)
+  {
+    const Method* m = methods + i;
+    int comp_size = 0, ok;
+    double start;
+
+    start = Now();
+    for (int it = 0; it < iterations; it++)
+      comp_size = CompressSingle(m, data, size, dst, dst_size);
+    double comp_time = Now() - start;
+
+    memset(check, 0, size);
+    start = Now();
+    for (int it = 0; it < iterations; it++)
+      UnCompressSingle(m, dst, comp_size, check, size);
+    double uncomp_time = Now() - start;
+
+    ok = comp_size > 0 && memcmp(data, check, size) == 0;
+    PrintResult(m->name, "single", mb, size, comp_size, comp_time, uncomp_time, ok);
+
+    start = Now();
+    for (int it = 0; it < iterations; it++)
+      comp_size = imCompressDataBlocks(data, size, dst, dst_size, m->method, m->quality, block_size);
+    comp_time = Now() - start;
+
+    memset(check, 0, size);
+    start = Now();
+    for (int it = 0; it < iterations; it++)
+      imCompressDataUnBlocks(dst, comp_size, check, size);
+    uncomp_time = Now() - start;
+
+    ok = comp_size > 0 && memcmp(data, check, size) == 0;
+    PrintResult(m->name, "blocks", mb, size, comp_size, comp_time, uncomp_time, ok);
+  }
+
+  free(check);
+  free(dst);
+  free(data);
+
+  return 0;
+}
@@ -0,0 +1,17 @@
+APPNAME = im_zbench
+APPTYPE = console
+LINKER = g++
+
+SRC = im_zbench.cpp
+
+USE_IM = Yes
+
+IM = ..
+
+USE_STATIC = Yes
+
+SLIB = $(IM_LIB)/libim_lzo.a
+
+ifeq ($(findstring Win, $(TEC_SYSNAME)), )
+  LIBS = pthread
+endif